@@ -32,6 +32,7 @@
 
 #include <core/frame/frame.h>
 #include <core/frame/frame_transform.h>
+#include <core/frame/geometry.h>
 #include <core/frame/pixel_format.h>
 #include <core/video_format.h>
 
@@ -47,6 +48,7 @@
 #include <boost/thread/future.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <vector>
 #include <set>
@@ -73,6 +75,7 @@ struct item
 	core::pixel_format_desc			pix_desc	= core::pixel_format::invalid;
 	std::array<const uint8_t*, 4>	data;
 	core::image_transform			transform;
+	core::frame_geometry			geometry	= core::frame_geometry::get_default();
 
 	item()
 	{
@@ -82,7 +85,7 @@ struct item
 
 bool operator==(const item& lhs, const item& rhs)
 {
-	return lhs.data == rhs.data && lhs.transform == rhs.transform;
+	return lhs.data == rhs.data && lhs.transform == rhs.transform && lhs.geometry.data() == rhs.geometry.data();
 }
 
 bool operator!=(const item& lhs, const item& rhs)
@@ -145,6 +148,197 @@ static void kernel(uint8_t* dest, const uint8_t* source, size_t count)
 		kernel<temporal_tag, aligned_tag>(dest, source, count);
 }
 
+// A quad of a quad_list mapped to pixel coordinates. Screen positions are
+// mapped back to texture coordinates by inverting the affine mapping given by
+// the upper left, upper right and lower left corners.
+struct raster_quad
+{
+	double	origin_x;
+	double	origin_y;
+	double	inv[4];			// screen delta -> quad coordinates (a, b)
+	double	texture_x;		// texture coordinate at the origin, in texels
+	double	texture_y;
+	double	texture_dx[2];	// texture delta per a and b, in texels
+	double	texture_dy[2];
+	int		min_x;
+	int		max_x;
+	int		min_y;
+	int		max_y;
+};
+
+// Renders quad_list geometry (used by the text producer to draw glyphs from
+// its texture atlas) with the fill transform applied, one row at a time
+// straight into the target. The nearest texels under a quad are gathered into
+// a scratch row one pixel at a time and composited with the same SSE kernel as
+// other items.
+class quad_list_rasterizer
+{
+	std::vector<raster_quad>	quads_;
+	const uint8_t*				texture_;
+	int							texture_width_;
+	int							texture_height_;
+	uint32_t					opacity_;
+public:
+	quad_list_rasterizer(const item& source, int width, int height, double aspect_ratio)
+		: quads_(to_raster_quads(source, width, height, aspect_ratio))
+		, texture_(source.data.at(0))
+		, texture_width_(source.pix_desc.planes.at(0).width)
+		, texture_height_(source.pix_desc.planes.at(0).height)
+		, opacity_(static_cast<uint32_t>(std::max(0.0, std::min(1.0, source.transform.opacity)) * 255.0 + 0.5))
+	{
+	}
+
+	// scratch must hold at least width pixels.
+	void draw_row(uint8_t* dest, uint8_t* scratch, int y, int width) const
+	{
+		for (auto& quad : quads_)
+		{
+			if (y < quad.min_y || y > quad.max_y)
+				continue;
+
+			auto begin = quad.min_x;
+			auto end = std::min(width, quad.max_x + 1);
+			auto count = end - begin;
+
+			if (count <= 0)
+				continue;
+
+			auto dy = y + 0.5 - quad.origin_y;
+			auto dx = begin + 0.5 - quad.origin_x;
+
+			// Quad coordinates at the first pixel and their increment per pixel.
+			auto a = quad.inv[0] * dx + quad.inv[1] * dy;
+			auto b = quad.inv[2] * dx + quad.inv[3] * dy;
+			auto da = quad.inv[0];
+			auto db = quad.inv[2];
+
+			for (int n = 0; n < count; ++n, a += da, b += db)
+			{
+				auto pixel = scratch + n * 4;
+				std::fill_n(pixel, 4, 0);
+				sample(quad, a, b, pixel);
+			}
+
+			// The kernel blends 8 pixels at a time, so the rest of the span is
+			// blended one pixel at a time to never touch pixels outside of it.
+			auto simd_count = count & ~7;
+
+			if (simd_count > 0)
+				kernel<xmm::temporal_tag>(dest + begin * 4, scratch, simd_count * 4);
+
+			for (int n = simd_count; n < count; ++n)
+				blend_pixel(dest + (begin + n) * 4, scratch + n * 4);
+		}
+	}
+private:
+	// The scalar equivalent of blend(), with the same rounding.
+	static void blend_pixel(uint8_t* dest, const uint8_t* source)
+	{
+		auto alpha = source[3];
+
+		for (int c = 0; c < 4; ++c)
+		{
+			auto s = std::min(source[c], alpha);
+			auto t = dest[c] * alpha + 0x80;
+
+			dest[c] = static_cast<uint8_t>(dest[c] + s - (((t >> 8) + t) >> 8));
+		}
+	}
+
+	// Nearest texel at the quad coordinates (a, b) premultiplied by the
+	// opacity. result is left as is outside of the quad or the atlas.
+	void sample(const raster_quad& quad, double a, double b, uint8_t* result) const
+	{
+		if (a < 0.0 || a >= 1.0 || b < 0.0 || b >= 1.0)
+			return;
+
+		auto u = static_cast<int>(quad.texture_x + a * quad.texture_dx[0] + b * quad.texture_dx[1]);
+		auto v = static_cast<int>(quad.texture_y + a * quad.texture_dy[0] + b * quad.texture_dy[1]);
+
+		if (u < 0 || v < 0 || u >= texture_width_ || v >= texture_height_)
+			return;
+
+		auto texel = texture_ + (v * texture_width_ + u) * 4;
+
+		if (opacity_ == 255)
+			std::copy_n(texel, 4, result);
+		else
+			for (int c = 0; c < 4; ++c)
+				result[c] = static_cast<uint8_t>((texel[c] * opacity_ + 127) / 255);
+	}
+
+	static std::vector<raster_quad> to_raster_quads(const item& source, int width, int height, double aspect_ratio)
+	{
+		auto& transform = source.transform;
+		auto& coords = source.geometry.data();
+		auto& plane = source.pix_desc.planes.at(0);
+		auto angle = transform.angle;
+		auto cos_angle = std::cos(angle);
+		auto sin_angle = std::sin(angle);
+
+		// The same vertex transform as the OpenGL image kernel.
+		auto to_screen = [&](const core::frame_geometry::coord& coord, double& x, double& y)
+		{
+			auto orig_x = (coord.vertex_x - transform.anchor[0]) * transform.fill_scale[0];
+			auto orig_y = (coord.vertex_y - transform.anchor[1]) * transform.fill_scale[1] / aspect_ratio;
+			x = (orig_x * cos_angle - orig_y * sin_angle + transform.fill_translation[0]) * width;
+			y = ((orig_x * sin_angle + orig_y * cos_angle) * aspect_ratio + transform.fill_translation[1]) * height;
+		};
+
+		std::vector<raster_quad> result;
+		result.reserve(coords.size() / 4);
+
+		for (std::size_t i = 0; i + 3 < coords.size(); i += 4)
+		{
+			auto& ul = coords[i];
+			auto& ur = coords[i + 1];
+			auto& lr = coords[i + 2];
+			auto& ll = coords[i + 3];
+
+			double x[4], y[4];
+			to_screen(ul, x[0], y[0]);
+			to_screen(ur, x[1], y[1]);
+			to_screen(lr, x[2], y[2]);
+			to_screen(ll, x[3], y[3]);
+
+			auto ex_x = x[1] - x[0];
+			auto ex_y = y[1] - y[0];
+			auto ey_x = x[3] - x[0];
+			auto ey_y = y[3] - y[0];
+			auto determinant = ex_x * ey_y - ey_x * ex_y;
+
+			// Degenerate, for example glyphs missing in the atlas.
+			if (std::abs(determinant) < 0.0001)
+				continue;
+
+			raster_quad quad;
+			quad.origin_x		= x[0];
+			quad.origin_y		= y[0];
+			quad.inv[0]			= ey_y / determinant;
+			quad.inv[1]			= -ey_x / determinant;
+			quad.inv[2]			= -ex_y / determinant;
+			quad.inv[3]			= ex_x / determinant;
+			quad.texture_x		= ul.texture_x * plane.width;
+			quad.texture_y		= ul.texture_y * plane.height;
+			quad.texture_dx[0]	= (ur.texture_x - ul.texture_x) * plane.width;
+			quad.texture_dx[1]	= (ll.texture_x - ul.texture_x) * plane.width;
+			quad.texture_dy[0]	= (ur.texture_y - ul.texture_y) * plane.height;
+			quad.texture_dy[1]	= (ll.texture_y - ul.texture_y) * plane.height;
+			quad.min_x			= std::max(0, static_cast<int>(std::floor(*std::min_element(x, x + 4))));
+			quad.max_x			= std::min(width - 1, static_cast<int>(std::ceil(*std::max_element(x, x + 4))));
+			quad.min_y			= std::max(0, static_cast<int>(std::floor(*std::min_element(y, y + 4))));
+			quad.max_y			= std::min(height - 1, static_cast<int>(std::ceil(*std::max_element(y, y + 4))));
+
+			if (quad.min_x > quad.max_x || quad.min_y > quad.max_y)
+				continue;
+
+			result.push_back(quad);
+		}
+
+		return result;
+	}
+};
+
 class image_renderer
 {
 	tbb::concurrent_unordered_map<int64_t, tbb::concurrent_bounded_queue<std::shared_ptr<SwsContext>>>	sws_devices_;
@@ -196,6 +390,17 @@ private:
 		auto start = field_mode == core::field_mode::lower ? 1 : 0;
 		auto step  = field_mode == core::field_mode::progressive ? 1 : 2;
 
+		auto aspect_ratio = static_cast<double>(format_desc_.square_width) / static_cast<double>(format_desc_.square_height);
+		std::vector<std::unique_ptr<quad_list_rasterizer>> rasterizers(items.size());
+
+		for (std::size_t n = 0; n < items.size(); ++n)
+		{
+			if (has_custom_geometry(items[n]))
+				rasterizers[n].reset(new quad_list_rasterizer(items[n], static_cast<int>(width), static_cast<int>(height), aspect_ratio));
+		}
+
+		auto has_geometry = std::any_of(rasterizers.begin(), rasterizers.end(), [](const std::unique_ptr<quad_list_rasterizer>& r) { return static_cast<bool>(r); });
+
 		// TODO: Add support for fill translations.
 		// TODO: Add support for mask rect.
 		// TODO: Add support for opacity.
@@ -205,33 +410,53 @@ private:
 		// TODO: Add support for slide transition.
 		tbb::parallel_for(tbb::blocked_range<std::size_t>(0, height/step), [&](const tbb::blocked_range<std::size_t>& r)
 		{
+			buffer scratch(has_geometry ? width * 4 : 0);
+
 			for(auto i = r.begin(); i != r.end(); ++i)
 			{
 				auto y = i*step+start;
+				auto row = dest + y*width*4;
 
-				for(std::size_t n = 0; n < items.size()-1; ++n)
-					kernel<xmm::temporal_tag>(dest + y*width*4, items[n].data.at(0) + y*width*4, width*4);
-
-				std::size_t n = items.size()-1;
-				kernel<xmm::nontemporal_tag>(dest + y*width*4, items[n].data.at(0) + y*width*4, width*4);
+				for(std::size_t n = 0; n < items.size(); ++n)
+				{
+					if(rasterizers[n])
+						rasterizers[n]->draw_row(row, scratch.data(), static_cast<int>(y), static_cast<int>(width));
+					else if(n < items.size()-1)
+						kernel<xmm::temporal_tag>(row, items[n].data.at(0) + y*width*4, width*4);
+					else
+						kernel<xmm::nontemporal_tag>(row, items[n].data.at(0) + y*width*4, width*4);
+				}
 			}
 
 			_mm_mfence();
 		});
 	}
 
-	void convert(std::vector<item>& source_items, int width, int height)
+	static bool has_custom_geometry(const item& item)
+	{
+		return item.geometry.data() != core::frame_geometry::get_default().data();
+	}
+
+	// Converts every item to BGRA. Items are scaled to the frame, except for
+	// the ones with custom geometry, which are sampled by the rasterizer and
+	// keep their size.
+	void convert(std::vector<item>& source_items, int frame_width, int frame_height)
 	{
-		std::set<std::array<const uint8_t*, 4>> buffers;
+		typedef std::pair<std::array<const uint8_t*, 4>, bool> buffer_entry;
+		std::set<buffer_entry> buffers;
 
 		for (auto& item : source_items)
-			buffers.insert(item.data);
+			buffers.insert(std::make_pair(item.data, has_custom_geometry(item)));
 
 		auto dest_items = source_items;
 
-		tbb::parallel_for_each(buffers.begin(), buffers.end(), [&](const std::array<const uint8_t*, 4>& data)
+		tbb::parallel_for_each(buffers.begin(), buffers.end(), [&](const buffer_entry& entry)
 		{
+			auto& data = entry.first;
+			auto custom_geometry = entry.second;
 			auto pix_desc = std::find_if(source_items.begin(), source_items.end(), [&](const item& item){return item.data == data;})->pix_desc;
+			auto width = custom_geometry ? pix_desc.planes.at(0).width : frame_width;
+			auto height = custom_geometry ? pix_desc.planes.at(0).height : frame_height;
 
 			if(pix_desc.format == core::pixel_format::bgra &&
 				pix_desc.planes.at(0).width == width &&
@@ -247,7 +472,8 @@ private:
 
 			int64_t key = ((static_cast<int64_t>(input_av_frame->width)	 << 32) & 0xFFFF00000000) |
 						  ((static_cast<int64_t>(input_av_frame->height) << 16) & 0xFFFF0000) |
-						  ((static_cast<int64_t>(input_av_frame->format) <<  8) & 0xFF00);
+						  ((static_cast<int64_t>(input_av_frame->format) <<  8) & 0xFF00) |
+						  (custom_geometry ? 1 : 0);
 
 			auto& pool = sws_devices_[key];
 
@@ -274,7 +500,7 @@ private:
 
 			for(std::size_t n = 0; n < source_items.size(); ++n)
 			{
-				if(source_items[n].data == data)
+				if(source_items[n].data == data && has_custom_geometry(source_items[n]) == custom_geometry)
 				{
 					dest_items[n].data.fill(0);
 					dest_items[n].data[0]			= dest_frame->data();
@@ -323,6 +549,7 @@ public:
 		item item;
 		item.pix_desc	= frame.pixel_format_desc();
 		item.transform	= transform_stack_.back();
+		item.geometry	= frame.geometry();
 		for(int n = 0; n < item.pix_desc.planes.size(); ++n)
 			item.data.at(n) = frame.image_data(n).begin();
 
@@ -357,6 +584,7 @@ void image_mixer::push(const core::frame_transform& transform){impl_->push(trans
 void image_mixer::visit(const core::const_frame& frame){impl_->visit(frame);}
 void image_mixer::pop(){impl_->pop();}
 int image_mixer::get_max_frame_size() { return std::numeric_limits<int>::max(); }
+bool image_mixer::mixes_on_cpu() const { return true; }
 std::future<array<const std::uint8_t>> image_mixer::operator()(const core::video_format_desc& format_desc, bool /* straighten_alpha */){return impl_->render(format_desc);}
 core::mutable_frame image_mixer::create_frame(const void* tag, const core::pixel_format_desc& desc, const core::audio_channel_layout& channel_layout) {return impl_->create_frame(tag, desc, channel_layout);}
 
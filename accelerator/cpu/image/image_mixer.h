@@ -38,6 +38,7 @@ public:
 
 	// Properties
 	int get_max_frame_size() override;
+	bool mixes_on_cpu() const override;
 private:
 	struct impl;
 	spl::unique_ptr<impl> impl_;
@@ -0,0 +1,159 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#include "stdafx.h"
+
+#include "cpu_affinity.h"
+
+#include "except.h"
+#include "log.h"
+#include "thread_info.h"
+#include "utf.h"
+#include "os/threading.h"
+
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+
+namespace caspar {
+
+std::vector<int> parse_processor_list(const std::wstring& list)
+{
+	std::vector<std::wstring> items;
+	std::vector<int> result;
+
+	boost::split(items, list, boost::is_any_of(L","));
+
+	for (auto item : items)
+	{
+		boost::trim(item);
+
+		if (item.empty())
+			continue;
+
+		try
+		{
+			auto dash = item.find(L'-');
+			auto first = boost::lexical_cast<int>(boost::trim_copy(item.substr(0, dash)));
+			auto last = dash == std::wstring::npos ? first : boost::lexical_cast<int>(boost::trim_copy(item.substr(dash + 1)));
+
+			if (first < 0 || last < first)
+				CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Invalid processor range: " + item));
+
+			for (int processor = first; processor <= last; ++processor)
+				result.push_back(processor);
+		}
+		catch (const boost::bad_lexical_cast&)
+		{
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Invalid processor list: " + list));
+		}
+	}
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+
+	return result;
+}
+
+std::wstring print_processor_list(const std::vector<int>& processors)
+{
+	std::wstring result;
+
+	for (size_t i = 0; i < processors.size();)
+	{
+		auto last = i;
+
+		while (last + 1 < processors.size() && processors[last + 1] == processors[last] + 1)
+			++last;
+
+		if (!result.empty())
+			result += L",";
+
+		result += boost::lexical_cast<std::wstring>(processors[i]);
+
+		if (last > i)
+			result += L"-" + boost::lexical_cast<std::wstring>(processors[last]);
+
+		i = last + 1;
+	}
+
+	return result;
+}
+
+cpu_affinity::cpu_affinity()
+{
+}
+
+cpu_affinity cpu_affinity::from_processor_list(const std::wstring& list)
+{
+	cpu_affinity result;
+
+	result.processors_	= parse_processor_list(list);
+	result.description_	= print_processor_list(result.processors_);
+
+	return result;
+}
+
+cpu_affinity cpu_affinity::from_numa_node(int node)
+{
+	cpu_affinity result;
+
+	result.processors_ = get_numa_node_processors(node);
+
+	if (result.processors_.empty())
+		CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"No processors found for NUMA node " + boost::lexical_cast<std::wstring>(node)));
+
+	result.description_ = L"node " + boost::lexical_cast<std::wstring>(node) + L": " + print_processor_list(result.processors_);
+
+	return result;
+}
+
+bool cpu_affinity::empty() const
+{
+	return processors_.empty();
+}
+
+const std::vector<int>& cpu_affinity::processors() const
+{
+	return processors_;
+}
+
+std::wstring cpu_affinity::print() const
+{
+	return description_;
+}
+
+void cpu_affinity::bind_current_thread() const
+{
+	if (empty())
+		return;
+
+	if (set_affinity_of_current_thread(processors_))
+		get_thread_info().affinity = u8(description_);
+	else
+		CASPAR_LOG(warning) << L"Failed to bind " << u16(get_thread_info().name) << L" to processors " << description_;
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace caspar {
+
+/**
+ * A set of logical processors that threads are bound to, like the processors
+ * of the NUMA node where the frames of a channel are allocated. The default
+ * constructed affinity does not restrict threads.
+ */
+class cpu_affinity
+{
+	std::vector<int>	processors_;
+	std::wstring		description_;
+public:
+	cpu_affinity();
+
+	/**
+	 * @param list	Processor indices and ranges, like "0-7,16-23".
+	 */
+	static cpu_affinity from_processor_list(const std::wstring& list);
+	static cpu_affinity from_numa_node(int node);
+
+	bool empty() const;
+	const std::vector<int>& processors() const;
+	std::wstring print() const;
+
+	/**
+	 * Binds the calling thread to the processors and records it in the
+	 * thread_info of the thread. Does nothing if empty.
+	 */
+	void bind_current_thread() const;
+};
+
+std::vector<int> parse_processor_list(const std::wstring& list);
+std::wstring print_processor_list(const std::vector<int>& processors);
+
+}
@@ -0,0 +1,188 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../stdafx.h"
+
+#include "latency_stats.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace caspar { namespace diagnostics {
+
+namespace {
+
+// About 38 hours, which keeps the highest bucket within NUM_BUCKETS.
+const std::int64_t MAX_VALUE = (static_cast<std::int64_t>(1) << 37) - 1;
+
+}
+
+const int latency_histogram::SUB_BUCKETS;
+const int latency_histogram::NUM_BUCKETS;
+
+latency_histogram::snapshot::snapshot()
+	: counts_(NUM_BUCKETS, 0)
+{
+}
+
+double latency_histogram::snapshot::mean() const
+{
+	return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+std::int64_t latency_histogram::snapshot::value_at(double quantile) const
+{
+	if (count_ == 0)
+		return 0;
+
+	auto target = static_cast<std::uint64_t>(std::ceil(std::min(1.0, std::max(0.0, quantile)) * count_));
+	target = std::max<std::uint64_t>(target, 1);
+	std::uint64_t seen = 0;
+
+	for (int bucket = 0; bucket < NUM_BUCKETS; ++bucket)
+	{
+		seen += counts_[bucket];
+
+		if (seen >= target)
+			return std::min(highest_equivalent_value(bucket), max_);
+	}
+
+	return max_;
+}
+
+latency_histogram::snapshot latency_histogram::snapshot::since(const snapshot& earlier) const
+{
+	snapshot result;
+
+	for (int bucket = 0; bucket < NUM_BUCKETS; ++bucket)
+	{
+		auto count = counts_[bucket] - std::min(counts_[bucket], earlier.counts_[bucket]);
+
+		result.counts_[bucket] = count;
+		result.count_ += count;
+
+		if (count > 0)
+			result.max_ = highest_equivalent_value(bucket);
+	}
+
+	result.sum_ = sum_ - std::min(sum_, earlier.sum_);
+	result.max_ = std::min(result.max_, max_);
+
+	return result;
+}
+
+latency_histogram::latency_histogram()
+{
+	reset();
+}
+
+latency_histogram::snapshot latency_histogram::get_snapshot() const
+{
+	snapshot result;
+
+	// The counters are read one by one while others may be recording, so the
+	// count is the sum of what was read to be consistent with the buckets.
+	for (int bucket = 0; bucket < NUM_BUCKETS; ++bucket)
+	{
+		result.counts_[bucket] = counts_[bucket];
+		result.count_ += result.counts_[bucket];
+	}
+
+	result.sum_ = sum_;
+	result.max_ = max_;
+
+	return result;
+}
+
+void latency_histogram::reset()
+{
+	for (auto& count : counts_)
+		count = 0;
+
+	sum_ = 0;
+	max_ = 0;
+}
+
+int latency_histogram::bucket_of(std::int64_t value)
+{
+	value = std::min(std::max<std::int64_t>(value, 0), MAX_VALUE);
+
+	if (value < SUB_BUCKETS)
+		return static_cast<int>(value);
+
+	int msb = 4;
+
+	while (value >> (msb + 1))
+		++msb;
+
+	int shift = msb - 4;
+
+	return (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+}
+
+std::int64_t latency_histogram::highest_equivalent_value(int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	int shift		= bucket / SUB_BUCKETS - 1;
+	auto sub_bucket	= static_cast<std::int64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS);
+
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+latency_stats::latency_stats()
+{
+	late_		= 0;
+	underflows_	= 0;
+	budget_		= 0;
+}
+
+boost::property_tree::wptree latency_stats::info() const
+{
+	boost::property_tree::wptree info;
+	auto snapshot = histogram_.get_snapshot();
+
+	// In microseconds
+	info.add(L"count",		snapshot.count());
+	info.add(L"mean",		static_cast<std::int64_t>(snapshot.mean()));
+	info.add(L"p50",		snapshot.value_at(0.5));
+	info.add(L"p90",		snapshot.value_at(0.9));
+	info.add(L"p99",		snapshot.value_at(0.99));
+	info.add(L"p999",		snapshot.value_at(0.999));
+	info.add(L"max",		snapshot.max());
+	info.add(L"budget",		budget());
+	info.add(L"late",		late());
+	info.add(L"underflows",	underflows());
+
+	return info;
+}
+
+void latency_stats::reset()
+{
+	histogram_.reset();
+	late_		= 0;
+	underflows_	= 0;
+}
+
+}}
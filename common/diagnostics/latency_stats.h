@@ -0,0 +1,167 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <tbb/atomic.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace caspar { namespace diagnostics {
+
+/**
+ * Histogram of latencies in microseconds, bucketed like HdrHistogram with 16
+ * linear sub-buckets per power of two, so every value is known within 1/16 of
+ * itself. The buckets are a fixed array of atomic counters, so recording is
+ * lock-free and can be done from any thread while others read.
+ */
+class latency_histogram : boost::noncopyable
+{
+public:
+	static const int SUB_BUCKETS	= 16;
+	static const int NUM_BUCKETS	= (33 + 1) * SUB_BUCKETS;
+
+	/**
+	 * A copy of the counters. The difference between two snapshots of the
+	 * same histogram is the histogram of the values recorded in between.
+	 */
+	class snapshot
+	{
+		std::vector<std::uint64_t>	counts_;
+		std::uint64_t				count_	= 0;
+		std::uint64_t				sum_	= 0;
+		std::int64_t				max_	= 0;
+
+		friend class latency_histogram;
+	public:
+		snapshot();
+
+		std::uint64_t count() const { return count_; }
+		std::int64_t max() const { return max_; }
+		double mean() const;
+
+		/**
+		 * @param quantile	In the range [0.0, 1.0].
+		 *
+		 * @return			The highest value equivalent to the value at the
+		 *					given quantile, but never more than max().
+		 */
+		std::int64_t value_at(double quantile) const;
+
+		/**
+		 * @return The values recorded after earlier and up to this. The max
+		 *         is the upper bound of the highest bucket.
+		 */
+		snapshot since(const snapshot& earlier) const;
+	};
+
+	latency_histogram();
+
+	void record(std::int64_t micros)
+	{
+		if (micros < 0)
+			micros = 0;
+
+		counts_[bucket_of(micros)].fetch_and_increment();
+		sum_.fetch_and_add(static_cast<std::uint64_t>(micros));
+
+		std::int64_t max = max_;
+
+		while (micros > max)
+		{
+			auto previous = max_.compare_and_swap(micros, max);
+
+			if (previous == max)
+				break;
+
+			max = previous;
+		}
+	}
+
+	snapshot get_snapshot() const;
+	void reset();
+
+	static int bucket_of(std::int64_t value);
+	static std::int64_t highest_equivalent_value(int bucket);
+private:
+	tbb::atomic<std::uint64_t>	counts_[NUM_BUCKETS];
+	tbb::atomic<std::uint64_t>	sum_;
+	tbb::atomic<std::int64_t>	max_;
+};
+
+/**
+ * Latencies of one stage of the frame pipeline, for example the mixer of a
+ * channel, measured against the frame budget, together with counters of the
+ * frames that were late (took longer than the budget) and of underflows (no
+ * frame was ready in time).
+ */
+class latency_stats : boost::noncopyable
+{
+	latency_histogram			histogram_;
+	tbb::atomic<std::uint64_t>	late_;
+	tbb::atomic<std::uint64_t>	underflows_;
+	tbb::atomic<std::int64_t>	budget_;
+public:
+	latency_stats();
+
+	/**
+	 * @param budget_micros	The time available per frame, or 0 if there is
+	 *						no deadline, like when freewheeling.
+	 */
+	void record(std::int64_t micros, std::int64_t budget_micros)
+	{
+		histogram_.record(micros);
+		budget_ = budget_micros;
+
+		if (budget_micros > 0 && micros > budget_micros)
+			late_.fetch_and_increment();
+	}
+
+	/**
+	 * Records a duration in seconds against the duration of a frame at fps.
+	 */
+	void record_frame_time(double seconds, double fps)
+	{
+		record(
+				static_cast<std::int64_t>(seconds * 1000000.0),
+				fps > 0.0 ? static_cast<std::int64_t>(1000000.0 / fps) : 0);
+	}
+
+	void record_underflow()
+	{
+		underflows_.fetch_and_increment();
+	}
+
+	std::uint64_t late() const { return late_; }
+	std::uint64_t underflows() const { return underflows_; }
+	std::int64_t budget() const { return budget_; }
+
+	latency_histogram::snapshot get_snapshot() const { return histogram_.get_snapshot(); }
+
+	boost::property_tree::wptree info() const;
+	void reset();
+};
+
+}}
@@ -0,0 +1,276 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../stdafx.h"
+
+#include "memory_accounting.h"
+
+#include <tbb/atomic.h>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace caspar { namespace diagnostics {
+
+namespace {
+
+struct subsystem : boost::noncopyable
+{
+	const std::wstring			name;
+	tbb::atomic<std::int64_t>	used;
+	tbb::atomic<std::int64_t>	budget;
+
+	explicit subsystem(const std::wstring& name)
+		: name(name)
+	{
+		used	= 0;
+		budget	= 0;
+	}
+
+	bool over_budget() const
+	{
+		std::int64_t limit = budget;
+
+		return limit > 0 && used > limit;
+	}
+};
+
+}
+
+struct memory_account::impl : boost::noncopyable
+{
+	subsystem&					subsystem_;
+	const int					channel_;
+	const int					layer_;
+	tbb::atomic<std::int64_t>	bytes_;
+
+	impl(subsystem& subsystem, int channel, int layer)
+		: subsystem_(subsystem)
+		, channel_(channel)
+		, layer_(layer)
+	{
+		bytes_ = 0;
+	}
+};
+
+namespace {
+
+class memory_registry : boost::noncopyable
+{
+	boost::mutex										mutex_;
+	std::map<std::wstring, std::unique_ptr<subsystem>>	subsystems_; // Never removed, so references stay valid.
+	std::set<const memory_account::impl*>				accounts_;
+	tbb::atomic<std::int64_t>							used_;
+	tbb::atomic<std::int64_t>							budget_;
+public:
+	static memory_registry& instance()
+	{
+		// Leaked, since accounts may be destroyed during static destruction,
+		// like the one of the image cache.
+		static memory_registry* instance = new memory_registry;
+
+		return *instance;
+	}
+
+	subsystem& get_subsystem(const std::wstring& name)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		auto& result = subsystems_[name];
+
+		if (!result)
+			result.reset(new subsystem(name));
+
+		return *result;
+	}
+
+	void add(const memory_account::impl& account)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		accounts_.insert(&account);
+	}
+
+	void remove(const memory_account::impl& account)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		accounts_.erase(&account);
+	}
+
+	void change_usage(subsystem& subsystem, std::int64_t delta)
+	{
+		subsystem.used.fetch_and_add(delta);
+		used_.fetch_and_add(delta);
+	}
+
+	bool over_budget() const
+	{
+		std::int64_t limit = budget_;
+
+		return limit > 0 && used_ > limit;
+	}
+
+	void set_budget(std::int64_t bytes)
+	{
+		budget_ = std::max<std::int64_t>(0, bytes);
+	}
+
+	std::int64_t used() const
+	{
+		return used_;
+	}
+
+	boost::property_tree::wptree info()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		typedef std::map<std::pair<int, int>, std::int64_t> usage_per_owner;
+		std::map<const subsystem*, usage_per_owner> owners;
+
+		for (auto account : accounts_)
+		{
+			std::int64_t bytes = account->bytes_;
+
+			if (bytes != 0)
+				owners[&account->subsystem_][std::make_pair(account->channel_, account->layer_)] += bytes;
+		}
+
+		boost::property_tree::wptree info;
+
+		info.add(L"used",	used());
+		info.add(L"budget",	static_cast<std::int64_t>(budget_));
+
+		auto& subsystems_info = info.add_child(L"subsystems", boost::property_tree::wptree());
+
+		for (auto& entry : subsystems_)
+		{
+			auto& subsystem = *entry.second;
+			boost::property_tree::wptree subsystem_info;
+
+			subsystem_info.add(L"name",		subsystem.name);
+			subsystem_info.add(L"used",		static_cast<std::int64_t>(subsystem.used));
+			subsystem_info.add(L"budget",	static_cast<std::int64_t>(subsystem.budget));
+
+			auto& owners_info = subsystem_info.add_child(L"owners", boost::property_tree::wptree());
+
+			for (auto& owner : owners[&subsystem])
+			{
+				boost::property_tree::wptree owner_info;
+
+				if (owner.first.first != -1)
+					owner_info.add(L"channel", owner.first.first);
+
+				if (owner.first.second != -1)
+					owner_info.add(L"layer", owner.first.second);
+
+				owner_info.add(L"used", owner.second);
+				owners_info.add_child(L"owner", owner_info);
+			}
+
+			subsystems_info.add_child(L"subsystem", subsystem_info);
+		}
+
+		return info;
+	}
+private:
+	memory_registry()
+	{
+		used_	= 0;
+		budget_	= 0;
+	}
+};
+
+}
+
+memory_account::memory_account(const std::wstring& subsystem, int channel, int layer)
+	: impl_(new impl(memory_registry::instance().get_subsystem(subsystem), channel, layer))
+{
+	memory_registry::instance().add(*impl_);
+}
+
+memory_account::~memory_account()
+{
+	auto& registry = memory_registry::instance();
+
+	registry.remove(*impl_);
+	registry.change_usage(impl_->subsystem_, -impl_->bytes_.fetch_and_store(0));
+}
+
+void memory_account::add(std::int64_t bytes)
+{
+	impl_->bytes_.fetch_and_add(bytes);
+	memory_registry::instance().change_usage(impl_->subsystem_, bytes);
+}
+
+void memory_account::subtract(std::int64_t bytes)
+{
+	add(-bytes);
+}
+
+void memory_account::set(std::int64_t bytes)
+{
+	auto previous = impl_->bytes_.fetch_and_store(bytes);
+
+	memory_registry::instance().change_usage(impl_->subsystem_, bytes - previous);
+}
+
+std::int64_t memory_account::bytes() const
+{
+	return impl_->bytes_;
+}
+
+bool memory_account::over_budget() const
+{
+	return impl_->subsystem_.over_budget() || memory_registry::instance().over_budget();
+}
+
+void set_memory_budget(std::int64_t bytes)
+{
+	memory_registry::instance().set_budget(bytes);
+}
+
+void set_memory_budget(const std::wstring& subsystem, std::int64_t bytes)
+{
+	memory_registry::instance().get_subsystem(subsystem).budget = std::max<std::int64_t>(0, bytes);
+}
+
+std::int64_t get_memory_usage()
+{
+	return memory_registry::instance().used();
+}
+
+std::int64_t get_memory_usage(const std::wstring& subsystem)
+{
+	return memory_registry::instance().get_subsystem(subsystem).used;
+}
+
+boost::property_tree::wptree get_memory_info()
+{
+	return memory_registry::instance().info();
+}
+
+}}
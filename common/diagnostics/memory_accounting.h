@@ -0,0 +1,88 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace caspar { namespace diagnostics {
+
+/**
+ * The memory held by one owner, like the packet buffer of an ffmpeg input,
+ * accounted to a subsystem and tagged with the channel and layer it belongs
+ * to, if any. The account is registered for as long as it lives, and whatever
+ * it still holds is released when it is destroyed.
+ *
+ * Updating is lock-free, so it can be done for every packet or frame.
+ */
+class memory_account : boost::noncopyable
+{
+public:
+	/**
+	 * @param subsystem	For example "ffmpeg-input", the name of its budget.
+	 * @param channel	The 1 based index of the channel, or -1 if none.
+	 * @param layer		The layer, or -1 if none.
+	 */
+	explicit memory_account(const std::wstring& subsystem, int channel = -1, int layer = -1);
+	~memory_account();
+
+	void add(std::int64_t bytes);
+	void subtract(std::int64_t bytes);
+	void set(std::int64_t bytes);
+	std::int64_t bytes() const;
+
+	/**
+	 * @return Whether the subsystem or all subsystems together use more than
+	 *         their budget, in which case the owner should hold back, by
+	 *         prefetching less or by evicting what it caches.
+	 */
+	bool over_budget() const;
+
+	struct impl;
+private:
+	std::unique_ptr<impl> impl_;
+};
+
+/**
+ * @param bytes	The budget of all subsystems together, or 0 for none.
+ */
+void set_memory_budget(std::int64_t bytes);
+
+/**
+ * @param bytes	The budget of the subsystem, or 0 for none.
+ */
+void set_memory_budget(const std::wstring& subsystem, std::int64_t bytes);
+
+std::int64_t get_memory_usage();
+std::int64_t get_memory_usage(const std::wstring& subsystem);
+
+/**
+ * @return The usage and budget in total and of every subsystem, with the
+ *         usage of every subsystem broken down per channel and layer.
+ */
+boost::property_tree::wptree get_memory_info();
+
+}}
@@ -0,0 +1,317 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../stdafx.h"
+
+#include "trace.h"
+
+#include "../os/clock.h"
+#include "../thread_info.h"
+#include "../utf.h"
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace caspar { namespace diagnostics { namespace trace {
+
+namespace detail {
+
+tbb::atomic<bool> enabled;
+
+}
+
+namespace {
+
+struct event
+{
+	const std::wstring*	name;
+	int					priority;
+	std::int64_t		enqueued;
+	std::int64_t		started;
+	std::int64_t		ended;
+};
+
+// Written only by the thread owning it, read by anyone. A reader copies the
+// events and then discards the ones that the writer may have overwritten while
+// they were being copied.
+class ring
+{
+	static const std::uint64_t CAPACITY = 1 << 14;
+
+	std::vector<event>			events_;
+	tbb::atomic<std::uint64_t>	written_;
+	tbb::atomic<std::uint64_t>	cleared_;
+public:
+	const std::int64_t			native_id;
+	const std::string			thread_name;
+	tbb::atomic<bool>			exited;
+
+	ring(std::int64_t native_id, std::string thread_name)
+		: events_(CAPACITY)
+		, native_id(native_id)
+		, thread_name(std::move(thread_name))
+	{
+		written_	= 0;
+		cleared_	= 0;
+		exited		= false;
+	}
+
+	void push(const event& e)
+	{
+		std::uint64_t index = written_;
+
+		events_[index % CAPACITY] = e;
+		written_ = index + 1;
+	}
+
+	void clear()
+	{
+		cleared_ = written_;
+	}
+
+	std::vector<event> snapshot() const
+	{
+		std::uint64_t end	= written_;
+		std::uint64_t begin	= std::max<std::uint64_t>(cleared_, end > CAPACITY ? end - CAPACITY : 0);
+		std::vector<event> result;
+
+		result.reserve(static_cast<std::size_t>(end - begin));
+
+		for (auto index = begin; index < end; ++index)
+			result.push_back(events_[index % CAPACITY]);
+
+		// The slot of the event being written now is the one of the oldest
+		// event that is still intact.
+		std::uint64_t written_after = written_;
+		std::uint64_t overwritten	= written_after + 1 > CAPACITY ? written_after + 1 - CAPACITY : 0;
+
+		if (overwritten > begin)
+			result.erase(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(std::min(overwritten - begin, end - begin)));
+
+		return result;
+	}
+};
+
+class registry
+{
+	static const std::size_t MAX_EXITED_RINGS = 64;
+
+	boost::mutex										mutex_;
+	std::vector<std::shared_ptr<ring>>					rings_;
+	std::set<std::wstring>								names_;
+	boost::thread_specific_ptr<std::shared_ptr<ring>>	local_;
+public:
+	registry()
+		: local_([](std::shared_ptr<ring>* local)
+		{
+			(*local)->exited = true;
+			delete local;
+		})
+	{
+	}
+
+	static registry& get_instance()
+	{
+		static registry instance;
+
+		return instance;
+	}
+
+	ring& local_ring()
+	{
+		auto local = local_.get();
+
+		if (!local)
+		{
+			auto& info	= get_thread_info();
+			auto r		= std::make_shared<ring>(info.native_id, info.name);
+
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			// Keep the events of threads that have exited, but only of the
+			// most recent ones.
+			auto exited = std::count_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<ring>& r) { return r->exited; });
+
+			for (auto it = rings_.begin(); it != rings_.end() && exited >= static_cast<std::ptrdiff_t>(MAX_EXITED_RINGS);)
+			{
+				if ((*it)->exited)
+				{
+					it = rings_.erase(it);
+					--exited;
+				}
+				else
+					++it;
+			}
+
+			rings_.push_back(r);
+			local = new std::shared_ptr<ring>(r);
+			local_.reset(local);
+		}
+
+		return **local;
+	}
+
+	std::vector<std::shared_ptr<ring>> rings()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		return rings_;
+	}
+
+	const std::wstring* intern(const std::wstring& name)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		return &*names_.insert(name).first;
+	}
+};
+
+void write_json_string(std::ostream& out, const std::string& str)
+{
+	out << '"';
+
+	for (auto c : str)
+	{
+		switch (c)
+		{
+		case '"':	out << "\\\"";	break;
+		case '\\':	out << "\\\\";	break;
+		case '\n':	out << "\\n";	break;
+		case '\r':	out << "\\r";	break;
+		case '\t':	out << "\\t";	break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			else
+				out << c;
+		}
+	}
+
+	out << '"';
+}
+
+}
+
+void enable(bool enabled)
+{
+	detail::enabled = enabled;
+}
+
+void clear()
+{
+	for (auto& r : registry::get_instance().rings())
+		r->clear();
+}
+
+const std::wstring* intern(const std::wstring& name)
+{
+	return registry::get_instance().intern(name);
+}
+
+std::int64_t now()
+{
+	return monotonic_clock_nanos();
+}
+
+void record(const std::wstring* name, int priority, std::int64_t enqueued, std::int64_t started, std::int64_t ended)
+{
+	event e;
+	e.name		= name;
+	e.priority	= priority;
+	e.enqueued	= enqueued;
+	e.started	= started;
+	e.ended		= ended;
+
+	registry::get_instance().local_ring().push(e);
+}
+
+int write_chrome_trace(std::ostream& out)
+{
+	std::vector<std::pair<std::shared_ptr<ring>, std::vector<event>>> snapshots;
+	std::int64_t origin = std::numeric_limits<std::int64_t>::max();
+
+	for (auto& r : registry::get_instance().rings())
+	{
+		auto events = r->snapshot();
+
+		for (auto& e : events)
+			origin = std::min(origin, e.enqueued);
+
+		snapshots.push_back(std::make_pair(r, std::move(events)));
+	}
+
+	std::stringstream result;
+	int num_events	= 0;
+	bool first		= true;
+
+	result << std::fixed << std::setprecision(3);
+	result << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	auto begin_object = [&]
+	{
+		result << (first ? "\n" : ",\n");
+		first = false;
+	};
+
+	for (auto& snapshot : snapshots)
+	{
+		auto& r = *snapshot.first;
+
+		begin_object();
+		result << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r.native_id << ",\"args\":{\"name\":";
+		write_json_string(result, r.thread_name);
+		result << "}}";
+
+		for (auto& e : snapshot.second)
+		{
+			begin_object();
+			result << "{\"name\":";
+			write_json_string(result, u8(*e.name));
+			result
+				<< ",\"cat\":\"" << (e.priority < 0 ? "scope" : "task") << "\""
+				<< ",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.native_id
+				<< ",\"ts\":" << (e.started - origin) / 1000.0
+				<< ",\"dur\":" << (e.ended - e.started) / 1000.0;
+
+			if (e.priority >= 0)
+				result << ",\"args\":{\"priority\":" << e.priority << ",\"queued_us\":" << (e.started - e.enqueued) / 1000.0 << "}";
+
+			result << "}";
+			++num_events;
+		}
+	}
+
+	result << "\n]}\n";
+	out << result.rdbuf();
+
+	return num_events;
+}
+
+}}}
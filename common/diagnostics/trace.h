@@ -0,0 +1,118 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <tbb/atomic.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace caspar { namespace diagnostics { namespace trace {
+
+/**
+ * Task tracing. When enabled, every task run by an executor and every scope
+ * put around a piece of work records when it was enqueued, started and ended.
+ * The events are written without locking into a fixed size ring buffer per
+ * thread, so only the most recent events of each thread are kept, and can be
+ * written out in the Chrome trace event format (chrome://tracing, Perfetto).
+ *
+ * When disabled the cost is a check of an atomic flag.
+ */
+
+namespace detail {
+
+extern tbb::atomic<bool> enabled;
+
+}
+
+inline bool is_enabled()
+{
+	return detail::enabled;
+}
+
+void enable(bool enabled);
+
+/**
+ * Removes all recorded events.
+ */
+void clear();
+
+/**
+ * @return A pointer to a string equal to name, valid for the lifetime of the
+ *         process. Events refer to their names by these pointers, so that no
+ *         strings have to be copied when recording.
+ */
+const std::wstring* intern(const std::wstring& name);
+
+std::int64_t now();
+
+/**
+ * Records an event on the ring buffer of the calling thread.
+ *
+ * @param priority The task priority, or -1 for scopes that were not queued.
+ */
+void record(const std::wstring* name, int priority, std::int64_t enqueued, std::int64_t started, std::int64_t ended);
+
+/**
+ * Writes the recorded events of all threads as a Chrome trace event json
+ * document.
+ *
+ * @return The number of events written.
+ */
+int write_chrome_trace(std::ostream& out);
+
+/**
+ * Records the lifetime of the scope as an event. For queued tasks, enqueued is
+ * the time the task was enqueued, or 0 if tracing was disabled at the time, in
+ * which case nothing is recorded.
+ */
+class scope : boost::noncopyable
+{
+	const std::wstring*	name_;
+	int					priority_;
+	std::int64_t		enqueued_;
+	std::int64_t		started_;
+public:
+	explicit scope(const std::wstring* name)
+		: scope(name, -1, is_enabled() ? now() : 0)
+	{
+	}
+
+	scope(const std::wstring* name, int priority, std::int64_t enqueued)
+		: name_(name)
+		, priority_(priority)
+		, enqueued_(enqueued)
+		, started_(enqueued != 0 ? now() : 0)
+	{
+	}
+
+	~scope()
+	{
+		if (started_ != 0)
+			record(name_, priority_, enqueued_, started_, now());
+	}
+};
+
+}}}
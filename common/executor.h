@@ -22,20 +22,21 @@
 #pragma once
 
 #include "os/general_protection_fault.h"
+#include "diagnostics/trace.h"
 #include "except.h"
 #include "log.h"
-#include "blocking_bounded_queue_adapter.h"
-#include "blocking_priority_queue.h"
 #include "future.h"
+#include "pooled_allocator.h"
+#include "task_queue.h"
 
 #include <tbb/atomic.h>
-#include <tbb/concurrent_priority_queue.h>
 
 #include <boost/thread.hpp>
 #include <boost/optional.hpp>
 
 #include <functional>
 #include <future>
+#include <memory>
 
 namespace caspar {
 enum class task_priority
@@ -48,14 +49,78 @@ enum class task_priority
 	higher_priority
 };
 
+namespace detail {
+
+template<typename R, typename Func>
+void set_result(std::promise<R>& promise, Func& func)
+{
+	promise.set_value(func());
+}
+
+template<typename Func>
+void set_result(std::promise<void>& promise, Func& func)
+{
+	func();
+	promise.set_value();
+}
+
+/**
+ * The queued form of a function given to an executor. The shared state of the
+ * promise is allocated from the pool, like the task holding this.
+ */
+template<typename Func, typename R>
+struct executor_function
+{
+	Func				func;
+	std::promise<R>		promise;
+	const std::wstring*	trace_name;
+	task_priority		priority;
+	std::int64_t		enqueued;
+
+	executor_function(Func func, const std::wstring* trace_name, task_priority priority, std::int64_t enqueued)
+		: func(std::move(func))
+		, promise(std::allocator_arg, pooled_allocator<R>())
+		, trace_name(trace_name)
+		, priority(priority)
+		, enqueued(enqueued)
+	{
+	}
+
+	executor_function(executor_function&& other)
+		: func(std::move(other.func))
+		, promise(std::move(other.promise))
+		, trace_name(other.trace_name)
+		, priority(other.priority)
+		, enqueued(other.enqueued)
+	{
+	}
+
+	void operator()()
+	{
+		diagnostics::trace::scope trace(trace_name, static_cast<int>(priority), enqueued);
+
+		try
+		{
+			set_result(promise, func);
+		}
+		catch (...)
+		{
+			promise.set_exception(std::current_exception());
+		}
+	}
+};
+
+}
+
 class executor final
 {
 	executor(const executor&);
 	executor& operator=(const executor&);
 
-	typedef blocking_priority_queue<std::function<void()>, task_priority>	function_queue_t;
+	typedef task_queue	function_queue_t;
 
 	const std::wstring	name_;
+	const std::wstring*	trace_name_;
 	tbb::atomic<bool>	is_running_;
 	boost::thread		thread_;
 	function_queue_t	execution_queue_;
@@ -64,14 +129,8 @@ class executor final
 public:
 	executor(const std::wstring& name)
 		: name_(name)
-		, execution_queue_(std::numeric_limits<int>::max(), std::vector<task_priority> {
-			task_priority::lowest_priority,
-			task_priority::lower_priority,
-			task_priority::low_priority,
-			task_priority::normal_priority,
-			task_priority::high_priority,
-			task_priority::higher_priority
-		})
+		, trace_name_(diagnostics::trace::intern(name))
+		, execution_queue_(static_cast<int>(task_priority::higher_priority) + 1, std::numeric_limits<int>::max())
 	{
 		is_running_ = true;
 		currently_in_task_ = false;
@@ -126,10 +185,10 @@ public:
 		if(!is_current())
 			CASPAR_THROW_EXCEPTION(invalid_operation() << msg_info("Executor can only yield inside of thread context.")  << source_info(name_));
 
-		std::function<void ()> func;
+		executor_task task;
 
-		while (execution_queue_.try_pop(func, minimum_priority))
-			func();
+		while (execution_queue_.try_pop(task, static_cast<int>(minimum_priority)))
+			task.run();
 	}
 
 	void set_capacity(function_queue_t::size_type capacity)
@@ -149,8 +208,7 @@ public:
 
 	void clear()
 	{
-		std::function<void ()> func;
-		while(execution_queue_.try_pop(func));
+		execution_queue_.clear();
 	}
 
 	void stop()
@@ -203,74 +261,67 @@ private:
 		Func&& func,
 		task_priority priority = task_priority::normal_priority) -> std::future<decltype(func())> // noexcept
 	{
-		typedef typename std::remove_reference<Func>::type	function_type;
-		typedef decltype(func())							result_type;
-		typedef std::packaged_task<result_type()>			task_type;
-
-		std::shared_ptr<task_type> task;
+		typedef typename std::decay<Func>::type					function_type;
+		typedef decltype(func())								result_type;
+		typedef detail::executor_function<function_type, result_type>	task_type;
 
-		// Use pointers since the boost thread library doesn't fully support move semantics.
+		auto enqueued = diagnostics::trace::is_enabled() ? diagnostics::trace::now() : 0;
 
-		auto raw_func2 = new function_type(std::forward<Func>(func));
-		try
+		if (is_current())
 		{
-			task.reset(new task_type([raw_func2]() -> result_type
+			// The caller may wait for the future from within a task of this
+			// executor, so the future runs the task itself if it has not run
+			// yet, instead of blocking forever.
+			struct shared_task
 			{
-				std::unique_ptr<function_type> func2(raw_func2);
-				return (*func2)();
-			}));
-		}
-		catch(...)
-		{
-			delete raw_func2;
-			throw;
-		}
+				task_type			task;
+				tbb::atomic<bool>	claimed;
 
-		auto future = task->get_future().share();
-		auto function = [task]
-		{
-			try
-			{
-				(*task)();
-			}
-			catch(std::future_error&){}
-		};
+				shared_task(task_type task)
+					: task(std::move(task))
+				{
+					claimed = false;
+				}
 
-		if (!execution_queue_.try_push(priority, function))
-		{
-			if (is_current())
-				CASPAR_THROW_EXCEPTION(invalid_operation() << msg_info(print() + L" Overflow. Avoiding deadlock."));
+				void run()
+				{
+					if (!claimed.fetch_and_store(true))
+						task();
+				}
+			};
 
-			CASPAR_LOG(warning) << print() << L" Overflow. Blocking caller.";
-			execution_queue_.push(priority, function);
-		}
+			auto task	= std::make_shared<shared_task>(task_type(std::forward<Func>(func), trace_name_, priority, enqueued));
+			auto future	= task->task.promise.get_future().share();
 
-		return std::async(std::launch::deferred, [=]() mutable -> result_type
-		{
-			if (!is_ready(future) && is_current()) // Avoids potential deadlock.
-			{
-				function();
-			}
+			enqueue(executor_task([task] { task->run(); }), priority);
 
-			try
+			return std::async(std::launch::deferred, [=]() -> result_type
 			{
+				if (!is_ready(future) && is_current()) // Avoids potential deadlock.
+					task->run();
+
 				return future.get();
-			}
-			catch (const caspar_exception& e)
-			{
-				if (!is_current()) // Add context information from this thread before rethrowing.
-				{
-					auto ctx_info = boost::get_error_info<context_info_t>(e);
+			});
+		}
 
-					if (ctx_info)
-						e << context_info(get_context() + *ctx_info);
-					else
-						e << context_info(get_context());
-				}
+		task_type task(std::forward<Func>(func), trace_name_, priority, enqueued);
+		auto future = task.promise.get_future();
 
-				throw;
-			}
-		});
+		enqueue(executor_task(std::move(task)), priority);
+
+		return future;
+	}
+
+	void enqueue(executor_task task, task_priority priority)
+	{
+		if (!execution_queue_.try_push(static_cast<int>(priority), task))
+		{
+			if (is_current())
+				CASPAR_THROW_EXCEPTION(invalid_operation() << msg_info(print() + L" Overflow. Avoiding deadlock."));
+
+			CASPAR_LOG(warning) << print() << L" Overflow. Blocking caller.";
+			execution_queue_.push(static_cast<int>(priority), task);
+		}
 	}
 
 	void run() // noexcept
@@ -280,10 +331,9 @@ private:
 		{
 			try
 			{
-				std::function<void ()> func;
-				execution_queue_.pop(func);
+				auto task = execution_queue_.pop();
 				currently_in_task_ = true;
-				func();
+				task.run();
 			}
 			catch (...)
 			{
@@ -296,11 +346,11 @@ private:
 		// Execute rest
 		try
 		{
-			std::function<void()> func;
+			executor_task task;
 
-			while (execution_queue_.try_pop(func))
+			while (execution_queue_.try_pop(task))
 			{
-				func();
+				task.run();
 			}
 		}
 		catch (...)
@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "stdafx.h"
+
+#include "frame_clock.h"
+
+#include "os/clock.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace caspar {
+
+namespace {
+
+const std::int64_t SPIN_NANOS			= 250000;
+const std::int64_t MAX_FRAMES_BEHIND	= 2;
+
+std::int64_t nanos_for_frames(std::int64_t frames, const boost::rational<int>& framerate)
+{
+	std::int64_t num = framerate.numerator();
+	std::int64_t den = framerate.denominator();
+
+	// Split to not overflow for long running channels.
+	return frames / num * den * 1000000000 + frames % num * den * 1000000000 / num;
+}
+
+std::int64_t server_clock_epoch()
+{
+	static const std::int64_t epoch = monotonic_clock_nanos();
+
+	return epoch;
+}
+
+}
+
+frame_clock::frame_clock(boost::rational<int> framerate, bool lock_to_server_clock)
+	: framerate_(framerate)
+	, lock_to_server_clock_(lock_to_server_clock)
+{
+	server_clock_epoch();
+}
+
+void frame_clock::set_framerate(boost::rational<int> framerate)
+{
+	if (framerate == framerate_)
+		return;
+
+	framerate_	= framerate;
+	started_	= false;
+}
+
+void frame_clock::tick()
+{
+	auto now = monotonic_clock_nanos();
+
+	if (!started_)
+	{
+		start(now);
+		return;
+	}
+
+	++frame_;
+	++frames_ticked_;
+
+	auto behind = now - deadline(frame_);
+
+	if (behind > nanos_for_frames(MAX_FRAMES_BEHIND, framerate_))
+	{
+		skipped_frames_ += behind * framerate_.numerator() / (framerate_.denominator() * 1000000000ll);
+		anchor(now);
+	}
+
+	wait_until(deadline(frame_));
+}
+
+void frame_clock::start(std::int64_t now)
+{
+	anchor(now);
+
+	started_			= true;
+	first_deadline_		= deadline(frame_);
+	frames_ticked_		= 0;
+	drift_				= 0;
+
+	wait_until(first_deadline_);
+}
+
+// Makes deadline(frame_) the first deadline not before now.
+void frame_clock::anchor(std::int64_t now)
+{
+	if (!lock_to_server_clock_)
+	{
+		epoch_	= now;
+		frame_	= 0;
+		return;
+	}
+
+	epoch_		= server_clock_epoch();
+	auto period	= static_cast<double>(framerate_.denominator()) * 1000000000.0 / static_cast<double>(framerate_.numerator());
+	frame_		= static_cast<std::int64_t>(static_cast<double>(now - epoch_) / period);
+
+	while (deadline(frame_) < now)
+		++frame_;
+
+	while (frame_ > 0 && deadline(frame_ - 1) >= now)
+		--frame_;
+}
+
+std::int64_t frame_clock::deadline(std::int64_t frame) const
+{
+	return epoch_ + nanos_for_frames(frame, framerate_);
+}
+
+void frame_clock::wait_until(std::int64_t deadline)
+{
+	if (deadline - monotonic_clock_nanos() > SPIN_NANOS)
+		sleep_until_monotonic_nanos(deadline - SPIN_NANOS);
+
+	auto woke = monotonic_clock_nanos();
+
+	while (woke < deadline)
+	{
+		std::this_thread::yield();
+		woke = monotonic_clock_nanos();
+	}
+
+	auto lateness = woke - deadline;
+
+	jitter_				+= (lateness - jitter_) / 16;
+	window_max_jitter_	= std::max(window_max_jitter_, lateness);
+	drift_				= woke - (first_deadline_ + nanos_for_frames(frames_ticked_, framerate_));
+
+	if (++window_frames_ * framerate_.denominator() >= framerate_.numerator())
+	{
+		max_jitter_			= window_max_jitter_;
+		window_max_jitter_	= 0;
+		window_frames_		= 0;
+	}
+}
+
+std::int64_t frame_clock::jitter_nanos() const { return jitter_; }
+std::int64_t frame_clock::max_jitter_nanos() const { return max_jitter_; }
+std::int64_t frame_clock::drift_nanos() const { return drift_; }
+std::int64_t frame_clock::skipped_frames() const { return skipped_frames_; }
+
+}
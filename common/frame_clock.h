@@ -0,0 +1,99 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <boost/rational.hpp>
+
+#include <cstdint>
+
+namespace caspar {
+
+/**
+ * Paces a channel at an exact rational frame rate. Every frame has an absolute
+ * deadline computed from its frame number with nanosecond resolution, so
+ * rounding of the frame duration never accumulates into drift against the wall
+ * clock. Sleeps until shortly before the deadline and spins the rest of the
+ * way.
+ *
+ * When locked to the server clock, the deadlines of all channels with the same
+ * frame rate fall on the same grid, counted from when the server started.
+ */
+class frame_clock
+{
+public:
+	frame_clock(boost::rational<int> framerate, bool lock_to_server_clock);
+
+	/**
+	 * Changes the frame rate. Counting starts over at the next tick.
+	 */
+	void set_framerate(boost::rational<int> framerate);
+
+	/**
+	 * Waits until it is time for the next frame. The first tick does not wait
+	 * unless locked to the server clock. When more than a couple of frames
+	 * behind, the missed deadlines are skipped instead of catching up.
+	 */
+	void tick();
+
+	/**
+	 * @return The average distance between wake up and deadline.
+	 */
+	std::int64_t jitter_nanos() const;
+
+	/**
+	 * @return The largest distance between wake up and deadline during the
+	 *         last second.
+	 */
+	std::int64_t max_jitter_nanos() const;
+
+	/**
+	 * @return How far the frames ticked lag behind the wall clock, since the
+	 *         first tick.
+	 */
+	std::int64_t drift_nanos() const;
+
+	/**
+	 * @return The number of deadlines skipped after falling behind.
+	 */
+	std::int64_t skipped_frames() const;
+private:
+	void start(std::int64_t now);
+	void anchor(std::int64_t now);
+	std::int64_t deadline(std::int64_t frame) const;
+	void wait_until(std::int64_t deadline);
+
+	boost::rational<int>	framerate_;
+	const bool				lock_to_server_clock_;
+	bool					started_			= false;
+	std::int64_t			epoch_				= 0;
+	std::int64_t			frame_				= 0;
+	std::int64_t			first_deadline_		= 0;
+	std::int64_t			frames_ticked_		= 0;
+	std::int64_t			jitter_				= 0;
+	std::int64_t			max_jitter_			= 0;
+	std::int64_t			window_max_jitter_	= 0;
+	std::int64_t			window_frames_		= 0;
+	std::int64_t			drift_				= 0;
+	std::int64_t			skipped_frames_		= 0;
+};
+
+}
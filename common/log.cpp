@@ -27,6 +27,7 @@
 #include "except.h"
 #include "utf.h"
 
+#include <chrono>
 #include <ios>
 #include <iomanip>
 #include <string>
@@ -46,6 +47,9 @@
 #include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
 #include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/unlocked_frontend.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/block_on_overflow.hpp>
 #include <boost/log/core/record.hpp>
 #include <boost/log/attributes/attribute_value.hpp>
 #include <boost/log/attributes/function.hpp>
@@ -57,6 +61,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <tbb/atomic.h>
 
@@ -178,10 +184,84 @@ std::string current_exception_diagnostic_information()
 
 }
 
-void add_file_sink(const std::wstring& file, const boost::log::filter& filter)
+/**
+ * Periodically flushes the asynchronous file sinks. Their backends do not
+ * flush after every record, so the records fed while the previous batch was
+ * written reach the file in one write.
+ */
+class sink_flusher : boost::noncopyable
+{
+	boost::mutex				mutex_;
+	boost::condition_variable	cond_;
+	bool						running_	= true;
+	boost::thread				thread_;
+public:
+	sink_flusher()
+		: thread_([this] { run(); })
+	{
+	}
+
+	~sink_flusher()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			running_ = false;
+		}
+
+		cond_.notify_all();
+		thread_.join();
+	}
+
+	static void ensure_started()
+	{
+		static sink_flusher instance;
+	}
+private:
+	void run()
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+
+		while (running_)
+		{
+			cond_.wait_for(lock, boost::chrono::milliseconds(500));
+
+			lock.unlock();
+			flush();
+			lock.lock();
+		}
+	}
+};
+
+// Formatting and writing is done on a thread of the sink, so a slow disk or a
+// lot of debug logging does not delay the threads logging. When the queue is
+// full they wait, rather than the queue growing or records being lost.
+typedef boost::log::sinks::asynchronous_sink<
+		boost::log::sinks::text_file_backend,
+		boost::log::sinks::bounded_fifo_queue<10000, boost::log::sinks::block_on_overflow>> file_sink_type;
+
+/**
+ * Flushes a file sink when fed, which the thread logging waits for.
+ */
+class flushing_backend : public boost::log::sinks::basic_sink_backend<boost::log::sinks::concurrent_feeding>
 {
-	typedef boost::log::sinks::synchronous_sink<boost::log::sinks::text_file_backend> file_sink_type;
+	boost::weak_ptr<file_sink_type> file_sink_;
+public:
+	explicit flushing_backend(boost::weak_ptr<file_sink_type> file_sink)
+		: file_sink_(std::move(file_sink))
+	{
+	}
+
+	void consume(const boost::log::record_view& rec)
+	{
+		auto file_sink = file_sink_.lock();
+
+		if (file_sink)
+			file_sink->flush();
+	}
+};
 
+void add_file_sink(const std::wstring& file, const boost::log::filter& filter)
+{
 	try
 	{
 		if (!boost::filesystem::is_directory(boost::filesystem::path(file).parent_path()))
@@ -190,7 +270,7 @@ void add_file_sink(const std::wstring& file, const boost::log::filter& filter)
 		auto file_sink = boost::make_shared<file_sink_type>(
 			boost::log::keywords::file_name = (file + L"_%Y-%m-%d.log"),
 			boost::log::keywords::time_based_rotation = boost::log::sinks::file::rotation_at_time_point(0, 0, 0),
-			boost::log::keywords::auto_flush = true,
+			boost::log::keywords::auto_flush = false,
 			boost::log::keywords::open_mode = std::ios::app
 			);
 
@@ -199,6 +279,16 @@ void add_file_sink(const std::wstring& file, const boost::log::filter& filter)
 		file_sink->set_formatter(boost::bind(&my_formatter<boost::log::formatting_ostream>, print_all_characters, _1, _2));
 		file_sink->set_filter(filter);
 		boost::log::core::get()->add_sink(file_sink);
+		sink_flusher::ensure_started();
+
+		// Errors are on disk before the thread logging them continues, so they
+		// and what was logged before them survive a crash that follows. The
+		// core feeds the sinks in the order they were added, so the file sink
+		// already has the record when this flushes it.
+		auto flushing_sink = boost::make_shared<boost::log::sinks::unlocked_sink<flushing_backend>>(
+				boost::make_shared<flushing_backend>(file_sink));
+		flushing_sink->set_filter(boost::log::trivial::severity >= boost::log::trivial::error);
+		boost::log::core::get()->add_sink(flushing_sink);
 	}
 	catch (...)
 	{
@@ -246,6 +336,11 @@ std::shared_ptr<void> add_preformatted_line_sink(std::function<void(std::string
 	});
 }
 
+void flush()
+{
+	boost::log::core::get()->flush();
+}
+
 boost::mutex& get_filter_mutex()
 {
 	static boost::mutex instance;
@@ -260,6 +355,13 @@ boost::log::trivial::severity_level& get_level()
 	return instance;
 }
 
+tbb::atomic<int>& get_enabled_level()
+{
+	static tbb::atomic<int> instance;
+
+	return instance;
+}
+
 log_category& get_disabled_categories()
 {
 	static log_category instance = log_category::calltrace;
@@ -272,6 +374,8 @@ void set_log_filter()
 	auto severity_filter		= boost::log::trivial::severity >= get_level();
 	auto disabled_categories	= get_disabled_categories();
 
+	get_enabled_level() = static_cast<int>(get_level());
+
 	boost::log::core::get()->set_filter([=](const boost::log::attribute_value_set& attributes)
 	{
 		return severity_filter(attributes)
@@ -321,6 +425,55 @@ void set_log_category(const std::wstring& cat, bool enabled)
 	set_log_filter();
 }
 
+bool is_enabled(boost::log::trivial::severity_level lvl)
+{
+	return static_cast<int>(lvl) >= get_enabled_level();
+}
+
+namespace {
+
+std::int64_t now_millis()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+rate_limiter::rate_limiter(int max_messages, std::int64_t interval_millis)
+	: interval_millis_(interval_millis)
+	, max_messages_(max_messages)
+{
+	window_start_	= now_millis();
+	count_			= 0;
+	suppressed_		= 0;
+}
+
+int rate_limiter::acquire()
+{
+	auto now	= now_millis();
+	auto start	= window_start_;
+
+	// Only the thread moving the window on resets the count. A message counted
+	// by another thread just before that is lost, which is harmless here.
+	if (now - start >= interval_millis_ && window_start_.compare_and_swap(now, start) == start)
+		count_ = 0;
+
+	if (count_.fetch_and_increment() < max_messages_)
+		return suppressed_.fetch_and_store(0);
+
+	suppressed_.fetch_and_increment();
+
+	return -1;
+}
+
+std::wstring suppressed_note(int suppressed)
+{
+	if (suppressed <= 0)
+		return std::wstring();
+
+	return L"(" + boost::lexical_cast<std::wstring>(suppressed) + L" similar messages suppressed) ";
+}
+
 void print_child(
 		boost::log::trivial::severity_level level,
 		const std::wstring& indent,
@@ -31,8 +31,12 @@
 #include <boost/log/sources/global_logger_storage.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
 #include <boost/exception/all.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/property_tree/ptree_fwd.hpp>
 
+#include <tbb/atomic.h>
+
+#include <cstdint>
 #include <string>
 #include <locale>
 #include <functional>
@@ -71,6 +75,11 @@ inline std::basic_string<T> replace_nonprintable_copy(std::basic_string<T, std::
 void add_file_sink(const std::wstring& file, const boost::log::filter& filter);
 std::shared_ptr<void> add_preformatted_line_sink(std::function<void(std::string line)> formatted_line_sink);
 
+/**
+ * Writes all log records queued by the asynchronous sinks.
+ */
+void flush();
+
 enum class log_category
 {
 	normal			= 1,
@@ -97,6 +106,43 @@ BOOST_LOG_INLINE_GLOBAL_LOGGER_INIT(logger, caspar_logger)
 #define CASPAR_LOG_COMMUNICATION(lvl)\
 	BOOST_LOG_CHANNEL_SEV(::caspar::log::logger::get(), ::caspar::log::log_category::communication,	::boost::log::trivial::lvl)
 
+/**
+ * Limits how often a call site is allowed to log, so that a message logged for
+ * every frame cannot flood the log and slow down the channels. At most
+ * max_messages are let through per interval.
+ */
+class rate_limiter : boost::noncopyable
+{
+	const std::int64_t			interval_millis_;
+	const int					max_messages_;
+	tbb::atomic<std::int64_t>	window_start_;
+	tbb::atomic<int>			count_;
+	tbb::atomic<int>			suppressed_;
+public:
+	explicit rate_limiter(int max_messages = 5, std::int64_t interval_millis = 1000);
+
+	/**
+	 * @return	-1 if the message should be suppressed, otherwise the number of
+	 *			messages suppressed since the last one let through.
+	 */
+	int acquire();
+};
+
+bool is_enabled(boost::log::trivial::severity_level lvl);
+std::wstring suppressed_note(int suppressed);
+
+/**
+ * Like CASPAR_LOG, but at most 5 messages per second are logged from the call
+ * site. The first message logged after others were suppressed tells how many.
+ */
+#define CASPAR_LOG_RATE_LIMITED(lvl)\
+	for (int caspar_log_suppressed = ::caspar::log::is_enabled(::boost::log::trivial::lvl)\
+				? []() -> ::caspar::log::rate_limiter& { static ::caspar::log::rate_limiter limiter; return limiter; }().acquire()\
+				: -1;\
+			caspar_log_suppressed >= 0;\
+			caspar_log_suppressed = -1)\
+		CASPAR_LOG(lvl) << ::caspar::log::suppressed_note(caspar_log_suppressed)
+
 #define CASPAR_LOG_CALL_STACK()	try{\
 		CASPAR_LOG(info) << L"callstack (" << caspar::get_thread_info().name << L"):\n" << caspar::get_call_stack();\
 	}\
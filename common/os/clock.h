@@ -0,0 +1,40 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace caspar {
+
+/**
+ * @return The current time in nanoseconds of a monotonic clock with an
+ *         unspecified epoch.
+ */
+std::int64_t monotonic_clock_nanos();
+
+/**
+ * Sleeps until monotonic_clock_nanos() has reached deadline. Never returns
+ * early, but may return late depending on the scheduler.
+ */
+void sleep_until_monotonic_nanos(std::int64_t deadline);
+
+}
@@ -0,0 +1,40 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <tbb/atomic.h>
+
+namespace caspar {
+
+/**
+ * Blocks while word is equal to expected, or until woken by futex_wake_all().
+ * May also return spuriously, so the caller has to check its condition again.
+ */
+void futex_wait(tbb::atomic<int>& word, int expected);
+
+/**
+ * Wakes all threads blocked in futex_wait() on word. Should be called after
+ * word has been changed.
+ */
+void futex_wake_all(tbb::atomic<int>& word);
+
+}
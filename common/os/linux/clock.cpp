@@ -0,0 +1,50 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../../stdafx.h"
+
+#include "../clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+namespace caspar {
+
+std::int64_t monotonic_clock_nanos()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void sleep_until_monotonic_nanos(std::int64_t deadline)
+{
+	timespec spec;
+	spec.tv_sec		= static_cast<time_t>(deadline / 1000000000);
+	spec.tv_nsec	= static_cast<long>(deadline % 1000000000);
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, nullptr) == EINTR)
+	{
+	}
+}
+
+}
@@ -0,0 +1,578 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "../../stdafx.h"
+
+#include "../native_filesystem_monitor.h"
+#include "../general_protection_fault.h"
+
+#include "../../polling_filesystem_monitor.h"
+#include "../../except.h"
+#include "../../log.h"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+#include <future>
+
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace caspar {
+
+namespace {
+
+// How long a file must be left alone before it is considered completely written.
+const boost::chrono::milliseconds SETTLE_TIME(2000);
+const std::time_t NO_LONGER_WRITING_AGE = 3; // Assume std::time_t is expressed in seconds
+const std::uint32_t WATCH_MASK =
+		IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+// Remote writes to these are not reported by inotify.
+const std::uint32_t NETWORK_FILESYSTEM_TYPES[] =
+{
+	0x6969,		// NFS
+	0x517B,		// SMB
+	0xFF534D42,	// CIFS
+	0xFE534D42,	// SMB2
+	0x5346414F,	// AFS
+	0x73757245,	// CODA
+	0x01021997,	// 9P
+	0x65735546	// FUSE (sshfs and friends)
+};
+
+bool is_network_filesystem(const boost::filesystem::path& folder)
+{
+	struct statfs info;
+
+	if (statfs(folder.c_str(), &info) != 0)
+		return false;
+
+	for (auto type : NETWORK_FILESYSTEM_TYPES)
+	{
+		if (static_cast<std::uint32_t>(info.f_type) == type)
+			return true;
+	}
+
+	return false;
+}
+
+bool can_read_file(const boost::filesystem::path& file)
+{
+	boost::filesystem::wifstream stream(file);
+
+	return stream.is_open();
+}
+
+}
+
+class inotify_filesystem_monitor : public filesystem_monitor
+{
+	typedef boost::chrono::steady_clock clock;
+
+	tbb::atomic<bool>											running_;
+	const boost::filesystem::path								folder_;
+	const filesystem_event										events_mask_;
+	const bool													report_already_existing_;
+	const filesystem_monitor_handler							handler_;
+	const initial_files_handler									initial_files_handler_;
+	int															fd_;
+	std::map<int, boost::filesystem::path>						dirs_by_watch_;
+	std::map<boost::filesystem::path, std::time_t>				files_;
+	std::map<boost::filesystem::path, clock::time_point>		pending_;
+	std::promise<void>											initial_scan_completion_;
+	tbb::concurrent_queue<boost::filesystem::path>				to_reemmit_;
+	tbb::atomic<bool>											reemmit_all_;
+	boost::thread												thread_;
+public:
+	inotify_filesystem_monitor(
+			const boost::filesystem::path& folder_to_watch,
+			filesystem_event events_of_interest_mask,
+			bool report_already_existing,
+			const filesystem_monitor_handler& handler,
+			const initial_files_handler& initial_files_handler)
+		: folder_(folder_to_watch)
+		, events_mask_(events_of_interest_mask)
+		, report_already_existing_(report_already_existing)
+		, handler_(handler)
+		, initial_files_handler_(initial_files_handler)
+		, fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	{
+		running_ = true;
+		reemmit_all_ = false;
+
+		if (fd_ < 0)
+			CASPAR_THROW_EXCEPTION(operation_failed() << msg_info("inotify_init1 failed") << boost::errinfo_errno(errno));
+	}
+
+	~inotify_filesystem_monitor()
+	{
+		running_ = false;
+
+		if (thread_.joinable())
+			thread_.join();
+
+		if (fd_ >= 0)
+			close(fd_);
+	}
+
+	void start()
+	{
+		// Watches are added on the calling thread so that running out of
+		// watches can be reported to the factory, which then falls back to
+		// polling.
+		add_watches(folder_);
+
+		thread_ = boost::thread([this] { run(); });
+	}
+
+	std::future<void> initial_files_processed() override
+	{
+		return initial_scan_completion_.get_future();
+	}
+
+	void reemmit_all() override
+	{
+		reemmit_all_ = true;
+	}
+
+	void reemmit(const boost::filesystem::path& file) override
+	{
+		to_reemmit_.push(file);
+	}
+private:
+	bool interested_in(filesystem_event event) const
+	{
+		return static_cast<int>(events_mask_ & event) != 0;
+	}
+
+	void emit(filesystem_event event, const boost::filesystem::path& file)
+	{
+		if (!interested_in(event))
+			return;
+
+		try
+		{
+			handler_(event, file);
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+
+	void run()
+	{
+		ensure_gpf_handler_installed_for_thread("inotify_filesystem_monitor");
+
+		try
+		{
+			initial_scan();
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+
+		initial_scan_completion_.set_value();
+
+		std::vector<char> buffer(64 * 1024);
+
+		while (running_)
+		{
+			try
+			{
+				process_reemmits();
+
+				pollfd descriptor = { fd_, POLLIN, 0 };
+				int timeout_millis = pending_.empty() ? 500 : 100;
+
+				if (poll(&descriptor, 1, timeout_millis) > 0)
+					read_events(buffer);
+
+				flush_settled_files();
+			}
+			catch (...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+			}
+		}
+	}
+
+	void add_watch(const boost::filesystem::path& dir)
+	{
+		int wd = inotify_add_watch(fd_, dir.c_str(), WATCH_MASK);
+
+		if (wd < 0)
+			CASPAR_THROW_EXCEPTION(operation_failed()
+					<< msg_info("inotify_add_watch failed. Consider raising fs.inotify.max_user_watches.")
+					<< boost::errinfo_errno(errno)
+					<< file_name_info(dir.wstring()));
+
+		dirs_by_watch_[wd] = dir;
+	}
+
+	void add_watches(const boost::filesystem::path& root)
+	{
+		add_watch(root);
+
+		for (boost::filesystem::wrecursive_directory_iterator iter(root), end; iter != end; ++iter)
+		{
+			if (boost::filesystem::is_directory(iter->path()))
+				add_watch(iter->path());
+		}
+	}
+
+	void initial_scan()
+	{
+		std::set<boost::filesystem::path> initial_files;
+		auto now = std::time(nullptr);
+
+		for (boost::filesystem::wrecursive_directory_iterator iter(folder_), end; iter != end; ++iter)
+		{
+			if (!running_)
+				return;
+
+			auto& path = iter->path();
+
+			if (boost::filesystem::is_directory(path))
+				continue;
+
+			boost::system::error_code ec;
+			auto mtime = boost::filesystem::last_write_time(path, ec);
+
+			if (ec)
+				continue;
+
+			if (now - mtime < NO_LONGER_WRITING_AGE || !can_read_file(path))
+			{
+				pending_[path] = clock::now();
+				continue;
+			}
+
+			files_.insert(std::make_pair(path, mtime));
+			initial_files.insert(path);
+
+			if (report_already_existing_)
+				emit(filesystem_event::CREATED, path);
+		}
+
+		initial_files_handler_(initial_files);
+	}
+
+	void rescan()
+	{
+		std::set<boost::filesystem::path> removed_files;
+
+		for (auto& file : files_)
+			removed_files.insert(file.first);
+
+		add_watches(folder_);
+
+		for (boost::filesystem::wrecursive_directory_iterator iter(folder_), end; iter != end; ++iter)
+		{
+			auto& path = iter->path();
+
+			if (boost::filesystem::is_directory(path))
+				continue;
+
+			boost::system::error_code ec;
+			auto mtime = boost::filesystem::last_write_time(path, ec);
+
+			if (ec)
+				continue;
+
+			auto known = files_.find(path);
+
+			if (known == files_.end() || known->second != mtime)
+				pending_[path] = clock::now();
+
+			removed_files.erase(path);
+		}
+
+		for (auto& path : removed_files)
+			remove_file(path);
+	}
+
+	void process_reemmits()
+	{
+		if (reemmit_all_.fetch_and_store(false))
+		{
+			for (auto& file : files_)
+			{
+				if (!running_)
+					return;
+
+				emit(filesystem_event::MODIFIED, file.first);
+			}
+		}
+		else
+		{
+			boost::filesystem::path file;
+
+			while (to_reemmit_.try_pop(file))
+			{
+				if (files_.find(file) != files_.end() && boost::filesystem::exists(file))
+					emit(filesystem_event::MODIFIED, file);
+			}
+		}
+	}
+
+	void read_events(std::vector<char>& buffer)
+	{
+		while (true)
+		{
+			auto length = read(fd_, buffer.data(), buffer.size());
+
+			if (length <= 0)
+				return;
+
+			for (auto ptr = buffer.data(); ptr < buffer.data() + length;)
+			{
+				auto event = reinterpret_cast<const inotify_event*>(ptr);
+
+				handle_event(*event);
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+
+	void handle_event(const inotify_event& event)
+	{
+		if (event.mask & IN_Q_OVERFLOW)
+		{
+			CASPAR_LOG(warning) << L"[inotify_filesystem_monitor] Event queue overflowed. Rescanning " << folder_.wstring();
+			rescan();
+			return;
+		}
+
+		auto dir = dirs_by_watch_.find(event.wd);
+
+		if (dir == dirs_by_watch_.end())
+			return;
+
+		if (event.mask & IN_IGNORED)
+		{
+			dirs_by_watch_.erase(dir);
+			return;
+		}
+
+		if (event.len == 0)
+			return;
+
+		auto path = dir->second / event.name;
+
+		if (event.mask & IN_ISDIR)
+		{
+			if (event.mask & (IN_CREATE | IN_MOVED_TO))
+				add_directory(path);
+			else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+				remove_directory(path);
+		}
+		else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+		{
+			pending_.erase(path);
+			remove_file(path);
+		}
+		else
+			pending_[path] = clock::now();
+	}
+
+	void add_directory(const boost::filesystem::path& dir)
+	{
+		try
+		{
+			add_watches(dir);
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+
+		// Files may have been created before the watch was in place.
+		for (boost::filesystem::wrecursive_directory_iterator iter(dir), end; iter != end; ++iter)
+		{
+			if (!boost::filesystem::is_directory(iter->path()))
+				pending_[iter->path()] = clock::now();
+		}
+	}
+
+	void remove_directory(const boost::filesystem::path& dir)
+	{
+		auto prefix = dir.string() + "/";
+		std::vector<boost::filesystem::path> removed;
+
+		for (auto& file : files_)
+		{
+			if (boost::algorithm::starts_with(file.first.string(), prefix))
+				removed.push_back(file.first);
+		}
+
+		for (auto& path : removed)
+			remove_file(path);
+
+		for (auto it = pending_.begin(); it != pending_.end();)
+		{
+			if (boost::algorithm::starts_with(it->first.string(), prefix))
+				it = pending_.erase(it);
+			else
+				++it;
+		}
+
+		// A directory moved out of the tree still has its watches.
+		for (auto it = dirs_by_watch_.begin(); it != dirs_by_watch_.end();)
+		{
+			if (it->second == dir || boost::algorithm::starts_with(it->second.string(), prefix))
+			{
+				inotify_rm_watch(fd_, it->first);
+				it = dirs_by_watch_.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	void remove_file(const boost::filesystem::path& file)
+	{
+		if (files_.erase(file) > 0)
+			emit(filesystem_event::REMOVED, file);
+	}
+
+	void flush_settled_files()
+	{
+		auto now = clock::now();
+
+		for (auto it = pending_.begin(); it != pending_.end();)
+		{
+			if (now - it->second < SETTLE_TIME)
+			{
+				++it;
+				continue;
+			}
+
+			auto path = it->first;
+			boost::system::error_code ec;
+			auto mtime = boost::filesystem::last_write_time(path, ec);
+
+			if (ec || boost::filesystem::is_directory(path))
+			{
+				// Removed again before settling, already handled.
+				it = pending_.erase(it);
+				continue;
+			}
+
+			if (!can_read_file(path))
+			{
+				it->second = now;
+				++it;
+				continue;
+			}
+
+			it = pending_.erase(it);
+
+			auto known = files_.find(path);
+
+			if (known == files_.end())
+			{
+				files_.insert(std::make_pair(path, mtime));
+				emit(filesystem_event::CREATED, path);
+			}
+			else if (known->second != mtime)
+			{
+				known->second = mtime;
+				emit(filesystem_event::MODIFIED, path);
+			}
+		}
+	}
+};
+
+struct native_filesystem_monitor_factory::impl
+{
+	polling_filesystem_monitor_factory fallback_;
+
+	impl(
+			std::shared_ptr<boost::asio::io_service> scheduler,
+			int fallback_scan_interval_millis)
+		: fallback_(std::move(scheduler), fallback_scan_interval_millis)
+	{
+	}
+};
+
+native_filesystem_monitor_factory::native_filesystem_monitor_factory(
+		std::shared_ptr<boost::asio::io_service> scheduler,
+		int fallback_scan_interval_millis)
+	: impl_(new impl(std::move(scheduler), fallback_scan_interval_millis))
+{
+}
+
+native_filesystem_monitor_factory::~native_filesystem_monitor_factory()
+{
+}
+
+filesystem_monitor::ptr native_filesystem_monitor_factory::create(
+		const boost::filesystem::path& folder_to_watch,
+		filesystem_event events_of_interest_mask,
+		bool report_already_existing,
+		const filesystem_monitor_handler& handler,
+		const initial_files_handler& initial_files_handler)
+{
+	if (is_network_filesystem(folder_to_watch))
+	{
+		CASPAR_LOG(info) << L"[native_filesystem_monitor] " << folder_to_watch.wstring() << L" is on a network filesystem. Using polling.";
+
+		return impl_->fallback_.create(folder_to_watch, events_of_interest_mask, report_already_existing, handler, initial_files_handler);
+	}
+
+	try
+	{
+		auto monitor = spl::make_shared<inotify_filesystem_monitor>(
+				folder_to_watch,
+				events_of_interest_mask,
+				report_already_existing,
+				handler,
+				initial_files_handler);
+
+		monitor->start();
+
+		return monitor;
+	}
+	catch (...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION_AT_LEVEL(debug);
+		CASPAR_LOG(warning) << L"[native_filesystem_monitor] Could not watch " << folder_to_watch.wstring() << L" using inotify. Using polling.";
+
+		return impl_->fallback_.create(folder_to_watch, events_of_interest_mask, report_already_existing, handler, initial_files_handler);
+	}
+}
+
+}
@@ -21,6 +21,7 @@ void catch_fpe(int signum)
 	catch (...)
 	{
 		CASPAR_LOG_CURRENT_EXCEPTION();
+		log::flush();
 		throw;
 	}
 }
@@ -34,6 +35,7 @@ void catch_segv(int signum)
 	catch (...)
 	{
 		CASPAR_LOG_CURRENT_EXCEPTION();
+		log::flush();
 		throw;
 	}
 }
@@ -22,16 +22,44 @@
 #include "../../stdafx.h"
 
 #include "../threading.h"
+#include "../../cpu_affinity.h"
+#include "../../utf.h"
 
+#include <boost/lexical_cast.hpp>
+
+#include <fstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 
 namespace caspar {
 
+namespace {
+
+// From linux/ioprio.h which is not exported by all distributions.
+const int IOPRIO_CLASS_SHIFT	= 13;
+const int IOPRIO_CLASS_BE		= 2;
+const int IOPRIO_WHO_PROCESS	= 1;
+const int IOPRIO_LOWEST_BE		= (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7;
+
+}
+
 void set_priority_of_current_thread(thread_priority priority)
 {
-	// TODO: implement
+	if (priority == thread_priority::LOW)
+	{
+		// On Linux both nice value and io priority are per thread when
+		// addressed by thread id.
+		auto tid = get_current_thread_id();
+
+		setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 10);
+		syscall(__NR_ioprio_set, IOPRIO_WHO_PROCESS, static_cast<int>(tid), IOPRIO_LOWEST_BE);
+	}
 }
 
 std::int64_t get_current_thread_id()
@@ -39,4 +67,29 @@ std::int64_t get_current_thread_id()
 	return syscall(__NR_gettid);
 }
 
+bool set_affinity_of_current_thread(const std::vector<int>& processors)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (auto processor : processors)
+	{
+		if (processor < CPU_SETSIZE)
+			CPU_SET(processor, &set);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::vector<int> get_numa_node_processors(int node)
+{
+	std::ifstream cpulist("/sys/devices/system/node/node" + boost::lexical_cast<std::string>(node) + "/cpulist");
+	std::string list;
+
+	if (node < 0 || !std::getline(cpulist, list))
+		return std::vector<int>();
+
+	return parse_processor_list(u16(list));
+}
+
 }
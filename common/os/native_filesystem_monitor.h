@@ -0,0 +1,68 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#pragma once
+
+#include "../filesystem_monitor.h"
+
+#include <boost/asio.hpp>
+
+namespace caspar {
+
+/**
+ * A filesystem monitor implementation using inotify, only available on Linux.
+ * Reacts to changes within a couple of seconds without periodically rescanning
+ * the whole folder.
+ * <p>
+ * Files are only reported as CREATED or MODIFIED when no more changes have
+ * been seen for a while, so that partially written files are not picked up.
+ * <p>
+ * Falls back to polling for folders on network filesystems (where change
+ * notifications are not delivered for remote writes) and when the operating
+ * system mechanism is unavailable or out of resources.
+ */
+class native_filesystem_monitor_factory : public filesystem_monitor_factory
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param scheduler                     The io_service used by the polling
+	 *                                      fallback.
+	 * @param fallback_scan_interval_millis The number of milliseconds between
+	 *                                      each scan when falling back to
+	 *                                      polling.
+	 */
+	native_filesystem_monitor_factory(
+			std::shared_ptr<boost::asio::io_service> scheduler,
+			int fallback_scan_interval_millis = 5000);
+	virtual ~native_filesystem_monitor_factory();
+	virtual filesystem_monitor::ptr create(
+			const boost::filesystem::path& folder_to_watch,
+			filesystem_event events_of_interest_mask,
+			bool report_already_existing,
+			const filesystem_monitor_handler& handler,
+			const initial_files_handler& initial_files_handler);
+private:
+	struct impl;
+	spl::unique_ptr<impl> impl_;
+};
+
+}
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 namespace caspar {
 
@@ -33,4 +34,16 @@ enum class thread_priority
 void set_priority_of_current_thread(thread_priority priority);
 std::int64_t get_current_thread_id();
 
+/**
+ * @return	false if the processors could not be set, for example if none of
+ *			them exist.
+ */
+bool set_affinity_of_current_thread(const std::vector<int>& processors);
+
+/**
+ * @return	The logical processors of the NUMA node, or empty if there is no
+ *			such node.
+ */
+std::vector<int> get_numa_node_processors(int node);
+
 }
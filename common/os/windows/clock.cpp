@@ -0,0 +1,52 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../../stdafx.h"
+
+#include "../clock.h"
+
+#include "windows.h"
+
+namespace caspar {
+
+std::int64_t monotonic_clock_nanos()
+{
+	static const std::int64_t frequency = []
+	{
+		LARGE_INTEGER result;
+		QueryPerformanceFrequency(&result);
+		return result.QuadPart;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	return counter.QuadPart / frequency * 1000000000 + counter.QuadPart % frequency * 1000000000 / frequency;
+}
+
+void sleep_until_monotonic_nanos(std::int64_t deadline)
+{
+	// Sleep(1) sleeps 1-2 ms, so only give up the timeslice when closer.
+	for (auto left = deadline - monotonic_clock_nanos(); left > 0; left = deadline - monotonic_clock_nanos())
+		Sleep(left > 2000000 ? 1 : 0);
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../../stdafx.h"
+
+#include "../futex.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <cstdint>
+#include <functional>
+
+namespace caspar {
+
+// WaitOnAddress() is not available before Windows 8, so the waiters are parked
+// on a condition variable chosen by the address of the word instead.
+struct bucket
+{
+	boost::mutex				mutex;
+	boost::condition_variable	cond;
+};
+
+static bucket& get_bucket(tbb::atomic<int>& word)
+{
+	static bucket buckets[64];
+
+	return buckets[std::hash<void*>()(&word) % 64];
+}
+
+void futex_wait(tbb::atomic<int>& word, int expected)
+{
+	auto& b = get_bucket(word);
+	boost::unique_lock<boost::mutex> lock(b.mutex);
+
+	if (word == expected)
+		b.cond.wait(lock);
+}
+
+void futex_wake_all(tbb::atomic<int>& word)
+{
+	auto& b = get_bucket(word);
+	boost::lock_guard<boost::mutex> lock(b.mutex);
+
+	b.cond.notify_all();
+}
+
+}
@@ -38,4 +38,35 @@ std::int64_t get_current_thread_id()
 	return GetCurrentThreadId();
 }
 
+bool set_affinity_of_current_thread(const std::vector<int>& processors)
+{
+	// Only the processors of the first processor group are supported.
+	DWORD_PTR mask = 0;
+
+	for (auto processor : processors)
+	{
+		if (processor < static_cast<int>(sizeof(DWORD_PTR) * 8))
+			mask |= static_cast<DWORD_PTR>(1) << processor;
+	}
+
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+std::vector<int> get_numa_node_processors(int node)
+{
+	std::vector<int> result;
+	ULONGLONG mask = 0;
+
+	if (node < 0 || !GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask))
+		return result;
+
+	for (int processor = 0; processor < 64; ++processor)
+	{
+		if (mask & (static_cast<ULONGLONG>(1) << processor))
+			result.push_back(processor);
+	}
+
+	return result;
+}
+
 }
@@ -0,0 +1,215 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <tbb/atomic.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <cstddef>
+#include <new>
+
+namespace caspar {
+
+namespace detail {
+
+/**
+ * A pool of fixed size blocks for objects that are allocated and freed at a
+ * high rate, often on different threads, like the tasks of an executor and the
+ * shared states of their futures.
+ *
+ * Freed blocks are pushed on a shared lock-free stack. Each thread allocates
+ * from a cache of its own, and refills it by taking the whole shared stack at
+ * once, so that no thread ever pops a single block from the shared stack (which
+ * would be subject to the ABA problem). Blocks are never returned to the heap.
+ */
+template<std::size_t SIZE>
+class block_pool : boost::noncopyable
+{
+	struct free_block
+	{
+		free_block* next;
+	};
+
+	struct cache
+	{
+		free_block* head = nullptr;
+	};
+
+	tbb::atomic<free_block*>			freed_;
+	boost::thread_specific_ptr<cache>	caches_;
+public:
+	static_assert(SIZE >= sizeof(free_block), "block too small");
+
+	static block_pool& instance()
+	{
+		// Leaked, since blocks may be freed by threads outliving static
+		// destruction.
+		static block_pool* instance = new block_pool;
+
+		return *instance;
+	}
+
+	void* allocate()
+	{
+		auto local = caches_.get();
+
+		if (!local)
+		{
+			local = new cache;
+			caches_.reset(local);
+		}
+
+		if (!local->head)
+			local->head = freed_.fetch_and_store(nullptr);
+
+		if (!local->head)
+			return ::operator new(SIZE);
+
+		auto block = local->head;
+		local->head = block->next;
+
+		return block;
+	}
+
+	void deallocate(void* p)
+	{
+		auto block = static_cast<free_block*>(p);
+
+		push(block, block);
+	}
+private:
+	block_pool()
+		: caches_([](cache* local)
+		{
+			auto& pool = instance();
+			auto first = local->head;
+
+			if (first)
+			{
+				auto last = first;
+
+				while (last->next)
+					last = last->next;
+
+				pool.push(first, last);
+			}
+
+			delete local;
+		})
+	{
+		freed_ = nullptr;
+	}
+
+	void push(free_block* first, free_block* last)
+	{
+		free_block* head;
+
+		do
+		{
+			head = freed_;
+			last->next = head;
+		}
+		while (freed_.compare_and_swap(first, head) != head);
+	}
+};
+
+inline void* pooled_allocate(std::size_t size)
+{
+	if (size <= 64)
+		return block_pool<64>::instance().allocate();
+	else if (size <= 128)
+		return block_pool<128>::instance().allocate();
+	else if (size <= 256)
+		return block_pool<256>::instance().allocate();
+	else if (size <= 512)
+		return block_pool<512>::instance().allocate();
+	else
+		return ::operator new(size);
+}
+
+inline void pooled_deallocate(void* p, std::size_t size)
+{
+	if (size <= 64)
+		block_pool<64>::instance().deallocate(p);
+	else if (size <= 128)
+		block_pool<128>::instance().deallocate(p);
+	else if (size <= 256)
+		block_pool<256>::instance().deallocate(p);
+	else if (size <= 512)
+		block_pool<512>::instance().deallocate(p);
+	else
+		::operator delete(p);
+}
+
+}
+
+/**
+ * Stateless allocator allocating from process wide pools of 64, 128, 256 and
+ * 512 byte blocks, and from the heap for anything larger.
+ */
+template<typename T>
+class pooled_allocator
+{
+public:
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef pooled_allocator<U> other;
+	};
+
+	pooled_allocator()
+	{
+	}
+
+	template<typename U>
+	pooled_allocator(const pooled_allocator<U>&)
+	{
+	}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(detail::pooled_allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		detail::pooled_deallocate(p, n * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator==(const pooled_allocator<U>&) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=(const pooled_allocator<U>&) const
+	{
+		return false;
+	}
+};
+
+}
@@ -0,0 +1,99 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#include "stdafx.h"
+
+#include "task_arena.h"
+
+#include "except.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <tbb/task_scheduler_init.h>
+
+#include <algorithm>
+
+namespace caspar {
+
+namespace {
+
+tbb::priority_t to_tbb_priority(task_arena_priority priority)
+{
+	switch (priority)
+	{
+	case task_arena_priority::low:
+		return tbb::priority_low;
+	case task_arena_priority::high:
+		return tbb::priority_high;
+	default:
+		return tbb::priority_normal;
+	}
+}
+
+}
+
+task_arena_priority task_arena_priority_from_string(const std::wstring& str)
+{
+	if (boost::iequals(str, L"low"))
+		return task_arena_priority::low;
+	else if (boost::iequals(str, L"normal"))
+		return task_arena_priority::normal;
+	else if (boost::iequals(str, L"high"))
+		return task_arena_priority::high;
+
+	CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Invalid priority: " + str));
+}
+
+std::wstring to_string(task_arena_priority priority)
+{
+	switch (priority)
+	{
+	case task_arena_priority::low:
+		return L"low";
+	case task_arena_priority::high:
+		return L"high";
+	default:
+		return L"normal";
+	}
+}
+
+task_arena::task_arena(int max_threads, int num_masters, task_arena_priority priority)
+	: max_threads_(max_threads)
+	, priority_(priority)
+	, tbb_priority_(to_tbb_priority(priority))
+	, arena_(
+			(max_threads > 0 ? max_threads : std::max(1, tbb::task_scheduler_init::default_num_threads() - 1)) + num_masters,
+			static_cast<unsigned>(num_masters))
+{
+}
+
+int task_arena::max_threads() const
+{
+	return max_threads_;
+}
+
+task_arena_priority task_arena::priority() const
+{
+	return priority_;
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#pragma once
+
+#include <tbb/task.h>
+#include <tbb/task_arena.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <exception>
+#include <string>
+
+namespace caspar {
+
+enum class task_arena_priority
+{
+	low,
+	normal,
+	high
+};
+
+task_arena_priority task_arena_priority_from_string(const std::wstring& str);
+std::wstring to_string(task_arena_priority priority);
+
+/**
+ * A tbb::task_arena for the parallel work of a channel, or of background work
+ * like generating thumbnails, so that the tbb::parallel_for calls of one do not
+ * compete for the worker threads of the others. Priority is global, so worker
+ * threads leave arenas of lower priority when there is work in one of higher
+ * priority.
+ */
+class task_arena : boost::noncopyable
+{
+	const int					max_threads_;
+	const task_arena_priority	priority_;
+	const tbb::priority_t		tbb_priority_;
+	tbb::task_arena				arena_;
+public:
+	/**
+	 * @param max_threads	The number of worker threads that may join, or 0
+	 *						for all but one of them (at least one).
+	 * @param num_masters	The number of threads of its own that execute in the
+	 *						arena, for which slots are reserved.
+	 */
+	explicit task_arena(
+			int max_threads = 0,
+			int num_masters = 1,
+			task_arena_priority priority = task_arena_priority::normal);
+
+	/**
+	 * Runs func in the arena on the calling thread, so that any parallel
+	 * algorithm started by it runs in the arena.
+	 */
+	template<typename Func>
+	void execute(Func&& func)
+	{
+		std::exception_ptr exception;
+
+		arena_.execute([&]
+		{
+			try
+			{
+				tbb::task::self().set_group_priority(tbb_priority_);
+				func();
+			}
+			catch (...)
+			{
+				// If the arena was full the functor was run by another thread.
+				exception = std::current_exception();
+			}
+		});
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+	int max_threads() const;
+	task_arena_priority priority() const;
+};
+
+}
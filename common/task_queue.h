@@ -0,0 +1,454 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include "os/futex.h"
+#include "pooled_allocator.h"
+
+#include <tbb/atomic.h>
+#include <tbb/spin_mutex.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace caspar {
+
+class task_queue;
+
+/**
+ * A move only void() callable stored in a pooled node which doubles as the
+ * link of a task_queue, so that neither the callable nor the queueing of it
+ * allocates from the heap, unless the callable is larger than the node.
+ *
+ * A task is either run once, or destroyed without being run.
+ */
+class executor_task
+{
+	friend class task_queue;
+
+	static const std::size_t NODE_SIZE = 256;
+
+	struct node
+	{
+		tbb::atomic<node*>	next;
+		void				(*run)(node&);		// Runs and destroys the callable.
+		void				(*destroy)(node&);	// Destroys the callable.
+		std::aligned_storage<NODE_SIZE - 32, 16>::type storage;
+	};
+
+	static_assert(sizeof(node) <= NODE_SIZE, "node too large");
+
+	typedef detail::block_pool<NODE_SIZE> pool;
+
+	node* node_;
+public:
+	executor_task()
+		: node_(nullptr)
+	{
+	}
+
+	template<typename Func>
+	explicit executor_task(Func&& func)
+		: node_(nullptr)
+	{
+		typedef typename std::decay<Func>::type func_type;
+
+		auto n = new(pool::instance().allocate()) node;
+
+		try
+		{
+			construct<func_type>(*n, std::forward<Func>(func), std::integral_constant<bool,
+					sizeof(func_type) <= sizeof(n->storage) && std::alignment_of<func_type>::value <= 16>());
+		}
+		catch (...)
+		{
+			pool::instance().deallocate(n);
+			throw;
+		}
+
+		node_ = n;
+	}
+
+	executor_task(executor_task&& other)
+		: node_(other.node_)
+	{
+		other.node_ = nullptr;
+	}
+
+	executor_task& operator=(executor_task&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			node_ = other.node_;
+			other.node_ = nullptr;
+		}
+
+		return *this;
+	}
+
+	~executor_task()
+	{
+		reset();
+	}
+
+	explicit operator bool() const
+	{
+		return node_ != nullptr;
+	}
+
+	void run()
+	{
+		auto n = node_;
+		node_ = nullptr;
+
+		std::unique_ptr<node, void (*)(node*)> release(n, [](node* n) { pool::instance().deallocate(n); });
+		n->run(*n);
+	}
+
+	void reset()
+	{
+		if (!node_)
+			return;
+
+		node_->destroy(*node_);
+		pool::instance().deallocate(node_);
+		node_ = nullptr;
+	}
+private:
+	executor_task(const executor_task&);
+	executor_task& operator=(const executor_task&);
+
+	explicit executor_task(node* n)
+		: node_(n)
+	{
+	}
+
+	node* release()
+	{
+		auto n = node_;
+		node_ = nullptr;
+		return n;
+	}
+
+	template<typename F, typename Func>
+	static void construct(node& n, Func&& func, std::true_type /* fits inline */)
+	{
+		new(&n.storage) F(std::forward<Func>(func));
+
+		n.run = [](node& n)
+		{
+			auto& f = *reinterpret_cast<F*>(&n.storage);
+
+			try
+			{
+				f();
+			}
+			catch (...)
+			{
+				f.~F();
+				throw;
+			}
+
+			f.~F();
+		};
+		n.destroy = [](node& n)
+		{
+			reinterpret_cast<F*>(&n.storage)->~F();
+		};
+	}
+
+	template<typename F, typename Func>
+	static void construct(node& n, Func&& func, std::false_type /* fits inline */)
+	{
+		new(&n.storage) F*(new F(std::forward<Func>(func)));
+
+		n.run = [](node& n)
+		{
+			std::unique_ptr<F> f(*reinterpret_cast<F**>(&n.storage));
+			(*f)();
+		};
+		n.destroy = [](node& n)
+		{
+			delete *reinterpret_cast<F**>(&n.storage);
+		};
+	}
+};
+
+/**
+ * Bounded multi producer, single consumer priority queue of executor_task.
+ *
+ * Every priority has its own intrusive lock-free FIFO (Dmitry Vyukov's MPSC
+ * node based queue), so pushing is wait-free apart from the exchange of the
+ * last node of the priority. Popping takes the highest priority task available
+ * and is serialized by a spin lock, since besides the consumer thread others
+ * may clear the queue.
+ *
+ * A consumer waiting for tasks sleeps on a futex, which producers only touch
+ * when there is a consumer to wake up (an eventcount). Producers blocking on a
+ * full queue wait on a condition variable.
+ */
+class task_queue : boost::noncopyable
+{
+	typedef executor_task::node node;
+
+	struct lane
+	{
+		tbb::atomic<node*>	head;	// The most recently pushed node.
+		node*				tail;	// The next node to pop, or the stub.
+		node				stub;
+
+		lane()
+		{
+			stub.next	= nullptr;
+			head		= &stub;
+			tail		= &stub;
+		}
+	};
+
+	const int					num_priorities_;
+	std::unique_ptr<lane[]>		lanes_;
+	tbb::spin_mutex				pop_mutex_;
+	tbb::atomic<int>			size_;
+	tbb::atomic<int>			capacity_;
+	tbb::atomic<int>			wakeups_;
+	tbb::atomic<int>			sleepers_;
+
+	boost::mutex				space_mutex_;
+	boost::condition_variable	space_available_;
+	tbb::atomic<int>			space_waiters_;
+public:
+	typedef unsigned int size_type;
+
+	/**
+	 * @param num_priorities	The priorities are 0 (lowest) to
+	 *							num_priorities - 1 (highest).
+	 */
+	task_queue(int num_priorities, size_type capacity)
+		: num_priorities_(num_priorities)
+		, lanes_(new lane[num_priorities])
+	{
+		size_			= 0;
+		capacity_		= clamp(capacity);
+		wakeups_		= 0;
+		sleepers_		= 0;
+		space_waiters_	= 0;
+	}
+
+	~task_queue()
+	{
+		clear();
+	}
+
+	/**
+	 * Pushes task unless the queue is full, in which case task is left as it
+	 * was.
+	 */
+	bool try_push(int priority, executor_task& task)
+	{
+		if (size_.fetch_and_increment() >= capacity_)
+		{
+			size_.fetch_and_decrement();
+			return false;
+		}
+
+		push_node(lanes_[priority], task.release());
+
+		if (sleepers_ > 0)
+		{
+			wakeups_.fetch_and_increment();
+			futex_wake_all(wakeups_);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Pushes task, blocking while the queue is full.
+	 */
+	void push(int priority, executor_task& task)
+	{
+		while (!try_push(priority, task))
+		{
+			boost::unique_lock<boost::mutex> lock(space_mutex_);
+
+			space_waiters_.fetch_and_increment();
+
+			while (size_ >= capacity_)
+				space_available_.wait(lock);
+
+			space_waiters_.fetch_and_decrement();
+		}
+	}
+
+	/**
+	 * Pops the highest priority task, blocking while the queue is empty.
+	 */
+	executor_task pop()
+	{
+		executor_task task;
+
+		while (!try_pop(task))
+		{
+			sleepers_.fetch_and_increment();
+			int wakeups = wakeups_;
+
+			// A task pushed before the sleeper was counted would not wake it.
+			if (try_pop(task))
+			{
+				sleepers_.fetch_and_decrement();
+				break;
+			}
+
+			futex_wait(wakeups_, wakeups);
+			sleepers_.fetch_and_decrement();
+		}
+
+		return task;
+	}
+
+	/**
+	 * Pops the highest priority task of at least minimum_priority, if any.
+	 */
+	bool try_pop(executor_task& task, int minimum_priority = 0)
+	{
+		tbb::spin_mutex::scoped_lock lock(pop_mutex_);
+
+		for (int priority = num_priorities_ - 1; priority >= minimum_priority; --priority)
+		{
+			auto n = pop_node(lanes_[priority]);
+
+			if (n)
+			{
+				task = executor_task(n);
+				size_.fetch_and_decrement();
+				notify_space_available();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * Destroys all queued tasks without running them.
+	 */
+	void clear()
+	{
+		executor_task task;
+
+		while (try_pop(task))
+			task.reset();
+	}
+
+	void set_capacity(size_type capacity)
+	{
+		capacity_ = clamp(capacity);
+		notify_space_available();
+	}
+
+	size_type capacity() const
+	{
+		return static_cast<size_type>(capacity_);
+	}
+
+	size_type size() const
+	{
+		return static_cast<size_type>(std::max(0, static_cast<int>(size_)));
+	}
+
+	size_type space_available() const
+	{
+		return static_cast<size_type>(std::max(0, capacity_ - size_));
+	}
+private:
+	static int clamp(size_type capacity)
+	{
+		return static_cast<int>(std::min<size_type>(capacity, std::numeric_limits<int>::max()));
+	}
+
+	static void push_node(lane& l, node* n)
+	{
+		n->next = nullptr;
+		auto previous = l.head.fetch_and_store(n);
+		previous->next.fetch_and_store(n); // Full fence, orders the link before reading sleepers_.
+	}
+
+	static node* pop_node(lane& l)
+	{
+		auto tail = l.tail;
+		node* next = tail->next;
+
+		if (tail == &l.stub)
+		{
+			if (!next)
+				return nullptr;
+
+			l.tail	= next;
+			tail	= next;
+			next	= next->next;
+		}
+
+		if (next)
+		{
+			l.tail = next;
+			return tail;
+		}
+
+		// A producer has exchanged the head but not linked its node yet.
+		if (tail != l.head)
+			return nullptr;
+
+		push_node(l, &l.stub);
+		next = tail->next;
+
+		if (next)
+		{
+			l.tail = next;
+			return tail;
+		}
+
+		return nullptr;
+	}
+
+	void notify_space_available()
+	{
+		if (space_waiters_ > 0)
+		{
+			boost::lock_guard<boost::mutex> lock(space_mutex_);
+			space_available_.notify_all();
+		}
+	}
+};
+
+}
@@ -37,6 +37,7 @@ struct thread_info
 {
 	std::string		name;
 	std::int64_t	native_id;
+	std::string		affinity;	// The processors the thread is bound to, if any.
 
 	thread_info();
 };
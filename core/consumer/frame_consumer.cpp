@@ -127,6 +127,7 @@ public:
 
 	std::future<bool> send(const_frame frame) override																				{return consumer_->send(std::move(frame));}
 	void initialize(const video_format_desc& format_desc, const audio_channel_layout& channel_layout, int channel_index) override	{return consumer_->initialize(format_desc, channel_layout, channel_index);}
+	void freewheel(bool enabled) override																							{consumer_->freewheel(enabled);}
 	std::wstring print() const override																								{return consumer_->print();}
 	std::wstring name() const override																								{return consumer_->name();}
 	boost::property_tree::wptree info() const override 																				{return consumer_->info();}
@@ -161,6 +162,7 @@ public:
 		consumer_->initialize(format_desc, channel_layout, channel_index);
 		CASPAR_LOG(info) << consumer_->print() << L" Initialized.";
 	}
+	void freewheel(bool enabled) override																							{consumer_->freewheel(enabled);}
 	std::wstring print() const override																								{return consumer_->print();}
 	std::wstring name() const override																								{return consumer_->name();}
 	boost::property_tree::wptree info() const override 																				{return consumer_->info();}
@@ -215,6 +217,7 @@ public:
 		return consumer_->initialize(format_desc, channel_layout, channel_index);
 	}
 
+	void freewheel(bool enabled) override									{consumer_->freewheel(enabled);}
 	std::wstring print() const override										{return consumer_->print();}
 	std::wstring name() const override										{return consumer_->name();}
 	boost::property_tree::wptree info() const override 						{return consumer_->info();}
@@ -270,6 +273,7 @@ public:
 		return std::move(result);
 	}
 
+	void freewheel(bool enabled) override									{consumer_->freewheel(enabled);}
 	std::wstring print() const override										{return consumer_->print();}
 	std::wstring name() const override										{return consumer_->name();}
 	boost::property_tree::wptree info() const override 						{return consumer_->info();}
@@ -56,6 +56,7 @@ public:
 
 	virtual std::future<bool>				send(const_frame frame) = 0;
 	virtual void							initialize(const video_format_desc& format_desc, const audio_channel_layout& channel_layout, int channel_index) = 0;
+	virtual void							freewheel(bool enabled) {} // Consumers that drop frames to keep up in real time should block instead when enabled.
 
 	// monitor::observable
 
@@ -33,12 +33,16 @@
 #include "../video_format.h"
 #include "../frame/frame.h"
 #include "../frame/audio_channel_layout.h"
+#include "../monitor/latency_reporter.h"
 
 #include <common/assert.h>
+#include <common/cpu_affinity.h>
 #include <common/future.h>
 #include <common/executor.h>
 #include <common/diagnostics/graph.h>
-#include <common/prec_timer.h>
+#include <common/diagnostics/latency_stats.h>
+#include <common/diagnostics/memory_accounting.h>
+#include <common/frame_clock.h>
 #include <common/memshfl.h>
 #include <common/env.h>
 #include <common/linq.h>
@@ -57,27 +61,35 @@ struct output::impl
 	spl::shared_ptr<diagnostics::graph>	graph_;
 	spl::shared_ptr<monitor::subject>	monitor_subject_			= spl::make_shared<monitor::subject>("/output");
 	const int							channel_index_;
+	const bool							freewheel_;
 	video_format_desc					format_desc_;
 	audio_channel_layout				channel_layout_;
 	std::map<int, port>					ports_;
-	prec_timer							sync_timer_;
+	frame_clock							sync_clock_;
 	boost::circular_buffer<const_frame>	frames_;
+	caspar::diagnostics::memory_account	frames_memory_				{ L"output", channel_index_ };
 	std::map<int, int64_t>				send_to_consumers_delays_;
+	caspar::diagnostics::latency_stats	consume_stats_;
+	monitor::latency_reporter			consume_reporter_;
 	executor							executor_					{ L"output " + boost::lexical_cast<std::wstring>(channel_index_) };
 public:
-	impl(spl::shared_ptr<diagnostics::graph> graph, const video_format_desc& format_desc, const audio_channel_layout& channel_layout, int channel_index)
+	impl(spl::shared_ptr<diagnostics::graph> graph, const video_format_desc& format_desc, const audio_channel_layout& channel_layout, int channel_index, bool freewheel, const cpu_affinity& affinity)
 		: graph_(std::move(graph))
 		, channel_index_(channel_index)
+		, freewheel_(freewheel)
 		, format_desc_(format_desc)
 		, channel_layout_(channel_layout)
+		, sync_clock_(format_desc.framerate, env::properties().get(L"configuration.lock-channels-to-server-clock", false))
 	{
 		graph_->set_color("consume-time", diagnostics::color(1.0f, 0.4f, 0.0f, 0.8f));
+		executor_.invoke([&] { affinity.bind_current_thread(); });
 	}
 
 	void add(int index, spl::shared_ptr<frame_consumer> consumer)
 	{
 		remove(index);
 
+		consumer->freewheel(freewheel_);
 		consumer->initialize(format_desc_, channel_layout_, channel_index_);
 
 		executor_.begin_invoke([this, index, consumer]
@@ -137,6 +149,8 @@ public:
 			format_desc_ = format_desc;
 			channel_layout_ = channel_layout;
 			frames_.clear();
+			frames_memory_.set(0);
+			sync_clock_.set_framerate(format_desc_.framerate);
 		});
 	}
 
@@ -178,6 +192,7 @@ public:
 
 			frames_.set_capacity(std::max(2, minmax.second - minmax.first) + 1); // std::max(2, x) since we want to guarantee some pipeline depth for asycnhronous mixer read-back.
 			frames_.push_back(input_frame);
+			frames_memory_.set(static_cast<std::int64_t>(frames_.size()) * format_desc_.size);
 
 			if (!frames_.full())
 				return nullptr;
@@ -234,6 +249,13 @@ public:
 						send_to_consumers_delays_.erase(it->first);
 						ports_.erase(it->first);
 					}
+					else
+					{
+						auto port = ports_.find(it->first);
+
+						if (port != ports_.end())
+							port->second.record_send_time(frame_timer->elapsed(), format_desc.fps, freewheel_);
+					}
 				}
 				catch (...)
 				{
@@ -243,11 +265,20 @@ public:
 				}
 			}
 
-			if (!has_synchronization_clock())
-				sync_timer_.tick(1.0 / format_desc_.fps);
+			if (!freewheel_ && !has_synchronization_clock())
+			{
+				sync_clock_.tick();
+
+				*monitor_subject_
+					<< monitor::message("/clock/jitter") % (sync_clock_.jitter_nanos() / 1000)
+					<< monitor::message("/clock/max_jitter") % (sync_clock_.max_jitter_nanos() / 1000)
+					<< monitor::message("/clock/drift") % (sync_clock_.drift_nanos() / 1000);
+			}
 
 			auto consume_time = frame_timer->elapsed();
 			graph_->set_value("consume-time", consume_time * format_desc.fps * 0.5);
+			consume_stats_.record_frame_time(consume_time, freewheel_ ? 0.0 : format_desc.fps);
+			consume_reporter_.tick(consume_stats_, *monitor_subject_, format_desc.fps);
 			*monitor_subject_
 				<< monitor::message("/consume_time") % consume_time
 				<< monitor::message("/profiler/time") % consume_time % (1.0 / format_desc.fps);
@@ -269,6 +300,16 @@ public:
 				info.add_child(L"consumers.consumer", port.second.info())
 					.add(L"index", port.first);
 			}
+
+			if (!freewheel_ && !has_synchronization_clock())
+			{
+				// In microseconds
+				info.add(L"clock.jitter", sync_clock_.jitter_nanos() / 1000);
+				info.add(L"clock.max-jitter", sync_clock_.max_jitter_nanos() / 1000);
+				info.add(L"clock.drift", sync_clock_.drift_nanos() / 1000);
+				info.add(L"clock.skipped-frames", sync_clock_.skipped_frames());
+			}
+
 			return info;
 		}, task_priority::high_priority));
 	}
@@ -298,6 +339,24 @@ public:
 		}, task_priority::high_priority));
 	}
 
+	std::future<boost::property_tree::wptree> stats_info()
+	{
+		return std::move(executor_.begin_invoke([&]() -> boost::property_tree::wptree
+		{
+			boost::property_tree::wptree info;
+
+			info.add_child(L"consume", consume_stats_.info());
+
+			for (auto& port : ports_)
+			{
+				info.add_child(L"consumers.consumer", port.second.stats_info())
+					.add(L"index", port.first);
+			}
+
+			return info;
+		}, task_priority::high_priority));
+	}
+
 	std::vector<spl::shared_ptr<const frame_consumer>> get_consumers()
 	{
 		return executor_.invoke([=]
@@ -312,13 +371,14 @@ public:
 	}
 };
 
-output::output(spl::shared_ptr<diagnostics::graph> graph, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout, int channel_index) : impl_(new impl(std::move(graph), format_desc, channel_layout, channel_index)){}
+output::output(spl::shared_ptr<diagnostics::graph> graph, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout, int channel_index, bool freewheel, const cpu_affinity& affinity) : impl_(new impl(std::move(graph), format_desc, channel_layout, channel_index, freewheel, affinity)){}
 void output::add(int index, const spl::shared_ptr<frame_consumer>& consumer){impl_->add(index, consumer);}
 void output::add(const spl::shared_ptr<frame_consumer>& consumer){impl_->add(consumer);}
 void output::remove(int index){impl_->remove(index);}
 void output::remove(const spl::shared_ptr<frame_consumer>& consumer){impl_->remove(consumer);}
 std::future<boost::property_tree::wptree> output::info() const{return impl_->info();}
 std::future<boost::property_tree::wptree> output::delay_info() const{ return impl_->delay_info(); }
+std::future<boost::property_tree::wptree> output::stats_info() const{ return impl_->stats_info(); }
 std::vector<spl::shared_ptr<const frame_consumer>> output::get_consumers() const { return impl_->get_consumers(); }
 std::future<void> output::operator()(const_frame frame, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout){ return (*impl_)(std::move(frame), format_desc, channel_layout); }
 monitor::subject& output::monitor_output() {return *impl_->monitor_subject_;}
@@ -32,6 +32,7 @@
 
 #include <future>
 
+FORWARD1(caspar, class cpu_affinity);
 FORWARD2(caspar, diagnostics, class graph);
 
 namespace caspar { namespace core {
@@ -46,7 +47,7 @@ public:
 
 	// Constructors
 
-	explicit output(spl::shared_ptr<caspar::diagnostics::graph> graph, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout, int channel_index);
+	explicit output(spl::shared_ptr<caspar::diagnostics::graph> graph, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout, int channel_index, bool freewheel, const cpu_affinity& affinity);
 
 	// Methods
 
@@ -64,6 +65,7 @@ public:
 
 	std::future<boost::property_tree::wptree> info() const;
 	std::future<boost::property_tree::wptree> delay_info() const;
+	std::future<boost::property_tree::wptree> stats_info() const;
 	std::vector<spl::shared_ptr<const frame_consumer>> get_consumers() const;
 
 private:
@@ -4,6 +4,10 @@
 
 #include "frame_consumer.h"
 #include "../frame/frame.h"
+#include "../monitor/latency_reporter.h"
+
+#include <common/diagnostics/latency_stats.h>
+
 #include <boost/lexical_cast.hpp>
 
 #include <future>
@@ -16,6 +20,8 @@ struct port::impl
 	spl::shared_ptr<monitor::subject>	monitor_subject_ = spl::make_shared<monitor::subject>("/port/" + boost::lexical_cast<std::string>(index_));
 	spl::shared_ptr<frame_consumer>		consumer_;
 	int									channel_index_;
+	caspar::diagnostics::latency_stats	send_stats_;
+	monitor::latency_reporter			send_reporter_;
 public:
 	impl(int index, int channel_index, spl::shared_ptr<frame_consumer> consumer)
 		: index_(index)
@@ -35,6 +41,12 @@ public:
 		*monitor_subject_ << monitor::message("/type") % consumer_->name();
 		return consumer_->send(std::move(frame));
 	}
+
+	void record_send_time(double seconds, double fps, bool freewheel)
+	{
+		send_stats_.record_frame_time(seconds, freewheel ? 0.0 : fps);
+		send_reporter_.tick(send_stats_, *monitor_subject_, fps);
+	}
 	std::wstring print() const
 	{
 		return consumer_->print();
@@ -60,6 +72,11 @@ public:
 		return consumer_->info();
 	}
 
+	boost::property_tree::wptree stats_info() const
+	{
+		return send_stats_.info();
+	}
+
 	int64_t presentation_frame_age_millis() const
 	{
 		return consumer_->presentation_frame_age_millis();
@@ -76,12 +93,14 @@ port::port(port&& other) : impl_(std::move(other.impl_)){}
 port::~port(){}
 port& port::operator=(port&& other){impl_ = std::move(other.impl_); return *this;}
 std::future<bool> port::send(const_frame frame){return impl_->send(std::move(frame));}
+void port::record_send_time(double seconds, double fps, bool freewheel){impl_->record_send_time(seconds, fps, freewheel);}
 monitor::subject& port::monitor_output() {return *impl_->monitor_subject_;}
 void port::change_channel_format(const core::video_format_desc& format_desc, const audio_channel_layout& channel_layout){impl_->change_channel_format(format_desc, channel_layout);}
 int port::buffer_depth() const{return impl_->buffer_depth();}
 std::wstring port::print() const{ return impl_->print();}
 bool port::has_synchronization_clock() const{return impl_->has_synchronization_clock();}
 boost::property_tree::wptree port::info() const{return impl_->info();}
+boost::property_tree::wptree port::stats_info() const{return impl_->stats_info();}
 int64_t port::presentation_frame_age_millis() const{ return impl_->presentation_frame_age_millis(); }
 spl::shared_ptr<const frame_consumer> port::consumer() const { return impl_->consumer(); }
 }}
@@ -30,6 +30,12 @@ public:
 
 	std::future<bool> send(const_frame frame);
 
+	/**
+	 * Records how long the consumer took to accept the frame of the last
+	 * send(). Sends of a freewheeling channel are never counted as late.
+	 */
+	void record_send_time(double seconds, double fps, bool freewheel);
+
 	monitor::subject& monitor_output();
 
 	// Properties
@@ -39,6 +45,7 @@ public:
 	int buffer_depth() const;
 	bool has_synchronization_clock() const;
 	boost::property_tree::wptree info() const;
+	boost::property_tree::wptree stats_info() const;
 	int64_t presentation_frame_age_millis() const;
 	spl::shared_ptr<const frame_consumer> consumer() const;
 private:
@@ -50,6 +50,13 @@ public:
 	// Properties
 
 	virtual int get_max_frame_size() = 0;
+
+	/**
+	 * @return Whether the frames are mixed in system memory by the CPU, in
+	 *         which case producers might as well process them on the CPU
+	 *         themselves.
+	 */
+	virtual bool mixes_on_cpu() const { return false; }
 };
 
 }}
\ No newline at end of file
@@ -84,6 +84,8 @@ struct audio_mixer::impl : boost::noncopyable
 	float								master_volume_			= 1.0f;
 	float								previous_master_volume_	= master_volume_;
 	spl::shared_ptr<diagnostics::graph>	graph_;
+	std::vector<std::string>			pfs_paths_;
+	std::vector<std::string>			dbfs_paths_;
 public:
 	impl(spl::shared_ptr<diagnostics::graph> graph)
 		: graph_(std::move(graph))
@@ -243,7 +245,7 @@ public:
 				.count();
 
 			if(nb_invalid_streams > 0)
-				CASPAR_LOG(trace) << "[audio_mixer] Incorrect frame audio cadence detected.";
+				CASPAR_LOG_RATE_LIMITED(trace) << "[audio_mixer] Incorrect frame audio cadence detected.";
 		}
 
 		audio_buffer_ps result_ps(audio_size(audio_cadence_.front()), 0.0);
@@ -252,9 +254,9 @@ public:
 			if (stream.audio_data.size() < result_ps.size())
 			{
 				auto samples = (result_ps.size() - stream.audio_data.size()) / channel_layout_.num_channels;
-				CASPAR_LOG(trace) << L"[audio_mixer] Appended " << samples << L" zero samples";
-				CASPAR_LOG(trace) << L"[audio_mixer] Actual number of samples " << stream.audio_data.size() / channel_layout_.num_channels;
-				CASPAR_LOG(trace) << L"[audio_mixer] Wanted number of samples " << result_ps.size() / channel_layout_.num_channels;
+				CASPAR_LOG_RATE_LIMITED(trace) << L"[audio_mixer] Appended " << samples << L" zero samples";
+				CASPAR_LOG_RATE_LIMITED(trace) << L"[audio_mixer] Actual number of samples " << stream.audio_data.size() / channel_layout_.num_channels;
+				CASPAR_LOG_RATE_LIMITED(trace) << L"[audio_mixer] Wanted number of samples " << result_ps.size() / channel_layout_.num_channels;
 				stream.audio_data.resize(result_ps.size(), 0.0);
 			}
 
@@ -302,15 +304,22 @@ public:
 		// Otherwise it would be -infinity
 		static const auto MIN_PFS = 0.5f / static_cast<float>(std::numeric_limits<int32_t>::max());
 
+		// The paths are only formatted when the number of channels changes.
+		while (static_cast<int>(pfs_paths_.size()) < num_channels)
+		{
+			auto chan_str = boost::lexical_cast<std::string>(pfs_paths_.size() + 1);
+
+			pfs_paths_.push_back("/" + chan_str + "/pFS");
+			dbfs_paths_.push_back("/" + chan_str + "/dBFS");
+		}
+
 		for (int i = 0; i < num_channels; ++i)
 		{
 			const auto pFS = max[i] / static_cast<float>(std::numeric_limits<int32_t>::max());
 			const auto dBFS = 20.0f * std::log10(std::max(MIN_PFS, pFS));
 
-			auto chan_str = boost::lexical_cast<std::string>(i + 1);
-
-			monitor_subject_ << monitor::message("/" + chan_str + "/pFS") % pFS;
-			monitor_subject_ << monitor::message("/" + chan_str + "/dBFS") % dBFS;
+			monitor_subject_ << monitor::message(pfs_paths_[i]) % pFS;
+			monitor_subject_ << monitor::message(dbfs_paths_[i]) % dBFS;
 		}
 
 		graph_->set_value("volume", static_cast<double>(*boost::max_element(max)) / std::numeric_limits<int32_t>::max());
@@ -27,9 +27,12 @@
 
 #include "audio/audio_mixer.h"
 #include "image/image_mixer.h"
+#include "../monitor/latency_reporter.h"
 
+#include <common/cpu_affinity.h>
 #include <common/env.h>
 #include <common/executor.h>
+#include <common/task_arena.h>
 #include <common/diagnostics/graph.h>
 #include <common/except.h>
 #include <common/future.h>
@@ -58,24 +61,33 @@ struct mixer::impl : boost::noncopyable
 {
 	int									channel_index_;
 	spl::shared_ptr<diagnostics::graph>	graph_;
+	const bool							freewheel_;
 	tbb::atomic<int64_t>				current_mix_time_;
+	tbb::atomic<bool>					profiler_time_output_;
 	spl::shared_ptr<monitor::subject>	monitor_subject_	= spl::make_shared<monitor::subject>("/mixer");
 	audio_mixer							audio_mixer_		{ graph_ };
 	spl::shared_ptr<image_mixer>		image_mixer_;
+	spl::shared_ptr<task_arena>			arena_;
+	caspar::diagnostics::latency_stats	mix_stats_;
+	monitor::latency_reporter			mix_reporter_;
 
 	bool								straighten_alpha_	= false;
 			
 	executor							executor_			{ L"mixer " + boost::lexical_cast<std::wstring>(channel_index_) };
 
 public:
-	impl(int channel_index, spl::shared_ptr<diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer) 
+	impl(int channel_index, spl::shared_ptr<diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena) 
 		: channel_index_(channel_index)
 		, graph_(std::move(graph))
+		, freewheel_(freewheel)
 		, image_mixer_(std::move(image_mixer))
+		, arena_(std::move(arena))
 	{			
 		graph_->set_color("mix-time", diagnostics::color(1.0f, 0.0f, 0.9f, 0.8f));
 		current_mix_time_ = 0;
+		profiler_time_output_ = false;
 		audio_mixer_.monitor_output().attach_parent(monitor_subject_);
+		executor_.invoke([&] { affinity.bind_current_thread(); });
 	}
 	
 	const_frame operator()(std::map<int, draw_frame> frames, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout)
@@ -92,14 +104,20 @@ public:
 						static_cast<double>(format_desc.square_width)
 						/ static_cast<double>(format_desc.square_height));
 
-				for (auto& frame : frames)
+				std::future<array<const std::uint8_t>> image;
+
+				arena_->execute([&]
 				{
-					frame.second.accept(audio_mixer_);
-					frame.second.transform().image_transform.layer_depth = 1;
-					frame.second.accept(*image_mixer_);
-				}
-				
-				auto image = (*image_mixer_)(format_desc, straighten_alpha_);
+					for (auto& frame : frames)
+					{
+						frame.second.accept(audio_mixer_);
+						frame.second.transform().image_transform.layer_depth = 1;
+						frame.second.accept(*image_mixer_);
+					}
+
+					image = (*image_mixer_)(format_desc, straighten_alpha_);
+				});
+
 				auto audio = audio_mixer_(format_desc, channel_layout);
 
 				auto desc = core::pixel_format_desc(core::pixel_format::bgra);
@@ -116,6 +134,11 @@ public:
 		auto mix_time = frame_timer.elapsed();
 		graph_->set_value("mix-time", mix_time * format_desc.fps * 0.5);
 		current_mix_time_ = static_cast<int64_t>(mix_time * 1000.0);
+		mix_stats_.record_frame_time(mix_time, freewheel_ ? 0.0 : format_desc.fps);
+		mix_reporter_.tick(mix_stats_, *monitor_subject_, format_desc.fps);
+
+		if (profiler_time_output_)
+			*monitor_subject_ << monitor::message("/profiler/time") % mix_time % (1.0 / format_desc.fps);
 
 		return frame;
 	}
@@ -169,14 +192,17 @@ public:
 	}
 };
 	
-mixer::mixer(int channel_index, spl::shared_ptr<diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer) 
-	: impl_(new impl(channel_index, std::move(graph), std::move(image_mixer))){}
+mixer::mixer(int channel_index, spl::shared_ptr<diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena) 
+	: impl_(new impl(channel_index, std::move(graph), std::move(image_mixer), freewheel, affinity, std::move(arena))){}
 void mixer::set_master_volume(float volume) { impl_->set_master_volume(volume); }
 float mixer::get_master_volume() { return impl_->get_master_volume(); }
 void mixer::set_straight_alpha_output(bool value) { impl_->set_straight_alpha_output(value); }
 bool mixer::get_straight_alpha_output() { return impl_->get_straight_alpha_output(); }
+void mixer::set_profiler_time_output(bool value) { impl_->profiler_time_output_ = value; }
+bool mixer::get_profiler_time_output() const { return impl_->profiler_time_output_; }
 std::future<boost::property_tree::wptree> mixer::info() const{return impl_->info();}
 std::future<boost::property_tree::wptree> mixer::delay_info() const{ return impl_->delay_info(); }
+boost::property_tree::wptree mixer::stats_info() const{ return impl_->mix_stats_.info(); }
 const_frame mixer::operator()(std::map<int, draw_frame> frames, const video_format_desc& format_desc, const core::audio_channel_layout& channel_layout){ return (*impl_)(std::move(frames), format_desc, channel_layout); }
 mutable_frame mixer::create_frame(const void* tag, const core::pixel_format_desc& desc, const core::audio_channel_layout& channel_layout) {return impl_->image_mixer_->create_frame(tag, desc, channel_layout);}
 monitor::subject& mixer::monitor_output() { return *impl_->monitor_subject_; }
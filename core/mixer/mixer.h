@@ -34,6 +34,8 @@
 
 #include <map>
 
+FORWARD1(caspar, class cpu_affinity);
+FORWARD1(caspar, class task_arena);
 FORWARD2(caspar, diagnostics, class graph);
 
 namespace caspar { namespace core {
@@ -48,7 +50,7 @@ public:
 					
 	// Constructors
 	
-	explicit mixer(int channel_index, spl::shared_ptr<caspar::diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer);
+	explicit mixer(int channel_index, spl::shared_ptr<caspar::diagnostics::graph> graph, spl::shared_ptr<image_mixer> image_mixer, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena);
 
 	// Methods
 		
@@ -59,12 +61,20 @@ public:
 	void set_straight_alpha_output(bool value);
 	bool get_straight_alpha_output();
 
+	/**
+	 * Whether to send the mix time of every frame as /profiler/time, for
+	 * benchmarking. Off by default, since it is a message per frame.
+	 */
+	void set_profiler_time_output(bool value);
+	bool get_profiler_time_output() const;
+
 	mutable_frame create_frame(const void* tag, const pixel_format_desc& desc, const core::audio_channel_layout& channel_layout);
 
 	// Properties
 
 	std::future<boost::property_tree::wptree> info() const;
 	std::future<boost::property_tree::wptree> delay_info() const;
+	boost::property_tree::wptree stats_info() const;
 
 	monitor::subject& monitor_output();
 
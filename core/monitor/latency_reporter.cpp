@@ -0,0 +1,55 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../StdAfx.h"
+
+#include "latency_reporter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace caspar { namespace core { namespace monitor {
+
+latency_reporter::latency_reporter(std::string path)
+	: path_(std::move(path))
+{
+}
+
+void latency_reporter::tick(const caspar::diagnostics::latency_stats& stats, subject& subject, double fps)
+{
+	if (++frames_ < std::max(1, static_cast<int>(std::ceil(fps))))
+		return;
+
+	frames_ = 0;
+
+	auto snapshot	= stats.get_snapshot();
+	auto interval	= snapshot.since(last_);
+	last_			= std::move(snapshot);
+
+	subject
+		<< message(path_ + "/p50")			% interval.value_at(0.5)
+		<< message(path_ + "/p99")			% interval.value_at(0.99)
+		<< message(path_ + "/max")			% interval.max()
+		<< message(path_ + "/late")		% static_cast<std::int64_t>(stats.late())
+		<< message(path_ + "/underflows")	% static_cast<std::int64_t>(stats.underflows());
+}
+
+}}}
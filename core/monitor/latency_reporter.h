@@ -0,0 +1,53 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include "monitor.h"
+
+#include <common/diagnostics/latency_stats.h>
+
+#include <string>
+
+namespace caspar { namespace core { namespace monitor {
+
+/**
+ * Publishes latency stats as messages about once a second, with the
+ * p50, p99 and max in microseconds of the frames since the last time, and the
+ * total number of late frames and underflows:
+ *
+ * <path>/p50 <path>/p99 <path>/max <path>/late <path>/underflows
+ */
+class latency_reporter
+{
+	const std::string									path_;
+	caspar::diagnostics::latency_histogram::snapshot	last_;
+	int													frames_	= 0;
+public:
+	explicit latency_reporter(std::string path = "/latency");
+
+	/**
+	 * To be called once per frame.
+	 */
+	void tick(const caspar::diagnostics::latency_stats& stats, subject& subject, double fps);
+};
+
+}}}
@@ -22,6 +22,7 @@
 
 #include <common/memory.h>
 #include <common/assert.h>
+#include <common/pooled_allocator.h>
 
 #include <boost/variant.hpp>
 #include <boost/chrono/duration.hpp>
@@ -47,7 +48,7 @@ public:
 
 	message(std::string path, std::vector<data_t> data = std::vector<data_t>())
 		: path_(std::move(path))
-		, data_ptr_(std::make_shared<std::vector<data_t>>(std::move(data)))
+		, data_ptr_(std::allocate_shared<std::vector<data_t>>(pooled_allocator<std::vector<data_t>>(), std::move(data)))
 	{
 		CASPAR_ASSERT(path.empty() || path[0] == '/');
 	}
@@ -71,7 +72,11 @@ public:
 
 	message propagate(const std::string& path) const
 	{
-		return message(path + path_, data_ptr_);
+		std::string full_path;
+		full_path.reserve(path.size() + path_.size());
+		full_path.append(path).append(path_);
+
+		return message(std::move(full_path), data_ptr_);
 	}
 
 	template<typename T>
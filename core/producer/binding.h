@@ -26,13 +26,14 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <queue>
 #include <algorithm>
 #include <type_traits>
 #include <stdexcept>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/utility/value_init.hpp>
-#include <boost/range/algorithm/remove_if.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <common/tweener.h>
 #include <common/except.h>
@@ -41,12 +42,61 @@ namespace caspar { namespace core {
 
 namespace detail {
 
+struct impl_base;
+
+/**
+ * Collects the bindings whose dependencies changed and re-evaluates them in
+ * order of depth, so that a binding reachable through several paths is only
+ * evaluated once, after all of its dependencies are up to date. Bindings whose
+ * value did not change never schedule their dependants, so unchanged
+ * subgraphs are skipped entirely. Change listeners are invoked when all
+ * bindings have settled.
+ */
+class propagation_queue
+{
+	typedef std::pair<int, std::shared_ptr<const impl_base>> entry;
+
+	struct deeper
+	{
+		bool operator()(const entry& lhs, const entry& rhs) const
+		{
+			return lhs.first > rhs.first;
+		}
+	};
+
+	std::priority_queue<entry, std::vector<entry>, deeper>					queue_;
+	std::vector<std::pair<std::weak_ptr<void>, std::function<void ()>>>		listeners_;
+	bool																	draining_	= false;
+public:
+	static propagation_queue& for_this_thread()
+	{
+		static boost::thread_specific_ptr<propagation_queue> instance;
+
+		if (!instance.get())
+			instance.reset(new propagation_queue);
+
+		return *instance;
+	}
+
+	inline void schedule(std::shared_ptr<const impl_base> dependant);
+
+	void schedule(const std::pair<std::weak_ptr<void>, std::function<void ()>>& listener)
+	{
+		listeners_.push_back(listener);
+	}
+
+	inline void drain();
+};
+
 struct impl_base : std::enable_shared_from_this<impl_base>
 {
 	std::vector<std::shared_ptr<impl_base>> dependencies_;
+	mutable std::vector<std::weak_ptr<impl_base>> dependants_;
 	mutable std::vector<std::pair<
 			std::weak_ptr<void>,
 			std::function<void ()>>> on_change_;
+	int depth_ = 0;
+	mutable bool pending_ = false;
 
 	virtual ~impl_base()
 	{
@@ -61,8 +111,26 @@ struct impl_base : std::enable_shared_from_this<impl_base>
 		if (dependency->depends_on(self))
 			CASPAR_THROW_EXCEPTION(invalid_argument() << msg_info("Can't have circular dependencies between bindings"));
 
-		dependency->on_change(self, [=] { evaluate(); });
+		dependency->dependants_.push_back(self);
 		dependencies_.push_back(dependency);
+		deepen(dependency->depth_ + 1);
+	}
+
+	void clear_dependencies()
+	{
+		for (auto& dependency : dependencies_)
+		{
+			auto& dependants = dependency->dependants_;
+
+			dependants.erase(std::remove_if(dependants.begin(), dependants.end(), [this](const std::weak_ptr<impl_base>& d)
+			{
+				auto strong = d.lock();
+
+				return !strong || strong.get() == this;
+			}), dependants.end());
+		}
+
+		dependencies_.clear();
 	}
 
 	bool depends_on(const std::shared_ptr<impl_base>& other) const
@@ -85,8 +153,129 @@ struct impl_base : std::enable_shared_from_this<impl_base>
 	{
 		on_change_.push_back(std::make_pair(dependant, listener));
 	}
+
+	void evaluate_if_pending() const
+	{
+		if (pending_)
+		{
+			pending_ = false;
+			evaluate();
+		}
+	}
+
+	void notify_change() const
+	{
+		auto& queue				= propagation_queue::for_this_thread();
+		bool need_to_clean_up	= false;
+
+		for (auto& dependant : dependants_)
+		{
+			auto strong = dependant.lock();
+
+			if (strong)
+				queue.schedule(std::move(strong));
+			else
+				need_to_clean_up = true;
+		}
+
+		if (need_to_clean_up)
+			dependants_.erase(std::remove_if(dependants_.begin(), dependants_.end(), [](const std::weak_ptr<impl_base>& d)
+			{
+				return d.expired();
+			}), dependants_.end());
+
+		need_to_clean_up = false;
+
+		for (auto& listener : on_change_)
+		{
+			if (listener.first.expired())
+				need_to_clean_up = true;
+			else
+				queue.schedule(listener);
+		}
+
+		if (need_to_clean_up)
+			on_change_.erase(std::remove_if(on_change_.begin(), on_change_.end(), [](const std::pair<std::weak_ptr<void>, std::function<void()>>& l)
+			{
+				return l.first.expired();
+			}), on_change_.end());
+
+		queue.drain();
+	}
+private:
+	void deepen(int depth)
+	{
+		if (depth <= depth_)
+			return;
+
+		depth_ = depth;
+
+		for (auto& dependant : dependants_)
+		{
+			auto strong = dependant.lock();
+
+			if (strong)
+				strong->deepen(depth_ + 1);
+		}
+	}
 };
 
+void propagation_queue::schedule(std::shared_ptr<const impl_base> dependant)
+{
+	if (dependant->pending_)
+		return;
+
+	dependant->pending_ = true;
+	queue_.push(std::make_pair(dependant->depth_, std::move(dependant)));
+}
+
+void propagation_queue::drain()
+{
+	if (draining_)
+		return;
+
+	draining_ = true;
+
+	try
+	{
+		while (!queue_.empty() || !listeners_.empty())
+		{
+			while (!queue_.empty())
+			{
+				auto next = queue_.top().second;
+				queue_.pop();
+				next->evaluate_if_pending();
+			}
+
+			auto listeners = std::move(listeners_);
+			listeners_.clear();
+
+			for (auto& listener : listeners)
+			{
+				auto strong = listener.first.lock();
+
+				if (strong)
+					listener.second();
+			}
+		}
+	}
+	catch (...)
+	{
+		while (!queue_.empty())
+		{
+			queue_.top().second->pending_ = false;
+			queue_.pop();
+		}
+
+		listeners_.clear();
+		draining_ = false;
+
+		throw;
+	}
+
+	draining_ = false;
+}
+
 }
 
 template <typename T>
@@ -119,6 +308,8 @@ private:
 
 		T get() const
 		{
+			evaluate_if_pending();
+
 			if (!evaluated_)
 				evaluate();
 
@@ -140,7 +331,7 @@ private:
 
 			value_ = value;
 
-			on_change();
+			notify_change();
 		}
 
 		void evaluate() const override
@@ -154,36 +345,13 @@ private:
 				if (new_value != value_)
 				{
 					value_ = new_value;
-					on_change();
+					notify_change();
 				}
 			}
 			else
 				evaluated_ = true;
 		}
 
-		using impl_base::on_change;
-		void on_change() const
-		{
-			auto copy				= on_change_;
-			bool need_to_clean_up	= false;
-
-			for (auto& listener : copy)
-			{
-				auto strong = listener.first.lock();
-
-				if (strong)
-					listener.second();
-				else
-					need_to_clean_up = true;
-			}
-
-			if (need_to_clean_up)
-				boost::remove_if(on_change_, [&](const std::pair<std::weak_ptr<void>, std::function<void()>>& l)
-				{
-					return l.first.expired();
-				});
-		}
-
 		void bind(const std::shared_ptr<impl>& other)
 		{
 			unbind();
@@ -197,7 +365,7 @@ private:
 			if (bound())
 			{
 				expression_ = std::function<T ()>();
-				dependencies_.clear();
+				clear_dependencies();
 			}
 		}
 	};
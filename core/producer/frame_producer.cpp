@@ -73,12 +73,16 @@ frame_producer_dependencies::frame_producer_dependencies(
 		const std::vector<spl::shared_ptr<video_channel>>& channels,
 		const video_format_desc& format_desc,
 		const spl::shared_ptr<const frame_producer_registry> producer_registry,
-		const spl::shared_ptr<const cg_producer_registry> cg_registry)
+		const spl::shared_ptr<const cg_producer_registry> cg_registry,
+		bool freewheel,
+		const cpu_affinity& affinity)
 	: frame_factory(frame_factory)
 	, channels(channels)
 	, format_desc(format_desc)
 	, producer_registry(producer_registry)
 	, cg_registry(cg_registry)
+	, freewheel(freewheel)
+	, affinity(affinity)
 {
 }
 
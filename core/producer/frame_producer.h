@@ -27,6 +27,7 @@
 #include "../help/help_repository.h"
 #include "binding.h"
 
+#include <common/cpu_affinity.h>
 #include <common/forward.h>
 #include <common/future_fwd.h>
 #include <common/memory.h>
@@ -139,13 +140,17 @@ struct frame_producer_dependencies
 	video_format_desc								format_desc;
 	spl::shared_ptr<const frame_producer_registry>	producer_registry;
 	spl::shared_ptr<const cg_producer_registry>		cg_registry;
+	bool											freewheel; // No real time deadlines, so wait for input instead of repeating frames.
+	cpu_affinity									affinity; // Of the channel, for threads feeding it.
 
 	frame_producer_dependencies(
 			const spl::shared_ptr<core::frame_factory>& frame_factory,
 			const std::vector<spl::shared_ptr<video_channel>>& channels,
 			const video_format_desc& format_desc,
 			const spl::shared_ptr<const frame_producer_registry> producer_registry,
-			const spl::shared_ptr<const cg_producer_registry> cg_registry);
+			const spl::shared_ptr<const cg_producer_registry> cg_registry,
+			bool freewheel = false,
+			const cpu_affinity& affinity = cpu_affinity());
 };
 
 typedef std::function<spl::shared_ptr<core::frame_producer>(const frame_producer_dependencies&, const std::vector<std::wstring>&)> producer_factory_t;
@@ -27,6 +27,8 @@
 #include "../../frame/audio_channel_layout.h"
 #include "../../frame/draw_frame.h"
 #include "../../frame/frame.h"
+#include "../../frame/frame_factory.h"
+#include "../../frame/geometry.h"
 #include "../../frame/frame_transform.h"
 #include "../../frame/pixel_format.h"
 #include "../../monitor/monitor.h"
@@ -35,6 +37,12 @@
 #include <common/future.h>
 #include <common/tweener.h>
 
+#include <boost/property_tree/ptree.hpp>
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
 #include <functional>
 #include <queue>
 #include <future>
@@ -47,23 +55,198 @@ draw_frame drop_or_repeat(const draw_frame& source, const draw_frame&, const boo
 	return source;
 }
 
+// Finds the single image in a draw_frame, if it is drawn untransformed.
+class untransformed_image_extractor : public frame_visitor
+{
+	int			num_images_		= 0;
+	bool		transformed_	= false;
+	const_frame	image_;
+public:
+	void push(const frame_transform& transform) override
+	{
+		if (!(transform.image_transform == image_transform()))
+			transformed_ = true;
+	}
+
+	void pop() override
+	{
+	}
+
+	void visit(const const_frame& frame) override
+	{
+		if (frame.pixel_format_desc().planes.empty())
+			return;
+
+		++num_images_;
+		image_ = frame;
+	}
+
+	boost::optional<const_frame> image() const
+	{
+		if (num_images_ != 1 || transformed_)
+			return boost::none;
+
+		return image_;
+	}
+};
+
+// dest = sum(sources[i] * weights[i]) / 256 for every byte. The weights must
+// add up to 256, so the 16 bit intermediate sums cannot overflow.
+void blend_bytes(const std::vector<const std::uint8_t*>& sources, const std::vector<int>& weights, std::uint8_t* dest, std::size_t size)
+{
+	tbb::parallel_for(tbb::blocked_range<std::size_t>(0, size, 1 << 16), [&](const tbb::blocked_range<std::size_t>& r)
+	{
+		auto zero		= _mm_setzero_si128();
+		auto rounding	= _mm_set1_epi16(128);
+		auto n			= sources.size();
+		auto i			= r.begin();
+
+		for (; i + 16 <= r.end(); i += 16)
+		{
+			auto lo = rounding;
+			auto hi = rounding;
+
+			for (std::size_t s = 0; s < n; ++s)
+			{
+				auto weight	= _mm_set1_epi16(static_cast<short>(weights[s]));
+				auto pixels	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(sources[s] + i));
+
+				lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight));
+				hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight));
+			}
+
+			_mm_storeu_si128(
+					reinterpret_cast<__m128i*>(dest + i),
+					_mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+		}
+
+		for (; i < r.end(); ++i)
+		{
+			int sum = 128;
+
+			for (std::size_t s = 0; s < n; ++s)
+				sum += sources[s][i] * weights[s];
+
+			dest[i] = static_cast<std::uint8_t>(sum >> 8);
+		}
+	});
+}
+
+// Blends frames with the given weights. When enabled and all frames are plain
+// decoded images of the same format, the blend is done on the CPU in one pass
+// directly from the decoded frames, otherwise the mixer is asked to do it.
+class frame_blender
+{
+	std::shared_ptr<frame_factory>	frame_factory_;
+	bool							on_cpu_;
+public:
+	explicit frame_blender(std::shared_ptr<frame_factory> frame_factory)
+		: frame_factory_(std::move(frame_factory))
+		, on_cpu_(frame_factory_ && frame_factory_->mixes_on_cpu())
+	{
+	}
+
+	bool on_cpu() const
+	{
+		return on_cpu_;
+	}
+
+	void set_on_cpu(bool on_cpu)
+	{
+		if (on_cpu && !frame_factory_)
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info("CPU frame blending is not available for this producer"));
+
+		on_cpu_ = on_cpu;
+	}
+
+	draw_frame operator()(std::vector<draw_frame> frames, const std::vector<double>& weights) const
+	{
+		if (on_cpu_)
+		{
+			auto blended = blend_on_cpu(frames, weights);
+
+			if (blended)
+				return *blended;
+		}
+
+		for (std::size_t i = 0; i < frames.size(); ++i)
+		{
+			frames[i].transform().image_transform.is_mix	= true;
+			frames[i].transform().image_transform.opacity	= weights[i];
+		}
+
+		return draw_frame(std::move(frames));
+	}
+private:
+	boost::optional<draw_frame> blend_on_cpu(const std::vector<draw_frame>& frames, const std::vector<double>& weights) const
+	{
+		std::vector<const_frame>	images;
+		std::vector<int>			fixed_weights;
+		int							remaining_weight = 256;
+
+		for (std::size_t i = 0; i < frames.size(); ++i)
+		{
+			untransformed_image_extractor extractor;
+			frames[i].accept(extractor);
+			auto image = extractor.image();
+
+			if (!image)
+				return boost::none;
+
+			auto& desc	= image->pixel_format_desc();
+			auto& first	= images.empty() ? desc : images.front().pixel_format_desc();
+
+			if (desc.format != first.format || desc.planes.size() != first.planes.size())
+				return boost::none;
+
+			for (std::size_t p = 0; p < desc.planes.size(); ++p)
+			{
+				if (desc.planes[p].size != first.planes[p].size || desc.planes[p].linesize != first.planes[p].linesize)
+					return boost::none;
+			}
+
+			auto weight = i + 1 == frames.size()
+					? remaining_weight
+					: static_cast<int>(weights[i] * 256.0 + 0.5);
+			weight = std::max(0, std::min(remaining_weight, weight));
+			remaining_weight -= weight;
+
+			images.push_back(*image);
+			fixed_weights.push_back(weight);
+		}
+
+		auto& desc		= images.front().pixel_format_desc();
+		auto result		= frame_factory_->create_frame(this, desc, audio_channel_layout::invalid());
+
+		for (std::size_t p = 0; p < desc.planes.size(); ++p)
+		{
+			std::vector<const std::uint8_t*> sources;
+
+			for (auto& image : images)
+				sources.push_back(image.image_data(static_cast<int>(p)).begin());
+
+			blend_bytes(sources, fixed_weights, result.image_data(static_cast<int>(p)).begin(), desc.planes[p].size);
+		}
+
+		result.set_geometry(images.front().geometry());
+
+		draw_frame blended(std::move(result));
+		blended.transform().audio_transform.volume = 0.0;
+
+		return blended;
+	}
+};
+
 // Blends next frame with current frame when the distance is not 0.
 // Completely sharp when distance is 0 but blurry when in between.
-draw_frame blend2(const draw_frame& source, const draw_frame& destination, const boost::rational<int64_t>& distance)
+draw_frame blend2(const frame_blender& blender, const draw_frame& source, const draw_frame& destination, const boost::rational<int64_t>& distance)
 {
 	if (destination == draw_frame::empty())
 		return source;
 
-	auto under					= source;
-	auto over					= destination;
-	double float_distance		= boost::rational_cast<double>(distance);
-
-	under.transform().image_transform.is_mix	= true;
-	under.transform().image_transform.opacity	= 1 - float_distance;
-	over.transform().image_transform.is_mix		= true;
-	over.transform().image_transform.opacity	= float_distance;
+	double float_distance = boost::rational_cast<double>(distance);
 
-	return draw_frame::over(under, over);
+	return blender({ source, destination }, { 1 - float_distance, float_distance });
 }
 
 // Blends a moving window with a width of 1 frame duration.
@@ -73,9 +256,15 @@ draw_frame blend2(const draw_frame& source, const draw_frame& destination, const
 // This is blurrier than blend2, but gives a more even bluriness, instead of sharp, blurry, sharp, blurry.
 struct blend3
 {
-	draw_frame previous_frame	= draw_frame::empty();
-	draw_frame last_source		= draw_frame::empty();
-	draw_frame last_destination	= draw_frame::empty();
+	std::shared_ptr<const frame_blender>	blender;
+	draw_frame								previous_frame		= draw_frame::empty();
+	draw_frame								last_source			= draw_frame::empty();
+	draw_frame								last_destination	= draw_frame::empty();
+
+	explicit blend3(std::shared_ptr<const frame_blender> blender)
+		: blender(std::move(blender))
+	{
+	}
 
 	draw_frame operator()(const draw_frame& source, const draw_frame& destination, const boost::rational<int64_t>& distance)
 	{
@@ -93,22 +282,14 @@ struct blend3
 		bool has_previous = previous_frame != draw_frame::empty();
 
 		if (!has_previous)
-			return blend2(source, destination, distance);
-
-		auto middle											= last_source;
-		auto next_frame										= destination;
-		previous_frame.transform().image_transform.is_mix	= true;
-		middle.transform().image_transform.is_mix			= true;
-		next_frame.transform().image_transform.is_mix		= true;
+			return blend2(*blender, source, destination, distance);
 
-		double float_distance								= boost::rational_cast<double>(distance);
-		previous_frame.transform().image_transform.opacity	= std::max(0.0, 0.5 - float_distance * 0.5);
-		middle.transform().image_transform.opacity			= 0.5;
-		next_frame.transform().image_transform.opacity		= 1.0 - previous_frame.transform().image_transform.opacity - middle.transform().image_transform.opacity;
+		double float_distance	= boost::rational_cast<double>(distance);
+		double previous_weight	= std::max(0.0, 0.5 - float_distance * 0.5);
+		double middle_weight	= 0.5;
+		double next_weight		= 1.0 - previous_weight - middle_weight;
 
-		std::vector<draw_frame> combination { previous_frame, middle, next_frame };
-
-		return draw_frame(std::move(combination));
+		return (*blender)({ previous_frame, last_source, destination }, { previous_weight, middle_weight, next_weight });
 	}
 };
 
@@ -199,6 +380,7 @@ class framerate_producer : public frame_producer_base
 	std::vector<int>									destination_audio_cadence_;
 	boost::rational<std::int64_t>						speed_;
 	speed_tweener										user_speed_;
+	std::shared_ptr<frame_blender>						blender_;
 	std::function<draw_frame (
 			const draw_frame& source,
 			const draw_frame& destination,
@@ -218,8 +400,10 @@ public:
 			std::function<boost::rational<int> ()> get_source_framerate,
 			boost::rational<int> destination_framerate,
 			field_mode destination_fieldmode,
-			std::vector<int> destination_audio_cadence)
+			std::vector<int> destination_audio_cadence,
+			std::shared_ptr<frame_factory> frame_factory)
 		: source_(std::move(source))
+		, blender_(std::make_shared<frame_blender>(std::move(frame_factory)))
 		, get_source_framerate_(std::move(get_source_framerate))
 		, original_destination_framerate_(std::move(destination_framerate))
 		, original_destination_fieldmode_(destination_fieldmode)
@@ -265,14 +449,23 @@ public:
 		else if (boost::iequals(params.at(1), L"interpolation"))
 		{
 			if (boost::iequals(params.at(2), L"blend2"))
-				interpolator_ = &blend2;
+				interpolator_ = create_blend2();
 			else if (boost::iequals(params.at(2), L"blend3"))
-				interpolator_ = blend3();
+				interpolator_ = blend3(blender_);
 			else if (boost::iequals(params.at(2), L"drop_or_repeat"))
 				interpolator_ = &drop_or_repeat;
 			else
 				CASPAR_THROW_EXCEPTION(user_error() << msg_info("Valid interpolations are DROP_OR_REPEAT, BLEND2 and BLEND3"));
 		}
+		else if (boost::iequals(params.at(1), L"blending"))
+		{
+			if (boost::iequals(params.at(2), L"cpu"))
+				blender_->set_on_cpu(true);
+			else if (boost::iequals(params.at(2), L"mixer"))
+				blender_->set_on_cpu(false);
+			else
+				CASPAR_THROW_EXCEPTION(user_error() << msg_info("Valid blendings are CPU and MIXER"));
+		}
 		else if (boost::iequals(params.at(1), L"output_repeat")) // Only for debugging purposes
 		{
 			output_repeat_ = boost::lexical_cast<unsigned int>(params.at(2));
@@ -338,6 +531,16 @@ public:
 		return source_->pixel_constraints();
 	}
 private:
+	std::function<draw_frame (const draw_frame&, const draw_frame&, const boost::rational<int64_t>&)> create_blend2() const
+	{
+		auto blender = blender_;
+
+		return [blender](const draw_frame& source, const draw_frame& destination, const boost::rational<int64_t>& distance)
+		{
+			return blend2(*blender, source, destination, distance);
+		};
+	}
+
 	bool is_initialized() const
 	{
 		return source_framerate_ != -1;
@@ -466,7 +669,7 @@ private:
 			auto needed = destination_audio_cadence_.front();
 			auto got = audio_samples_.size() / source_channel_layout_.num_channels;
 			if (got != 0) // If at end of stream we don't care
-				CASPAR_LOG(debug) << print() << L" Too few audio samples. Needed " << needed << L" but got " << got;
+				CASPAR_LOG_RATE_LIMITED(debug) << print() << L" Too few audio samples. Needed " << needed << L" but got " << got;
 			buffer.swap(audio_samples_);
 			buffer.resize(needed * source_channel_layout_.num_channels, 0);
 		}
@@ -540,9 +743,9 @@ private:
 					|| destination_fieldmode_ != field_mode::progressive;
 
 			if (high_source_framerate && high_destination_framerate)	// The bluriness of blend3 is acceptable on high framerates.
-				interpolator_	= blend3();
+				interpolator_	= blend3(blender_);
 			else														// blend3 is mostly too blurry on low framerates. blend2 provides a compromise.
-				interpolator_	= &blend2;
+				interpolator_	= create_blend2();
 
 			CASPAR_LOG(warning) << source_->print() << L" Frame blending frame rate conversion required to conform to channel frame rate.";
 		}
@@ -557,6 +760,8 @@ void describe_framerate_producer(help_sink& sink)
 	sink.example(L">> CALL 1-10 FRAMERATE INTERPOLATION BLEND2", L"enables 2 frame blend interpolation.");
 	sink.example(L">> CALL 1-10 FRAMERATE INTERPOLATION BLEND3", L"enables 3 frame blend interpolation.");
 	sink.example(L">> CALL 1-10 FRAMERATE INTERPOLATION DROP_OR_REPEAT", L"disables frame interpolation.");
+	sink.example(L">> CALL 1-10 FRAMERATE BLENDING CPU", L"blends frames on the CPU in a single pass over the decoded frames. The default when using the CPU accelerator.");
+	sink.example(L">> CALL 1-10 FRAMERATE BLENDING MIXER", L"lets the mixer blend the frames. The default when using the GPU accelerator.");
 	sink.example(L">> CALL 1-10 FRAMERATE SPEED 0.25", L"immediately changes the speed to 25%. Sound will be disabled.");
 	sink.example(L">> CALL 1-10 FRAMERATE SPEED 0.25 50", L"changes the speed to 25% linearly over 50 frames. Sound will be disabled.");
 	sink.example(L">> CALL 1-10 FRAMERATE SPEED 0.25 50 easeinoutsine", L"changes the speed to 25% over 50 frames using specified easing curve. Sound will be disabled.");
@@ -568,14 +773,16 @@ spl::shared_ptr<frame_producer> create_framerate_producer(
 		std::function<boost::rational<int> ()> get_source_framerate,
 		boost::rational<int> destination_framerate,
 		field_mode destination_fieldmode,
-		std::vector<int> destination_audio_cadence)
+		std::vector<int> destination_audio_cadence,
+		std::shared_ptr<frame_factory> frame_factory)
 {
 	return spl::make_shared<framerate_producer>(
 			std::move(source),
 			std::move(get_source_framerate),
 			std::move(destination_framerate),
 			destination_fieldmode,
-			std::move(destination_audio_cadence));
+			std::move(destination_audio_cadence),
+			std::move(frame_factory));
 }
 
 }}
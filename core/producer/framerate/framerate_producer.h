@@ -42,6 +42,7 @@ spl::shared_ptr<frame_producer> create_framerate_producer(
 		std::function<boost::rational<int> ()> get_source_framerate, // Will be called after first receive() on the source
 		boost::rational<int> destination_framerate,
 		field_mode destination_fieldmode,
-		std::vector<int> destination_audio_cadence);
+		std::vector<int> destination_audio_cadence,
+		std::shared_ptr<frame_factory> frame_factory = nullptr); // Enables frame blending on the CPU
 
 }}
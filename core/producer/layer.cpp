@@ -29,6 +29,10 @@
 #include "../frame/draw_frame.h"
 #include "../frame/frame_transform.h"
 
+#include "../monitor/latency_reporter.h"
+
+#include <common/diagnostics/latency_stats.h>
+
 #include <boost/optional.hpp>
 #include <boost/thread/future.hpp>
 
@@ -42,6 +46,8 @@ struct layer::impl
 	boost::optional<int32_t>			auto_play_delta_;
 	bool								is_paused_			= false;
 	int64_t								current_frame_age_	= 0;
+	caspar::diagnostics::latency_stats	stats_;
+	monitor::latency_reporter			latency_reporter_;
 
 public:
 	impl(int index)
@@ -84,7 +90,7 @@ public:
 		if(preview)
 		{
 			play();
-			receive(video_format::invalid);
+			receive(video_format::invalid, false);
 			foreground_->paused(true);
 			is_paused_ = true;
 		}
@@ -116,7 +122,7 @@ public:
 		auto_play_delta_.reset();
 	}
 
-	draw_frame receive(const video_format_desc& format_desc)
+	draw_frame receive(const video_format_desc& format_desc, bool freewheel)
 	{
 		try
 		{
@@ -128,6 +134,13 @@ public:
 
 			*monitor_subject_ << monitor::message("/profiler/time") % produce_time % (1.0 / format_desc.fps);
 
+			if(frame == core::draw_frame::late())
+				stats_.record_underflow();
+			else
+				stats_.record_frame_time(produce_time, freewheel ? 0.0 : format_desc.fps);
+
+			latency_reporter_.tick(stats_, *monitor_subject_, format_desc.fps);
+
 			if(frame == core::draw_frame::late())
 				return foreground_->last_frame();
 
@@ -137,7 +150,7 @@ public:
 				if(frames_left < 1)
 				{
 					play();
-					return receive(format_desc);
+					return receive(format_desc, freewheel);
 				}
 			}
 
@@ -212,12 +225,13 @@ void layer::play(){impl_->play();}
 void layer::pause(){impl_->pause();}
 void layer::resume(){impl_->resume();}
 void layer::stop(){impl_->stop();}
-draw_frame layer::receive(const video_format_desc& format_desc) {return impl_->receive(format_desc);}
+draw_frame layer::receive(const video_format_desc& format_desc, bool freewheel) {return impl_->receive(format_desc, freewheel);}
 spl::shared_ptr<frame_producer> layer::foreground() const { return impl_->foreground_;}
 spl::shared_ptr<frame_producer> layer::background() const { return impl_->background_;}
 boost::property_tree::wptree layer::info() const{return impl_->info();}
 boost::property_tree::wptree layer::delay_info() const{return impl_->delay_info();}
 monitor::subject& layer::monitor_output() {return *impl_->monitor_subject_;}
+boost::property_tree::wptree layer::stats_info() const{return impl_->stats_.info();}
 void layer::on_interaction(const interaction_event::ptr& event) { impl_->on_interaction(event); }
 bool layer::collides(double x, double y) const { return impl_->collides(x, y); }
 }}
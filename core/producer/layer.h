@@ -62,7 +62,11 @@ public:
 	void resume();
 	void stop();
 	
-	draw_frame receive(const video_format_desc& format_desc);
+	/**
+	 * @param freewheel	Whether the channel renders as fast as it can, in
+	 *					which case there is no frame deadline to be late for.
+	 */
+	draw_frame receive(const video_format_desc& format_desc, bool freewheel);
 	
 	// monitor::observable
 
@@ -81,6 +85,12 @@ public:
 	boost::property_tree::wptree	info() const;
 	boost::property_tree::wptree	delay_info() const;
 
+	/**
+	 * Production times of the foreground producer, and its underflows, which
+	 * are the frames it did not have ready in time.
+	 */
+	boost::property_tree::wptree	stats_info() const;
+
 private:
 	struct impl;
 	spl::shared_ptr<impl> impl_;
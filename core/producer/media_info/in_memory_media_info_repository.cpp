@@ -23,76 +23,365 @@
 
 #include "in_memory_media_info_repository.h"
 
+#include <common/log.h>
+#include <common/utf.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <functional>
 #include <map>
+#include <sstream>
+#include <utility>
 #include <vector>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <tbb/atomic.h>
 
 #include "media_info.h"
 #include "media_info_repository.h"
 
 namespace caspar { namespace core {
 
+namespace {
+
+const std::string CACHE_FILE_HEADER = "casparcg-media-info-cache 1";
+
+struct file_stamp
+{
+	std::time_t		last_write_time	= 0;
+	std::uintmax_t	size			= 0;
+
+	bool operator==(const file_stamp& other) const
+	{
+		return last_write_time == other.last_write_time && size == other.size;
+	}
+};
+
+file_stamp stamp_of(const std::wstring& file)
+{
+	boost::system::error_code ec;
+	file_stamp stamp;
+
+	stamp.last_write_time = boost::filesystem::last_write_time(file, ec);
+
+	if (ec)
+		return file_stamp();
+
+	stamp.size = boost::filesystem::file_size(file, ec);
+
+	if (ec)
+		return file_stamp();
+
+	return stamp;
+}
+
+}
+
 class in_memory_media_info_repository : public media_info_repository
 {
-	boost::mutex mutex_;
-	std::map<std::wstring, boost::optional<media_info>> info_by_file_;
-	std::vector<media_info_extractor> extractors_;
+	struct cached_info
+	{
+		file_stamp					stamp;
+		boost::optional<media_info>	info;
+		std::uint64_t				last_used	= 0;
+	};
+
+	// Lookups only contend with other lookups hashing to the same stripe, and
+	// never while an extractor is probing a file.
+	struct stripe
+	{
+		boost::mutex							mutex;
+		std::map<std::wstring, cached_info>		info_by_file;
+	};
+
+	static const std::size_t NUM_STRIPES = 64;
+
+	std::array<stripe, NUM_STRIPES>		stripes_;
+	const std::size_t					max_entries_per_stripe_;
+	tbb::atomic<std::uint64_t>			use_counter_;
+	boost::shared_mutex					extractors_mutex_;
+	std::vector<media_info_extractor>	extractors_;
+	const std::wstring					cache_file_;
+	boost::mutex						persist_mutex_;
+	tbb::atomic<bool>					dirty_;
 public:
+	in_memory_media_info_repository(std::wstring cache_file, std::size_t max_entries)
+		: max_entries_per_stripe_(std::max<std::size_t>(1, (max_entries + NUM_STRIPES - 1) / NUM_STRIPES))
+		, cache_file_(std::move(cache_file))
+	{
+		dirty_ = false;
+		use_counter_ = 0;
+
+		if (!cache_file_.empty())
+			load();
+	}
+
+	~in_memory_media_info_repository()
+	{
+		try
+		{
+			persist();
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+
 	virtual void register_extractor(media_info_extractor extractor) override
 	{
-		boost::lock_guard<boost::mutex> lock(mutex_);
+		boost::unique_lock<boost::shared_mutex> lock(extractors_mutex_);
 
 		extractors_.push_back(extractor);
 	}
 
 	virtual boost::optional<media_info> get(const std::wstring& file) override
 	{
-		boost::lock_guard<boost::mutex> lock(mutex_);
+		auto stamp		= stamp_of(file);
+		auto& stripe	= stripe_for(file);
+
+		{
+			boost::lock_guard<boost::mutex> lock(stripe.mutex);
+
+			auto iter = stripe.info_by_file.find(file);
+
+			if (iter != stripe.info_by_file.end() && iter->second.stamp == stamp)
+			{
+				iter->second.last_used = ++use_counter_;
+				return iter->second.info;
+			}
+		}
+
+		cached_info entry;
+		entry.stamp		= stamp;
+		entry.info		= extract(file);
+		entry.last_used	= ++use_counter_;
+
+		{
+			boost::lock_guard<boost::mutex> lock(stripe.mutex);
+
+			stripe.info_by_file[file] = entry;
+			evict_least_recently_used(stripe);
+		}
+
+		dirty_ = true;
+
+		return entry.info;
+	}
+
+	virtual void remove(const std::wstring& file) override
+	{
+		auto& stripe = stripe_for(file);
+		boost::lock_guard<boost::mutex> lock(stripe.mutex);
+
+		if (stripe.info_by_file.erase(file) > 0)
+			dirty_ = true;
+	}
 
-		auto iter = info_by_file_.find(file);
+	virtual void persist() override
+	{
+		if (cache_file_.empty() || !dirty_.compare_and_swap(false, true))
+			return;
 
-		if (iter == info_by_file_.end())
+		boost::lock_guard<boost::mutex> lock(persist_mutex_);
+		std::stringstream out;
+
+		out << CACHE_FILE_HEADER << "\n";
+
+		BOOST_FOREACH(auto& stripe, stripes_)
 		{
-			media_info info;
-			auto extension = boost::to_upper_copy(boost::filesystem::path(file).extension().wstring());
-			bool success = false;
+			std::vector<std::pair<std::wstring, cached_info>> entries;
+
+			{
+				boost::lock_guard<boost::mutex> stripe_lock(stripe.mutex);
+				entries.assign(stripe.info_by_file.begin(), stripe.info_by_file.end());
+			}
 
-			BOOST_FOREACH(auto& extractor, extractors_)
+			BOOST_FOREACH(auto& entry, entries)
 			{
-				success = extractor(file, extension, info);
+				if (entry.first.find(L'\n') != std::wstring::npos)
+					continue;
+
+				// Files changed or deleted since they were probed are dropped
+				// instead of being persisted, they would be probed again anyway.
+				if (!(stamp_of(entry.first) == entry.second.stamp))
+				{
+					remove_if_unchanged(stripe, entry.first, entry.second.stamp);
+					continue;
+				}
+
+				auto& stamp	= entry.second.stamp;
+				auto& info	= entry.second.info;
 
-				if (success)
-					break;
+				out << stamp.last_write_time << "\t" << stamp.size << "\t";
+
+				if (info)
+					out << 1 << "\t" << info->duration << "\t" << info->time_base.numerator() << "\t" << info->time_base.denominator() << "\t" << u8(info->clip_type);
+				else
+					out << 0 << "\t0\t0\t1\t";
+
+				out << "\t" << u8(entry.first) << "\n";
 			}
+		}
+
+		auto temp_file = cache_file_ + L".tmp";
+
+		{
+			boost::filesystem::ofstream file(temp_file, std::ios::out | std::ios::trunc | std::ios::binary);
+
+			if (!file)
+			{
+				CASPAR_LOG(warning) << L"[media_info_repository] Could not write " << temp_file;
+				dirty_ = true;
+				return;
+			}
+
+			file << out.rdbuf();
+		}
 
-			boost::optional<media_info> result;
+		boost::system::error_code ec;
+		boost::filesystem::rename(temp_file, cache_file_, ec);
 
-			if (success)
-				result = info;
+		if (ec)
+		{
+			CASPAR_LOG(warning) << L"[media_info_repository] Could not replace " << cache_file_ << L": " << u16(ec.message());
+			dirty_ = true;
+		}
+	}
+private:
+	stripe& stripe_for(const std::wstring& file)
+	{
+		return stripes_[std::hash<std::wstring>()(file) % NUM_STRIPES];
+	}
 
-			info_by_file_.insert(std::make_pair(file, result));
+	// Called with the stripe locked.
+	void evict_least_recently_used(stripe& stripe)
+	{
+		while (stripe.info_by_file.size() > max_entries_per_stripe_)
+		{
+			auto oldest = std::min_element(stripe.info_by_file.begin(), stripe.info_by_file.end(), [](
+					const std::pair<const std::wstring, cached_info>& lhs,
+					const std::pair<const std::wstring, cached_info>& rhs)
+			{
+				return lhs.second.last_used < rhs.second.last_used;
+			});
 
-			return result;
+			stripe.info_by_file.erase(oldest);
 		}
+	}
+
+	void remove_if_unchanged(stripe& stripe, const std::wstring& file, const file_stamp& stamp)
+	{
+		boost::lock_guard<boost::mutex> lock(stripe.mutex);
+
+		auto iter = stripe.info_by_file.find(file);
 
-		return iter->second;
+		if (iter != stripe.info_by_file.end() && iter->second.stamp == stamp)
+			stripe.info_by_file.erase(iter);
 	}
 
-	virtual void remove(const std::wstring& file) override
+	boost::optional<media_info> extract(const std::wstring& file)
+	{
+		boost::shared_lock<boost::shared_mutex> lock(extractors_mutex_);
+
+		media_info info;
+		auto extension = boost::to_upper_copy(boost::filesystem::path(file).extension().wstring());
+
+		BOOST_FOREACH(auto& extractor, extractors_)
+		{
+			if (extractor(file, extension, info))
+				return info;
+		}
+
+		return boost::none;
+	}
+
+	void load()
 	{
-		boost::lock_guard<boost::mutex> lock(mutex_);
+		boost::filesystem::ifstream file(cache_file_, std::ios::in | std::ios::binary);
+
+		if (!file)
+			return;
+
+		std::string line;
+
+		if (!std::getline(file, line) || line != CACHE_FILE_HEADER)
+		{
+			CASPAR_LOG(warning) << L"[media_info_repository] Ignoring " << cache_file_ << L" with unknown format.";
+			return;
+		}
+
+		int num_entries = 0;
+
+		while (std::getline(file, line))
+		{
+			try
+			{
+				std::vector<std::string> fields;
+				std::size_t begin = 0;
 
-		info_by_file_.erase(file);
+				// The path is the last field, so it may contain tab characters itself.
+				while (fields.size() < 7)
+				{
+					auto end = line.find('\t', begin);
+
+					if (end == std::string::npos)
+						CASPAR_THROW_EXCEPTION(invalid_argument());
+
+					fields.push_back(line.substr(begin, end - begin));
+					begin = end + 1;
+				}
+
+				auto path = u16(line.substr(begin));
+
+				cached_info entry;
+				entry.stamp.last_write_time	= boost::lexical_cast<std::time_t>(fields.at(0));
+				entry.stamp.size			= boost::lexical_cast<std::uintmax_t>(fields.at(1));
+
+				if (fields.at(2) == "1")
+				{
+					media_info info;
+					info.duration	= boost::lexical_cast<std::int64_t>(fields.at(3));
+					info.time_base	= boost::rational<std::int64_t>(
+							boost::lexical_cast<std::int64_t>(fields.at(4)),
+							boost::lexical_cast<std::int64_t>(fields.at(5)));
+					info.clip_type	= u16(fields.at(6));
+					entry.info		= info;
+				}
+
+				auto& stripe = stripe_for(path);
+
+				stripe.info_by_file[path] = entry;
+				evict_least_recently_used(stripe);
+				++num_entries;
+			}
+			catch (...)
+			{
+				CASPAR_LOG(warning) << L"[media_info_repository] Skipping corrupt entry in " << cache_file_;
+			}
+		}
+
+		CASPAR_LOG(info) << L"[media_info_repository] Loaded " << num_entries << L" cached entries from " << cache_file_;
 	}
 };
 
-spl::shared_ptr<struct media_info_repository> create_in_memory_media_info_repository()
+spl::shared_ptr<struct media_info_repository> create_in_memory_media_info_repository(std::size_t max_entries)
+{
+	return spl::make_shared<in_memory_media_info_repository>(L"", max_entries);
+}
+
+spl::shared_ptr<struct media_info_repository> create_persistent_media_info_repository(const std::wstring& cache_file, std::size_t max_entries)
 {
-	return spl::make_shared<in_memory_media_info_repository>();
+	return spl::make_shared<in_memory_media_info_repository>(cache_file, max_entries);
 }
 
 }}
@@ -21,12 +21,18 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include <common/memory.h>
 
 namespace caspar { namespace core {
 
-spl::shared_ptr<struct media_info_repository> create_in_memory_media_info_repository();
+/**
+ * @param max_entries	The number of files to keep the media info of. The least
+ *						recently used ones are forgotten beyond that.
+ */
+spl::shared_ptr<struct media_info_repository> create_in_memory_media_info_repository(std::size_t max_entries = 100000);
+spl::shared_ptr<struct media_info_repository> create_persistent_media_info_repository(const std::wstring& cache_file, std::size_t max_entries = 100000);
 
 }}
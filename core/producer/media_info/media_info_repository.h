@@ -41,6 +41,7 @@ struct media_info_repository
 	virtual void register_extractor(media_info_extractor extractor) = 0;
 	virtual boost::optional<media_info> get(const std::wstring& file) = 0;
 	virtual void remove(const std::wstring& file) = 0;
+	virtual void persist() = 0;
 };
 
 }}
@@ -22,6 +22,7 @@
 #include "../../StdAfx.h"
 
 #include "expression_parser.h"
+#include "expression_program.h"
 
 #include <string>
 #include <memory>
@@ -32,7 +33,6 @@
 #include <cmath>
 
 #include <boost/any.hpp>
-#include <boost/locale.hpp>
 
 #include <common/log.h>
 #include <common/except.h>
@@ -72,27 +72,32 @@ std::wstring at_position(
 			+ L" in " + str;
 }
 
-boost::any as_binding(const boost::any& value);
+expression as_expression(const boost::any& value)
+{
+	if (is<expression>(value))
+		return as<expression>(value);
+	else
+		CASPAR_THROW_EXCEPTION(user_error() << msg_info(
+				L"Couldn't detect type of " + u16(value.type().name())));
+}
 
-template<typename T>
-binding<T> require(const boost::any& value)
+expression require(const boost::any& value, expression_type type)
 {
-	auto b = as_binding(value);
+	auto expr = as_expression(value);
 
-	if (is<binding<T>>(b))
-		return as<binding<T>>(b);
-	else
+	if (expr->type != type)
 		CASPAR_THROW_EXCEPTION(user_error() << msg_info(
-			L"Required binding of type " + u16(typeid(T).name())
-			+ L" but got " + u16(value.type().name())));
+			L"Required " + type_name(type) + L" but got " + type_name(expr->type)));
+
+	return expr;
 }
 
-boost::any parse_expression(
+expression parse_subexpression(
 		std::wstring::const_iterator& cursor,
 		const std::wstring& str,
 		const variable_repository& var_repo);
 
-boost::any parse_parenthesis(
+expression parse_parenthesis(
 		std::wstring::const_iterator& cursor,
 		const std::wstring& str,
 		const variable_repository& var_repo)
@@ -101,7 +106,7 @@ boost::any parse_parenthesis(
 		CASPAR_THROW_EXCEPTION(user_error()
 				<< msg_info(L"Expected (" + at_position(cursor, str)));
 
-	auto expr = parse_expression(cursor, str, var_repo);
+	auto expr = parse_subexpression(cursor, str, var_repo);
 
 	if (next_non_whitespace(cursor, str, L"Expected )") != L')')
 		CASPAR_THROW_EXCEPTION(user_error()
@@ -112,115 +117,105 @@ boost::any parse_parenthesis(
 	return expr;
 }
 
-boost::any create_animate_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_animate_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 3)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"animate() function requires three parameters: to_animate, duration, tweener"));
 
-	auto to_animate		= require<double>(params.at(0));
+	auto to_animate		= to_number_binding(require(params.at(0), expression_type::number));
 	auto frame_counter	= var_repo(L"frame").as<double>();
-	auto duration		= require<double>(params.at(1));
-	auto tw				= require<std::wstring>(params.at(2)).transformed([](const std::wstring& s) { return tweener(s); });
+	auto duration		= to_number_binding(require(params.at(1), expression_type::number));
+	auto tw				= to_string_binding(require(params.at(2), expression_type::string)).transformed([](const std::wstring& s) { return tweener(s); });
 
-	return to_animate.animated(frame_counter, duration, tw);
+	// Animations are stateful so they are kept as bindings of their own.
+	return input(to_animate.animated(frame_counter, duration, tw));
 }
 
-boost::any create_sin_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_sin_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"sin() function requires one parameters: angle"));
 
-	auto angle = require<double>(params.at(0));
+	auto angle = require(params.at(0), expression_type::number);
 
-	return angle.transformed([](double a) { return std::sin(a); });
+	return apply(expression_op::sin, { angle });
 }
 
-boost::any create_cos_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_cos_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"cos() function requires one parameters: angle"));
 
-	auto angle = require<double>(params.at(0));
+	auto angle = require(params.at(0), expression_type::number);
 
-	return angle.transformed([](double a) { return std::cos(a); });
+	return apply(expression_op::cos, { angle });
 }
 
-boost::any create_abs_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_abs_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"abs() function requires one parameters: value"));
 
-	auto val = require<double>(params.at(0));
+	auto val = require(params.at(0), expression_type::number);
 
-	return val.transformed([](double v) { return std::abs(v); });
+	return apply(expression_op::abs, { val });
 }
 
-boost::any create_floor_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_floor_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"floor() function requires one parameters: value"));
 
-	auto val = require<double>(params.at(0));
-
-	return val.transformed([](double v) { return std::floor(v); });
-}
-
-std::locale create_utf_locale()
-{
-	boost::locale::generator gen;
-	gen.categories(boost::locale::codepage_facet);
-	gen.categories(boost::locale::convert_facet);
+	auto val = require(params.at(0), expression_type::number);
 
-	return gen("");
+	return apply(expression_op::floor, { val });
 }
 
-boost::any create_to_lower_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_to_lower_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"to_lower() function requires one parameters: str"));
 
-	auto str	= require<std::wstring>(params.at(0));
-	auto locale	= create_utf_locale();
+	auto str = require(params.at(0), expression_type::string);
 
-	return str.transformed([=](std::wstring v) { return boost::locale::to_lower(v, locale); });
+	return apply(expression_op::to_lower, { str });
 }
 
-boost::any create_to_upper_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_to_upper_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"to_upper() function requires one parameters: str"));
 
-	auto str	= require<std::wstring>(params.at(0));
-	auto locale	= create_utf_locale();
+	auto str = require(params.at(0), expression_type::string);
 
-	return str.transformed([=](std::wstring v) { return boost::locale::to_upper(v, locale); });
+	return apply(expression_op::to_upper, { str });
 }
 
-boost::any create_length_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
+expression create_length_function(const std::vector<boost::any>& params, const variable_repository& var_repo)
 {
 	if (params.size() != 1)
 		CASPAR_THROW_EXCEPTION(user_error()
 			<< msg_info(L"length() function requires one parameters: str"));
 
-	auto str = require<std::wstring>(params.at(0));
+	auto str = require(params.at(0), expression_type::string);
 
-	return str.transformed([](std::wstring v) { return static_cast<double>(v.length()); });
+	return apply(expression_op::length, { str });
 }
 
-boost::any parse_function(
+expression parse_function(
 		const std::wstring& function_name,
 		std::wstring::const_iterator& cursor,
 		const std::wstring& str,
 		const variable_repository& var_repo)
 {
-	static std::map<std::wstring, std::function<boost::any (const std::vector<boost::any>& params, const variable_repository& var_repo)>> FUNCTIONS
+	static std::map<std::wstring, std::function<expression (const std::vector<boost::any>& params, const variable_repository& var_repo)>> FUNCTIONS
 	{
 		{ L"animate",	create_animate_function },
 		{ L"sin",		create_sin_function },
@@ -246,7 +241,7 @@ boost::any parse_function(
 
 	while (cursor != str.end())
 	{
-		params.push_back(parse_expression(cursor, str, var_repo));
+		params.push_back(parse_subexpression(cursor, str, var_repo));
 
 		auto next = next_non_whitespace(cursor, str, L"Expected , or )");
 
@@ -373,20 +368,20 @@ boost::any parse_variable(
 		return variable_name;
 
 	if (variable_name == L"true")
-		return true;
+		return bool_constant(true);
 	else if (variable_name == L"false")
-		return false;
+		return bool_constant(false);
 
 	variable& var = var_repo(variable_name);
 
 	if (var.is<double>())
-		return var.as<double>();
+		return input(var.as<double>());
 	else if (var.is<int64_t>())
-		return var.as<int64_t>().as<double>();
+		return input(var.as<int64_t>().as<double>());
 	else if (var.is<std::wstring>())
-		return var.as<std::wstring>();
+		return input(var.as<std::wstring>());
 	else if (var.is<bool>())
-		return var.as<bool>();
+		return input(var.as<bool>());
 
 	CASPAR_THROW_EXCEPTION(user_error() << msg_info(
 				L"Unhandled variable type of " + variable_name
@@ -567,145 +562,55 @@ op parse_operator(std::wstring::const_iterator& cursor, const std::wstring& str)
 			L"Unexpected end of input (Expected operator) in " + str));
 }
 
-boost::any as_binding(const boost::any& value)
-{
-	// Wrap supported constants as bindings
-	if (is<double>(value))
-		return binding<double>(as<double>(value));
-	else if (is<bool>(value))
-		return binding<bool>(as<bool>(value));
-	else if (is<std::wstring>(value))
-		return binding<std::wstring>(as<std::wstring>(value));
-	// Already one of the supported binding types
-	else if (is<binding<double>>(value))
-		return as<binding<double>>(value);
-	else if (is<binding<bool>>(value))
-		return as<binding<bool>>(value);
-	else if (is<binding<std::wstring>>(value))
-		return as<binding<std::wstring>>(value);
-	else
-		CASPAR_THROW_EXCEPTION(user_error() << msg_info(
-				L"Couldn't detect type of " + u16(value.type().name())));
-}
-
 boost::any negative(const boost::any& to_create_negative_of)
 {
-	return -require<double>(to_create_negative_of);
+	return apply(expression_op::negate, { require(to_create_negative_of, expression_type::number) });
 }
 
 boost::any not_(const boost::any& to_create_not_of)
 {
-	return !require<bool>(to_create_not_of);
-}
-
-boost::any multiply(const boost::any& lhs, boost::any& rhs)
-{
-	return require<double>(lhs) * require<double>(rhs);
+	return apply(expression_op::not_, { require(to_create_not_of, expression_type::boolean) });
 }
 
-boost::any divide(const boost::any& lhs, boost::any& rhs)
+boost::any numeric(expression_op op, const boost::any& lhs, const boost::any& rhs)
 {
-	return require<double>(lhs) / require<double>(rhs);
+	return apply(op, { require(lhs, expression_type::number), require(rhs, expression_type::number) });
 }
 
-boost::any modulus(const boost::any& lhs, boost::any& rhs)
+boost::any logical(expression_op op, const boost::any& lhs, const boost::any& rhs)
 {
-	return
-			(
-					require<double>(lhs).as<int64_t>()
-					% require<double>(rhs).as<int64_t>()
-			).as<double>();
+	return apply(op, { require(lhs, expression_type::boolean), require(rhs, expression_type::boolean) });
 }
 
-binding<std::wstring> stringify(const boost::any& value)
+expression stringify(const boost::any& value)
 {
-	auto b = as_binding(value);
-
-	if (is<binding<std::wstring>>(b))
-		return as<binding<std::wstring>>(b);
-	else if (is<binding<double>>(b))
-		return as<binding<double>>(b).as<std::wstring>();
-	else if (is<binding<bool>>(b))
-		return as<binding<bool>>(b).as<std::wstring>();
-	else
-		CASPAR_THROW_EXCEPTION(user_error()
-				<< msg_info(L"Couldn't stringify " + u16(value.type().name())));
+	return apply(expression_op::to_string, { as_expression(value) });
 }
 
-boost::any add(const boost::any& lhs, boost::any& rhs)
+boost::any add(const boost::any& lhs, const boost::any& rhs)
 {
-	auto l = as_binding(lhs);
-	auto r = as_binding(rhs);
+	auto l = as_expression(lhs);
+	auto r = as_expression(rhs);
 
 	// number
-	if (is<binding<double>>(l) && is<binding<double>>(r))
-		return as<binding<double>>(l) + as<binding<double>>(r);
-	// string
-	else if (is<binding<std::wstring>>(l) && is<binding<std::wstring>>(r))
-		return as<binding<std::wstring>>(l) + as<binding<std::wstring>>(r);
-	// mixed types to string and concatenated
+	if (l->type == expression_type::number && r->type == expression_type::number)
+		return apply(expression_op::add, { l, r });
+	// string, or mixed types converted to string and concatenated
 	else
-		return stringify(lhs) + stringify(rhs);
+		return apply(expression_op::concat, { stringify(l), stringify(r) });
 }
 
-boost::any subtract(const boost::any& lhs, boost::any& rhs)
+boost::any equal(expression_op op, const boost::any& lhs, const boost::any& rhs)
 {
-	return require<double>(lhs) - require<double>(rhs);
-}
-
-boost::any less(const boost::any& lhs, boost::any& rhs)
-{
-	return require<double>(lhs) < require<double>(rhs);
-}
+	auto l = as_expression(lhs);
+	auto r = as_expression(rhs);
 
-boost::any less_or_equal(const boost::any& lhs, boost::any& rhs)
-{
-	return require<double>(lhs) <= require<double>(rhs);
-}
-
-boost::any greater(const boost::any& lhs, boost::any& rhs)
-{
-	return require<double>(lhs) > require<double>(rhs);
-}
-
-boost::any greater_or_equal(const boost::any& lhs, boost::any& rhs)
-{
-	return require<double>(lhs) >= require<double>(rhs);
-}
-
-boost::any equal(const boost::any& lhs, boost::any& rhs)
-{
-	auto l = as_binding(lhs);
-	auto r = as_binding(rhs);
-
-	// number
-	if (is<binding<double>>(l) && is<binding<double>>(r))
-		return as<binding<double>>(l) == as<binding<double>>(r);
-	// string
-	else if (is<binding<std::wstring>>(l) && is<binding<std::wstring>>(r))
-		return as<binding<std::wstring>>(l) == as<binding<std::wstring>>(r);
+	// number or string
+	if (l->type == r->type && l->type != expression_type::boolean)
+		return apply(op, { l, r });
 	// boolean
 	else
-		return require<bool>(l) == require<bool>(r);
-}
-
-boost::any and_(const boost::any& lhs, boost::any& rhs)
-{
-	return require<bool>(lhs) && require<bool>(rhs);
-}
-
-boost::any or_(const boost::any& lhs, boost::any& rhs)
-{
-	return require<bool>(lhs) || require<bool>(rhs);
-}
-
-template<typename T>
-binding<T> ternary(
-		const binding<bool>& condition,
-		const binding<T>& true_value,
-		const binding<T>& false_value)
-{
-	return when(condition).then(true_value).otherwise(false_value);
+		return apply(op, { require(l, expression_type::boolean), require(r, expression_type::boolean) });
 }
 
 boost::any ternary(
@@ -713,22 +618,19 @@ boost::any ternary(
 		const boost::any& true_value,
 		const boost::any& false_value)
 {
-	auto cond = require<bool>(condition);
-	auto t = as_binding(true_value);
-	auto f = as_binding(false_value);
-
-	// double
-	if (is<binding<double>>(t) && is<binding<double>>(f))
-		return ternary(cond, as<binding<double>>(t), as<binding<double>>(f));
-	// string
-	else if (is<binding<std::wstring>>(t) && is<binding<std::wstring>>(f))
-		return ternary(
-				cond,
-				as<binding<std::wstring>>(t),
-				as<binding<std::wstring>>(f));
+	auto cond = require(condition, expression_type::boolean);
+	auto t = as_expression(true_value);
+	auto f = as_expression(false_value);
+
+	// number or string
+	if (t->type == f->type && t->type != expression_type::boolean)
+		return apply(expression_op::conditional, { cond, t, f });
 	// bool
 	else
-		return ternary(cond, require<bool>(t), require<bool>(f));
+		return apply(expression_op::conditional, {
+				cond,
+				require(t, expression_type::boolean),
+				require(f, expression_type::boolean) });
 }
 
 void resolve_operators(int precedence, std::vector<boost::any>& tokens)
@@ -768,31 +670,31 @@ void resolve_operators(int precedence, std::vector<boost::any>& tokens)
 				auto& token_before = tokens.at(i - 1);
 
 				if (op_token.characters == L"*")
-					token_before = multiply(token_before, token_after);
+					token_before = numeric(expression_op::multiply, token_before, token_after);
 				else if (op_token.characters == L"/")
-					token_before = divide(token_before, token_after);
+					token_before = numeric(expression_op::divide, token_before, token_after);
 				else if (op_token.characters == L"%")
-					token_before = modulus(token_before, token_after);
+					token_before = numeric(expression_op::modulus, token_before, token_after);
 				else if (op_token.characters == L"+")
 					token_before = add(token_before, token_after);
 				else if (op_token.characters == L"-")
-					token_before = subtract(token_before, token_after);
+					token_before = numeric(expression_op::subtract, token_before, token_after);
 				else if (op_token.characters == L"<")
-					token_before = less(token_before, token_after);
+					token_before = numeric(expression_op::less, token_before, token_after);
 				else if (op_token.characters == L"<=")
-					token_before = less_or_equal(token_before, token_after);
+					token_before = numeric(expression_op::less_or_equal, token_before, token_after);
 				else if (op_token.characters == L">")
-					token_before = greater(token_before, token_after);
+					token_before = numeric(expression_op::greater, token_before, token_after);
 				else if (op_token.characters == L">=")
-					token_before = greater_or_equal(token_before, token_after);
+					token_before = numeric(expression_op::greater_or_equal, token_before, token_after);
 				else if (op_token.characters == L"==")
-					token_before = equal(token_before, token_after);
+					token_before = equal(expression_op::equal, token_before, token_after);
 				else if (op_token.characters == L"!=")
-					token_before = not_(equal(token_before, token_after));
+					token_before = equal(expression_op::not_equal, token_before, token_after);
 				else if (op_token.characters == L"&&")
-					token_before = and_(token_before, token_after);
+					token_before = logical(expression_op::and_, token_before, token_after);
 				else if (op_token.characters == L"||")
-					token_before = or_(token_before, token_after);
+					token_before = logical(expression_op::or_, token_before, token_after);
 			}
 
 			tokens.erase(tokens.begin() + i, tokens.begin() + i + 2);
@@ -821,7 +723,7 @@ void resolve_operators(int precedence, std::vector<boost::any>& tokens)
 	}
 }
 
-boost::any parse_expression(
+expression parse_subexpression(
 		std::wstring::const_iterator& cursor,
 		const std::wstring& str,
 		const variable_repository& var_repo)
@@ -845,7 +747,7 @@ boost::any parse_expression(
 		case L'7':
 		case L'8':
 		case L'9':
-			tokens.push_back(parse_constant(cursor, str));
+			tokens.push_back(number_constant(parse_constant(cursor, str)));
 			break;
 		case L'+':
 		case L'-':
@@ -863,7 +765,7 @@ boost::any parse_expression(
 			tokens.push_back(parse_operator(cursor, str));
 			break;
 		case L'"':
-			tokens.push_back(parse_string_literal(cursor, str));
+			tokens.push_back(string_constant(parse_string_literal(cursor, str)));
 			break;
 		case L'(':
 			if (!tokens.empty() && is<std::wstring>(tokens.back()))
@@ -902,7 +804,25 @@ boost::any parse_expression(
 				<< msg_info(L"Expected operator" + at_position(cursor, str)));
 
 
-	return as_binding(tokens.at(0));
+	return as_expression(tokens.at(0));
+}
+
+boost::any parse_expression(
+		std::wstring::const_iterator& cursor,
+		const std::wstring& str,
+		const variable_repository& var_repo)
+{
+	auto expr = parse_subexpression(cursor, str, var_repo);
+
+	switch (expr->type)
+	{
+	case expression_type::number:
+		return to_number_binding(expr);
+	case expression_type::boolean:
+		return to_bool_binding(expr);
+	default:
+		return to_string_binding(expr);
+	}
 }
 
 }}}
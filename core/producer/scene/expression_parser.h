@@ -23,6 +23,11 @@
 
 #include "../variable.h"
 
+#include <common/except.h>
+#include <common/utf.h>
+
+#include <boost/any.hpp>
+
 namespace caspar { namespace core { namespace scene {
 
 typedef std::function<variable& (const std::wstring& name)> variable_repository;
@@ -0,0 +1,600 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../../StdAfx.h"
+
+#include "expression_program.h"
+
+#include <common/except.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/locale.hpp>
+
+namespace caspar { namespace core { namespace scene {
+
+namespace {
+
+enum class opcode : std::uint8_t
+{
+	push_number,
+	push_bool,
+	push_string,
+	load_number,
+	load_bool,
+	load_string,
+	negate,
+	add,
+	subtract,
+	multiply,
+	divide,
+	modulus,
+	sin,
+	cos,
+	abs,
+	floor,
+	less,
+	less_or_equal,
+	greater,
+	greater_or_equal,
+	equal_number,
+	equal_bool,
+	equal_string,
+	not_,
+	and_,
+	or_,
+	concat,
+	number_to_string,
+	bool_to_string,
+	to_lower,
+	to_upper,
+	length,
+	jump,
+	jump_if_false
+};
+
+struct instruction
+{
+	opcode	code;
+	int		operand;
+};
+
+const std::locale& utf_locale()
+{
+	static const std::locale locale = []
+	{
+		boost::locale::generator gen;
+		gen.categories(boost::locale::codepage_facet);
+		gen.categories(boost::locale::convert_facet);
+
+		return gen("");
+	}();
+
+	return locale;
+}
+
+int index_of(expression_type type)
+{
+	return static_cast<int>(type);
+}
+
+template<typename T> expression_type type_of();
+template<> expression_type type_of<double>()		{ return expression_type::number; }
+template<> expression_type type_of<bool>()			{ return expression_type::boolean; }
+template<> expression_type type_of<std::wstring>()	{ return expression_type::string; }
+
+template<typename T> T constant_value(const expression_node& node);
+template<> double constant_value<double>(const expression_node& node)		{ return node.number; }
+template<> bool constant_value<bool>(const expression_node& node)			{ return node.boolean; }
+template<> std::wstring constant_value<std::wstring>(const expression_node& node)	{ return node.string; }
+
+/**
+ * An expression tree flattened into postfix instructions operating on one
+ * value stack per type. The stacks are sized when compiling, so evaluation
+ * never allocates except when producing strings.
+ */
+class program
+{
+	std::vector<instruction>			code_;
+	std::vector<double>					numbers_;
+	std::vector<std::wstring>			strings_;
+	std::vector<binding<double>>		number_inputs_;
+	std::vector<binding<bool>>			bool_inputs_;
+	std::vector<binding<std::wstring>>	string_inputs_;
+	std::map<void*, int>				input_indexes_;
+	int									depth_[3];
+	int									max_depth_[3];
+	mutable std::vector<double>			number_stack_;
+	mutable std::vector<char>			bool_stack_;
+	mutable std::vector<std::wstring>	string_stack_;
+public:
+	explicit program(const expression& root)
+	{
+		std::fill_n(depth_, 3, 0);
+		std::fill_n(max_depth_, 3, 0);
+
+		emit(*root);
+
+		number_stack_.resize(max_depth_[index_of(expression_type::number)]);
+		bool_stack_.resize(max_depth_[index_of(expression_type::boolean)]);
+		string_stack_.resize(max_depth_[index_of(expression_type::string)]);
+		input_indexes_.clear();
+	}
+
+	template<typename T>
+	T evaluate() const;
+
+	template<typename T>
+	void make_dependant(binding<T>& result) const
+	{
+		for (auto& input : number_inputs_)
+			result.depend_on(input);
+
+		for (auto& input : bool_inputs_)
+			result.depend_on(input);
+
+		for (auto& input : string_inputs_)
+			result.depend_on(input);
+	}
+private:
+	void run() const
+	{
+		double*			ns	= number_stack_.data();
+		char*			bs	= bool_stack_.data();
+		std::wstring*	ss	= string_stack_.data();
+		int				n	= -1;
+		int				b	= -1;
+		int				s	= -1;
+
+		for (int pc = 0, end = static_cast<int>(code_.size()); pc < end; ++pc)
+		{
+			const auto& instr = code_[pc];
+
+			switch (instr.code)
+			{
+			case opcode::push_number:		ns[++n] = numbers_[instr.operand];								break;
+			case opcode::push_bool:			bs[++b] = static_cast<char>(instr.operand);						break;
+			case opcode::push_string:		ss[++s] = strings_[instr.operand];								break;
+			case opcode::load_number:		ns[++n] = number_inputs_[instr.operand].get();					break;
+			case opcode::load_bool:			bs[++b] = bool_inputs_[instr.operand].get();					break;
+			case opcode::load_string:		ss[++s] = string_inputs_[instr.operand].get();					break;
+			case opcode::negate:			ns[n] = -ns[n];													break;
+			case opcode::add:				ns[n - 1] += ns[n]; --n;										break;
+			case opcode::subtract:			ns[n - 1] -= ns[n]; --n;										break;
+			case opcode::multiply:			ns[n - 1] *= ns[n]; --n;										break;
+			case opcode::divide:			ns[n - 1] /= ns[n]; --n;										break;
+			case opcode::modulus:
+				ns[n - 1] = static_cast<double>(static_cast<std::int64_t>(ns[n - 1]) % static_cast<std::int64_t>(ns[n]));
+				--n;
+				break;
+			case opcode::sin:				ns[n] = std::sin(ns[n]);										break;
+			case opcode::cos:				ns[n] = std::cos(ns[n]);										break;
+			case opcode::abs:				ns[n] = std::abs(ns[n]);										break;
+			case opcode::floor:				ns[n] = std::floor(ns[n]);										break;
+			case opcode::less:				bs[++b] = ns[n - 1] < ns[n]; n -= 2;							break;
+			case opcode::less_or_equal:		bs[++b] = ns[n - 1] <= ns[n]; n -= 2;							break;
+			case opcode::greater:			bs[++b] = ns[n - 1] > ns[n]; n -= 2;							break;
+			case opcode::greater_or_equal:	bs[++b] = ns[n - 1] >= ns[n]; n -= 2;							break;
+			case opcode::equal_number:		bs[++b] = ns[n - 1] == ns[n]; n -= 2;							break;
+			case opcode::equal_bool:		bs[b - 1] = bs[b - 1] == bs[b]; --b;							break;
+			case opcode::equal_string:		bs[++b] = ss[s - 1] == ss[s]; s -= 2;							break;
+			case opcode::not_:				bs[b] = !bs[b];													break;
+			case opcode::and_:				bs[b - 1] = bs[b - 1] && bs[b]; --b;							break;
+			case opcode::or_:				bs[b - 1] = bs[b - 1] || bs[b]; --b;							break;
+			case opcode::concat:			ss[s - 1] += ss[s]; --s;										break;
+			case opcode::number_to_string:	ss[++s] = boost::lexical_cast<std::wstring>(ns[n--]);			break;
+			case opcode::bool_to_string:	ss[++s] = boost::lexical_cast<std::wstring>(bs[b--] != 0);		break;
+			case opcode::to_lower:			ss[s] = boost::locale::to_lower(ss[s], utf_locale());			break;
+			case opcode::to_upper:			ss[s] = boost::locale::to_upper(ss[s], utf_locale());			break;
+			case opcode::length:			ns[++n] = static_cast<double>(ss[s--].length());				break;
+			case opcode::jump:				pc = instr.operand - 1;											break;
+			case opcode::jump_if_false:		if (!bs[b--]) pc = instr.operand - 1;							break;
+			}
+		}
+	}
+
+	void push(expression_type type)
+	{
+		auto i = index_of(type);
+
+		max_depth_[i] = std::max(max_depth_[i], ++depth_[i]);
+	}
+
+	void pop(expression_type type)
+	{
+		--depth_[index_of(type)];
+	}
+
+	int add_instruction(opcode code, int operand = 0)
+	{
+		instruction instr;
+		instr.code		= code;
+		instr.operand	= operand;
+		code_.push_back(instr);
+
+		return static_cast<int>(code_.size()) - 1;
+	}
+
+	template<typename T>
+	int input_index(const binding<T>& input, std::vector<binding<T>>& inputs)
+	{
+		auto result = input_indexes_.insert(std::make_pair(input.identity(), static_cast<int>(inputs.size())));
+
+		if (result.second)
+			inputs.push_back(input);
+
+		return result.first->second;
+	}
+
+	void emit(const expression_node& node)
+	{
+		switch (node.op)
+		{
+		case expression_op::constant:
+			switch (node.type)
+			{
+			case expression_type::number:
+				add_instruction(opcode::push_number, static_cast<int>(numbers_.size()));
+				numbers_.push_back(node.number);
+				break;
+			case expression_type::boolean:
+				add_instruction(opcode::push_bool, node.boolean ? 1 : 0);
+				break;
+			case expression_type::string:
+				add_instruction(opcode::push_string, static_cast<int>(strings_.size()));
+				strings_.push_back(node.string);
+				break;
+			}
+
+			push(node.type);
+			return;
+		case expression_op::input:
+			switch (node.type)
+			{
+			case expression_type::number:
+				add_instruction(opcode::load_number, input_index(boost::any_cast<binding<double>>(node.input), number_inputs_));
+				break;
+			case expression_type::boolean:
+				add_instruction(opcode::load_bool, input_index(boost::any_cast<binding<bool>>(node.input), bool_inputs_));
+				break;
+			case expression_type::string:
+				add_instruction(opcode::load_string, input_index(boost::any_cast<binding<std::wstring>>(node.input), string_inputs_));
+				break;
+			}
+
+			push(node.type);
+			return;
+		case expression_op::conditional:
+			{
+				emit(*node.operands.at(0));
+				pop(expression_type::boolean);
+				auto jump_to_false = add_instruction(opcode::jump_if_false);
+				emit(*node.operands.at(1));
+				auto jump_to_end = add_instruction(opcode::jump);
+				pop(node.type);
+				code_.at(jump_to_false).operand = static_cast<int>(code_.size());
+				emit(*node.operands.at(2));
+				code_.at(jump_to_end).operand = static_cast<int>(code_.size());
+			}
+
+			return;
+		default:
+			break;
+		}
+
+		for (auto& operand : node.operands)
+			emit(*operand);
+
+		for (auto& operand : node.operands)
+			pop(operand->type);
+
+		switch (node.op)
+		{
+		case expression_op::negate:				add_instruction(opcode::negate);			break;
+		case expression_op::not_:				add_instruction(opcode::not_);				break;
+		case expression_op::add:				add_instruction(opcode::add);				break;
+		case expression_op::subtract:			add_instruction(opcode::subtract);			break;
+		case expression_op::multiply:			add_instruction(opcode::multiply);			break;
+		case expression_op::divide:				add_instruction(opcode::divide);			break;
+		case expression_op::modulus:			add_instruction(opcode::modulus);			break;
+		case expression_op::less:				add_instruction(opcode::less);				break;
+		case expression_op::less_or_equal:		add_instruction(opcode::less_or_equal);		break;
+		case expression_op::greater:			add_instruction(opcode::greater);			break;
+		case expression_op::greater_or_equal:	add_instruction(opcode::greater_or_equal);	break;
+		case expression_op::and_:				add_instruction(opcode::and_);				break;
+		case expression_op::or_:				add_instruction(opcode::or_);				break;
+		case expression_op::concat:				add_instruction(opcode::concat);			break;
+		case expression_op::sin:				add_instruction(opcode::sin);				break;
+		case expression_op::cos:				add_instruction(opcode::cos);				break;
+		case expression_op::abs:				add_instruction(opcode::abs);				break;
+		case expression_op::floor:				add_instruction(opcode::floor);				break;
+		case expression_op::to_lower:			add_instruction(opcode::to_lower);			break;
+		case expression_op::to_upper:			add_instruction(opcode::to_upper);			break;
+		case expression_op::length:				add_instruction(opcode::length);			break;
+		case expression_op::to_string:
+			add_instruction(node.operands.at(0)->type == expression_type::number
+					? opcode::number_to_string
+					: opcode::bool_to_string);
+			break;
+		case expression_op::equal:
+		case expression_op::not_equal:
+			switch (node.operands.at(0)->type)
+			{
+			case expression_type::number:	add_instruction(opcode::equal_number);	break;
+			case expression_type::boolean:	add_instruction(opcode::equal_bool);	break;
+			case expression_type::string:	add_instruction(opcode::equal_string);	break;
+			}
+
+			if (node.op == expression_op::not_equal)
+				add_instruction(opcode::not_);
+
+			break;
+		default:
+			CASPAR_THROW_EXCEPTION(invalid_argument() << msg_info(L"Cannot compile expression operator"));
+		}
+
+		push(node.type);
+	}
+};
+
+template<>
+double program::evaluate() const
+{
+	run();
+	return number_stack_[0];
+}
+
+template<>
+bool program::evaluate() const
+{
+	run();
+	return bool_stack_[0] != 0;
+}
+
+template<>
+std::wstring program::evaluate() const
+{
+	run();
+	return string_stack_[0];
+}
+
+void require(const expression& operand, expression_type type)
+{
+	if (operand->type != type)
+		CASPAR_THROW_EXCEPTION(user_error() << msg_info(
+				L"Required " + type_name(type) + L" but got " + type_name(operand->type)));
+}
+
+void require_count(const std::vector<expression>& operands, std::size_t count)
+{
+	if (operands.size() != count)
+		CASPAR_THROW_EXCEPTION(invalid_argument() << msg_info(L"Wrong number of operands to expression operator"));
+}
+
+void require_all(const std::vector<expression>& operands, std::size_t count, expression_type type)
+{
+	require_count(operands, count);
+
+	for (auto& operand : operands)
+		require(operand, type);
+}
+
+expression fold(const expression& node)
+{
+	program folded(node);
+	auto result = std::make_shared<expression_node>();
+	result->type	= node->type;
+	result->op		= expression_op::constant;
+
+	switch (node->type)
+	{
+	case expression_type::number:	result->number	= folded.evaluate<double>();		break;
+	case expression_type::boolean:	result->boolean	= folded.evaluate<bool>();			break;
+	case expression_type::string:	result->string	= folded.evaluate<std::wstring>();	break;
+	}
+
+	return result;
+}
+
+template<typename T>
+binding<T> to_binding(const expression& expr)
+{
+	require(expr, type_of<T>());
+
+	if (expr->op == expression_op::input)
+		return boost::any_cast<binding<T>>(expr->input);
+	else if (expr->op == expression_op::constant)
+		return binding<T>(constant_value<T>(*expr));
+
+	auto compiled = std::make_shared<program>(expr);
+	binding<T> result([compiled] { return compiled->evaluate<T>(); });
+	compiled->make_dependant(result);
+
+	return result;
+}
+
+template<typename T>
+expression make_input(const binding<T>& value)
+{
+	auto node = std::make_shared<expression_node>();
+	node->type	= type_of<T>();
+	node->op	= expression_op::input;
+	node->input	= value;
+
+	return node;
+}
+
+}
+
+expression number_constant(double value)
+{
+	auto node = std::make_shared<expression_node>();
+	node->type		= expression_type::number;
+	node->op		= expression_op::constant;
+	node->number	= value;
+
+	return node;
+}
+
+expression bool_constant(bool value)
+{
+	auto node = std::make_shared<expression_node>();
+	node->type		= expression_type::boolean;
+	node->op		= expression_op::constant;
+	node->boolean	= value;
+
+	return node;
+}
+
+expression string_constant(std::wstring value)
+{
+	auto node = std::make_shared<expression_node>();
+	node->type		= expression_type::string;
+	node->op		= expression_op::constant;
+	node->string	= std::move(value);
+
+	return node;
+}
+
+expression input(const binding<double>& value)			{ return make_input(value); }
+expression input(const binding<bool>& value)			{ return make_input(value); }
+expression input(const binding<std::wstring>& value)	{ return make_input(value); }
+
+expression apply(expression_op op, std::vector<expression> operands)
+{
+	auto node	= std::make_shared<expression_node>();
+	node->op	= op;
+
+	switch (op)
+	{
+	case expression_op::negate:
+	case expression_op::sin:
+	case expression_op::cos:
+	case expression_op::abs:
+	case expression_op::floor:
+		require_all(operands, 1, expression_type::number);
+		node->type = expression_type::number;
+		break;
+	case expression_op::not_:
+		require_all(operands, 1, expression_type::boolean);
+		node->type = expression_type::boolean;
+		break;
+	case expression_op::add:
+	case expression_op::subtract:
+	case expression_op::multiply:
+	case expression_op::divide:
+	case expression_op::modulus:
+		require_all(operands, 2, expression_type::number);
+		node->type = expression_type::number;
+		break;
+	case expression_op::less:
+	case expression_op::less_or_equal:
+	case expression_op::greater:
+	case expression_op::greater_or_equal:
+		require_all(operands, 2, expression_type::number);
+		node->type = expression_type::boolean;
+		break;
+	case expression_op::equal:
+	case expression_op::not_equal:
+		require_count(operands, 2);
+		require(operands.at(1), operands.at(0)->type);
+		node->type = expression_type::boolean;
+		break;
+	case expression_op::and_:
+	case expression_op::or_:
+		require_all(operands, 2, expression_type::boolean);
+		node->type = expression_type::boolean;
+		break;
+	case expression_op::concat:
+		require_all(operands, 2, expression_type::string);
+		node->type = expression_type::string;
+		break;
+	case expression_op::to_string:
+		require_count(operands, 1);
+
+		if (operands.at(0)->type == expression_type::string)
+			return operands.at(0);
+
+		node->type = expression_type::string;
+		break;
+	case expression_op::to_lower:
+	case expression_op::to_upper:
+		require_all(operands, 1, expression_type::string);
+		node->type = expression_type::string;
+		break;
+	case expression_op::length:
+		require_all(operands, 1, expression_type::string);
+		node->type = expression_type::number;
+		break;
+	case expression_op::conditional:
+		require_count(operands, 3);
+		require(operands.at(0), expression_type::boolean);
+		require(operands.at(2), operands.at(1)->type);
+		node->type = operands.at(1)->type;
+		break;
+	default:
+		CASPAR_THROW_EXCEPTION(invalid_argument() << msg_info(L"Not an operator"));
+	}
+
+	node->operands = std::move(operands);
+
+	bool all_constant = std::all_of(node->operands.begin(), node->operands.end(), [](const expression& operand)
+	{
+		return operand->op == expression_op::constant;
+	});
+
+	if (all_constant)
+		return fold(node);
+
+	return node;
+}
+
+binding<double> to_number_binding(const expression& expr)
+{
+	return to_binding<double>(expr);
+}
+
+binding<bool> to_bool_binding(const expression& expr)
+{
+	return to_binding<bool>(expr);
+}
+
+binding<std::wstring> to_string_binding(const expression& expr)
+{
+	return to_binding<std::wstring>(expr);
+}
+
+std::wstring type_name(expression_type type)
+{
+	switch (type)
+	{
+	case expression_type::number:	return L"number";
+	case expression_type::boolean:	return L"boolean";
+	case expression_type::string:	return L"string";
+	default:						return L"unknown";
+	}
+}
+
+}}}
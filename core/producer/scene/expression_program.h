@@ -0,0 +1,110 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include "../binding.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/any.hpp>
+
+namespace caspar { namespace core { namespace scene {
+
+enum class expression_type
+{
+	number,
+	boolean,
+	string
+};
+
+enum class expression_op
+{
+	constant,
+	input,
+	negate,
+	not_,
+	add,
+	subtract,
+	multiply,
+	divide,
+	modulus,
+	less,
+	less_or_equal,
+	greater,
+	greater_or_equal,
+	equal,
+	not_equal,
+	and_,
+	or_,
+	concat,
+	to_string,
+	sin,
+	cos,
+	abs,
+	floor,
+	to_lower,
+	to_upper,
+	length,
+	conditional
+};
+
+/**
+ * A typed expression tree node as produced by the expression parser. Trees are
+ * type checked and constant folded when built, and compiled into a flat
+ * program when turned into a binding, so evaluating a parsed expression is a
+ * single loop over instructions instead of one binding per operator.
+ */
+struct expression_node
+{
+	expression_type										type;
+	expression_op										op;
+	std::vector<std::shared_ptr<const expression_node>>	operands;
+	double												number	= 0.0;
+	bool												boolean	= false;
+	std::wstring										string;
+	boost::any											input;
+};
+
+typedef std::shared_ptr<const expression_node> expression;
+
+expression number_constant(double value);
+expression bool_constant(bool value);
+expression string_constant(std::wstring value);
+expression input(const binding<double>& value);
+expression input(const binding<bool>& value);
+expression input(const binding<std::wstring>& value);
+
+/**
+ * Creates an operator node, throwing user_error if the operands are of the
+ * wrong types. If all operands are constants the result is a constant.
+ */
+expression apply(expression_op op, std::vector<expression> operands);
+
+binding<double> to_number_binding(const expression& expr);
+binding<bool> to_bool_binding(const expression& expr);
+binding<std::wstring> to_string_binding(const expression& expr);
+
+std::wstring type_name(expression_type type);
+
+}}}
@@ -27,6 +27,10 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include "scene_producer.h"
 
 #include "../../frame/draw_frame.h"
@@ -65,42 +69,95 @@ levels::levels()
 {
 }
 
-struct timeline
+/**
+ * The keyframes affecting one binding, kept as sorted contiguous arrays. A
+ * cursor remembers the first keyframe at or after the last evaluated frame,
+ * so normal playback only ever looks at the neighbouring keyframes and the
+ * arrays are only searched when the timeline is seeked.
+ */
+class timeline
 {
-	std::map<int64_t, keyframe> keyframes;
+	std::vector<keyframe>	pending_;
+	std::vector<int64_t>	frames_;
+	std::vector<int64_t>	segment_starts_;
+	std::vector<keyframe>	keyframes_;
+	std::size_t				cursor_			= 0;
+	int64_t					last_frame_		= -1;
+public:
+	void add(const keyframe& k)
+	{
+		pending_.push_back(k);
+	}
 
 	void on_frame(int64_t frame)
 	{
-		auto before = --keyframes.upper_bound(frame);
-		bool found_before = before != keyframes.end() && before->first < frame;
-		auto after = keyframes.upper_bound(frame);
-		bool found_after = after != keyframes.end() && after->first > frame;
-		auto exact_frame = keyframes.find(frame);
-		bool found_exact_frame = exact_frame != keyframes.end();
+		if (!pending_.empty())
+			compile();
 
-		if (found_exact_frame)
+		seek(frame);
+
+		auto count = keyframes_.size();
+
+		if (cursor_ < count && frames_[cursor_] == frame)
 		{
-			exact_frame->second.on_destination_frame();
+			keyframes_[cursor_].on_destination_frame();
 
-			auto next_frame = ++exact_frame;
+			if (cursor_ + 1 < count && keyframes_[cursor_ + 1].on_start_animate)
+				keyframes_[cursor_ + 1].on_start_animate();
+		}
+		else if (cursor_ < count)
+		{
+			auto& after = keyframes_[cursor_];
 
-			if (next_frame != keyframes.end() && next_frame->second.on_start_animate)
-				next_frame->second.on_start_animate();
+			if (after.on_start_animate && frame == 0)
+				after.on_start_animate();
+			else if (after.on_animate_to)
+				after.on_animate_to(segment_starts_[cursor_], frame);
 		}
-		else if (found_after)
+	}
+private:
+	void seek(int64_t frame)
+	{
+		if (frame == last_frame_ + 1)
 		{
-			int64_t start_frame = 0;
+			if (cursor_ < frames_.size() && frames_[cursor_] < frame)
+				++cursor_;
+		}
+		else if (frame != last_frame_)
+			cursor_ = std::lower_bound(frames_.begin(), frames_.end(), frame) - frames_.begin();
 
-			if (found_before)
-			{
-				start_frame = before->first;
-			}
+		last_frame_ = frame;
+	}
+
+	void compile()
+	{
+		// The first keyframe stored for a frame wins, like it always has.
+		std::vector<keyframe> merged;
+		merged.reserve(keyframes_.size() + pending_.size());
+		merged.insert(merged.end(), keyframes_.begin(), keyframes_.end());
+		merged.insert(merged.end(), pending_.begin(), pending_.end());
+		std::stable_sort(merged.begin(), merged.end(), [](const keyframe& lhs, const keyframe& rhs)
+		{
+			return lhs.destination_frame < rhs.destination_frame;
+		});
+		merged.erase(std::unique(merged.begin(), merged.end(), [](const keyframe& lhs, const keyframe& rhs)
+		{
+			return lhs.destination_frame == rhs.destination_frame;
+		}), merged.end());
 
-			if (after->second.on_start_animate && frame == 0)
-				after->second.on_start_animate();
-			else if (after->second.on_animate_to)
-				after->second.on_animate_to(start_frame, frame);
+		keyframes_ = std::move(merged);
+		pending_.clear();
+		frames_.clear();
+		segment_starts_.clear();
+
+		for (auto& k : keyframes_)
+		{
+			segment_starts_.push_back(frames_.empty() ? 0 : frames_.back());
+			frames_.push_back(k.destination_frame);
 		}
+
+		last_frame_	= std::numeric_limits<int64_t>::min();
+		cursor_		= 0;
 	}
 };
 
@@ -146,7 +203,8 @@ struct scene_producer::impl
 	binding<int64_t>										mouse_x_;
 	binding<int64_t>										mouse_y_;
 	double													frame_fraction_			= 0.0;
-	std::map<void*, timeline>								timelines_;
+	std::vector<timeline>									timelines_;
+	std::map<void*, std::size_t>							timeline_by_identity_;
 	std::map<std::wstring, std::shared_ptr<core::variable>>	variables_;
 	std::vector<std::wstring>								variable_names_;
 	std::multimap<int64_t, marker>							markers_by_frame_;
@@ -230,7 +288,12 @@ struct scene_producer::impl
 
 	void store_keyframe(void* timeline_identity, const keyframe& k)
 	{
-		timelines_[timeline_identity].keyframes.insert(std::make_pair(k.destination_frame, k));
+		auto index = timeline_by_identity_.insert(std::make_pair(timeline_identity, timelines_.size()));
+
+		if (index.second)
+			timelines_.emplace_back();
+
+		timelines_.at(index.first->second).add(k);
 	}
 
 	void store_variable(
@@ -469,8 +532,10 @@ struct scene_producer::impl
 
 		frame_number_.set(frame_number_.get() + speed_.get());
 
+		auto timeline_frame = timeline_frame_number_.get();
+
 		for (auto& timeline : timelines_)
-			timeline.second.on_frame(timeline_frame_number_.get());
+			timeline.on_frame(timeline_frame);
 
 		std::vector<draw_frame> frames;
 
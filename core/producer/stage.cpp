@@ -29,10 +29,14 @@
 #include "../frame/frame_factory.h"
 #include "../interaction/interaction_aggregator.h"
 #include "../consumer/write_frame_consumer.h"
+#include "../monitor/latency_reporter.h"
 
+#include <common/cpu_affinity.h>
 #include <common/executor.h>
+#include <common/task_arena.h>
 #include <common/future.h>
 #include <common/diagnostics/graph.h>
+#include <common/diagnostics/latency_stats.h>
 #include <common/timer.h>
 
 #include <core/frame/frame_transform.h>
@@ -52,20 +56,27 @@ struct stage::impl : public std::enable_shared_from_this<impl>
 {
 	int																		channel_index_;
 	spl::shared_ptr<diagnostics::graph>										graph_;
+	const bool																freewheel_;
+	spl::shared_ptr<task_arena>												arena_;
 	spl::shared_ptr<monitor::subject>										monitor_subject_	= spl::make_shared<monitor::subject>("/stage");
 	std::map<int, layer>													layers_;
 	std::map<int, tweened_transform>										tweens_;
 	interaction_aggregator													aggregator_;
 	// map of layer -> map of tokens (src ref) -> layer_consumer
 	std::map<int, std::map<void*, spl::shared_ptr<write_frame_consumer>>>	layer_consumers_;
+	caspar::diagnostics::latency_stats										produce_stats_;
+	monitor::latency_reporter												produce_reporter_;
 	executor																executor_			{ L"stage " + boost::lexical_cast<std::wstring>(channel_index_) };
 public:
-	impl(int channel_index, spl::shared_ptr<diagnostics::graph> graph)
+	impl(int channel_index, spl::shared_ptr<diagnostics::graph> graph, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena)
 		: channel_index_(channel_index)
 		, graph_(std::move(graph))
+		, freewheel_(freewheel)
+		, arena_(std::move(arena))
 		, aggregator_([=] (double x, double y) { return collission_detect(x, y); })
 	{
 		graph_->set_color("produce-time", diagnostics::color(0.0f, 1.0f, 0.0f));
+		executor_.invoke([&] { affinity.bind_current_thread(); });
 	}
 
 	std::map<int, draw_frame> operator()(const video_format_desc& format_desc)
@@ -93,9 +104,12 @@ public:
 
 				aggregator_.translate_and_send();
 
-				tbb::parallel_for_each(indices.begin(), indices.end(), [&](int index)
+				arena_->execute([&]
 				{
-					draw(index, format_desc, frames);
+					tbb::parallel_for_each(indices.begin(), indices.end(), [&](int index)
+					{
+						draw(index, format_desc, frames);
+					});
 				});
 			}
 			catch(...)
@@ -111,6 +125,8 @@ public:
 		//frames_subject_ << frames;
 
 		graph_->set_value("produce-time", frame_timer.elapsed()*format_desc.fps*0.5);
+		produce_stats_.record_frame_time(frame_timer.elapsed(), freewheel_ ? 0.0 : format_desc.fps);
+		produce_reporter_.tick(produce_stats_, *monitor_subject_, format_desc.fps);
 		*monitor_subject_ << monitor::message("/profiler/time") % frame_timer.elapsed() % (1.0/format_desc.fps);
 
 		return frames;
@@ -122,7 +138,7 @@ public:
 		auto& tween		= tweens_[index];
 		auto& consumers	= layer_consumers_[index];
 
-		auto frame  = layer.receive(format_desc);
+		auto frame  = layer.receive(format_desc, freewheel_);
 
 		if (!consumers.empty())
 		{
@@ -426,6 +442,21 @@ public:
 		}, task_priority::high_priority));
 	}
 
+	std::future<boost::property_tree::wptree> stats_info()
+	{
+		return std::move(executor_.begin_invoke([this]() -> boost::property_tree::wptree
+		{
+			boost::property_tree::wptree info;
+
+			info.add_child(L"produce", produce_stats_.info());
+
+			for (auto& layer : layers_)
+				info.add_child(L"layers.layer", layer.second.stats_info()).add(L"index", layer.first);
+
+			return info;
+		}, task_priority::high_priority));
+	}
+
 	std::future<std::wstring> call(int index, const std::vector<std::wstring>& params)
 	{
 		return flatten(executor_.begin_invoke([=]
@@ -463,7 +494,7 @@ public:
 	}
 };
 
-stage::stage(int channel_index, spl::shared_ptr<diagnostics::graph> graph) : impl_(new impl(channel_index, std::move(graph))){}
+stage::stage(int channel_index, spl::shared_ptr<diagnostics::graph> graph, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena) : impl_(new impl(channel_index, std::move(graph), freewheel, affinity, std::move(arena))){}
 std::future<std::wstring> stage::call(int index, const std::vector<std::wstring>& params){return impl_->call(index, params);}
 std::future<void> stage::apply_transforms(const std::vector<stage::transform_tuple_t>& transforms){ return impl_->apply_transforms(transforms); }
 std::future<void> stage::apply_transform(int index, const std::function<core::frame_transform(core::frame_transform)>& transform, unsigned int mix_duration, const tweener& tween){ return impl_->apply_transform(index, transform, mix_duration, tween); }
@@ -487,6 +518,7 @@ std::future<boost::property_tree::wptree> stage::info() const{ return impl_->inf
 std::future<boost::property_tree::wptree> stage::info(int index) const{ return impl_->info(index); }
 std::future<boost::property_tree::wptree> stage::delay_info() const{ return impl_->delay_info(); }
 std::future<boost::property_tree::wptree> stage::delay_info(int index) const{ return impl_->delay_info(index); }
+std::future<boost::property_tree::wptree> stage::stats_info() const{ return impl_->stats_info(); }
 std::map<int, draw_frame> stage::operator()(const video_format_desc& format_desc){ return (*impl_)(format_desc); }
 monitor::subject& stage::monitor_output(){return *impl_->monitor_subject_;}
 void stage::on_interaction(const interaction_event::ptr& event) { impl_->on_interaction(event); }
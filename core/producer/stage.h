@@ -38,6 +38,8 @@
 #include <tuple>
 #include <vector>
 
+FORWARD1(caspar, class cpu_affinity);
+FORWARD1(caspar, class task_arena);
 FORWARD2(caspar, diagnostics, class graph);
 
 namespace caspar { namespace core {
@@ -57,7 +59,7 @@ public:
 
 	// Constructors
 
-	explicit stage(int channel_index, spl::shared_ptr<caspar::diagnostics::graph> graph);
+	explicit stage(int channel_index, spl::shared_ptr<caspar::diagnostics::graph> graph, bool freewheel, const cpu_affinity& affinity, spl::shared_ptr<task_arena> arena);
 	
 	// Methods
 
@@ -103,6 +105,7 @@ public:
 
 	std::future<boost::property_tree::wptree>		delay_info() const;
 	std::future<boost::property_tree::wptree>		delay_info(int layer) const;
+	std::future<boost::property_tree::wptree>		stats_info() const;
 private:
 	struct impl;
 	spl::shared_ptr<impl> impl_;
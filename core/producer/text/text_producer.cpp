@@ -45,11 +45,14 @@
 #include <common/env.h>
 #include <common/future.h>
 #include <common/param.h>
+#include <map>
 #include <memory>
+#include <tuple>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -111,15 +114,93 @@ void init(module_dependencies dependencies)
 	dependencies.producer_registry->register_producer_factory(L"Text Producer", create_text_producer, describe_text_producer);
 }
 
+// Opening every font file is expensive, so the fonts are only enumerated
+// again when the font folder has changed.
+std::map<std::wstring, std::wstring> enumerate_fonts_cached()
+{
+	static boost::mutex							mutex;
+	static std::map<std::wstring, std::wstring>	fonts;
+	static std::time_t							folder_write_time	= 0;
+
+	boost::system::error_code ec;
+	auto write_time = last_write_time(env::font_folder(), ec);
+
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	if (ec || write_time != folder_write_time)
+	{
+		fonts = enumerate_fonts();
+		folder_write_time = ec ? 0 : write_time;
+	}
+
+	return fonts;
+}
+
 text_info& find_font_file(text_info& info)
 {
 	auto& font_name = info.font;
-	auto fonts = enumerate_fonts();
+	auto fonts = enumerate_fonts_cached();
 	auto it = std::find_if(fonts.begin(), fonts.end(), font_comparer(font_name));
 	info.font_file = (it != fonts.end()) ? (*it).second : L"";
 	return info;
 }
 
+// Glyphs rendered into an atlas, shared by all text producers using the same
+// font, size and color.
+struct shared_font
+{
+	texture_atlas	atlas	{ 1024, 512, 4 };
+	texture_font	font;
+	const_frame		atlas_frame;
+
+	shared_font(const spl::shared_ptr<frame_factory>& frame_factory, const text_info& text_info, bool normalize_coordinates)
+		: font(atlas, text_info, normalize_coordinates)
+	{
+		//TODO: examine str to determine which unicode_blocks to load
+		font.load_glyphs(unicode_block::Basic_Latin, text_info.color);
+		font.load_glyphs(unicode_block::Latin_1_Supplement, text_info.color);
+		font.load_glyphs(unicode_block::Latin_Extended_A, text_info.color);
+
+		core::pixel_format_desc pfd(core::pixel_format::bgra);
+		pfd.planes.push_back(core::pixel_format_desc::plane(static_cast<int>(atlas.width()), static_cast<int>(atlas.height()), static_cast<int>(atlas.depth())));
+		auto frame = frame_factory->create_frame(this, pfd, core::audio_channel_layout::invalid());
+		memcpy(frame.image_data().data(), atlas.data(), frame.image_data().size());
+		atlas_frame = std::move(frame);
+	}
+};
+
+spl::shared_ptr<shared_font> get_shared_font(const spl::shared_ptr<frame_factory>& frame_factory, const text_info& text_info, bool normalize_coordinates)
+{
+	typedef std::tuple<std::wstring, std::wstring, double, double, double, double, double, bool> key_t;
+
+	static boost::mutex								mutex;
+	static std::map<key_t, std::weak_ptr<shared_font>>	fonts;
+
+	auto& color = text_info.color;
+	key_t key(text_info.font_file, text_info.font, text_info.size, color.a, color.r, color.g, color.b, normalize_coordinates);
+
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	auto font = fonts[key].lock();
+
+	if (font)
+		return spl::make_shared_ptr(font);
+
+	auto result = spl::make_shared<shared_font>(frame_factory, text_info, normalize_coordinates);
+	fonts[key] = result;
+
+	// Forget fonts no longer used by any producer.
+	for (auto it = fonts.begin(); it != fonts.end();)
+	{
+		if (it->second.expired())
+			it = fonts.erase(it);
+		else
+			++it;
+	}
+
+	return result;
+}
+
 } // namespace text
 
 
@@ -143,9 +224,7 @@ struct text_producer::impl
 	variable_impl<double>					current_bearing_y_;
 	variable_impl<double>					current_protrude_under_y_;
 	draw_frame								frame_;
-	text::texture_atlas						atlas_						{ 1024, 512, 4 };
-	text::texture_font						font_;
-	const_frame								atlas_frame_;
+	spl::shared_ptr<text::shared_font>		font_;
 
 public:
 	explicit impl(const spl::shared_ptr<frame_factory>& frame_factory, int x, int y, const std::wstring& str, text::text_info& text_info, long parent_width, long parent_height, bool standalone)
@@ -153,15 +232,8 @@ public:
 		, x_(x), y_(y)
 		, parent_width_(parent_width), parent_height_(parent_height)
 		, standalone_(standalone)
-		, font_(atlas_, text::find_font_file(text_info), !standalone)
+		, font_(text::get_shared_font(frame_factory, text::find_font_file(text_info), !standalone))
 	{
-		//TODO: examine str to determine which unicode_blocks to load
-		font_.load_glyphs(text::unicode_block::Basic_Latin, text_info.color);
-		font_.load_glyphs(text::unicode_block::Latin_1_Supplement, text_info.color);
-		font_.load_glyphs(text::unicode_block::Latin_Extended_A, text_info.color);
-
-		atlas_frame_ = create_atlas_frame();
-
 		tracking_.value().set(text_info.tracking);
 		scale_x_.value().set(text_info.scale_x);
 		scale_y_.value().set(text_info.scale_y);
@@ -186,22 +258,12 @@ public:
 		CASPAR_LOG(info) << print() << L" Initialized";
 	}
 
-	core::const_frame create_atlas_frame() const
-	{
-		core::pixel_format_desc pfd(core::pixel_format::bgra);
-		pfd.planes.push_back(core::pixel_format_desc::plane(static_cast<int>(atlas_.width()), static_cast<int>(atlas_.height()), static_cast<int>(atlas_.depth())));
-		auto frame = frame_factory_->create_frame(this, pfd, core::audio_channel_layout::invalid());
-		memcpy(frame.image_data().data(), atlas_.data(), frame.image_data().size());
-		return std::move(frame);
-	}
-
 	void generate_frame()
 	{
 		text::string_metrics metrics;
-		font_.set_tracking(tracking_.value().get());
 
-		auto vertex_stream = font_.create_vertex_stream(text_.value().get(), x_, y_, parent_width_, parent_height_, &metrics, shear_.value().get());
-		auto frame = atlas_frame_.with_geometry(frame_geometry(frame_geometry::geometry_type::quad_list, std::move(vertex_stream)));
+		auto vertex_stream = font_->font.create_vertex_stream(text_.value().get(), x_, y_, parent_width_, parent_height_, &metrics, shear_.value().get(), tracking_.value().get());
+		auto frame = font_->atlas_frame.with_geometry(frame_geometry(frame_geometry::geometry_type::quad_list, std::move(vertex_stream)));
 
 		this->constraints_.width.set(metrics.width * this->scale_x_.value().get());
 		this->constraints_.height.set(metrics.height * this->scale_y_.value().get());
@@ -291,8 +353,8 @@ public:
 		boost::property_tree::wptree info;
 		info.add(L"type", L"text");
 		info.add(L"text", text_.value().get());
-		info.add(L"font", font_.get_name());
-		info.add(L"size", font_.get_size());
+		info.add(L"font", font_->font.get_name());
+		info.add(L"size", font_->font.get_size());
 		return info;
 	}
 };
@@ -6,6 +6,7 @@
 
 #include <map>
 #include <memory>
+#include <boost/thread/mutex.hpp>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
@@ -34,6 +35,13 @@ private:
 
 		double left, top, right, bottom;
 		int width, height;
+
+		// Metrics kept from when the glyph was rendered, so that laying out
+		// text does not have to load the glyph again.
+		FT_UInt	index		= 0;
+		FT_Pos	bearing_x	= 0;
+		FT_Pos	bearing_y	= 0;
+		FT_Pos	advance_x	= 0;
 	};
 
 	spl::shared_ptr<FT_FaceRec_>	face_;
@@ -43,6 +51,7 @@ private:
 	bool							normalize_;
 	std::map<int, glyph_info>		glyphs_;
 	std::wstring					name_;
+	boost::mutex					face_mutex_;
 
 public:
 	impl(texture_atlas& atlas, const text_info& info, bool normalize_coordinates)
@@ -97,15 +106,27 @@ public:
 			}
 
 			atlas_.set_region(region.x, region.y, bitmap.width, bitmap.rows, bitmap.buffer, bitmap.pitch, col);
-			glyphs_.insert(std::pair<int, glyph_info>(i, glyph_info(bitmap.width, bitmap.rows,
-										region.x / static_cast<double>(atlas_.width()),
-										region.y / static_cast<double>(atlas_.height()),
-										(region.x + bitmap.width) / static_cast<double>(atlas_.width()),
-										(region.y + bitmap.rows) / static_cast<double>(atlas_.height()))));
+
+			glyph_info info(bitmap.width, bitmap.rows,
+					region.x / static_cast<double>(atlas_.width()),
+					region.y / static_cast<double>(atlas_.height()),
+					(region.x + bitmap.width) / static_cast<double>(atlas_.width()),
+					(region.y + bitmap.rows) / static_cast<double>(atlas_.height()));
+			info.index		= glyph_index;
+			info.bearing_x	= face_->glyph->metrics.horiBearingX;
+			info.bearing_y	= face_->glyph->metrics.horiBearingY;
+			info.advance_x	= face_->glyph->advance.x;
+
+			glyphs_.insert(std::pair<int, glyph_info>(i, info));
 		}
 	}
 
 	std::vector<frame_geometry::coord> create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear)
+	{
+		return create_vertex_stream(str, x, y, parent_width, parent_height, metrics, shear, tracking_);
+	}
+
+	std::vector<frame_geometry::coord> create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear, double tracking)
 	{
 		//TODO: detect glyphs that aren't in the atlas and load them (and maybe that entire unicode_block on the fly
 
@@ -129,23 +150,23 @@ public:
 			{
 				const glyph_info& coords = glyph_it->second;
 
-				FT_UInt glyph_index = FT_Get_Char_Index(face_.get(), (*it));
+				FT_UInt glyph_index = coords.index;
 
 				if(use_kerning && previous && glyph_index)
 				{
+					// The face may be shared by producers on other channels.
+					boost::lock_guard<boost::mutex> lock(face_mutex_);
 					FT_Vector delta;
 					FT_Get_Kerning(face_.get(), previous, glyph_index, FT_KERNING_DEFAULT, &delta);
 
 					pos_x += delta.x / 64.0;
 				}
 
-				FT_Load_Glyph(face_.get(), glyph_index, FT_LOAD_NO_BITMAP | FT_LOAD_FORCE_AUTOHINT | FT_LOAD_TARGET_NORMAL);
-
-				double left = (pos_x + face_->glyph->metrics.horiBearingX / 64.0) / parent_width;
-				double right = ((pos_x + face_->glyph->metrics.horiBearingX / 64.0) + coords.width) / parent_width;
+				double left = (pos_x + coords.bearing_x / 64.0) / parent_width;
+				double right = ((pos_x + coords.bearing_x / 64.0) + coords.width) / parent_width;
 
-				double top = (pos_y - face_->glyph->metrics.horiBearingY/64.0) / parent_height;
-				double bottom = ((pos_y - face_->glyph->metrics.horiBearingY / 64.0) + coords.height) / parent_height;
+				double top = (pos_y - coords.bearing_y / 64.0) / parent_height;
+				double bottom = ((pos_y - coords.bearing_y / 64.0) + coords.height) / parent_height;
 
 				auto ul_index = index * 4;
 				auto ur_index = ul_index + 1;
@@ -176,7 +197,7 @@ public:
 				result[ll_index].texture_x	= coords.left;			//texcoord.r
 				result[ll_index].texture_y	= coords.bottom;		//texcoord.s
 
-				int bearingY = face_->glyph->metrics.horiBearingY >> 6;
+				int bearingY = coords.bearing_y >> 6;
 
 				if(bearingY > maxBearingY)
 					maxBearingY = bearingY;
@@ -189,8 +210,8 @@ public:
 				if (maxBearingY + maxProtrudeUnderY > maxHeight)
 					maxHeight = maxBearingY + maxProtrudeUnderY;
 
-				pos_x += face_->glyph->advance.x / 64.0;
-				pos_x += tracking_;
+				pos_x += coords.advance_x / 64.0;
+				pos_x += tracking;
 				previous = glyph_index;
 			}
 			else
@@ -201,7 +222,7 @@ public:
 
 		if(normalize_)
 		{
-			auto ratio_x = parent_width / (pos_x - tracking_ - x);
+			auto ratio_x = parent_width / (pos_x - tracking - x);
 			auto ratio_y = parent_height / static_cast<double>(maxHeight);
 
 			for (auto& coord : result)
@@ -213,7 +234,7 @@ public:
 
 		if (metrics != nullptr)
 		{
-			metrics->width			= static_cast<int>(pos_x - tracking_ - x + 0.5);
+			metrics->width			= static_cast<int>(pos_x - tracking - x + 0.5);
 			metrics->bearingY		= maxBearingY;
 			metrics->height			= maxHeight;
 			metrics->protrudeUnderY	= maxProtrudeUnderY;
@@ -237,6 +258,7 @@ texture_font::texture_font(texture_atlas& atlas, const text_info& info, bool nor
 void texture_font::load_glyphs(unicode_block range, const color<double>& col) { impl_->load_glyphs(range, col); }
 void texture_font::set_tracking(double tracking) { impl_->set_tracking(tracking); }
 std::vector<frame_geometry::coord> texture_font::create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear) { return impl_->create_vertex_stream(str, x, y, parent_width, parent_height, metrics, shear); }
+std::vector<frame_geometry::coord> texture_font::create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear, double tracking) { return impl_->create_vertex_stream(str, x, y, parent_width, parent_height, metrics, shear, get_size() * tracking / 1000.0); }
 std::wstring texture_font::get_name() const { return impl_->get_name(); }
 double texture_font::get_size() const { return impl_->get_size(); }
 
@@ -24,6 +24,8 @@ public:
 	void load_glyphs(unicode_block block, const color<double>& col);
 	void set_tracking(double tracking);
 	std::vector<frame_geometry::coord> create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear = 0.0);
+	// Does not depend on set_tracking(), so a font can be shared between producers.
+	std::vector<frame_geometry::coord> create_vertex_stream(const std::wstring& str, int x, int y, int parent_width, int parent_height, string_metrics* metrics, double shear, double tracking);
 	std::wstring get_name() const;
 	double get_size() const;
 
@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <set>
 #include <future>
 
@@ -34,8 +35,14 @@
 
 #include <tbb/atomic.h>
 
+#include <common/cpu_affinity.h>
 #include <common/diagnostics/graph.h>
 #include <common/filesystem.h>
+#include <common/executor.h>
+#include <common/task_arena.h>
+#include <common/blocking_priority_queue.h>
+#include <common/os/threading.h>
+#include <common/os/general_protection_fault.h>
 
 #include "producer/frame_producer.h"
 #include "producer/cg_proxy.h"
@@ -49,48 +56,37 @@
 #include "frame/audio_channel_layout.h"
 #include "producer/media_info/media_info.h"
 #include "producer/media_info/media_info_repository.h"
+#include "monitor/monitor.h"
 
 namespace caspar { namespace core {
 
-struct thumbnail_output
-{
-	tbb::atomic<int> sleep_millis;
-	std::function<void (const_frame)> on_send;
-
-	thumbnail_output(int sleep_millis)
-	{
-		this->sleep_millis = sleep_millis;
-	}
-
-	void send(const_frame frame, std::shared_ptr<void> frame_and_ticket)
-	{
-		int current_sleep = sleep_millis;
-
-		if (current_sleep > 0)
-			boost::this_thread::sleep_for(boost::chrono::milliseconds(current_sleep));
-
-		on_send(std::move(frame));
-		on_send = nullptr;
-	}
-};
-
 struct thumbnail_generator::impl
 {
 private:
+	typedef blocking_priority_queue<boost::filesystem::path, task_priority> job_queue_t;
+
 	boost::filesystem::path							media_path_;
 	boost::filesystem::path							thumbnails_path_;
 	int												width_;
 	int												height_;
 	spl::shared_ptr<image_mixer>					image_mixer_;
 	spl::shared_ptr<diagnostics::graph>				graph_;
+	spl::shared_ptr<monitor::subject>				monitor_subject_	= spl::make_shared<monitor::subject>("/thumbnail");
 	video_format_desc								format_desc_;
-	spl::unique_ptr<thumbnail_output>				output_;
+	spl::shared_ptr<task_arena>						arena_;
 	mixer											mixer_;
+	executor										mixer_executor_;
 	thumbnail_creator								thumbnail_creator_;
 	spl::shared_ptr<media_info_repository>			media_info_repo_;
 	spl::shared_ptr<const frame_producer_registry>	producer_registry_;
 	spl::shared_ptr<const cg_producer_registry>		cg_registry_;
 	bool											mipmap_;
+	job_queue_t										jobs_;
+	boost::mutex									queued_mutex_;
+	std::map<boost::filesystem::path, task_priority>	queued_; // The highest priority each file is queued at.
+	tbb::atomic<int>								num_generated_;
+	tbb::atomic<int>								num_outstanding_;
+	std::vector<boost::thread>						workers_;
 	filesystem_monitor::ptr							monitor_;
 public:
 	impl(
@@ -101,7 +97,7 @@ public:
 			int height,
 			const video_format_desc& render_video_mode,
 			std::unique_ptr<image_mixer> image_mixer,
-			int generate_delay_millis,
+			int num_workers,
 			const thumbnail_creator& thumbnail_creator,
 			spl::shared_ptr<media_info_repository> media_info_repo,
 			spl::shared_ptr<const frame_producer_registry> producer_registry,
@@ -113,13 +109,20 @@ public:
 		, height_(height)
 		, image_mixer_(std::move(image_mixer))
 		, format_desc_(render_video_mode)
-		, output_(spl::make_unique<thumbnail_output>(generate_delay_millis))
-		, mixer_(0, graph_, image_mixer_)
+		, arena_(spl::make_shared<task_arena>(std::max(1, num_workers), std::max(1, num_workers) + 1 /* workers and mixer */, task_arena_priority::low))
+		, mixer_(0, graph_, image_mixer_, true, cpu_affinity(), arena_)
+		, mixer_executor_(L"thumbnail_generator mixer")
 		, thumbnail_creator_(thumbnail_creator)
 		, media_info_repo_(std::move(media_info_repo))
 		, producer_registry_(std::move(producer_registry))
 		, cg_registry_(std::move(cg_registry))
 		, mipmap_(mipmap)
+		, jobs_(std::numeric_limits<int>::max(), std::vector<task_priority> {
+			task_priority::normal_priority,
+			task_priority::high_priority,
+			task_priority::higher_priority
+		})
+		, workers_(start_workers(num_workers))
 		, monitor_(monitor_factory.create(
 				media_path,
 				filesystem_event::ALL,
@@ -133,11 +136,26 @@ public:
 					this->on_initial_files(initial_files);
 				}))
 	{
+		num_generated_		= 0;
+		num_outstanding_	= 0;
 		graph_->set_text(L"thumbnail-channel");
 		graph_->auto_reset();
 		diagnostics::register_graph(graph_);
-		//monitor_->initial_scan_completion().get();
-		//output_->sleep_millis = 2000;
+	}
+
+	~impl()
+	{
+		// An empty path tells a worker to stop.
+		for (std::size_t i = 0; i < workers_.size(); ++i)
+			jobs_.push(task_priority::higher_priority, boost::filesystem::path());
+
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	monitor::subject& monitor_output()
+	{
+		return *monitor_subject_;
 	}
 
 	void on_initial_files(const std::set<boost::filesystem::path>& initial_files)
@@ -182,7 +200,7 @@ public:
 
 			if (boost::iequals(stem.wstring(), base_file.filename().wstring()))
 			{
-				monitor_->reemmit(iter->path());
+				enqueue(iter->path(), task_priority::high_priority);
 				found = true;
 			}
 		}
@@ -202,11 +220,11 @@ public:
 		{
 		case filesystem_event::CREATED:
 			if (needs_to_be_generated(file))
-				generate_thumbnail(file);
+				enqueue(file, task_priority::normal_priority);
 
 			break;
 		case filesystem_event::MODIFIED:
-			generate_thumbnail(file);
+			enqueue(file, task_priority::normal_priority);
 
 			break;
 		case filesystem_event::REMOVED:
@@ -218,6 +236,82 @@ public:
 		}
 	}
 
+	std::vector<boost::thread> start_workers(int num_workers)
+	{
+		std::vector<boost::thread> workers;
+
+		for (int i = 0; i < std::max(1, num_workers); ++i)
+			workers.push_back(boost::thread([this] { run_worker(); }));
+
+		return workers;
+	}
+
+	void enqueue(const boost::filesystem::path& file, task_priority priority)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(queued_mutex_);
+			auto queued = queued_.find(file);
+
+			if (queued == queued_.end())
+			{
+				queued_.insert(std::make_pair(file, priority));
+				++num_outstanding_;
+			}
+			else if (priority > queued->second)
+			{
+				// Queued again at the higher priority, the worker skips the
+				// job left at the lower one.
+				queued->second = priority;
+			}
+			else
+				return;
+		}
+
+		jobs_.push(priority, file);
+	}
+
+	void run_worker()
+	{
+		ensure_gpf_handler_installed_for_thread("thumbnail-worker");
+		set_priority_of_current_thread(thread_priority::LOW);
+
+		while (true)
+		{
+			boost::filesystem::path file;
+			jobs_.pop(file);
+
+			if (file.empty())
+				return;
+
+			{
+				boost::lock_guard<boost::mutex> lock(queued_mutex_);
+
+				// Already handled when it was queued again at a higher priority.
+				if (queued_.erase(file) == 0)
+					continue;
+			}
+
+			try
+			{
+				// The decoding is done in the arena, so it does not take
+				// worker threads from the channels.
+				arena_->execute([&]
+				{
+					generate_thumbnail(file);
+				});
+			}
+			catch (...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+			}
+
+			auto num_generated		= ++num_generated_;
+			auto num_outstanding	= --num_outstanding_;
+
+			*monitor_subject_ << monitor::message("/progress") % num_generated % num_outstanding;
+		}
+	}
+
 	bool needs_to_be_generated(const boost::filesystem::path& file)
 	{
 		using namespace boost::filesystem;
@@ -255,56 +349,49 @@ public:
 		auto media_file_with_extension = get_relative(file, media_path_);
 		auto media_file = get_relative_without_extension(file, media_path_);
 		auto png_file = thumbnails_path_ / (media_file.wstring() + L".png");
-		std::promise<void> thumbnail_ready;
+		auto raw_frame = draw_frame::empty();
 
+		// Decoding is done in parallel by the workers, only the mixing is
+		// serialized.
+		try
 		{
-			boost::filesystem::create_directories(png_file.parent_path());
-			output_->on_send = [this, &png_file] (const_frame frame)
-			{
-				thumbnail_creator_(frame, format_desc_, png_file, width_, height_);
-			};
-
-			std::map<int, draw_frame> frames;
-			auto raw_frame = draw_frame::empty();
+			raw_frame = producer_registry_->create_thumbnail(frame_producer_dependencies(image_mixer_, {}, format_desc_, producer_registry_, cg_registry_), media_file.wstring());
+			media_info_repo_->remove(file.wstring());
+			media_info_repo_->get(file.wstring());
+		}
+		catch (const boost::thread_interrupted&)
+		{
+			throw;
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION_AT_LEVEL(trace);
+			CASPAR_LOG(info) << L"Thumbnail producer failed to create thumbnail for " << media_file_with_extension << L". Turn on log level trace to see more information.";
+			return;
+		}
 
-			try
-			{
-				raw_frame = producer_registry_->create_thumbnail(frame_producer_dependencies(image_mixer_, {}, format_desc_, producer_registry_, cg_registry_), media_file.wstring());
-				media_info_repo_->remove(file.wstring());
-				media_info_repo_->get(file.wstring());
-			}
-			catch (const boost::thread_interrupted&)
-			{
-				throw;
-			}
-			catch (...)
-			{
-				CASPAR_LOG_CURRENT_EXCEPTION_AT_LEVEL(trace);
-				CASPAR_LOG(info) << L"Thumbnail producer failed to create thumbnail for " << media_file_with_extension << L". Turn on log level trace to see more information.";
-				return;
-			}
+		if (raw_frame == draw_frame::empty()
+				|| raw_frame == draw_frame::late())
+		{
+			CASPAR_LOG(debug) << L"No thumbnail producer for " << media_file_with_extension;
+			return;
+		}
 
-			if (raw_frame == draw_frame::empty()
-					|| raw_frame == draw_frame::late())
-			{
-				CASPAR_LOG(debug) << L"No thumbnail producer for " << media_file_with_extension;
-				return;
-			}
+		auto transformed_frame = draw_frame(raw_frame);
+		transformed_frame.transform().image_transform.fill_scale[0] = static_cast<double>(width_) / format_desc_.width;
+		transformed_frame.transform().image_transform.fill_scale[1] = static_cast<double>(height_) / format_desc_.height;
+		transformed_frame.transform().image_transform.use_mipmap = mipmap_;
 
-			auto transformed_frame = draw_frame(raw_frame);
-			transformed_frame.transform().image_transform.fill_scale[0] = static_cast<double>(width_) / format_desc_.width;
-			transformed_frame.transform().image_transform.fill_scale[1] = static_cast<double>(height_) / format_desc_.height;
-			transformed_frame.transform().image_transform.use_mipmap = mipmap_;
+		auto mixed_frame = mixer_executor_.invoke([&]
+		{
+			std::map<int, draw_frame> frames;
 			frames.insert(std::make_pair(0, transformed_frame));
 
-			std::shared_ptr<void> ticket(nullptr, [&thumbnail_ready](void*) { thumbnail_ready.set_value(); });
+			return mixer_(std::move(frames), format_desc_, audio_channel_layout(2, L"stereo", L""));
+		});
 
-			auto mixed_frame = mixer_(std::move(frames), format_desc_, audio_channel_layout(2, L"stereo", L""));
-
-			output_->send(std::move(mixed_frame), ticket);
-			ticket.reset();
-		}
-		thumbnail_ready.get_future().get();
+		boost::filesystem::create_directories(png_file.parent_path());
+		thumbnail_creator_(mixed_frame, format_desc_, png_file, width_, height_);
 
 		if (boost::filesystem::exists(png_file))
 		{
@@ -313,6 +400,7 @@ public:
 			{
 				boost::filesystem::last_write_time(png_file, boost::filesystem::last_write_time(file));
 				CASPAR_LOG(info) << L"Generated thumbnail for " << media_file_with_extension;
+				*monitor_subject_ << monitor::message("/generated") % media_file_with_extension.generic_wstring();
 			}
 			catch (...)
 			{
@@ -332,7 +420,7 @@ thumbnail_generator::thumbnail_generator(
 		int height,
 		const video_format_desc& render_video_mode,
 		std::unique_ptr<image_mixer> image_mixer,
-		int generate_delay_millis,
+		int num_workers,
 		const thumbnail_creator& thumbnail_creator,
 		spl::shared_ptr<media_info_repository> media_info_repo,
 		spl::shared_ptr<const frame_producer_registry> producer_registry,
@@ -345,7 +433,7 @@ thumbnail_generator::thumbnail_generator(
 				width, height,
 				render_video_mode,
 				std::move(image_mixer),
-				generate_delay_millis,
+				num_workers,
 				thumbnail_creator,
 				media_info_repo,
 				producer_registry,
@@ -368,4 +456,9 @@ void thumbnail_generator::generate_all()
 	impl_->generate_all();
 }
 
+monitor::subject& thumbnail_generator::monitor_output()
+{
+	return impl_->monitor_output();
+}
+
 }}
@@ -27,6 +27,7 @@
 #include <common/filesystem_monitor.h>
 
 #include "fwd.h"
+#include "monitor/monitor.h"
 
 namespace caspar { namespace core {
 
@@ -48,7 +49,7 @@ public:
 			int height,
 			const video_format_desc& render_video_mode,
 			std::unique_ptr<image_mixer> image_mixer,
-			int generate_delay_millis,
+			int num_workers,
 			const thumbnail_creator& thumbnail_creator,
 			spl::shared_ptr<media_info_repository> media_info_repo,
 			spl::shared_ptr<const frame_producer_registry> producer_registry,
@@ -57,6 +58,7 @@ public:
 	~thumbnail_generator();
 	void generate(const std::wstring& media_file);
 	void generate_all();
+	monitor::subject& monitor_output();
 private:
 	struct impl;
 	spl::unique_ptr<impl> impl_;
@@ -32,17 +32,22 @@
 #include "frame/draw_frame.h"
 #include "frame/frame_factory.h"
 #include "frame/audio_channel_layout.h"
+#include "monitor/latency_reporter.h"
 
 #include <common/diagnostics/graph.h>
+#include <common/diagnostics/latency_stats.h>
+#include <common/diagnostics/trace.h>
 #include <common/env.h>
 #include <common/lock.h>
 #include <common/executor.h>
+#include <common/task_arena.h>
 #include <common/timer.h>
 #include <common/future.h>
 
 #include <core/mixer/image/image_mixer.h>
 #include <core/diagnostics/call_context.h>
 
+#include <tbb/atomic.h>
 #include <tbb/spin_mutex.h>
 
 #include <boost/property_tree/ptree.hpp>
@@ -58,6 +63,9 @@ struct video_channel::impl final
 	spl::shared_ptr<monitor::subject>					monitor_subject_;
 
 	const int											index_;
+	const bool											freewheel_;
+	const cpu_affinity									affinity_;
+	const spl::shared_ptr<task_arena>					arena_;
 
 	mutable tbb::spin_mutex								format_desc_mutex_;
 	core::video_format_desc								format_desc_;
@@ -81,22 +89,40 @@ struct video_channel::impl final
 	int64_t												last_tick_listener_id	= 0;
 	std::unordered_map<int64_t, std::function<void ()>>	tick_listeners_;
 
+	caspar::timer										freewheel_timer_;
+	int64_t												freewheel_frames_		= 0;
+	tbb::atomic<double>									freewheel_fps_;
+
+	caspar::diagnostics::latency_stats					frame_stats_;
+	monitor::latency_reporter							frame_reporter_;
+
+	const std::wstring*									trace_produce_			= caspar::diagnostics::trace::intern(L"produce");
+	const std::wstring*									trace_mix_				= caspar::diagnostics::trace::intern(L"mix");
+	const std::wstring*									trace_consume_			= caspar::diagnostics::trace::intern(L"consume");
+
 	executor											executor_				{ L"video_channel " + boost::lexical_cast<std::wstring>(index_) };
 public:
 	impl(
 			int index,
 			const core::video_format_desc& format_desc,
 			const core::audio_channel_layout& channel_layout,
-			std::unique_ptr<image_mixer> image_mixer)
+			std::unique_ptr<image_mixer> image_mixer,
+			bool freewheel,
+			const cpu_affinity& affinity,
+			int max_threads,
+			task_arena_priority priority)
 		: monitor_subject_(spl::make_shared<monitor::subject>(
 				"/channel/" + boost::lexical_cast<std::string>(index)))
 		, index_(index)
+		, freewheel_(freewheel)
+		, affinity_(affinity)
+		, arena_(spl::make_shared<task_arena>(max_threads, 2 /* stage and mixer */, priority))
 		, format_desc_(format_desc)
 		, channel_layout_(channel_layout)
-		, output_(graph_, format_desc, channel_layout, index)
+		, output_(graph_, format_desc, channel_layout, index, freewheel, affinity)
 		, image_mixer_(std::move(image_mixer))
-		, mixer_(index, graph_, image_mixer_)
-		, stage_(index, graph_)
+		, mixer_(index, graph_, image_mixer_, freewheel, affinity, arena_)
+		, stage_(index, graph_, freewheel, affinity, arena_)
 	{
 		graph_->set_color("tick-time", caspar::diagnostics::color(0.0f, 0.6f, 0.9f));
 		graph_->set_text(print());
@@ -106,9 +132,15 @@ public:
 		mixer_.monitor_output().attach_parent(monitor_subject_);
 		stage_.monitor_output().attach_parent(monitor_subject_);
 
+		freewheel_fps_ = 0.0;
+
+		executor_.invoke([&] { affinity_.bind_current_thread(); });
 		executor_.begin_invoke([=]{tick();});
 
-		CASPAR_LOG(info) << print() << " Successfully Initialized.";
+		if (freewheel_)
+			CASPAR_LOG(info) << print() << " Successfully Initialized. Freewheeling.";
+		else
+			CASPAR_LOG(info) << print() << " Successfully Initialized.";
 	}
 
 	~impl()
@@ -180,20 +212,43 @@ public:
 
 			// Produce
 
-			auto stage_frames = stage_(format_desc);
+			auto stage_frames = traced(trace_produce_, [&] { return stage_(format_desc); });
 
 			// Mix
 
-			auto mixed_frame  = mixer_(std::move(stage_frames), format_desc, channel_layout);
+			auto mixed_frame  = traced(trace_mix_, [&] { return mixer_(std::move(stage_frames), format_desc, channel_layout); });
 
 			// Consume
 
-			output_ready_for_frame_ = output_(std::move(mixed_frame), format_desc, channel_layout);
-			output_ready_for_frame_.get();
+			{
+				caspar::diagnostics::trace::scope trace(trace_consume_);
+
+				if (freewheel_)
+				{
+					// Produce and mix the next frame while the consumers are busy
+					// with this one, instead of waiting for them first. The future
+					// is replaced before get(), which leaves it invalid, so an
+					// exception from the consumers only costs this frame.
+					auto previous = std::move(output_ready_for_frame_);
+					output_ready_for_frame_ = make_ready_future();
+					previous.get();
+					output_ready_for_frame_ = output_(std::move(mixed_frame), format_desc, channel_layout);
+					update_freewheel_fps();
+				}
+				else
+				{
+					output_ready_for_frame_ = output_(std::move(mixed_frame), format_desc, channel_layout);
+					output_ready_for_frame_.get();
+				}
+			}
 
 			auto frame_time = frame_timer.elapsed()*format_desc.fps*0.5;
 			graph_->set_value("tick-time", frame_time);
 
+			// A freewheeling channel has no deadline to be late for.
+			frame_stats_.record_frame_time(frame_timer.elapsed(), freewheel_ ? 0.0 : format_desc.fps);
+			frame_reporter_.tick(frame_stats_, *monitor_subject_, format_desc.fps);
+
 			*monitor_subject_	<< monitor::message("/profiler/time")	% frame_timer.elapsed() % (1.0/ video_format_desc().fps)
 								<< monitor::message("/format")			% format_desc.name;
 		}
@@ -206,6 +261,31 @@ public:
 			executor_.begin_invoke([=]{tick();});
 	}
 
+	template<typename Func>
+	auto traced(const std::wstring* name, Func&& func) -> decltype(func())
+	{
+		caspar::diagnostics::trace::scope trace(name);
+
+		return func();
+	}
+
+	void update_freewheel_fps()
+	{
+		++freewheel_frames_;
+
+		auto elapsed = freewheel_timer_.elapsed();
+
+		if (elapsed < 1.0)
+			return;
+
+		freewheel_fps_ = freewheel_frames_ / elapsed;
+		freewheel_frames_ = 0;
+		freewheel_timer_.restart();
+
+		graph_->set_text(print() + L" " + boost::lexical_cast<std::wstring>(static_cast<int>(freewheel_fps_)) + L" fps");
+		*monitor_subject_ << monitor::message("/freewheel/fps") % static_cast<double>(freewheel_fps_);
+	}
+
 	std::wstring print() const
 	{
 		return L"video_channel[" + boost::lexical_cast<std::wstring>(index_) + L"|" +  video_format_desc().name + L"]";
@@ -226,6 +306,16 @@ public:
 
 		info.add(L"video-mode", video_format_desc().name);
 		info.add(L"audio-channel-layout", audio_channel_layout().print());
+
+		if (freewheel_)
+			info.add(L"freewheel.fps", static_cast<double>(freewheel_fps_));
+
+		if (!affinity_.empty())
+			info.add(L"affinity", affinity_.print());
+
+		info.add(L"arena.max-threads", arena_->max_threads());
+		info.add(L"arena.priority", to_string(arena_->priority()));
+
 		info.add_child(L"stage", stage_info.get());
 		info.add_child(L"mixer", mixer_info.get());
 		info.add_child(L"output", output_info.get());
@@ -249,6 +339,21 @@ public:
 		return info;
 	}
 
+	boost::property_tree::wptree stats_info() const
+	{
+		boost::property_tree::wptree info;
+
+		auto stage_info		= stage_.stats_info();
+		auto output_info	= output_.stats_info();
+
+		info.add_child(L"frame", frame_stats_.info());
+		info.add_child(L"stage", stage_info.get());
+		info.add_child(L"mixer.mix", mixer_.stats_info());
+		info.add_child(L"output", output_info.get());
+
+		return info;
+	}
+
 	std::shared_ptr<void> add_tick_listener(std::function<void()> listener)
 	{
 		return lock(tick_listeners_mutex_, [&]
@@ -271,7 +376,11 @@ video_channel::video_channel(
 		int index,
 		const core::video_format_desc& format_desc,
 		const core::audio_channel_layout& channel_layout,
-		std::unique_ptr<image_mixer> image_mixer) : impl_(new impl(index, format_desc, channel_layout, std::move(image_mixer))){}
+		std::unique_ptr<image_mixer> image_mixer,
+		bool freewheel,
+		const cpu_affinity& affinity,
+		int max_threads,
+		task_arena_priority priority) : impl_(new impl(index, format_desc, channel_layout, std::move(image_mixer), freewheel, affinity, max_threads, priority)){}
 video_channel::~video_channel(){}
 const stage& video_channel::stage() const { return impl_->stage_;}
 stage& video_channel::stage() { return impl_->stage_;}
@@ -286,7 +395,10 @@ core::audio_channel_layout video_channel::audio_channel_layout() const { return
 void core::video_channel::audio_channel_layout(const core::audio_channel_layout& channel_layout) { impl_->audio_channel_layout(channel_layout); }
 boost::property_tree::wptree video_channel::info() const{return impl_->info();}
 boost::property_tree::wptree video_channel::delay_info() const { return impl_->delay_info(); }
+boost::property_tree::wptree video_channel::stats_info() const { return impl_->stats_info(); }
 int video_channel::index() const { return impl_->index(); }
+bool video_channel::freewheel() const { return impl_->freewheel_; }
+const cpu_affinity& video_channel::affinity() const { return impl_->affinity_; }
 monitor::subject& video_channel::monitor_output(){ return *impl_->monitor_subject_; }
 std::shared_ptr<void> video_channel::add_tick_listener(std::function<void()> listener) { return impl_->add_tick_listener(std::move(listener)); }
 
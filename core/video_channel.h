@@ -21,7 +21,9 @@
 
 #pragma once
 
+#include <common/cpu_affinity.h>
 #include <common/memory.h>
+#include <common/task_arena.h>
 #include <common/forward.h>
 
 #include "fwd.h"
@@ -48,7 +50,11 @@ public:
 			int index,
 			const video_format_desc& format_desc,
 			const audio_channel_layout& channel_layout,
-			std::unique_ptr<image_mixer> image_mixer);
+			std::unique_ptr<image_mixer> image_mixer,
+			bool freewheel = false,
+			const cpu_affinity& affinity = cpu_affinity(),
+			int max_threads = 0,
+			task_arena_priority priority = task_arena_priority::normal);
 	~video_channel();
 
 	// Methods
@@ -75,7 +81,10 @@ public:
 
 	boost::property_tree::wptree			info() const;
 	boost::property_tree::wptree			delay_info() const;
+	boost::property_tree::wptree			stats_info() const;
 	int										index() const;
+	bool									freewheel() const;
+	const cpu_affinity&						affinity() const;
 private:
 	struct impl;
 	spl::unique_ptr<impl> impl_;
@@ -47,6 +47,7 @@
 #include <common/cache_aligned_vector.h>
 #include <common/timer.h>
 #include <common/param.h>
+#include <common/semaphore.h>
 #include <common/software_version.h>
 
 #include <tbb/concurrent_queue.h>
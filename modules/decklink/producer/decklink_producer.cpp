@@ -497,6 +497,7 @@ spl::shared_ptr<core::frame_producer> create_producer(const core::frame_producer
 			get_source_framerate,
 			target_framerate,
 			dependencies.format_desc.field_mode,
-			dependencies.format_desc.audio_cadence));
+			dependencies.format_desc.audio_cadence,
+			dependencies.frame_factory));
 }
 }}
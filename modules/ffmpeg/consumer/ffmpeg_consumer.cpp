@@ -1185,6 +1185,7 @@ struct ffmpeg_consumer_proxy : public core::frame_consumer
 	const bool							mono_streams_;
 	const bool							compatibility_mode_;
 	int									consumer_index_offset_;
+	bool								freewheel_				= false;
 
 	std::unique_ptr<ffmpeg_consumer>	consumer_;
 	std::unique_ptr<ffmpeg_consumer>	key_only_consumer_;
@@ -1220,6 +1221,11 @@ public:
 		}
 	}
 
+	void freewheel(bool enabled) override
+	{
+		freewheel_ = enabled;
+	}
+
 	int64_t presentation_frame_age_millis() const override
 	{
 		return consumer_ ? static_cast<int64_t>(consumer_->presentation_frame_age_millis()) : 0;
@@ -1227,10 +1233,14 @@ public:
 
 	std::future<bool> send(core::const_frame frame) override
 	{
+		// When freewheeling, send() blocks until the encoders are ready,
+		// which paces the channel instead of dropping frames.
 		bool ready_for_frame = consumer_->ready_for_frame();
 
 		if (ready_for_frame && separate_key_)
-			ready_for_frame = ready_for_frame && key_only_consumer_->ready_for_frame();
+			ready_for_frame = key_only_consumer_->ready_for_frame();
+
+		ready_for_frame = ready_for_frame || freewheel_;
 
 		if (ready_for_frame)
 		{
@@ -43,6 +43,7 @@
 #include <core/producer/framerate/framerate_producer.h>
 #include <core/frame/frame_factory.h>
 
+#include <functional>
 #include <future>
 #include <queue>
 
@@ -93,9 +94,11 @@ struct ffmpeg_producer : public core::frame_producer_base
 	std::unique_ptr<video_decoder>						video_decoder_;
 	std::vector<std::unique_ptr<audio_decoder>>			audio_decoders_;
 	std::unique_ptr<frame_muxer>						muxer_;
+	std::function<std::unique_ptr<frame_muxer>()>		create_muxer_;
 
 	const boost::rational<int>							framerate_;
 	const bool											thumbnail_mode_;
+	const bool											freewheel_;
 
 	core::draw_frame									last_frame_;
 
@@ -103,6 +106,7 @@ struct ffmpeg_producer : public core::frame_producer_base
 
 	int64_t												frame_number_				= 0;
 	uint32_t											file_frame_number_			= 0;
+	bool												awaiting_seek_flush_		= false;
 public:
 	explicit ffmpeg_producer(
 			const spl::shared_ptr<core::frame_factory>& frame_factory,
@@ -114,13 +118,16 @@ public:
 			uint32_t out,
 			bool thumbnail_mode,
 			const std::wstring& custom_channel_order,
-			const ffmpeg_options& vid_params)
+			const ffmpeg_options& vid_params,
+			bool freewheel = false,
+			const cpu_affinity& affinity = cpu_affinity())
 		: filename_(url_or_file)
 		, frame_factory_(frame_factory)
 		, initial_logger_disabler_(temporary_enable_quiet_logging_for_thread(thumbnail_mode))
-		, input_(graph_, url_or_file, loop, in, out, thumbnail_mode, vid_params)
+		, input_(graph_, url_or_file, loop, in, out, thumbnail_mode, vid_params, affinity)
 		, framerate_(read_framerate(*input_.context(), format_desc.framerate))
 		, thumbnail_mode_(thumbnail_mode)
+		, freewheel_(freewheel)
 		, last_frame_(core::draw_frame::empty())
 	{
 		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
@@ -206,7 +213,11 @@ public:
 		if (!video_decoder_ && audio_decoders_.empty())
 			CASPAR_THROW_EXCEPTION(averror_stream_not_found() << msg_info("No streams found"));
 
-		muxer_.reset(new frame_muxer(framerate_, std::move(audio_input_pads), frame_factory, format_desc, channel_layout, filter, true));
+		create_muxer_ = [=]
+		{
+			return std::unique_ptr<frame_muxer>(new frame_muxer(framerate_, audio_input_pads, frame_factory, format_desc, channel_layout, filter, true));
+		};
+		muxer_ = create_muxer_();
 
 		if (auto nb_frames = file_nb_frames())
 		{
@@ -248,6 +259,25 @@ public:
 		for (int n = 0; n < 16 && frame_buffer_.size() < 2; ++n)
 			try_decode_frame();
 
+		// Without a deadline to meet, wait for the input instead of repeating
+		// the last frame, unless the input stalls.
+		if (freewheel_)
+		{
+			static const auto TIMEOUT = boost::chrono::seconds(5);
+			auto deadline = boost::chrono::steady_clock::now() + TIMEOUT;
+
+			while (frame_buffer_.empty() && !input_.eof())
+			{
+				if (!input_.wait_for_packet(deadline))
+				{
+					CASPAR_LOG(warning) << print() << L" Input stalled for " << TIMEOUT.count() << L" seconds. Repeating last frame.";
+					break;
+				}
+
+				try_decode_frame();
+			}
+		}
+
 		graph_->set_value("frame-time", frame_timer_.elapsed() * out_fps() *0.5);
 
 		if (frame_buffer_.empty())
@@ -307,43 +337,35 @@ public:
 
 	core::draw_frame render_specific_frame(uint32_t file_position)
 	{
-		// Some trial and error and undeterministic stuff here
-		static const int NUM_RETRIES = 32;
+		// In thumbnail mode the input seeks to the closest key frame at or
+		// before the requested position, so the first frame decoded after the
+		// seek is used instead of decoding forward to the exact frame. Frames
+		// decoded before the seek are skipped, see try_decode_frame().
+		static const auto TIMEOUT = boost::chrono::seconds(5);
 
 		if (file_position > 0) // Assume frames are requested in sequential order,
 			                   // therefore no seeking should be necessary for the first frame.
 		{
-			input_.seek(file_position > 1 ? file_position - 2: file_position).get();
-			boost::this_thread::sleep_for(boost::chrono::milliseconds(40));
+			while (!frame_buffer_.empty())
+				frame_buffer_.pop();
+
+			awaiting_seek_flush_ = true;
+			input_.seek(file_position).get();
 		}
 
-		for (int i = 0; i < NUM_RETRIES; ++i)
-		{
-			boost::this_thread::sleep_for(boost::chrono::milliseconds(40));
+		auto deadline = boost::chrono::steady_clock::now() + TIMEOUT;
 
+		while (boost::chrono::steady_clock::now() < deadline)
+		{
 			auto frame = render_frame();
 
 			if (frame.second == std::numeric_limits<uint32_t>::max())
 			{
-				// Retry
-				continue;
+				if (input_.eof() || !input_.wait_for_packet(deadline))
+					break;
 			}
-			else if (frame.second == file_position + 1 || frame.second == file_position)
+			else if (!awaiting_seek_flush_)
 				return frame.first;
-			else if (frame.second > file_position + 1)
-			{
-				CASPAR_LOG(trace) << print() << L" " << frame.second << L" received, wanted " << file_position + 1;
-				int64_t adjusted_seek = file_position - (frame.second - file_position + 1);
-
-				if (adjusted_seek > 1 && file_position > 0)
-				{
-					CASPAR_LOG(trace) << print() << L" adjusting to " << adjusted_seek;
-					input_.seek(static_cast<uint32_t>(adjusted_seek) - 1).get();
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(40));
-				}
-				else
-					return frame.first;
-			}
 		}
 
 		CASPAR_LOG(trace) << print() << " Giving up finding frame at " << file_position;
@@ -585,6 +607,20 @@ public:
 			}
 		});
 
+		if (video == flush_video() && awaiting_seek_flush_)
+		{
+			// A thumbnail seek has gone through the decoder. Start over with a
+			// new muxer, since the old one may still hold frames or fields from
+			// before the seek, for example in its deinterlacing filter.
+			muxer_ = create_muxer_();
+			video = nullptr;
+
+			while (!frame_buffer_.empty())
+				frame_buffer_.pop();
+
+			awaiting_seek_flush_ = false;
+		}
+
 		muxer_->push(video);
 		muxer_->push(audio);
 
@@ -728,7 +764,9 @@ spl::shared_ptr<core::frame_producer> create_producer(
 			out,
 			false,
 			custom_channel_order,
-			vid_params);
+			vid_params,
+			dependencies.freewheel,
+			dependencies.affinity);
 
 	if (producer->audio_only())
 		return core::create_destroy_proxy(producer);
@@ -741,7 +779,8 @@ spl::shared_ptr<core::frame_producer> create_producer(
 			get_source_framerate,
 			target_framerate,
 			dependencies.format_desc.field_mode,
-			dependencies.format_desc.audio_cadence));
+			dependencies.format_desc.audio_cadence,
+			dependencies.frame_factory));
 }
 
 core::draw_frame create_thumbnail_frame(
@@ -758,7 +797,16 @@ core::draw_frame create_thumbnail_frame(
 	auto loop		= false;
 	auto in			= 0;
 	auto out		= std::numeric_limits<uint32_t>::max();
-	auto filter_str = L"";
+	auto grid		= std::max(1, env::properties().get(L"configuration.thumbnails.video-grid", 2));
+	auto width		= env::properties().get(L"configuration.thumbnails.width", 256);
+	auto height		= env::properties().get(L"configuration.thumbnails.height", 144);
+
+	// Scale down to the size of a grid cell already in the filter graph so
+	// that the mixer never sees full resolution frames.
+	auto filter_str	=
+			L"SCALE=" + boost::lexical_cast<std::wstring>(std::max(2, width / grid))
+			+ L":" + boost::lexical_cast<std::wstring>(std::max(2, height / grid))
+			+ L":interl=-1";
 
 	ffmpeg_options vid_params;
 	auto producer = spl::make_shared<ffmpeg_producer>(
@@ -0,0 +1,338 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "../../StdAfx.h"
+
+#include "field_filter.h"
+
+#include <core/frame/frame_factory.h>
+#include <core/frame/pixel_format.h>
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace caspar { namespace ffmpeg {
+
+namespace {
+
+inline __m128i abs_diff(__m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+inline std::uint8_t average(std::uint8_t a, std::uint8_t b)
+{
+	return static_cast<std::uint8_t>((a + b + 1) >> 1);
+}
+
+// Edge based line average. Interpolates between the two neighbouring lines in
+// the direction (vertical or one of the two diagonals) where they differ the
+// least, so that diagonal edges do not get jagged. stride is the distance in
+// bytes between two samples of the same component.
+void interpolate_line(const std::uint8_t* above, const std::uint8_t* below, std::uint8_t* dest, int linesize, int stride)
+{
+	auto scalar = [&](int x)
+	{
+		if (x < stride || x + stride >= linesize)
+		{
+			dest[x] = average(above[x], below[x]);
+			return;
+		}
+
+		int vertical	= std::abs(above[x] - below[x]);
+		int left		= std::abs(above[x - stride] - below[x + stride]);
+		int right		= std::abs(above[x + stride] - below[x - stride]);
+
+		if (vertical <= left && vertical <= right)
+			dest[x] = average(above[x], below[x]);
+		else if (left <= right)
+			dest[x] = average(above[x - stride], below[x + stride]);
+		else
+			dest[x] = average(above[x + stride], below[x - stride]);
+	};
+
+	int x = 0;
+
+	for (; x < std::min(stride, linesize); ++x)
+		scalar(x);
+
+	for (; x + 16 + stride <= linesize; x += 16)
+	{
+		auto a		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+		auto b		= _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+		auto a_left	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - stride));
+		auto b_left	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - stride));
+		auto a_right	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + stride));
+		auto b_right	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + stride));
+
+		auto vertical	= abs_diff(a, b);
+		auto left		= abs_diff(a_left, b_right);
+		auto right		= abs_diff(a_right, b_left);
+		auto least		= _mm_min_epu8(vertical, _mm_min_epu8(left, right));
+
+		auto use_vertical	= _mm_cmpeq_epi8(vertical, least);
+		auto use_left		= _mm_andnot_si128(use_vertical, _mm_cmpeq_epi8(left, least));
+		auto use_right		= _mm_andnot_si128(_mm_or_si128(use_vertical, use_left), _mm_set1_epi8(-1));
+
+		auto result = _mm_or_si128(
+				_mm_and_si128(use_vertical, _mm_avg_epu8(a, b)),
+				_mm_or_si128(
+						_mm_and_si128(use_left, _mm_avg_epu8(a_left, b_right)),
+						_mm_and_si128(use_right, _mm_avg_epu8(a_right, b_left))));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), result);
+	}
+
+	for (; x < linesize; ++x)
+		scalar(x);
+}
+
+// Replaces the lines of the given parity in dest by interpolating the lines of
+// the other parity in source. source and dest may be the same plane.
+void interpolate_field(const std::uint8_t* source, std::uint8_t* dest, const core::pixel_format_desc::plane& plane, int parity)
+{
+	int num_lines = (plane.height - parity + 1) / 2;
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, num_lines, 16), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int i = r.begin(); i != r.end(); ++i)
+		{
+			int y		= parity + i * 2;
+			int y_above	= y > 0 ? y - 1 : y + 1;
+			int y_below	= y + 1 < plane.height ? y + 1 : y_above;
+
+			if (y_above >= plane.height)
+			{
+				std::memmove(dest + y * plane.linesize, source + y * plane.linesize, plane.linesize);
+				continue;
+			}
+
+			interpolate_line(
+					source + y_above * plane.linesize,
+					source + y_below * plane.linesize,
+					dest + y * plane.linesize,
+					plane.linesize,
+					plane.stride);
+		}
+	});
+}
+
+void copy_field(const std::uint8_t* source, std::uint8_t* dest, const core::pixel_format_desc::plane& plane, int parity)
+{
+	for (int y = parity; y < plane.height; y += 2)
+		std::memcpy(dest + y * plane.linesize, source + y * plane.linesize, plane.linesize);
+}
+
+std::vector<std::uint8_t> black_pixel(core::pixel_format format, int plane_index, int stride)
+{
+	std::vector<std::uint8_t> pixel(stride, 0);
+
+	switch (format)
+	{
+	case core::pixel_format::ycbcr:
+	case core::pixel_format::ycbcra:
+		pixel.assign(stride, plane_index == 0 ? 16 : plane_index == 3 ? 255 : 128);
+		break;
+	case core::pixel_format::bgra:
+	case core::pixel_format::rgba:
+		pixel.back() = 255;
+		break;
+	case core::pixel_format::argb:
+	case core::pixel_format::abgr:
+		pixel.front() = 255;
+		break;
+	default:
+		break;
+	}
+
+	return pixel;
+}
+
+void fill_black(std::uint8_t* dest, int num_lines, const core::pixel_format_desc& desc, int plane_index)
+{
+	if (num_lines < 1)
+		return;
+
+	auto& plane	= desc.planes.at(plane_index);
+	auto pixel	= black_pixel(desc.format, plane_index, plane.stride);
+
+	for (int x = 0; x < plane.linesize; x += plane.stride)
+		std::memcpy(dest + x, pixel.data(), plane.stride);
+
+	for (int y = 1; y < num_lines; ++y)
+		std::memcpy(dest + y * plane.linesize, dest, plane.linesize);
+}
+
+}
+
+struct field_filter::impl
+{
+	const void*								tag_;
+	spl::shared_ptr<core::frame_factory>	frame_factory_;
+	core::audio_channel_layout				channel_layout_;
+	bool									deinterlace_bob_;
+	bool									shift_down_one_line_;
+	int										pad_to_height_;
+
+	impl(
+			const void* tag,
+			spl::shared_ptr<core::frame_factory> frame_factory,
+			const core::audio_channel_layout& channel_layout,
+			bool deinterlace_bob,
+			bool shift_down_one_line,
+			int pad_to_height)
+		: tag_(tag)
+		, frame_factory_(std::move(frame_factory))
+		, channel_layout_(channel_layout)
+		, deinterlace_bob_(deinterlace_bob)
+		, shift_down_one_line_(shift_down_one_line)
+		, pad_to_height_(pad_to_height)
+	{
+	}
+
+	std::vector<core::mutable_frame> apply(core::mutable_frame frame, core::field_mode field_mode)
+	{
+		std::vector<core::mutable_frame> result;
+
+		if (frame.pixel_format_desc().planes.empty())
+		{
+			result.push_back(std::move(frame));
+			return result;
+		}
+
+		if (deinterlace_bob_)
+		{
+			auto second = bob(frame, field_mode);
+
+			result.push_back(pad(std::move(frame)));
+			result.push_back(pad(std::move(second)));
+		}
+		else
+		{
+			if (shift_down_one_line_)
+				shift_down(frame);
+
+			result.push_back(pad(std::move(frame)));
+		}
+
+		return result;
+	}
+
+	// Turns frame into the first field and returns the second field.
+	core::mutable_frame bob(core::mutable_frame& frame, core::field_mode field_mode)
+	{
+		auto& desc			= frame.pixel_format_desc();
+		auto second			= frame_factory_->create_frame(tag_, desc, channel_layout_);
+		int first_parity	= field_mode == core::field_mode::lower ? 1 : 0;
+		int second_parity	= 1 - first_parity;
+
+		for (int n = 0; n < static_cast<int>(desc.planes.size()); ++n)
+		{
+			auto& plane		= desc.planes[n];
+			auto source		= frame.image_data(n).begin();
+			auto dest		= second.image_data(n).begin();
+
+			// The second field has to be taken out before its lines are
+			// overwritten when interpolating the first field in place.
+			copy_field(source, dest, plane, second_parity);
+			interpolate_field(source, dest, plane, first_parity);
+			interpolate_field(source, source, plane, second_parity);
+		}
+
+		return second;
+	}
+
+	void shift_down(core::mutable_frame& frame)
+	{
+		auto& desc = frame.pixel_format_desc();
+
+		// Like avfilter, do not move subsampled chroma half a chroma line.
+		for (auto& plane : desc.planes)
+		{
+			if (plane.height != desc.planes.at(0).height)
+				return;
+		}
+
+		for (int n = 0; n < static_cast<int>(desc.planes.size()); ++n)
+		{
+			auto& plane	= desc.planes[n];
+			auto data	= frame.image_data(n).begin();
+
+			std::memmove(data + plane.linesize, data, plane.linesize * (plane.height - 1));
+			fill_black(data, 1, desc, n);
+		}
+	}
+
+	// Pads with two black lines on top, which is where the 480 lines of NTSC
+	// DV belong in a 486 line frame, and the rest at the bottom.
+	core::mutable_frame pad(core::mutable_frame frame)
+	{
+		auto& desc	= frame.pixel_format_desc();
+		int height	= desc.planes.at(0).height;
+
+		if (pad_to_height_ <= height)
+			return std::move(frame);
+
+		core::pixel_format_desc padded_desc(desc.format);
+
+		for (auto& plane : desc.planes)
+			padded_desc.planes.push_back(core::pixel_format_desc::plane(plane.width, plane.height * pad_to_height_ / height, plane.stride));
+
+		auto padded = frame_factory_->create_frame(tag_, padded_desc, channel_layout_);
+
+		for (int n = 0; n < static_cast<int>(desc.planes.size()); ++n)
+		{
+			auto& plane			= desc.planes[n];
+			auto& padded_plane	= padded_desc.planes[n];
+			int top				= 2 * plane.height / height;
+			int bottom			= padded_plane.height - plane.height - top;
+			auto dest			= padded.image_data(n).begin();
+
+			fill_black(dest, top, padded_desc, n);
+			std::memcpy(dest + top * plane.linesize, frame.image_data(n).begin(), plane.size);
+			fill_black(dest + (top + plane.height) * plane.linesize, bottom, padded_desc, n);
+		}
+
+		return std::move(padded);
+	}
+};
+
+field_filter::field_filter(
+		const void* tag,
+		spl::shared_ptr<core::frame_factory> frame_factory,
+		const core::audio_channel_layout& channel_layout,
+		bool deinterlace_bob,
+		bool shift_down_one_line,
+		int pad_to_height)
+	: impl_(new impl(tag, std::move(frame_factory), channel_layout, deinterlace_bob, shift_down_one_line, pad_to_height))
+{
+}
+
+std::vector<core::mutable_frame> field_filter::apply(core::mutable_frame frame, core::field_mode field_mode) { return impl_->apply(std::move(frame), field_mode); }
+bool field_filter::is_double_rate() const { return impl_->deinterlace_bob_; }
+
+}}
@@ -0,0 +1,77 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <common/memory.h>
+
+#include <core/frame/frame.h>
+#include <core/frame/audio_channel_layout.h>
+#include <core/video_format.h>
+#include <core/fwd.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace caspar { namespace ffmpeg {
+
+/**
+ * Does the field conversions needed between the decoded frames and the
+ * channel directly on the planes of the decoded frames, instead of via an
+ * avfilter graph:
+ *
+ * - Bob deinterlacing into one frame per field (double rate), interpolating
+ *   the missing lines with an edge directed line average.
+ * - Moving a lower field first frame down one line to become upper field
+ *   first.
+ * - Padding NTSC DV (480 lines) to 486 lines.
+ *
+ * The kernels are SSE2 and are run in parallel over slices of lines.
+ */
+class field_filter : boost::noncopyable
+{
+public:
+	field_filter(
+			const void* tag,
+			spl::shared_ptr<core::frame_factory> frame_factory,
+			const core::audio_channel_layout& channel_layout,
+			bool deinterlace_bob,
+			bool shift_down_one_line,
+			int pad_to_height);
+
+	/**
+	 * Applies the conversions to a decoded frame.
+	 *
+	 * @param frame      The frame, which is modified in place when possible.
+	 * @param field_mode The field order of the frame.
+	 *
+	 * @return The resulting frames, two when deinterlacing, otherwise one.
+	 */
+	std::vector<core::mutable_frame> apply(core::mutable_frame frame, core::field_mode field_mode);
+
+	bool is_double_rate() const;
+private:
+	struct impl;
+	spl::shared_ptr<impl> impl_;
+};
+
+}}
@@ -29,8 +29,10 @@
 #include "../../ffmpeg.h"
 
 #include <core/video_format.h>
+#include <core/diagnostics/call_context.h>
 
 #include <common/diagnostics/graph.h>
+#include <common/diagnostics/memory_accounting.h>
 #include <common/executor.h>
 #include <common/except.h>
 #include <common/os/general_protection_fault.h>
@@ -41,6 +43,10 @@
 #include <tbb/atomic.h>
 #include <tbb/recursive_mutex.h>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
 #if defined(_MSC_VER)
 #pragma warning (push)
 #pragma warning (disable : 4244)
@@ -77,14 +83,22 @@ struct input::impl : boost::noncopyable
 
 	tbb::concurrent_bounded_queue<std::shared_ptr<AVPacket>>	buffer_;
 	tbb::atomic<size_t>											buffer_size_;
+	diagnostics::memory_account									memory_;
+
+	boost::mutex												packet_mutex_;
+	boost::condition_variable									packet_available_;
 
 	executor													executor_;
 
-	explicit impl(const spl::shared_ptr<diagnostics::graph> graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params)
+	explicit impl(const spl::shared_ptr<diagnostics::graph> graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params, const cpu_affinity& affinity)
 		: graph_(graph)
 		, format_context_(open_input(url_or_file, vid_params))
 		, filename_(url_or_file)
 		, thumbnail_mode_(thumbnail_mode)
+		, memory_(
+				L"ffmpeg-input",
+				core::diagnostics::call_context::for_thread().video_channel,
+				core::diagnostics::call_context::for_thread().layer)
 		, executor_(print())
 	{
 		if (thumbnail_mode_)
@@ -93,6 +107,14 @@ struct input::impl : boost::noncopyable
 				enable_quiet_logging_for_thread();
 			});
 
+		// Read on the processors of the channel fed, so the packets are
+		// allocated in the memory of its NUMA node.
+		if (!affinity.empty())
+			executor_.invoke([&]
+			{
+				affinity.bind_current_thread();
+			});
+
 		in_				= in;
 		out_			= out;
 		loop_			= loop;
@@ -115,7 +137,10 @@ struct input::impl : boost::noncopyable
 		if(result)
 		{
 			if(packet)
+			{
 				buffer_size_ -= packet->size;
+				memory_.subtract(packet->size);
+			}
 			tick();
 		}
 
@@ -125,6 +150,23 @@ struct input::impl : boost::noncopyable
 		return result;
 	}
 
+	bool wait_for_packet(boost::chrono::steady_clock::time_point deadline)
+	{
+		boost::unique_lock<boost::mutex> lock(packet_mutex_);
+
+		return packet_available_.wait_until(lock, deadline, [this]
+		{
+			return !buffer_.empty() || !executor_.is_running();
+		});
+	}
+
+	void notify_packet_available()
+	{
+		boost::lock_guard<boost::mutex> lock(packet_mutex_);
+
+		packet_available_.notify_all();
+	}
+
 	std::ptrdiff_t get_max_buffer_count() const
 	{
 		return thumbnail_mode_ ? 1 : MAX_BUFFER_COUNT;
@@ -144,7 +186,10 @@ struct input::impl : boost::noncopyable
 		{
 			std::shared_ptr<AVPacket> packet;
 			while(buffer_.try_pop(packet) && packet)
+			{
 				buffer_size_ -= packet->size;
+				memory_.subtract(packet->size);
+			}
 
 			queued_seek(target);
 
@@ -161,7 +206,8 @@ struct input::impl : boost::noncopyable
 
 	bool full() const
 	{
-		return (buffer_size_ > MAX_BUFFER_SIZE || buffer_.size() > get_max_buffer_count()) && buffer_.size() > get_min_buffer_count();
+		// Over the memory budget only the minimum is prefetched.
+		return (buffer_size_ > MAX_BUFFER_SIZE || buffer_.size() > get_max_buffer_count() || memory_.over_budget()) && buffer_.size() > get_min_buffer_count();
 	}
 
 	void tick()
@@ -224,6 +270,7 @@ struct input::impl : boost::noncopyable
 
 					buffer_.try_push(packet);
 					buffer_size_ += packet->size;
+					memory_.add(packet->size);
 
 					graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/MAX_BUFFER_SIZE);
 					graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
@@ -237,6 +284,8 @@ struct input::impl : boost::noncopyable
 					CASPAR_LOG_CURRENT_EXCEPTION();
 				executor_.stop();
 			}
+
+			notify_packet_available();
 		});
 	}
 
@@ -337,13 +386,16 @@ struct input::impl : boost::noncopyable
 		auto stream = format_context_->streams[default_stream_index_];
 
 		auto fps = read_fps(*format_context_, 0.0);
+		auto target_timestamp = static_cast<int64_t>((target / fps * stream->time_base.den) / stream->time_base.num);
 
+		// Thumbnails only need a representative frame, so land on the closest
+		// key frame at or before the target instead of anywhere near it.
 		THROW_ON_ERROR2(avformat_seek_file(
 			format_context_.get(),
 			default_stream_index_,
 			std::numeric_limits<int64_t>::min(),
-			static_cast<int64_t>((target / fps * stream->time_base.den) / stream->time_base.num),
-			std::numeric_limits<int64_t>::max(),
+			target_timestamp,
+			thumbnail_mode_ ? target_timestamp : std::numeric_limits<int64_t>::max(),
 			0), print());
 
 		file_frame_number_ = target;
@@ -372,10 +424,11 @@ struct input::impl : boost::noncopyable
 	}
 };
 
-input::input(const spl::shared_ptr<diagnostics::graph>& graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params)
-	: impl_(new impl(graph, url_or_file, loop, in, out, thumbnail_mode, vid_params)){}
+input::input(const spl::shared_ptr<diagnostics::graph>& graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params, const cpu_affinity& affinity)
+	: impl_(new impl(graph, url_or_file, loop, in, out, thumbnail_mode, vid_params, affinity)){}
 bool input::eof() const {return !impl_->executor_.is_running();}
 bool input::try_pop(std::shared_ptr<AVPacket>& packet){return impl_->try_pop(packet);}
+bool input::wait_for_packet(boost::chrono::steady_clock::time_point deadline){return impl_->wait_for_packet(deadline);}
 spl::shared_ptr<AVFormatContext> input::context(){return impl_->format_context_;}
 void input::in(uint32_t value){impl_->in_ = value;}
 uint32_t input::in() const{return impl_->in_;}
@@ -23,6 +23,7 @@
 
 #include "../util/util.h"
 
+#include <common/cpu_affinity.h>
 #include <common/memory.h>
 
 #include <memory>
@@ -30,6 +31,7 @@
 #include <cstdint>
 #include <future>
 
+#include <boost/chrono/system_clocks.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/rational.hpp>
 
@@ -49,11 +51,19 @@ namespace ffmpeg {
 class input : boost::noncopyable
 {
 public:
-	explicit input(const spl::shared_ptr<diagnostics::graph>& graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params);
+	explicit input(const spl::shared_ptr<diagnostics::graph>& graph, const std::wstring& url_or_file, bool loop, uint32_t in, uint32_t out, bool thumbnail_mode, const ffmpeg_options& vid_params, const cpu_affinity& affinity = cpu_affinity());
 
 	bool								try_pop(std::shared_ptr<AVPacket>& packet);
 	bool								eof() const;
 
+	/**
+	 * Waits until a packet can be popped, the end of the input is reached
+	 * or the deadline has passed.
+	 *
+	 * @return false if the deadline passed first.
+	 */
+	bool								wait_for_packet(boost::chrono::steady_clock::time_point deadline);
+
 	void								in(uint32_t value);
 	uint32_t							in() const;
 	void								out(uint32_t value);
@@ -24,6 +24,7 @@
 #include "frame_muxer.h"
 
 #include "../filter/filter.h"
+#include "../filter/field_filter.h"
 #include "../filter/audio_filter.h"
 #include "../util/util.h"
 #include "../../ffmpeg.h"
@@ -35,10 +36,12 @@
 #include <core/frame/frame_factory.h>
 #include <core/frame/frame.h>
 #include <core/frame/audio_channel_layout.h>
+#include <core/diagnostics/call_context.h>
 
 #include <common/env.h>
 #include <common/except.h>
 #include <common/log.h>
+#include <common/diagnostics/memory_accounting.h>
 
 #if defined(_MSC_VER)
 #pragma warning (push)
@@ -144,6 +147,7 @@ struct frame_muxer::impl : boost::noncopyable
 	boost::optional<av_frame_format>				previously_filtered_frame_;
 
 	std::unique_ptr<filter>							filter_;
+	std::unique_ptr<field_filter>					field_filter_;
 	const std::wstring								filter_str_;
 	std::unique_ptr<audio_filter>					audio_filter_;
 	const bool										multithreaded_filter_;
@@ -152,6 +156,8 @@ struct frame_muxer::impl : boost::noncopyable
 	mutable boost::mutex							out_framerate_mutex_;
 	boost::rational<int>							out_framerate_;
 
+	caspar::diagnostics::memory_account				memory_;
+
 	impl(
 			boost::rational<int> in_framerate,
 			std::vector<audio_input_pad> audio_input_pads,
@@ -168,6 +174,10 @@ struct frame_muxer::impl : boost::noncopyable
 		, filter_str_(filter_str)
 		, multithreaded_filter_(multithreaded_filter)
 		, force_deinterlacing_(force_deinterlacing)
+		, memory_(
+				L"frame-muxer",
+				core::diagnostics::call_context::for_thread().video_channel,
+				core::diagnostics::call_context::for_thread().layer)
 	{
 		video_streams_.push(std::queue<core::mutable_frame>());
 		audio_streams_.push(core::mutable_audio_buffer());
@@ -197,6 +207,7 @@ struct frame_muxer::impl : boost::noncopyable
 
 			display_mode_ = display_mode::invalid;
 			filter_.reset();
+			field_filter_.reset();
 			previously_filtered_frame_ = boost::none;
 		}
 
@@ -206,21 +217,30 @@ struct frame_muxer::impl : boost::noncopyable
 		}
 		else if (video_frame == empty_video())
 		{
-			video_streams_.back().push(frame_factory_->create_frame(this, core::pixel_format::invalid, audio_channel_layout_));
+			push_video(frame_factory_->create_frame(this, core::pixel_format::invalid, audio_channel_layout_));
 			display_mode_ = display_mode::simple;
 		}
 		else
 		{
-			if (!filter_ || display_mode_ == display_mode::invalid)
+			if ((!filter_ && !field_filter_) || display_mode_ == display_mode::invalid)
 				update_display_mode(video_frame);
 
-			if (filter_)
+			if (field_filter_)
+			{
+				previously_filtered_frame_ = current_frame_format;
+
+				auto frame = make_frame(this, spl::make_shared_ptr(video_frame), *frame_factory_, audio_channel_layout_);
+
+				for (auto& field : field_filter_->apply(std::move(frame), get_mode(*video_frame)))
+					push_video(std::move(field));
+			}
+			else if (filter_)
 			{
 				filter_->push(video_frame);
 				previously_filtered_frame_ = current_frame_format;
 
 				for (auto& av_frame : filter_->poll_all())
-					video_streams_.back().push(make_frame(this, av_frame, *frame_factory_, audio_channel_layout_));
+					push_video(make_frame(this, av_frame, *frame_factory_, audio_channel_layout_));
 			}
 		}
 
@@ -302,7 +322,10 @@ struct frame_muxer::impl : boost::noncopyable
 		if (video_streams_.size() > 1 && audio_streams_.size() > 1 && (!video_ready2() || !audio_ready2()))
 		{
 			if (!video_streams_.front().empty() || !audio_streams_.front().empty())
-				CASPAR_LOG(trace) << "Truncating: " << video_streams_.front().size() << L" video-frames, " << audio_streams_.front().size() << L" audio-samples.";
+				CASPAR_LOG_RATE_LIMITED(trace) << "Truncating: " << video_streams_.front().size() << L" video-frames, " << audio_streams_.front().size() << L" audio-samples.";
+
+			while (!video_streams_.front().empty())
+				pop_video();
 
 			video_streams_.pop();
 			audio_streams_.pop();
@@ -319,13 +342,30 @@ struct frame_muxer::impl : boost::noncopyable
 		return poll();
 	}
 
+	void push_video(core::mutable_frame frame)
+	{
+		memory_.add(size_of(frame));
+		video_streams_.back().push(std::move(frame));
+	}
+
 	core::mutable_frame pop_video()
 	{
 		auto frame = std::move(video_streams_.front().front());
 		video_streams_.front().pop();
+		memory_.subtract(size_of(frame));
 		return frame;
 	}
 
+	static std::int64_t size_of(const core::mutable_frame& frame)
+	{
+		std::int64_t size = 0;
+
+		for (std::size_t plane = 0; plane < frame.pixel_format_desc().planes.size(); ++plane)
+			size += frame.image_data(plane).size();
+
+		return size;
+	}
+
 	core::mutable_audio_buffer pop_audio()
 	{
 		CASPAR_VERIFY(audio_streams_.front().size() >= audio_cadence_.front() * audio_channel_layout_.num_channels);
@@ -347,6 +387,8 @@ struct frame_muxer::impl : boost::noncopyable
 
 		if(filter_ && filter_->is_double_rate()) // Take into account transformations in filter.
 			nb_frames2 *= 2;
+		else if (field_filter_ && field_filter_->is_double_rate())
+			nb_frames2 *= 2;
 
 		return static_cast<uint32_t>(nb_frames2);
 	}
@@ -360,8 +402,6 @@ struct frame_muxer::impl : boost::noncopyable
 private:
 	void update_display_mode(const std::shared_ptr<AVFrame>& frame)
 	{
- 		std::wstring filter_str = filter_str_;
-
 		display_mode_ = display_mode::simple;
 
 		auto mode = get_mode(*frame);
@@ -391,14 +431,51 @@ private:
 			}
 		}
 
+		if (filter_str_.empty())
+			update_field_filter(*frame, mode);
+		else
+			update_filter(*frame, mode);
+
+		auto in_fps = static_cast<double>(in_framerate_.numerator()) / static_cast<double>(in_framerate_.denominator());
+
+		if (ffmpeg::is_logging_quiet_for_thread())
+			CASPAR_LOG(debug) << L"[frame_muxer] " << display_mode_ << L" " << print_mode(frame->width, frame->height, in_fps, frame->interlaced_frame > 0);
+		else
+			CASPAR_LOG(info) << L"[frame_muxer] " << display_mode_ << L" " << print_mode(frame->width, frame->height, in_fps, frame->interlaced_frame > 0);
+	}
+
+	// Without a user supplied filter the conversions needed for the channel
+	// are done on the decoded planes instead of via an avfilter graph.
+	void update_field_filter(const AVFrame& frame, core::field_mode mode)
+	{
+		bool deinterlace_bob		= display_mode_ == display_mode::deinterlace_bob;
+		bool shift_down_one_line	= !deinterlace_bob && mode == core::field_mode::lower && format_desc_.field_mode == core::field_mode::upper;
+		int pad_to_height			= frame.height == 480 ? 486 : 0; // NTSC DV
+
+		filter_.reset();
+		field_filter_.reset(new field_filter(
+				this,
+				frame_factory_,
+				audio_channel_layout_,
+				deinterlace_bob,
+				shift_down_one_line,
+				pad_to_height));
+
+		set_out_framerate(deinterlace_bob ? in_framerate_ * 2 : in_framerate_);
+	}
+
+	void update_filter(const AVFrame& frame, core::field_mode mode)
+	{
+		std::wstring filter_str = filter_str_;
+
 		if (display_mode_ == display_mode::deinterlace_bob)
 			filter_str = append_filter(filter_str, L"YADIF=1:-1");
 		else
 		{
 			if (mode == core::field_mode::lower && format_desc_.field_mode == core::field_mode::upper)
 			{
-				filter_str = append_filter(filter_str, L"CROP=h=" + boost::lexical_cast<std::wstring>(frame->height - 1) + L":y=0");
-				filter_str = append_filter(filter_str, L"PAD=0:" + boost::lexical_cast<std::wstring>(frame->height) + L":0:1:black");
+				filter_str = append_filter(filter_str, L"CROP=h=" + boost::lexical_cast<std::wstring>(frame.height - 1) + L":y=0");
+				filter_str = append_filter(filter_str, L"PAD=0:" + boost::lexical_cast<std::wstring>(frame.height) + L":0:1:black");
 				filter_str = append_filter(filter_str, L"SETFIELD=tff");
 			}
 			else if (mode == core::field_mode::upper && format_desc_.field_mode == core::field_mode::lower)
@@ -413,30 +490,24 @@ private:
 		if (filter::is_double_rate(filter_str))
 			out_framerate *= 2;
 
-		if (frame->height == 480) // NTSC DV
+		if (frame.height == 480) // NTSC DV
 		{
-			auto pad_str = L"PAD=" + boost::lexical_cast<std::wstring>(frame->width) + L":486:0:2:black";
+			auto pad_str = L"PAD=" + boost::lexical_cast<std::wstring>(frame.width) + L":486:0:2:black";
 			filter_str = append_filter(filter_str, pad_str);
 		}
 
+		field_filter_.reset();
 		filter_.reset (new filter(
-				frame->width,
-				frame->height,
+				frame.width,
+				frame.height,
 				1 / in_framerate_,
 				in_framerate_,
-				boost::rational<int>(frame->sample_aspect_ratio.num, frame->sample_aspect_ratio.den),
-				static_cast<AVPixelFormat>(frame->format),
+				boost::rational<int>(frame.sample_aspect_ratio.num, frame.sample_aspect_ratio.den),
+				static_cast<AVPixelFormat>(frame.format),
 				std::vector<AVPixelFormat>(),
 				u8(filter_str)));
 
 		set_out_framerate(out_framerate);
-
-		auto in_fps = static_cast<double>(in_framerate_.numerator()) / static_cast<double>(in_framerate_.denominator());
-
-		if (ffmpeg::is_logging_quiet_for_thread())
-			CASPAR_LOG(debug) << L"[frame_muxer] " << display_mode_ << L" " << print_mode(frame->width, frame->height, in_fps, frame->interlaced_frame > 0);
-		else
-			CASPAR_LOG(info) << L"[frame_muxer] " << display_mode_ << L" " << print_mode(frame->width, frame->height, in_fps, frame->interlaced_frame > 0);
 	}
 
 	void merge()
@@ -40,6 +40,7 @@
 #include <common/executor.h>
 #include <common/lock.h>
 #include <common/future.h>
+#include <common/cache_aligned_vector.h>
 #include <common/diagnostics/graph.h>
 #include <common/prec_timer.h>
 #include <common/linq.h>
@@ -62,7 +63,9 @@
 #include <cef_render_handler.h>
 #pragma warning(pop)
 
-#include <queue>
+#include <array>
+#include <cstring>
+#include <vector>
 
 #include "../html.h"
 
@@ -88,8 +91,27 @@ class html_client
 	tbb::concurrent_queue<std::wstring>		javascript_before_load_;
 	tbb::atomic<bool>						loaded_;
 	tbb::atomic<bool>						removed_;
-	std::queue<core::draw_frame>			frames_;
-	mutable boost::mutex					frames_mutex_;
+
+	// CEF paints into a ring of three buffers and the latest painted one is
+	// handed over to the executor by atomically swapping indices, so the UI
+	// thread never waits for the producer. Only the regions that have changed
+	// since a buffer was last painted into are copied to it.
+	struct paint_buffer
+	{
+		cache_aligned_vector<uint8_t>		pixels;
+		int									width	= 0;
+		int									height	= 0;
+	};
+
+	static const int						FRESH_PAINT = 0x100;
+
+	std::array<paint_buffer, 3>				paint_buffers_;
+	std::array<std::vector<CefRect>, 3>		stale_regions_;				// UI thread only
+	int										painting_			= 0;	// UI thread only
+	int										reading_			= 1;	// executor only
+	tbb::atomic<int>						latest_;
+	tbb::atomic<int64_t>					dropped_paints_;
+	tbb::atomic<int64_t>					late_paints_;
 
 	core::draw_frame						last_frame_;
 	core::draw_frame						last_progressive_frame_;
@@ -114,12 +136,16 @@ public:
 	{
 		graph_->set_color("browser-tick-time", diagnostics::color(0.1f, 1.0f, 0.1f));
 		graph_->set_color("tick-time", diagnostics::color(0.0f, 0.6f, 0.9f));
-		graph_->set_color("dropped-frame", diagnostics::color(0.3f, 0.6f, 0.3f));
+		graph_->set_color("dropped-paint", diagnostics::color(0.3f, 0.6f, 0.3f));
+		graph_->set_color("late-paint", diagnostics::color(0.6f, 0.3f, 0.3f));
 		graph_->set_text(print());
 		diagnostics::register_graph(graph_);
 
 		loaded_ = false;
 		removed_ = false;
+		latest_ = 2;
+		dropped_paints_ = 0;
+		late_paints_ = 0;
 		executor_.begin_invoke([&]{ update(); });
 	}
 
@@ -178,6 +204,16 @@ public:
 		return removed_;
 	}
 
+	int64_t num_dropped_paints() const
+	{
+		return dropped_paints_;
+	}
+
+	int64_t num_late_paints() const
+	{
+		return late_paints_;
+	}
+
 private:
 
 	bool GetViewRect(CefRefPtr<CefBrowser> browser, CefRect &rect)
@@ -203,25 +239,88 @@ private:
 		paint_timer_.restart();
 		CASPAR_ASSERT(CefCurrentlyOn(TID_UI));
 
-		core::pixel_format_desc pixel_desc;
-			pixel_desc.format = core::pixel_format::bgra;
-			pixel_desc.planes.push_back(
-				core::pixel_format_desc::plane(width, height, 4));
-		auto frame = frame_factory_->create_frame(this, pixel_desc, core::audio_channel_layout::invalid());
-		std::memcpy(frame.image_data().begin(), buffer, width * height * 4);
+		// Popups like the list of a <select> are painted separately and are
+		// not composited into the view.
+		if (type != PET_VIEW)
+			return;
+
+		auto& target	= paint_buffers_[painting_];
+		auto& stale		= stale_regions_[painting_];
 
-		lock(frames_mutex_, [&]
+		if (target.width != width || target.height != height)
 		{
-			frames_.push(core::draw_frame(std::move(frame)));
+			target.pixels.resize(width * height * 4);
+			target.width	= width;
+			target.height	= height;
+			stale.assign(1, CefRect(0, 0, width, height));
+		}
 
-			size_t max_in_queue = format_desc_.field_count + 1;
+		stale.insert(stale.end(), dirtyRects.begin(), dirtyRects.end());
 
-			while (frames_.size() > max_in_queue)
-			{
-				frames_.pop();
-				graph_->set_tag(diagnostics::tag_severity::WARNING, "dropped-frame");
-			}
-		});
+		for (auto& region : stale)
+			copy_region(static_cast<const uint8_t*>(buffer), target, region);
+
+		stale.clear();
+
+		for (int i = 0; i < static_cast<int>(stale_regions_.size()); ++i)
+		{
+			if (i != painting_)
+				add_stale_regions(stale_regions_[i], dirtyRects);
+		}
+
+		auto previous = latest_.fetch_and_store(painting_ | FRESH_PAINT);
+
+		if (previous & FRESH_PAINT)
+		{
+			++dropped_paints_;
+			graph_->set_tag(diagnostics::tag_severity::WARNING, "dropped-paint");
+		}
+
+		painting_ = previous & ~FRESH_PAINT;
+	}
+
+	static void copy_region(const uint8_t* source, paint_buffer& target, const CefRect& region)
+	{
+		int left	= std::max(region.x, 0);
+		int top		= std::max(region.y, 0);
+		int right	= std::min(region.x + region.width, target.width);
+		int bottom	= std::min(region.y + region.height, target.height);
+
+		if (left >= right)
+			return;
+
+		for (int y = top; y < bottom; ++y)
+		{
+			auto offset = (y * target.width + left) * 4;
+			std::memcpy(target.pixels.data() + offset, source + offset, (right - left) * 4);
+		}
+	}
+
+	static void add_stale_regions(std::vector<CefRect>& stale, const RectList& regions)
+	{
+		static const std::size_t MAX_STALE_REGIONS = 16;
+
+		stale.insert(stale.end(), regions.begin(), regions.end());
+
+		if (stale.size() <= MAX_STALE_REGIONS)
+			return;
+
+		// Copying the bounding box is cheaper than keeping track of many
+		// small regions.
+		int left	= stale.front().x;
+		int top		= stale.front().y;
+		int right	= stale.front().x + stale.front().width;
+		int bottom	= stale.front().y + stale.front().height;
+
+		for (auto& region : stale)
+		{
+			left	= std::min(left, region.x);
+			top		= std::min(top, region.y);
+			right	= std::max(right, region.x + region.width);
+			bottom	= std::max(bottom, region.y + region.height);
+		}
+
+		stale.assign(1, CefRect(left, top, right - left, bottom - top));
 	}
 
 	void OnAfterCreated(CefRefPtr<CefBrowser> browser) override
@@ -313,30 +412,23 @@ private:
 
 	bool try_pop(core::draw_frame& result)
 	{
-		return lock(frames_mutex_, [&]() -> bool
-		{
-			if (!frames_.empty())
-			{
-				result = std::move(frames_.front());
-				frames_.pop();
+		if (!(latest_ & FRESH_PAINT))
+			return false;
 
-				return true;
-			}
+		reading_ = latest_.fetch_and_store(reading_) & ~FRESH_PAINT;
 
-			return false;
-		});
-	}
+		auto& source = paint_buffers_[reading_];
 
-	core::draw_frame pop()
-	{
-		core::draw_frame frame;
+		core::pixel_format_desc pixel_desc;
+			pixel_desc.format = core::pixel_format::bgra;
+			pixel_desc.planes.push_back(
+				core::pixel_format_desc::plane(source.width, source.height, 4));
+		auto frame = frame_factory_->create_frame(this, pixel_desc, core::audio_channel_layout::invalid());
+		std::memcpy(frame.image_data().begin(), source.pixels.data(), source.pixels.size());
 
-		if (!try_pop(frame))
-		{
-			CASPAR_THROW_EXCEPTION(caspar_exception() << msg_info(u8(print()) + " No frame in buffer"));
-		}
+		result = core::draw_frame(std::move(frame));
 
-		return frame;
+		return true;
 	}
 
 	void update()
@@ -346,60 +438,53 @@ private:
 		prec_timer timer;
 		timer.tick(0.0);
 
-		auto num_frames = lock(frames_mutex_, [&]
-		{
-			return frames_.size();
-		});
+		core::draw_frame frame1;
 
-		if (num_frames >= format_desc_.field_count)
+		if (!try_pop(frame1))
 		{
 			if (format_desc_.field_mode != core::field_mode::progressive)
-			{
-				auto frame1 = pop();
+				lock(last_frame_mutex_, [&]
+				{
+					last_frame_ = last_progressive_frame_;
+				});
 
-				executor_.yield(caspar::task_priority::lowest_priority);
-				timer.tick(1.0 / (format_desc_.fps * format_desc_.field_count));
-				invoke_requested_animation_frames();
+			return;
+		}
 
-				auto frame2 = pop();
+		if (format_desc_.field_mode != core::field_mode::progressive)
+		{
+			executor_.yield(caspar::task_priority::lowest_priority);
+			timer.tick(1.0 / (format_desc_.fps * format_desc_.field_count));
+			invoke_requested_animation_frames();
+
+			core::draw_frame frame2;
 
+			if (try_pop(frame2))
+			{
 				lock(last_frame_mutex_, [&]
 				{
 					last_progressive_frame_ = frame2;
 					last_frame_ = core::draw_frame::interlace(frame1, frame2, format_desc_.field_mode);
 				});
 			}
-			else
-			{
-				auto frame = pop();
+			else // Not painted in time for the second field. Probably the
+			{    // last frame of some animation sequence.
+				++late_paints_;
+				graph_->set_tag(diagnostics::tag_severity::INFO, "late-paint");
 
 				lock(last_frame_mutex_, [&]
 				{
-					last_frame_ = frame;
+					last_progressive_frame_ = frame1;
+					last_frame_ = frame1;
 				});
 			}
 		}
-		else if (num_frames == 1) // Interlaced but only one frame
-		{                         // available. Probably the last frame
-		                          // of some animation sequence.
-			auto frame = pop();
-
+		else
+		{
 			lock(last_frame_mutex_, [&]
 			{
-				last_progressive_frame_ = frame;
-				last_frame_ = frame;
+				last_frame_ = frame1;
 			});
-
-			timer.tick(1.0 / (format_desc_.fps * format_desc_.field_count));
-			invoke_requested_animation_frames();
-		}
-		else
-		{
-			if (format_desc_.field_mode != core::field_mode::progressive)
-				lock(last_frame_mutex_, [&]
-				{
-					last_frame_ = last_progressive_frame_;
-				});
 		}
 	}
 
@@ -563,6 +648,13 @@ public:
 	{
 		boost::property_tree::wptree info;
 		info.add(L"type", L"html-producer");
+
+		if (client_)
+		{
+			info.add(L"dropped-paints", client_->num_dropped_paints());
+			info.add(L"late-paints", client_->num_late_paints());
+		}
+
 		return info;
 	}
 
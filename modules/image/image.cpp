@@ -25,6 +25,7 @@
 #include "producer/image_scroll_producer.h"
 #include "consumer/image_consumer.h"
 #include "util/image_loader.h"
+#include "util/image_cache.h"
 
 #include <core/producer/frame_producer.h>
 #include <core/consumer/frame_consumer.h>
@@ -73,6 +74,7 @@ void init(core::module_dependencies dependencies)
 
 void uninit()
 {
+	clear_image_cache();
 	FreeImage_DeInitialise();
 }
 
@@ -22,6 +22,7 @@
 #include "image_producer.h"
 
 #include "../util/image_loader.h"
+#include "../util/image_cache.h"
 
 #include <core/video_format.h>
 
@@ -41,6 +42,7 @@
 #include <common/array.h>
 #include <common/base64.h>
 #include <common/param.h>
+#include <common/future.h>
 #include <common/os/filesystem.h>
 
 #include <boost/filesystem.hpp>
@@ -52,27 +54,21 @@
 
 namespace caspar { namespace image {
 
-std::pair<core::draw_frame, core::constraints> load_image(
+core::mutable_frame create_frame(
 		const spl::shared_ptr<core::frame_factory>& frame_factory,
-		const std::wstring& filename)
+		const void* tag,
+		const decoded_image& image)
 {
-	auto bitmap = load_image(filename);
-	FreeImage_FlipVertical(bitmap.get());
+	if (std::max(image.width(), image.height()) > frame_factory->get_max_frame_size())
+		CASPAR_THROW_EXCEPTION(user_error() << msg_info("Image too large for texture"));
 
 	core::pixel_format_desc desc = core::pixel_format::bgra;
-	auto width = FreeImage_GetWidth(bitmap.get());
-	auto height = FreeImage_GetHeight(bitmap.get());
-	desc.planes.push_back(core::pixel_format_desc::plane(width, height, 4));
-	auto frame = frame_factory->create_frame(bitmap.get(), desc, core::audio_channel_layout::invalid());
-
-	std::copy_n(
-			FreeImage_GetBits(bitmap.get()),
-			frame.image_data(0).size(),
-			frame.image_data(0).begin());
-
-	return std::make_pair(
-			core::draw_frame(std::move(frame)),
-			core::constraints(width, height));
+	desc.planes.push_back(core::pixel_format_desc::plane(image.width(), image.height(), 4));
+	auto frame = frame_factory->create_frame(tag, desc, core::audio_channel_layout::invalid());
+
+	copy_to_frame(image, frame.image_data(0).begin());
+
+	return frame;
 }
 
 struct image_producer : public core::frame_producer_base
@@ -83,13 +79,19 @@ struct image_producer : public core::frame_producer_base
 	const uint32_t								length_;
 	core::draw_frame							frame_				= core::draw_frame::empty();
 	core::constraints							constraints_;
+	decoded_image_future						pending_image_;
 
 	image_producer(const spl::shared_ptr<core::frame_factory>& frame_factory, const std::wstring& description, bool thumbnail_mode, uint32_t length)
 		: description_(description)
 		, frame_factory_(frame_factory)
 		, length_(length)
 	{
-		load(load_image(description_));
+		// Decoding is done by the shared decoder threads so that the AMCP
+		// thread is not blocked. Until then the frames are late.
+		if (thumbnail_mode)
+			load(*load_image_async(description_, false).get());
+		else
+			pending_image_ = load_image_async(description_);
 
 		if (thumbnail_mode)
 			CASPAR_LOG(debug) << print() << L" Initialized";
@@ -102,28 +104,46 @@ struct image_producer : public core::frame_producer_base
 		, frame_factory_(frame_factory)
 		, length_(length)
 	{
-		load(load_png_from_memory(png_data, size));
+		decoded_image image;
+		image.bitmap = load_png_from_memory(png_data, size);
+		load(image);
 
 		CASPAR_LOG(info) << print() << L" Initialized";
 	}
 
-	void load(const std::shared_ptr<FIBITMAP>& bitmap)
+	void load(const decoded_image& image)
+	{
+		frame_ = core::draw_frame(create_frame(frame_factory_, this, image));
+		constraints_.width.set(image.width());
+		constraints_.height.set(image.height());
+	}
+
+	/**
+	 * @return false while the image is still being decoded. If it could not
+	 *         be decoded or loaded the error is thrown, which stops the layer.
+	 */
+	bool try_load_pending()
 	{
-		FreeImage_FlipVertical(bitmap.get());
-		auto longest_side = static_cast<int>(std::max(FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get())));
+		if (!pending_image_.valid())
+			return true;
 
-		if (longest_side > frame_factory_->get_max_frame_size())
-			CASPAR_THROW_EXCEPTION(user_error() << msg_info("Image too large for texture"));
+		if (!is_ready(pending_image_))
+			return false;
 
-		core::pixel_format_desc desc;
-		desc.format = core::pixel_format::bgra;
-		desc.planes.push_back(core::pixel_format_desc::plane(FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get()), 4));
-		auto frame = frame_factory_->create_frame(this, desc, core::audio_channel_layout::invalid());
+		auto image = std::move(pending_image_);
+		pending_image_ = decoded_image_future();
 
-		std::copy_n(FreeImage_GetBits(bitmap.get()), frame.image_data().size(), frame.image_data().begin());
-		frame_ = core::draw_frame(std::move(frame));
-		constraints_.width.set(FreeImage_GetWidth(bitmap.get()));
-		constraints_.height.set(FreeImage_GetHeight(bitmap.get()));
+		try
+		{
+			load(*image.get());
+		}
+		catch (...)
+		{
+			CASPAR_LOG(error) << print() << L" Failed to load image.";
+			throw;
+		}
+
+		return true;
 	}
 
 	// frame_producer
@@ -132,6 +152,9 @@ struct image_producer : public core::frame_producer_base
 	{
 		monitor_subject_ << core::monitor::message("/file/path") % description_;
 
+		if (!try_load_pending())
+			return core::draw_frame::late();
+
 		return frame_;
 	}
 
@@ -236,20 +259,26 @@ spl::shared_ptr<core::frame_producer> create_producer(const core::frame_producer
 
 		int width = -1;
 		int height = -1;
+		std::vector<decoded_image_future> images;
 		std::vector<core::draw_frame> frames;
+		images.reserve(files.size());
 		frames.reserve(files.size());
 
+		// Queue all of them first so that they are decoded in parallel.
 		for (auto& file : files)
+			images.push_back(load_image_async(file));
+
+		for (auto& image : images)
 		{
-			auto frame = load_image(dependencies.frame_factory, file);
+			auto decoded = image.get();
 
 			if (width == -1)
 			{
-				width = static_cast<int>(frame.second.width.get());
-				height = static_cast<int>(frame.second.height.get());
+				width = decoded->width();
+				height = decoded->height();
 			}
 
-			frames.push_back(std::move(frame.first));
+			frames.push_back(core::draw_frame(create_frame(dependencies.frame_factory, decoded.get(), *decoded)));
 		}
 
 		return core::create_const_producer(std::move(frames), width, height);
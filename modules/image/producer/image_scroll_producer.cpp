@@ -23,6 +23,7 @@
 #include "image_scroll_producer.h"
 
 #include "../util/image_loader.h"
+#include "../util/image_cache.h"
 #include "../util/image_view.h"
 #include "../util/image_algorithms.h"
 
@@ -46,17 +47,20 @@
 #include <common/param.h>
 #include <common/os/filesystem.h>
 #include <common/future.h>
+#include <common/cache_aligned_vector.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/ptree.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/date_time.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <map>
 
 namespace caspar { namespace image {
 
@@ -111,7 +115,10 @@ struct image_scroll_producer : public core::frame_producer_base
 	core::monitor::subject						monitor_subject_;
 
 	const std::wstring							filename_;
-	std::vector<core::draw_frame>				frames_;
+	const spl::shared_ptr<core::frame_factory>	frame_factory_;
+	cache_aligned_vector<uint8_t>				image_;
+	int											num_tiles_			= 0;
+	std::map<int, core::draw_frame>				tiles_;
 	core::video_format_desc						format_desc_;
 	int											width_;
 	int											height_;
@@ -136,6 +143,7 @@ struct image_scroll_producer : public core::frame_producer_base
 			bool premultiply_with_alpha = false,
 			bool progressive = false)
 		: filename_(filename)
+		, frame_factory_(frame_factory)
 		, format_desc_(format_desc)
 		, end_time_(std::move(end_time))
 		, progressive_(progressive)
@@ -145,11 +153,10 @@ struct image_scroll_producer : public core::frame_producer_base
 		if (end_time_)
 			speed = -1.0;
 
-		auto bitmap = load_image(filename_);
-		FreeImage_FlipVertical(bitmap.get());
+		auto decoded = load_image_async(filename_).get();
 
-		width_  = FreeImage_GetWidth(bitmap.get());
-		height_ = FreeImage_GetHeight(bitmap.get());
+		width_  = decoded->width();
+		height_ = decoded->height();
 		constraints_.width.set(width_);
 		constraints_.height.set(height_);
 
@@ -180,15 +187,14 @@ struct image_scroll_producer : public core::frame_producer_base
 
 		speed_ = speed_tweener(speed, speed, 0, tweener(L"linear"));
 
-		auto bytes = FreeImage_GetBits(bitmap.get());
-		auto count = width_*height_*4;
-		image_view<bgra_pixel> original_view(bytes, width_, height_);
+		image_.resize(static_cast<std::size_t>(width_) * height_ * 4);
+		copy_to_frame(*decoded, image_.data());
+
+		image_view<bgra_pixel> original_view(image_.data(), width_, height_);
 
 		if (premultiply_with_alpha)
 			premultiply(original_view);
 
-		boost::scoped_array<uint8_t> blurred_copy;
-
 		if (motion_blur_px > 0)
 		{
 			double angle = 3.14159265 / 2; // Up
@@ -200,82 +206,16 @@ struct image_scroll_producer : public core::frame_producer_base
 			else if (horizontal && speed  > 0)
 				angle = 0.0; // Right
 
-			blurred_copy.reset(new uint8_t[count]);
-			image_view<bgra_pixel> blurred_view(blurred_copy.get(), width_, height_);
+			cache_aligned_vector<uint8_t> blurred(image_.size());
 			caspar::tweener blur_tweener(L"easeInQuad");
-			blur(original_view, blurred_view, angle, motion_blur_px, blur_tweener);
-			bytes = blurred_copy.get();
-			bitmap.reset();
+			blur_bgra(image_.data(), blurred.data(), width_, height_, angle, motion_blur_px, blur_tweener);
+			image_.swap(blurred);
 		}
 
 		if (vertical)
-		{
-			int n = 1;
-
-			while(count > 0)
-			{
-				core::pixel_format_desc desc = core::pixel_format::bgra;
-				desc.planes.push_back(core::pixel_format_desc::plane(width_, format_desc_.height, 4));
-				auto frame = frame_factory->create_frame(this, desc, core::audio_channel_layout::invalid());
-
-				if(count >= frame.image_data(0).size())
-				{
-					std::copy_n(bytes + count - frame.image_data(0).size(), frame.image_data(0).size(), frame.image_data(0).begin());
-					count -= static_cast<int>(frame.image_data(0).size());
-				}
-				else
-				{
-					memset(frame.image_data(0).begin(), 0, frame.image_data(0).size());
-					std::copy_n(bytes, count, frame.image_data(0).begin() + format_desc_.size - count);
-					count = 0;
-				}
-
-				core::draw_frame draw_frame(std::move(frame));
-
-				// Set the relative position to the other image fragments
-				draw_frame.transform().image_transform.fill_translation[1] = - n++;
-
-				frames_.push_back(draw_frame);
-			}
-		}
-		else if (horizontal)
-		{
-			int i = 0;
-			while(count > 0)
-			{
-				core::pixel_format_desc desc = core::pixel_format::bgra;
-				desc.planes.push_back(core::pixel_format_desc::plane(format_desc_.width, height_, 4));
-				auto frame = frame_factory->create_frame(this, desc, core::audio_channel_layout::invalid());
-				if(count >= frame.image_data(0).size())
-				{
-					for(int y = 0; y < height_; ++y)
-						std::copy_n(bytes + i * format_desc_.width*4 + y * width_*4, format_desc_.width*4, frame.image_data(0).begin() + y * format_desc_.width*4);
-
-					++i;
-					count -= static_cast<int>(frame.image_data(0).size());
-				}
-				else
-				{
-					memset(frame.image_data(0).begin(), 0, frame.image_data(0).size());
-					auto width2 = width_ % format_desc_.width;
-					for(int y = 0; y < height_; ++y)
-						std::copy_n(bytes + i * format_desc_.width*4 + y * width_*4, width2*4, frame.image_data(0).begin() + y * format_desc_.width*4);
-
-					count = 0;
-				}
-
-				frames_.push_back(core::draw_frame(std::move(frame)));
-			}
-
-			std::reverse(frames_.begin(), frames_.end());
-
-			// Set the relative positions of the image fragments.
-			for (size_t n = 0; n < frames_.size(); ++n)
-			{
-				double translation = - (static_cast<double>(n) + 1.0);
-				frames_[n].transform().image_transform.fill_translation[0] = translation;
-			}
-		}
+			num_tiles_ = (height_ + format_desc_.height - 1) / format_desc_.height;
+		else
+			num_tiles_ = (width_ + format_desc_.width - 1) / format_desc_.width;
 
 		CASPAR_LOG(info) << print() << L" Initialized";
 	}
@@ -313,46 +253,83 @@ struct image_scroll_producer : public core::frame_producer_base
 		return make_ready_future<std::wstring>(L"");
 	}
 
-	std::vector<core::draw_frame> get_visible()
+	// Tile n is the part of the image that is n screens from the start
+	// position, so its fill_translation along the scroll axis is -n.
+	core::draw_frame create_tile(int n)
 	{
-		std::vector<core::draw_frame> result;
-		result.reserve(frames_.size());
+		bool vertical = width_ == format_desc_.width;
+		core::pixel_format_desc desc = core::pixel_format::bgra;
+		desc.planes.push_back(core::pixel_format_desc::plane(format_desc_.width, vertical ? format_desc_.height : height_, 4));
+		auto frame = frame_factory_->create_frame(this, desc, core::audio_channel_layout::invalid());
+		auto dest = frame.image_data(0).begin();
+		auto row_size = format_desc_.width * 4;
 
-		for (auto& frame : frames_)
+		if (vertical)
 		{
-			auto& fill_translation = frame.transform().image_transform.fill_translation;
+			// Counted from the bottom, the topmost tile is padded at the top.
+			int first_row = height_ - n * format_desc_.height;
 
-			if (width_ == format_desc_.width)
+			for (int y = 0; y < format_desc_.height; ++y, dest += row_size)
 			{
-				auto motion_offset_in_screens = (static_cast<double>(start_offset_y_) + delta_) / static_cast<double>(format_desc_.height);
-				auto vertical_offset = fill_translation[1] + motion_offset_in_screens;
-
-				if (vertical_offset < -1.0 || vertical_offset > 1.0)
-				{
-					continue;
-				}
+				if (first_row + y < 0)
+					std::memset(dest, 0, row_size);
+				else
+					std::memcpy(dest, image_.data() + (first_row + y) * row_size, row_size);
 			}
-			else
-			{
-				auto motion_offset_in_screens = (static_cast<double>(start_offset_x_) + delta_) / static_cast<double>(format_desc_.width);
-				auto horizontal_offset = fill_translation[0] + motion_offset_in_screens;
+		}
+		else
+		{
+			// Counted from the right, the rightmost tile is padded to the right.
+			int first_column = (num_tiles_ - n) * format_desc_.width;
+			int columns = std::min(format_desc_.width, width_ - first_column);
 
-				if (horizontal_offset < -1.0 || horizontal_offset > 1.0)
-				{
-					continue;
-				}
-			}
+			if (columns < format_desc_.width)
+				std::memset(dest, 0, frame.image_data(0).size());
 
-			result.push_back(frame);
+			for (int y = 0; y < height_; ++y, dest += row_size)
+				std::memcpy(dest, image_.data() + (y * width_ + first_column) * 4, columns * 4);
 		}
 
+		core::draw_frame tile(std::move(frame));
+		tile.transform().image_transform.fill_translation[vertical ? 1 : 0] = -n;
+
+		return tile;
+	}
+
+	std::vector<core::draw_frame> get_visible()
+	{
+		bool vertical = width_ == format_desc_.width;
+		auto motion_offset_in_screens = vertical
+				? (static_cast<double>(start_offset_y_) + delta_) / static_cast<double>(format_desc_.height)
+				: (static_cast<double>(start_offset_x_) + delta_) / static_cast<double>(format_desc_.width);
+
+		// A tile is visible while its offset from the screen is within [-1, 1].
+		int first = std::max(1, static_cast<int>(std::ceil(motion_offset_in_screens - 1.0)));
+		int last = std::min(num_tiles_, static_cast<int>(std::floor(motion_offset_in_screens + 1.0)));
+
+		// Only the visible tiles are kept. The buffers of the others go back
+		// to the pool of the frame factory to be reused for the next tiles.
+		std::map<int, core::draw_frame> visible_tiles;
+		std::vector<core::draw_frame> result;
+
+		for (int n = first; n <= last; ++n)
+		{
+			auto it = tiles_.find(n);
+			auto tile = it != tiles_.end() ? it->second : create_tile(n);
+
+			visible_tiles.insert(std::make_pair(n, tile));
+			result.push_back(tile);
+		}
+
+		tiles_.swap(visible_tiles);
+
 		return std::move(result);
 	}
 
 	// frame_producer
 	core::draw_frame render_frame(bool allow_eof)
 	{
-		if(frames_.empty())
+		if (num_tiles_ == 0)
 			return core::draw_frame::empty();
 
 		core::draw_frame result(get_visible());
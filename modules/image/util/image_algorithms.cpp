@@ -20,6 +20,11 @@
 */
 
 #include "image_algorithms.h"
+#include "image_view.h"
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
 
 #include <vector>
 #include <cstdint>
@@ -47,4 +52,142 @@ std::vector<std::pair<int, int>> get_line_points(int num_pixels, double angle_ra
 	return std::move(line_points);
 }
 
+namespace {
+
+// Above this total weight the float division in blur_four_pixels() could
+// round differently than the integer division in rgba_weighting.
+const int MAX_SIMD_TOTAL_WEIGHT = 8192;
+
+inline void blur_pixel(
+		const bgra_pixel* src,
+		bgra_pixel* dst,
+		int num_pixels,
+		int index,
+		const std::vector<int>& offsets,
+		const std::vector<uint8_t>& weights)
+{
+	rgba_weighting w;
+
+	for (std::size_t i = 0; i < offsets.size(); ++i)
+	{
+		auto other = index + offsets[i];
+
+		if (other < 0 || other >= num_pixels)
+			break;
+
+		w.add_pixel(src[other], weights[i]);
+	}
+
+	w.add_pixel(src[index], 255);
+	w.store_result(dst[index]);
+}
+
+inline void accumulate(__m128i (&sums)[4], __m128i pixels, __m128i weight)
+{
+	const auto zero = _mm_setzero_si128();
+	auto lo = _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight);
+	auto hi = _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight);
+
+	sums[0] = _mm_add_epi32(sums[0], _mm_unpacklo_epi16(lo, zero));
+	sums[1] = _mm_add_epi32(sums[1], _mm_unpackhi_epi16(lo, zero));
+	sums[2] = _mm_add_epi32(sums[2], _mm_unpacklo_epi16(hi, zero));
+	sums[3] = _mm_add_epi32(sums[3], _mm_unpackhi_epi16(hi, zero));
+}
+
+inline __m128i divide(__m128i sums, __m128 half, __m128 reciprocal)
+{
+	// floor((sum + 0.5) / total) == sum / total for integers, and the half
+	// keeps the float rounding error from crossing an integer boundary.
+	return _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(sums), half), reciprocal));
+}
+
+inline void blur_four_pixels(
+		const uint8_t* src,
+		uint8_t* dst,
+		const std::vector<int>& byte_offsets,
+		const std::vector<uint8_t>& weights,
+		__m128 reciprocal)
+{
+	__m128i sums[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+
+	for (std::size_t i = 0; i < byte_offsets.size(); ++i)
+		accumulate(sums, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + byte_offsets[i])), _mm_set1_epi16(weights[i]));
+
+	accumulate(sums, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), _mm_set1_epi16(255));
+
+	const auto half = _mm_set1_ps(0.5f);
+	auto lo = _mm_packs_epi32(divide(sums[0], half, reciprocal), divide(sums[1], half, reciprocal));
+	auto hi = _mm_packs_epi32(divide(sums[2], half, reciprocal), divide(sums[3], half, reciprocal));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+}
+
+}
+
+void blur_bgra(
+	const std::uint8_t* src,
+	std::uint8_t* dst,
+	int width,
+	int height,
+	double angle_radians,
+	int blur_px,
+	const caspar::tweener& tweener)
+{
+	auto weights = get_tweened_values<uint8_t>(tweener, blur_px + 2, 255, 0);
+	weights.pop_back();
+	weights.erase(weights.begin());
+
+	// Like image_view::relative() the motion trail is followed in memory, so
+	// each coordinate is just a constant distance from the pixel.
+	std::vector<int> offsets;
+	std::vector<int> byte_offsets;
+	int total_weight = 255;
+
+	for (auto& coordinate : get_line_points(blur_px, angle_radians))
+	{
+		offsets.push_back(coordinate.first + width * coordinate.second);
+		byte_offsets.push_back(offsets.back() * 4);
+	}
+
+	for (auto weight : weights)
+		total_weight += weight;
+
+	int num_pixels	= width * height;
+	auto src_pixels	= reinterpret_cast<const bgra_pixel*>(src);
+	auto dst_pixels	= reinterpret_cast<bgra_pixel*>(dst);
+
+	// The pixels in [first_whole, end_whole) have their whole trail inside the
+	// image and the same total weight.
+	int first_whole = 0;
+	int end_whole = num_pixels;
+
+	for (auto offset : offsets)
+	{
+		first_whole = std::max(first_whole, -offset);
+		end_whole = std::min(end_whole, num_pixels - offset);
+	}
+
+	bool use_simd		= total_weight < MAX_SIMD_TOTAL_WEIGHT;
+	auto reciprocal		= _mm_set1_ps(1.0f / static_cast<float>(total_weight));
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, height, 8), [&](const tbb::blocked_range<int>& rows)
+	{
+		int begin	= rows.begin() * width;
+		int end		= rows.end() * width;
+		int index	= begin;
+
+		if (use_simd)
+		{
+			for (; index < end && index < first_whole; ++index)
+				blur_pixel(src_pixels, dst_pixels, num_pixels, index, offsets, weights);
+
+			for (; index + 4 <= std::min(end, end_whole); index += 4)
+				blur_four_pixels(src + index * 4, dst + index * 4, byte_offsets, weights, reciprocal);
+		}
+
+		for (; index < end; ++index)
+			blur_pixel(src_pixels, dst_pixels, num_pixels, index, offsets, weights);
+	});
+}
+
 }}	//namespace caspar::image
\ No newline at end of file
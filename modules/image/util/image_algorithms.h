@@ -26,6 +26,7 @@
 #include <cmath>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
 
 namespace caspar { namespace image {
 
@@ -175,6 +176,30 @@ void blur(
 	blur(src, dst, motion_trail, tweener);
 }
 
+/**
+ * Directionally blur an 8 bit BGRA image. Gives exactly the same result as
+ * blur() on image_view<bgra_pixel> views, but the rows are blurred in parallel
+ * and the pixels that have the whole motion trail inside the image are
+ * weighted four at a time using SSE2.
+ *
+ * @param src           The source pixels, width * height * 4 bytes.
+ * @param dst           The destination pixels, may not overlap src.
+ * @param width         The width of the image.
+ * @param height        The height of the image.
+ * @param angle_radians The angle in radians to directionally blur the image.
+ * @param blur_px       The number of pixels of the blur.
+ * @param tweener       The tweener to use to create a pixel weighting curve
+ *                      with.
+ */
+void blur_bgra(
+	const std::uint8_t* src,
+	std::uint8_t* dst,
+	int width,
+	int height,
+	double angle_radians,
+	int blur_px,
+	const caspar::tweener& tweener);
+
 /**
  * Premultiply with alpha for each pixel in an ImageView. The modifications is
  * done in place. The pixel type of the ImageView must model the RGBAPixel
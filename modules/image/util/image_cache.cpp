@@ -0,0 +1,359 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "image_cache.h"
+#include "image_loader.h"
+
+#include <common/env.h>
+#include <common/diagnostics/memory_accounting.h>
+#include <common/log.h>
+#include <common/os/general_protection_fault.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread.hpp>
+
+#include <tbb/concurrent_queue.h>
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace caspar { namespace image {
+
+namespace {
+
+struct file_stamp
+{
+	std::time_t		last_write_time	= 0;
+	std::uintmax_t	size			= 0;
+
+	bool operator==(const file_stamp& other) const
+	{
+		return last_write_time == other.last_write_time && size == other.size;
+	}
+};
+
+file_stamp stamp_of(const std::wstring& file)
+{
+	boost::system::error_code ec;
+	file_stamp stamp;
+
+	stamp.last_write_time = boost::filesystem::last_write_time(file, ec);
+
+	if (ec)
+		return file_stamp();
+
+	stamp.size = boost::filesystem::file_size(file, ec);
+
+	if (ec)
+		return file_stamp();
+
+	return stamp;
+}
+
+spl::shared_ptr<const decoded_image> decode(const std::wstring& filename)
+{
+	auto image = spl::make_shared<decoded_image>();
+	image->bitmap = decode_image(filename, image->needs_premultiply);
+
+	return image;
+}
+
+class image_cache
+{
+	struct entry
+	{
+		file_stamp							stamp;
+		decoded_image_future				image;
+		std::uint64_t						id		= 0;
+		std::size_t							size	= 0; // 0 while decoding.
+		std::list<std::wstring>::iterator	lru_position;
+	};
+
+	const std::size_t										budget_;
+	boost::mutex											mutex_;
+	std::map<std::wstring, entry>							entries_;
+	std::list<std::wstring>									lru_; // Most recently used first.
+	std::size_t												total_size_	= 0;
+	diagnostics::memory_account								memory_		{ L"image-cache" };
+	std::uint64_t											next_id_	= 0;
+	tbb::concurrent_bounded_queue<std::function<void()>>	jobs_;
+	std::vector<boost::thread>								decoders_;
+public:
+	image_cache(std::size_t budget, int num_decoders)
+		: budget_(budget)
+	{
+		for (int i = 0; i < std::max(1, num_decoders); ++i)
+			decoders_.push_back(boost::thread([this] { run_decoder(); }));
+	}
+
+	~image_cache()
+	{
+		// An empty job tells a decoder to stop.
+		for (std::size_t i = 0; i < decoders_.size(); ++i)
+			jobs_.push(nullptr);
+
+		for (auto& decoder : decoders_)
+			decoder.join();
+	}
+
+	decoded_image_future load(const std::wstring& filename)
+	{
+		auto stamp = stamp_of(filename);
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto it = entries_.find(filename);
+
+		if (it != entries_.end())
+		{
+			if (it->second.stamp == stamp)
+			{
+				lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+
+				return it->second.image;
+			}
+
+			erase(it);
+		}
+
+		auto id			= ++next_id_;
+		auto promise	= std::make_shared<std::promise<spl::shared_ptr<const decoded_image>>>();
+		auto& new_entry	= entries_[filename];
+
+		lru_.push_front(filename);
+		new_entry.stamp			= stamp;
+		new_entry.image			= promise->get_future().share();
+		new_entry.id			= id;
+		new_entry.lru_position	= lru_.begin();
+
+		jobs_.push([=]
+		{
+			try
+			{
+				auto image = decode(filename);
+				on_decoded(filename, id, image->size());
+				promise->set_value(image);
+			}
+			catch (...)
+			{
+				on_decoded(filename, id, 0);
+				promise->set_exception(std::current_exception());
+			}
+		});
+
+		return new_entry.image;
+	}
+
+	void clear()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		for (auto it = entries_.begin(); it != entries_.end();)
+		{
+			// Images still being decoded are accounted for when done.
+			if (it->second.size > 0)
+				erase(it++);
+			else
+				++it;
+		}
+	}
+private:
+	void run_decoder()
+	{
+		ensure_gpf_handler_installed_for_thread("image-decoder");
+
+		std::function<void()> job;
+
+		while (true)
+		{
+			jobs_.pop(job);
+
+			if (!job)
+				return;
+
+			job();
+		}
+	}
+
+	void on_decoded(const std::wstring& filename, std::uint64_t id, std::size_t size)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto it = entries_.find(filename);
+
+		// Replaced or cleared while decoding.
+		if (it == entries_.end() || it->second.id != id)
+			return;
+
+		// Failed images are not cached, the file might be fixed.
+		if (size == 0)
+		{
+			erase(it);
+			return;
+		}
+
+		it->second.size	= size;
+		total_size_		+= size;
+		memory_.add(size);
+
+		auto candidate = lru_.end();
+
+		// Also evicted when the memory is needed elsewhere.
+		while ((total_size_ > budget_ || memory_.over_budget()) && candidate != lru_.begin())
+		{
+			auto current	= std::prev(candidate);
+			auto victim		= entries_.find(*current);
+
+			if (victim->second.size > 0)
+				erase(victim);
+			else
+				candidate = current;
+		}
+	}
+
+	void erase(std::map<std::wstring, entry>::iterator it)
+	{
+		total_size_ -= it->second.size;
+		memory_.subtract(it->second.size);
+		lru_.erase(it->second.lru_position);
+		entries_.erase(it);
+	}
+};
+
+image_cache& get_cache()
+{
+	static image_cache cache(
+			static_cast<std::size_t>(env::properties().get(L"configuration.image.cache-size-mb", 512)) * 1024 * 1024,
+			env::properties().get(L"configuration.image.decoder-threads", static_cast<int>(std::max(1u, boost::thread::hardware_concurrency() / 2))));
+
+	return cache;
+}
+
+// Multiplies the colors of two unpacked bgra pixels with their alpha. The
+// division by 255 rounds down, exactly like premultiply() in
+// image_algorithms.h, since (x + 1 + (x >> 8)) >> 8 == x / 255 for all
+// x <= 255 * 255.
+inline __m128i premultiply_unpacked(__m128i pixels, __m128i alpha_lanes, __m128i opaque)
+{
+	auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alpha), opaque);
+
+	auto product = _mm_mullo_epi16(pixels, alpha);
+
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(product, _mm_set1_epi16(1)), _mm_srli_epi16(product, 8)), 8);
+}
+
+void premultiply_row(const std::uint8_t* source, std::uint8_t* dest, int width)
+{
+	const auto zero			= _mm_setzero_si128();
+	const auto alpha_bytes	= _mm_set1_epi32(static_cast<int>(0xFF000000));
+	const auto alpha_lanes	= _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	const auto opaque		= _mm_and_si128(alpha_lanes, _mm_set1_epi16(255));
+
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4, source += 16, dest += 16)
+	{
+		auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+
+		// Fully opaque pixels are common and unaffected.
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(pixels, alpha_bytes), alpha_bytes)) != 0xFFFF)
+		{
+			auto lo = premultiply_unpacked(_mm_unpacklo_epi8(pixels, zero), alpha_lanes, opaque);
+			auto hi = premultiply_unpacked(_mm_unpackhi_epi8(pixels, zero), alpha_lanes, opaque);
+			pixels = _mm_packus_epi16(lo, hi);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), pixels);
+	}
+
+	for (; x < width; ++x, source += 4, dest += 4)
+	{
+		int alpha = source[3];
+
+		dest[0] = static_cast<std::uint8_t>(source[0] * alpha / 255);
+		dest[1] = static_cast<std::uint8_t>(source[1] * alpha / 255);
+		dest[2] = static_cast<std::uint8_t>(source[2] * alpha / 255);
+		dest[3] = static_cast<std::uint8_t>(alpha);
+	}
+}
+
+}
+
+decoded_image_future load_image_async(const std::wstring& filename, bool use_cache)
+{
+	if (use_cache)
+		return get_cache().load(filename);
+
+	std::promise<spl::shared_ptr<const decoded_image>> promise;
+
+	try
+	{
+		promise.set_value(decode(filename));
+	}
+	catch (...)
+	{
+		promise.set_exception(std::current_exception());
+	}
+
+	return promise.get_future().share();
+}
+
+void copy_to_frame(const decoded_image& image, std::uint8_t* dest)
+{
+	auto width		= image.width();
+	auto height		= image.height();
+	auto pitch		= FreeImage_GetPitch(image.bitmap.get());
+	auto bits		= FreeImage_GetBits(image.bitmap.get());
+	auto row_size	= static_cast<std::size_t>(width) * 4;
+
+	// The decoded image is bottom-up, so the rows are flipped on the way.
+	tbb::parallel_for(tbb::blocked_range<int>(0, height, 16), [&](const tbb::blocked_range<int>& rows)
+	{
+		for (int y = rows.begin(); y != rows.end(); ++y)
+		{
+			auto source = bits + static_cast<std::size_t>(height - 1 - y) * pitch;
+			auto row	= dest + y * row_size;
+
+			if (image.needs_premultiply)
+				premultiply_row(source, row, width);
+			else
+				std::memcpy(row, source, row_size);
+		}
+	});
+}
+
+void clear_image_cache()
+{
+	get_cache().clear();
+}
+
+}}
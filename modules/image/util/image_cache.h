@@ -0,0 +1,85 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#pragma once
+
+#include <common/memory.h>
+
+#include <FreeImage.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace caspar { namespace image {
+
+/**
+ * A 32 bit image as it was decoded from disk, that is bottom-up and not yet
+ * premultiplied. The last steps are done while copying into a frame, see
+ * copy_to_frame(), so that the decoded pixels can be shared between any
+ * number of producers and channels.
+ */
+struct decoded_image
+{
+	std::shared_ptr<FIBITMAP>	bitmap;
+	bool						needs_premultiply	= false;
+
+	int width() const		{ return static_cast<int>(FreeImage_GetWidth(bitmap.get())); }
+	int height() const		{ return static_cast<int>(FreeImage_GetHeight(bitmap.get())); }
+	std::size_t size() const	{ return static_cast<std::size_t>(FreeImage_GetPitch(bitmap.get())) * FreeImage_GetHeight(bitmap.get()); }
+};
+
+typedef std::shared_future<spl::shared_ptr<const decoded_image>> decoded_image_future;
+
+/**
+ * Loads an image asynchronously on the shared pool of decoder threads.
+ * <p>
+ * Decoded images are kept in a server wide cache keyed by path, last write
+ * time and size, so loading the same still again (on any channel) does not
+ * touch the disk. The cache is bounded by configuration.image.cache-size-mb
+ * and evicts the least recently used images first. Concurrent requests for an
+ * image that is still being decoded share the same decoding.
+ *
+ * @param filename The full path of the image.
+ * @param use_cache Whether to look up and store the result in the cache.
+ *                  Thumbnail generation should not evict images in use.
+ *
+ * @return The future decoded image. Holds the exception if decoding failed.
+ */
+decoded_image_future load_image_async(const std::wstring& filename, bool use_cache = true);
+
+/**
+ * Copies a decoded image top-down into a bgra frame buffer, premultiplying
+ * the colors with alpha in the same SSE2 pass if required.
+ *
+ * @param image The decoded image.
+ * @param dest  The destination, width * height * 4 bytes.
+ */
+void copy_to_frame(const decoded_image& image, std::uint8_t* dest);
+
+/**
+ * Drops all cached images. Images still used by producers are kept alive by
+ * them.
+ */
+void clear_image_cache();
+
+}}
@@ -36,7 +36,7 @@
 
 namespace caspar { namespace image {
 
-std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename)
+std::shared_ptr<FIBITMAP> decode_image(const std::wstring& filename, bool& needs_premultiply)
 {
 	if(!boost::filesystem::exists(filename))
 		CASPAR_THROW_EXCEPTION(file_not_found() << boost::errinfo_file_name(u8(filename)));
@@ -71,7 +71,17 @@ std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename)
 	}
 
 	//PNG-images need to be premultiplied with their alpha
-	if(fif == FIF_PNG)
+	needs_premultiply = fif == FIF_PNG;
+
+	return bitmap;
+}
+
+std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename)
+{
+	bool needs_premultiply;
+	auto bitmap = decode_image(filename, needs_premultiply);
+
+	if (needs_premultiply)
 	{
 		image_view<bgra_pixel> original_view(FreeImage_GetBits(bitmap.get()), FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get()));
 		premultiply(original_view);
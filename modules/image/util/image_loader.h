@@ -29,6 +29,7 @@
 
 namespace caspar { namespace image {
 
+std::shared_ptr<FIBITMAP> decode_image(const std::wstring& filename, bool& needs_premultiply);
 std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename);
 std::shared_ptr<FIBITMAP> load_png_from_memory(const void* memory_location, size_t size);
 const std::set<std::wstring>& supported_extensions();
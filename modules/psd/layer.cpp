@@ -32,8 +32,14 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/parallel_for.h>
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
 namespace caspar { namespace psd {
 
@@ -156,7 +162,9 @@ struct layer::impl
 	friend class layer;
 
 	impl() : blend_mode_(caspar::core::blend_mode::normal), layer_type_(layer_type::content), link_group_id_(0), opacity_(255), sheet_color_(0), baseClipping_(false), flags_(0), protection_flags_(0), masks_count_(0), scale_{ 1.0, 1.0 }, angle_(0), shear_(0), tags_(layer_tag::none)
-	{}
+	{
+		decoded_ = false;
+	}
 
 private:
 	std::vector<channel>			channels_;
@@ -187,6 +195,13 @@ private:
 
 	layer_tag						tags_;
 
+	// The channel data is only decoded when the bitmap or the mask is first
+	// needed, from this stream positioned at the start of the data.
+	bigendian_file_input_stream		channel_data_;
+	std::streamoff					channel_data_length_	= 0;
+	boost::mutex					decode_mutex_;
+	tbb::atomic<bool>				decoded_;
+
 public:
 	void populate(bigendian_file_input_stream& stream, const psd_document& doc)
 	{
@@ -486,6 +501,69 @@ public:
 
 	void read_channel_data(bigendian_file_input_stream& stream)
 	{
+		channel_data_ = stream;
+		channel_data_length_ = 0;
+
+		for (auto& channel : channels_)
+			channel_data_length_ += channel.data_length;
+
+		stream.discard_bytes(channel_data_length_);
+	}
+
+	void copy_channel_data_to_memory()
+	{
+		boost::lock_guard<boost::mutex> lock(decode_mutex_);
+
+		if (decoded_)
+			return;
+
+		try
+		{
+			channel_data_ = channel_data_.copy_to_memory(channel_data_.current_position(), channel_data_length_);
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << L"Could not read the image data of layer " << name_;
+			channel_data_.close();
+			decoded_ = true;
+		}
+	}
+
+	void decode_channel_data()
+	{
+		if (decoded_)
+			return;
+
+		boost::lock_guard<boost::mutex> lock(decode_mutex_);
+
+		if (decoded_)
+			return;
+
+		try
+		{
+			decode_channels();
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << L"Could not decode the image data of layer " << name_;
+		}
+
+		channel_data_.close();
+		decoded_ = true;
+	}
+
+	void decode_channels()
+	{
+		struct channel_target
+		{
+			image8bit_ptr	target;
+			int				offset;
+			std::streamoff	position;
+			int				data_length;
+		};
+
 		image8bit_ptr bitmap;
 
 		bool has_transparency = has_channel(channel_type::transparency);
@@ -497,16 +575,21 @@ public:
 				std::memset(bitmap->data(), 255, bitmap->width()*bitmap->height()*bitmap->channel_count());
 		}
 
+		std::vector<channel_target> targets;
+		auto position = channel_data_.current_position();
+
 		for(auto it = channels_.begin(); it != channels_.end(); ++it)
 		{
 			auto channel = (*it);
+			auto channel_position = position;
 			image8bit_ptr target;
 			int offset = 0;
-			bool discard_channel = false;
+
+			position += channel.data_length;
 
 			//determine target bitmap and offset
 			if(channel.id >= 3)
-				discard_channel = true;	//discard channels that doesn't contribute to the final image
+				continue;	//discard channels that doesn't contribute to the final image
 			else if(channel.id >= -1)	//BGRA-data
 			{
 				target = bitmap;
@@ -528,26 +611,27 @@ public:
 				}
 			}
 
-			if(!target)
-				discard_channel = true;
-
-			auto end_of_data = stream.current_position() + channel.data_length;
-			if(!discard_channel)
-			{
-				auto encoding = stream.read_short();
-				if(target)
-				{
-					if(encoding == 0)
-						read_raw_image_data(stream, channel.data_length-2, target, offset);
-					else if(encoding == 1)
-						read_rle_image_data(stream, target, offset);
-					else
-						CASPAR_THROW_EXCEPTION(psd_file_format_exception() << msg_info("Unhandled image data encoding: " + boost::lexical_cast<std::string>(encoding)));
-				}
-			}
-			stream.set_position(end_of_data);
+			if(target)
+				targets.push_back(channel_target { target, offset, channel_position, channel.data_length });
 		}
 
+		// Every channel is stored separately and is written to its own byte
+		// of each pixel, so they can be decoded in parallel.
+		tbb::parallel_for(std::size_t(0), targets.size(), [&](std::size_t index)
+		{
+			auto& channel = targets[index];
+			auto stream = channel_data_;
+			stream.set_position(channel.position);
+
+			auto encoding = stream.read_short();
+			if(encoding == 0)
+				read_raw_image_data(stream, channel.data_length-2, *channel.target, channel.offset);
+			else if(encoding == 1)
+				read_rle_image_data(stream, channel.data_length-2, *channel.target, channel.offset);
+			else
+				CASPAR_THROW_EXCEPTION(psd_file_format_exception() << msg_info("Unhandled image data encoding: " + boost::lexical_cast<std::string>(encoding)));
+		});
+
 		if(bitmap && has_transparency)
 		{
 			caspar::image::image_view<caspar::image::bgra_pixel> view(bitmap->data(), bitmap->width(), bitmap->height());
@@ -557,75 +641,81 @@ public:
 		bitmap_ = bitmap;
 	}
 
-	void read_raw_image_data(bigendian_file_input_stream& stream, int data_length, image8bit_ptr target, int offset)
+	static void read_raw_image_data(bigendian_file_input_stream& stream, int data_length, image8bit& target, int offset)
 	{
-		auto total_length = target->width() * target->height();
+		auto total_length = target.width() * target.height();
 		if (total_length != data_length)
 			CASPAR_THROW_EXCEPTION(psd_file_format_exception() << msg_info("total_length != data_length"));
 
-		auto data = target->data();
-		auto stride = target->channel_count();
+		auto source = stream.read_bytes(total_length);
+		auto data = target.data();
+		auto stride = target.channel_count();
 
 		if (stride == 1)
-			stream.read(reinterpret_cast<char*>(data + offset), total_length);
+			std::memcpy(data + offset, source, total_length);
 		else
 		{
 			for(int index = 0; index < total_length; ++index)
-				data[index * stride + offset] = stream.read_byte();
+				data[index * stride + offset] = source[index];
 		}
 	}
 
-	void read_rle_image_data(bigendian_file_input_stream& stream, image8bit_ptr target, int offset)
+	static void read_rle_image_data(bigendian_file_input_stream& stream, int data_length, image8bit& target, int offset)
 	{
-		auto width = target->width();
-		auto height = target->height();
-		auto stride = target->channel_count();
+		auto width = target.width();
+		auto height = target.height();
+		auto stride = target.channel_count();
 
-		std::vector<int> scanline_lengths;
-		scanline_lengths.reserve(height);
+		// The scanline lengths are not needed since the scanlines follow each
+		// other.
+		stream.discard_bytes(height * 2);
 
-		for (int scanlineIndex = 0; scanlineIndex < height; ++scanlineIndex)
-			scanline_lengths.push_back(static_cast<std::int16_t>(stream.read_short()));
-
-		auto target_data = target->data();
-
-		std::vector<std::uint8_t> line(width);
+		auto source = stream.read_bytes(data_length - height * 2);
+		auto source_end = source + (data_length - height * 2);
+		auto target_data = target.data();
 
 		for(int scanlineIndex=0; scanlineIndex < height; ++scanlineIndex)
 		{
+			auto line = target_data + scanlineIndex * width * stride + offset;
 			int colIndex = 0;
 
-			do
+			while(colIndex < width)
 			{
-				int length = 0;
+				if (source == source_end)
+					CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
 
 				//Get controlbyte
-				char controlByte = static_cast<char>(stream.read_byte());
+				auto controlByte = static_cast<std::int8_t>(*source++);
+				int length = 0;
+
 				if(controlByte >= 0)
 				{
 					//Read uncompressed string
 					length = controlByte+1;
+
+					if (source_end - source < length || width - colIndex < length)
+						CASPAR_THROW_EXCEPTION(psd_file_format_exception() << msg_info("Invalid RLE data"));
+
 					for(int index=0; index < length; ++index)
-						line[colIndex+index] = stream.read_byte();
+						line[(colIndex+index) * stride] = source[index];
+
+					source += length;
 				}
 				else if(controlByte > -128)
 				{
 					//Repeat next byte
 					length = -controlByte+1;
-					auto value = stream.read_byte();
+
+					if (source == source_end || width - colIndex < length)
+						CASPAR_THROW_EXCEPTION(psd_file_format_exception() << msg_info("Invalid RLE data"));
+
+					auto value = *source++;
 					for(int index=0; index < length; ++index)
-						line[colIndex+index] = value;
+						line[(colIndex+index) * stride] = value;
 				}
 
 				colIndex += length;
 			}
-			while(colIndex < width);
-
-			//use line to populate target
-			for(int index = 0; index < width; ++index)
-			{
-				target_data[(scanlineIndex*width+index) * stride + offset] = line[index];
-			}
 		}
 	}
 };
@@ -634,6 +724,8 @@ layer::layer() : impl_(spl::make_shared<impl>()) {}
 
 void layer::populate(bigendian_file_input_stream& stream, const psd_document& doc) { impl_->populate(stream, doc); }
 void layer::read_channel_data(bigendian_file_input_stream& stream) { impl_->read_channel_data(stream); }
+void layer::decode_channel_data() { impl_->decode_channel_data(); }
+void layer::copy_channel_data_to_memory() { impl_->copy_channel_data_to_memory(); }
 
 const std::wstring& layer::name() const { return impl_->name_; }
 int layer::opacity() const { return impl_->opacity_; }
@@ -643,7 +735,7 @@ int layer::sheet_color() const { return impl_->sheet_color_; }
 bool layer::is_visible() { return (impl_->flags_ & 2) == 0; }	//the (PSD file-format) documentation is is saying the opposite but what the heck
 bool layer::is_position_protected() { return (impl_->protection_flags_& 4) == 4; }
 
-const layer::mask_info& layer::mask() const { return impl_->mask_; }
+const layer::mask_info& layer::mask() const { impl_->decode_channel_data(); return impl_->mask_; }
 
 const psd::point<double>& layer::text_pos() const { return impl_->text_pos_; }
 const psd::point<double>& layer::scale() const { return impl_->scale_; }
@@ -661,7 +753,7 @@ color<std::uint8_t> layer::solid_color() const { return impl_->solid_color_; }
 
 const point<int>& layer::location() const { return impl_->bitmap_rect_.location; }
 const size<int>& layer::size() const { return impl_->bitmap_rect_.size; }
-const image8bit_ptr& layer::bitmap() const { return impl_->bitmap_; }
+const image8bit_ptr& layer::bitmap() const { impl_->decode_channel_data(); return impl_->bitmap_; }
 
 layer_type layer::group_mode() const { return impl_->layer_type_; }
 int layer::link_group_id() const { return impl_->link_group_id_; }
@@ -123,7 +123,11 @@ public:
 	layer();
 
 	void populate(bigendian_file_input_stream&, const psd_document&);
+	// Only locates the channel data. It is decoded by decode_channel_data(),
+	// or on first use of bitmap() or mask().
 	void read_channel_data(bigendian_file_input_stream&);
+	void decode_channel_data();
+	void copy_channel_data_to_memory();
 
 	const std::wstring& name() const;
 	int opacity() const;
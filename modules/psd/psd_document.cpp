@@ -22,9 +22,17 @@
 #include "psd_document.h"
 #include "descriptor.h"
 #include <iostream>
+#include <ctime>
+#include <list>
 
+#include <common/env.h>
 #include <common/log.h>
 
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <tbb/parallel_for_each.h>
+
 namespace caspar { namespace psd {
 
 psd_document::psd_document()
@@ -40,6 +48,8 @@ void psd_document::parse(const std::wstring& filename)
 	read_color_mode();
 	read_image_resources();
 	read_layers();
+	decode_layers();
+	input_.close();
 }
 
 void psd_document::read_header()
@@ -228,5 +238,80 @@ void psd_document::read_layers()
 	}
 }
 
+void psd_document::decode_layers()
+{
+	// The layers that will be shown are decoded up front, in parallel. The
+	// others keep their compressed data in memory and are only decoded if
+	// used, so that the file does not have to be kept open.
+	tbb::parallel_for_each(layers_.begin(), layers_.end(), [](const layer_ptr& layer)
+	{
+		bool is_dynamic_text = layer->is_text() && !layer->is_static();
+
+		if (layer->is_visible() && layer->group_mode() == layer_type::content && !is_dynamic_text)
+			layer->decode_channel_data();
+		else
+			layer->copy_channel_data_to_memory();
+	});
+}
+
+namespace {
+
+struct cached_document
+{
+	std::wstring						filename;
+	std::time_t							last_write_time;
+	std::uintmax_t						size;
+	spl::shared_ptr<const psd_document>	document;
+};
+
+}
+
+spl::shared_ptr<const psd_document> load_document(const std::wstring& filename)
+{
+	static boost::mutex					mutex;
+	static std::list<cached_document>	documents; // Most recently used first.
+
+	auto max_documents = env::properties().get(L"configuration.psd.cached-documents", 8);
+
+	boost::system::error_code ec;
+	auto last_write_time = boost::filesystem::last_write_time(filename, ec);
+	auto size = boost::filesystem::file_size(filename, ec);
+
+	{
+		boost::lock_guard<boost::mutex> lock(mutex);
+
+		for (auto it = documents.begin(); it != documents.end(); ++it)
+		{
+			if (it->filename != filename)
+				continue;
+
+			if (!ec && it->last_write_time == last_write_time && it->size == size)
+			{
+				documents.splice(documents.begin(), documents, it);
+
+				return it->document;
+			}
+
+			documents.erase(it);
+			break;
+		}
+	}
+
+	auto document = spl::make_shared<psd_document>();
+	document->parse(filename);
+
+	if (ec || max_documents <= 0)
+		return document;
+
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	documents.push_front(cached_document { filename, last_write_time, size, document });
+
+	while (documents.size() > static_cast<std::size_t>(max_documents))
+		documents.pop_back();
+
+	return document;
+}
+
 }	//namespace psd
 }	//namespace caspar
@@ -25,6 +25,8 @@
 #include "misc.h"
 #include "layer.h"
 
+#include <common/memory.h>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <string>
@@ -43,6 +45,11 @@ public:
 		return layers_;
 	}
 
+	const std::vector<layer_ptr>& layers() const
+	{
+		return layers_;
+	}
+
 	int width() const
 	{
 		return width_;
@@ -90,6 +97,7 @@ private:
 	void read_color_mode();
 	void read_image_resources();
 	void read_layers();
+	void decode_layers();
 
 	std::wstring					filename_;
 	bigendian_file_input_stream		input_;
@@ -104,5 +112,17 @@ private:
 	boost::property_tree::wptree	timeline_desc_;
 };
 
+/**
+ * Get a parsed document, parsing it only if it is not among the most
+ * recently used documents or if the file has changed since it was parsed.
+ * The number of documents kept is configured by
+ * configuration.psd.cached-documents.
+ *
+ * @param filename The full path of the psd file.
+ *
+ * @return The document, shared with everyone else using the same file.
+ */
+spl::shared_ptr<const psd_document> load_document(const std::wstring& filename);
+
 }	//namespace psd
 }	//namespace caspar
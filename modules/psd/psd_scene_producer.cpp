@@ -366,18 +366,17 @@ spl::shared_ptr<core::frame_producer> create_psd_scene_producer(const core::fram
 	if (!found_file)
 		return core::frame_producer::empty();
 
-	psd_document doc;
-	doc.parse(*found_file);
+	auto doc = load_document(*found_file);
 
-	auto root = spl::make_shared<core::scene::scene_producer>(L"psd", params.at(0), doc.width(), doc.height(), dependencies.format_desc);
+	auto root = spl::make_shared<core::scene::scene_producer>(L"psd", params.at(0), doc->width(), doc->height(), dependencies.format_desc);
 
 	std::vector<std::pair<std::wstring, spl::shared_ptr<core::text_producer>>> text_producers_by_layer_name;
 
 	std::stack<dependency_resolver> scene_stack;
 	scene_stack.push(dependency_resolver{ root, true });
 
-	auto layers_end = doc.layers().rend();
-	for(auto it = doc.layers().rbegin(); it != layers_end; ++it)
+	auto layers_end = doc->layers().rend();
+	for(auto it = doc->layers().rbegin(); it != layers_end; ++it)
 	{
 		auto& psd_layer = (*it);
 		auto& current = scene_stack.top();
@@ -396,7 +395,7 @@ spl::shared_ptr<core::frame_producer> create_psd_scene_producer(const core::fram
 																																	dependencies.format_desc.name,
 																																	core::find_audio_cadence(dependencies.format_desc.framerate * 2) };
 
-			auto group = spl::make_shared<core::scene::scene_producer>(psd_layer->name(), L"layer group in " + params.at(0), doc.width(), doc.height(), format_desc);
+			auto group = spl::make_shared<core::scene::scene_producer>(psd_layer->name(), L"layer group in " + params.at(0), doc->width(), doc->height(), format_desc);
 
 			auto& scene_layer = current.scene()->create_layer(group, psd_layer->location().x, psd_layer->location().y, psd_layer->name());
 			scene_layer.adjustments.opacity.set(psd_layer->opacity() / 255.0);
@@ -448,7 +447,7 @@ spl::shared_ptr<core::frame_producer> create_psd_scene_producer(const core::fram
 				text_info.scale_y = psd_layer->scale().y / max_scale;
 				text_info.shear = 0;
 
-				auto text_producer = core::text_producer::create(dependencies.frame_factory, 0, 0, str, text_info, doc.width(), doc.height());
+				auto text_producer = core::text_producer::create(dependencies.frame_factory, 0, 0, str, text_info, doc->width(), doc->height());
 				//text_producer->pixel_constraints().width.set(psd_layer->size().width);
 				//text_producer->pixel_constraints().height.set(psd_layer->size().height);
 
@@ -591,8 +590,8 @@ spl::shared_ptr<core::frame_producer> create_psd_scene_producer(const core::fram
 	root->reverse_layers();
 	scene_stack.top().calculate();
 
-	if (doc.has_timeline())
-		create_marks(root, dependencies.format_desc, doc.timeline());
+	if (doc->has_timeline())
+		create_marks(root, dependencies.format_desc, doc->timeline());
 
 	// Reset all dynamic text fields to empty strings and expose them as a scene parameter.
 	for (auto& text_layer : text_producers_by_layer_name) {
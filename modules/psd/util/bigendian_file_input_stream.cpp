@@ -24,8 +24,31 @@
 #include <common/utf.h>
 #include <common/endian.h>
 
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <vector>
+
 namespace caspar { namespace psd {
 
+namespace {
+
+struct file_view
+{
+	boost::interprocess::file_mapping	file;
+	boost::interprocess::mapped_region	region;
+
+	explicit file_view(const std::wstring& filename)
+		: file(u8(filename).c_str(), boost::interprocess::read_only)
+		, region(file, boost::interprocess::read_only)
+	{
+	}
+};
+
+}
+
 bigendian_file_input_stream::bigendian_file_input_stream()
 {
 }
@@ -37,24 +60,59 @@ bigendian_file_input_stream::~bigendian_file_input_stream()
 
 void bigendian_file_input_stream::open(const std::wstring& filename)
 {
-	filename_ = filename;
-	ifs_.open(filename_.c_str(), std::ios::in | std::ios::binary);
-	if(!ifs_.is_open())
+	boost::system::error_code ec;
+	auto size = boost::filesystem::file_size(filename, ec);
+
+	if (ec)
+		CASPAR_THROW_EXCEPTION(file_not_found());
+
+	// An empty file can not be mapped.
+	if (size == 0)
+		CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
+
+	std::shared_ptr<file_view> view;
+
+	try
+	{
+		view = std::make_shared<file_view>(filename);
+	}
+	catch (const boost::interprocess::interprocess_exception&)
+	{
 		CASPAR_THROW_EXCEPTION(file_not_found());
+	}
+
+	data_		= static_cast<const std::uint8_t*>(view->region.get_address());
+	size_		= static_cast<std::streamoff>(view->region.get_size());
+	position_	= 0;
+	storage_	= view;
 }
 
 void bigendian_file_input_stream::close()
 {
-	if(ifs_.is_open())
-		ifs_.close();
+	storage_.reset();
+	data_		= nullptr;
+	size_		= 0;
+	position_	= 0;
 }
 
-std::uint8_t bigendian_file_input_stream::read_byte()
+bigendian_file_input_stream bigendian_file_input_stream::copy_to_memory(std::streamoff offset, std::streamoff length) const
 {
-	std::uint8_t out;
-	read(reinterpret_cast<char*>(&out), 1);
+	if (offset < 0 || length < 0 || offset + length > size_)
+		CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
+
+	auto copy = std::make_shared<std::vector<std::uint8_t>>(data_ + offset, data_ + offset + length);
+
+	bigendian_file_input_stream result;
+	result.data_	= copy->data();
+	result.size_	= length;
+	result.storage_	= copy;
 
-	return out;
+	return result;
+}
+
+std::uint8_t bigendian_file_input_stream::read_byte()
+{
+	return *read_bytes(1);
 }
 
 std::uint16_t bigendian_file_input_stream::read_short()
@@ -85,30 +143,33 @@ double bigendian_file_input_stream::read_double()
 void bigendian_file_input_stream::read(char* buf, std::streamsize length)
 {
 	if (length > 0)
-	{
-		if (ifs_.eof())
-			CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
+		std::memcpy(buf, read_bytes(length), static_cast<std::size_t>(length));
+}
 
-		ifs_.read(buf, length);
-		
-		if (ifs_.gcount() < length)
-			CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
-	}
+const std::uint8_t* bigendian_file_input_stream::read_bytes(std::streamsize length)
+{
+	if (length < 0 || position_ < 0 || position_ + length > size_)
+		CASPAR_THROW_EXCEPTION(unexpected_eof_exception());
+
+	auto result = data_ + position_;
+	position_ += length;
+
+	return result;
 }
 
 std::streamoff bigendian_file_input_stream::current_position()
 {
-	return ifs_.tellg();
+	return position_;
 }
 
 void bigendian_file_input_stream::set_position(std::streamoff offset)
 {
-	ifs_.seekg(offset, std::ios_base::beg);
+	position_ = offset;
 }
 
 void bigendian_file_input_stream::discard_bytes(std::streamoff length)
 {
-	ifs_.seekg(length, std::ios_base::cur);
+	position_ += length;
 }
 
 void bigendian_file_input_stream::discard_to_next_word()
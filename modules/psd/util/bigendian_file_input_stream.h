@@ -23,16 +23,21 @@
 
 #include <common/except.h>
 
-#include <boost/filesystem/fstream.hpp>
-
 #include <string>
-#include <fstream>
+#include <memory>
+#include <ios>
 #include <cstdint>
 
 namespace caspar { namespace psd {
 
 struct unexpected_eof_exception : virtual io_error {};
 
+/**
+ * Reads big endian data from a memory mapped file.
+ * <p>
+ * Copies share the mapping but have their own position, so different parts
+ * of a file can be read from different threads.
+ */
 class bigendian_file_input_stream
 {
 public:
@@ -42,6 +47,7 @@ public:
 	void open(const std::wstring& filename);
 
 	void read(char*, std::streamsize);
+	const std::uint8_t* read_bytes(std::streamsize);
 	std::uint8_t read_byte();
 	std::uint16_t read_short();
 	std::uint32_t read_long();
@@ -57,10 +63,23 @@ public:
 	std::streamoff current_position();
 	void set_position(std::streamoff);
 
+	/**
+	 * Copy a part of the file into memory so that it can still be read after
+	 * the file has been closed.
+	 *
+	 * @param offset The start of the part in the file.
+	 * @param length The number of bytes.
+	 *
+	 * @return A stream over the copy, with position 0 being offset.
+	 */
+	bigendian_file_input_stream copy_to_memory(std::streamoff offset, std::streamoff length) const;
+
 	void close();
 private:
-	boost::filesystem::ifstream	ifs_;
-	std::wstring				filename_;
+	std::shared_ptr<const void>	storage_;
+	const std::uint8_t*			data_		= nullptr;
+	std::streamoff				size_		= 0;
+	std::streamoff				position_	= 0;
 };
 
 class StreamPositionBackup
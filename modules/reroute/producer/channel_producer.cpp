@@ -357,7 +357,8 @@ spl::shared_ptr<core::frame_producer> create_channel_producer(
 			[producer] { return producer->current_framerate(); },
 			dependencies.format_desc.framerate,
 			dependencies.format_desc.field_mode,
-			dependencies.format_desc.audio_cadence);
+			dependencies.format_desc.audio_cadence,
+			dependencies.frame_factory);
 }
 
 }}
@@ -37,6 +37,8 @@
 #include <common/os/system_info.h>
 #include <common/os/filesystem.h>
 #include <common/base64.h>
+#include <common/diagnostics/memory_accounting.h>
+#include <common/diagnostics/trace.h>
 #include <common/thread_info.h>
 #include <common/filesystem.h>
 
@@ -307,7 +309,9 @@ core::frame_producer_dependencies get_producer_dependencies(const std::shared_pt
 			get_channels(ctx),
 			channel->video_format_desc(),
 			ctx.producer_registry,
-			ctx.cg_registry);
+			ctx.cg_registry,
+			channel->freewheel(),
+			channel->affinity());
 }
 
 // Basic Commands
@@ -2620,7 +2624,7 @@ void info_threads_describer(core::help_sink& sink, const core::help_repository&
 {
 	sink.short_description(L"Lists all known threads in the server.");
 	sink.syntax(L"INFO THREADS");
-	sink.para()->text(L"Lists all known threads in the server.");
+	sink.para()->text(L"Lists all known threads in the server. Threads bound to processors, like the threads of channels configured with a numa-node or cpus, are followed by the processors within brackets.");
 }
 
 std::wstring info_threads_command(command_context& ctx)
@@ -2630,7 +2634,12 @@ std::wstring info_threads_command(command_context& ctx)
 
 	for (auto& thread : get_thread_infos())
 	{
-		replyString << thread->native_id << L" " << u16(thread->name) << L"\r\n";
+		replyString << thread->native_id << L" " << u16(thread->name);
+
+		if (!thread->affinity.empty())
+			replyString << L" [" << u16(thread->affinity) << L"]";
+
+		replyString << L"\r\n";
 	}
 
 	replyString << L"\r\n";
@@ -2658,6 +2667,71 @@ std::wstring info_delay_command(command_context& ctx)
 	return create_info_xml_reply(info, L"DELAY");
 }
 
+void info_stats_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Get frame latency statistics of all channels.");
+	sink.syntax(L"INFO STATS");
+	sink.para()->text(L"Gets latency statistics for every channel, for each of its stages and for each layer and consumer.");
+	sink.para()->text(L"All times are in microseconds:");
+	sink.definitions()
+		->item(L"count", L"The number of frames measured.")
+		->item(L"p50, p90, p99, p999", L"The percentiles, within 1/16 of the actual value.")
+		->item(L"max", L"The longest time measured.")
+		->item(L"budget", L"The duration of a frame, or 0 for a freewheeling channel.")
+		->item(L"late", L"The number of frames that took longer than the budget.")
+		->item(L"underflows", L"The number of frames a producer did not have ready in time.");
+	sink.para()->text(L"The percentiles of the last second are also published over OSC, under for example ")
+		->code(L"/channel/1/mixer/latency/p99")->text(L".");
+}
+
+std::wstring info_stats_command(command_context& ctx)
+{
+	boost::property_tree::wptree info;
+
+	for (auto& channel : ctx.channels)
+	{
+		info.add_child(L"channels.channel", channel.channel->stats_info())
+			.add(L"index", channel.channel->index());
+	}
+
+	return create_info_xml_reply(info, L"STATS");
+}
+
+void info_channel_stats_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Get frame latency statistics of a channel.");
+	sink.syntax(L"INFO [video_channel:int] STATS");
+	sink.para()->text(L"Gets the latency statistics of the specified channel, like ")->see(L"INFO STATS")->text(L" does for all channels.");
+}
+
+std::wstring info_channel_stats_command(command_context& ctx)
+{
+	boost::property_tree::wptree info;
+
+	info.add_child(L"channel", ctx.channel.channel->stats_info())
+		.add(L"index", ctx.channel_index);
+
+	return create_info_xml_reply(info, L"STATS");
+}
+
+void info_memory_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Get the memory held by the server.");
+	sink.syntax(L"INFO MEMORY");
+	sink.para()->text(L"Gets the bytes held by each subsystem, like the packets read ahead by ffmpeg inputs and the image cache, "
+		L"broken down per channel and layer, together with the budgets configured under ")->code(L"memory-budget")->text(L".");
+	sink.para()->text(L"A budget of 0 means that there is no budget.");
+}
+
+std::wstring info_memory_command(command_context& ctx)
+{
+	boost::property_tree::wptree info;
+
+	info.add_child(L"memory", caspar::diagnostics::get_memory_info());
+
+	return create_info_xml_reply(info, L"MEMORY");
+}
+
 void diag_describer(core::help_sink& sink, const core::help_repository& repo)
 {
 	sink.short_description(L"Open the diagnostics window.");
@@ -2716,6 +2790,67 @@ std::wstring gl_gc_command(command_context& ctx)
 	return L"202 GL GC OK\r\n";
 }
 
+void trace_start_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Start tracing executor tasks.");
+	sink.syntax(L"TRACE START");
+	sink.para()->text(L"Clears any previously traced events and starts recording when each task of each thread was enqueued, started and ended. ")
+		->text(L"Only the most recent events of each thread are kept. Use ")->see(L"TRACE DUMP")->text(L" to write them to a file.");
+}
+
+std::wstring trace_start_command(command_context& ctx)
+{
+	caspar::diagnostics::trace::clear();
+	caspar::diagnostics::trace::enable(true);
+
+	return L"202 TRACE START OK\r\n";
+}
+
+void trace_stop_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Stop tracing executor tasks.");
+	sink.syntax(L"TRACE STOP");
+	sink.para()->text(L"Stops recording events. The events recorded so far are kept until the next ")->see(L"TRACE START")->text(L".");
+}
+
+std::wstring trace_stop_command(command_context& ctx)
+{
+	caspar::diagnostics::trace::enable(false);
+
+	return L"202 TRACE STOP OK\r\n";
+}
+
+void trace_dump_describer(core::help_sink& sink, const core::help_repository& repo)
+{
+	sink.short_description(L"Write the traced events to a file.");
+	sink.syntax(L"TRACE DUMP {[name:string]}");
+	sink.para()->text(L"Writes the traced events to ")->code(L"name")->text(L".json in the log folder, in the Chrome trace event format ")
+		->text(L"that can be opened in chrome://tracing or Perfetto. Without a name the file is named after the current time. ")
+		->text(L"Returns the path of the file.");
+	sink.para()->text(L"Examples:");
+	sink.example(L">> TRACE DUMP");
+	sink.example(L">> TRACE DUMP late_frame");
+}
+
+std::wstring trace_dump_command(command_context& ctx)
+{
+	auto name = ctx.parameters.empty()
+			? L"trace-" + boost::posix_time::to_iso_wstring(boost::posix_time::second_clock::local_time())
+			: boost::filesystem::path(ctx.parameters.at(0)).filename().wstring();
+	auto path = boost::filesystem::path(env::log_folder()) / (name + L".json");
+
+	boost::filesystem::ofstream file(path);
+
+	if (!file)
+		CASPAR_THROW_EXCEPTION(caspar_exception() << msg_info(L"Could not open file " + path.wstring()));
+
+	auto num_events = caspar::diagnostics::trace::write_chrome_trace(file);
+
+	CASPAR_LOG(info) << L"Wrote " << num_events << L" traced events to " << path.wstring();
+
+	return L"201 TRACE DUMP OK\r\n" + path.wstring() + L"\r\n";
+}
+
 static const int WIDTH = 80;
 
 struct max_width_sink : public core::help_sink
@@ -3086,9 +3221,15 @@ void register_commands(amcp_command_repository& repo)
 	repo.register_command(			L"Query Commands",		L"INFO QUEUES",					info_queues_describer,				info_queues_command,			0);
 	repo.register_command(			L"Query Commands",		L"INFO THREADS",				info_threads_describer,				info_threads_command,			0);
 	repo.register_channel_command(	L"Query Commands",		L"INFO DELAY",					info_delay_describer,				info_delay_command,				0);
+	repo.register_command(			L"Query Commands",		L"INFO STATS",					info_stats_describer,				info_stats_command,				0);
+	repo.register_channel_command(	L"Query Commands",		L"INFO STATS",					info_channel_stats_describer,		info_channel_stats_command,		0);
+	repo.register_command(			L"Query Commands",		L"INFO MEMORY",					info_memory_describer,				info_memory_command,			0);
 	repo.register_command(			L"Query Commands",		L"DIAG",						diag_describer,						diag_command,					0);
 	repo.register_command(			L"Query Commands",		L"GL INFO",						gl_info_describer,					gl_info_command,				0);
 	repo.register_command(			L"Query Commands",		L"GL GC",						gl_gc_describer,					gl_gc_command,					0);
+	repo.register_command(			L"Query Commands",		L"TRACE START",					trace_start_describer,				trace_start_command,			0);
+	repo.register_command(			L"Query Commands",		L"TRACE STOP",					trace_stop_describer,				trace_stop_command,				0);
+	repo.register_command(			L"Query Commands",		L"TRACE DUMP",					trace_dump_describer,				trace_dump_command,				0);
 	repo.register_command(			L"Query Commands",		L"BYE",							bye_describer,						bye_command,					0);
 	repo.register_command(			L"Query Commands",		L"KILL",						kill_describer,						kill_command,					0);
 	repo.register_command(			L"Query Commands",		L"RESTART",						restart_describer,					restart_command,				0);
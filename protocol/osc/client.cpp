@@ -36,13 +36,19 @@
 
 #include <core/monitor/monitor.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <map>
 #include <vector>
 #include <unordered_map>
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/chrono.hpp>
 
 #include <tbb/spin_mutex.h>
 
@@ -74,10 +80,13 @@ struct param_visitor : public boost::static_visitor<void>
 	void operator()(const std::vector<int8_t>& value)	{o << ::osc::Blob(value.data(), static_cast<unsigned long>(value.size()));}
 };
 
-void write_osc_event(byte_vector& destination, const core::monitor::message& message, int retry_allocation_attempt = 0)
+/**
+ * @param max_size	The size to encode into at first, raised to the size
+ *					required when it was too small, so it is known the next
+ *					time.
+ */
+void write_osc_event(byte_vector& destination, const core::monitor::message& message, std::size_t& max_size, int retry_allocation_attempt = 0)
 {
-	static std::size_t max_size = 128;
-
 	destination.resize(max_size);
 
 	::osc::OutboundPacketStream o(reinterpret_cast<char*>(destination.data()), static_cast<unsigned long>(destination.size()));
@@ -99,7 +108,7 @@ void write_osc_event(byte_vector& destination, const core::monitor::message& mes
 
 		max_size = e.required;
 		CASPAR_LOG(trace) << L"[osc] Too small buffer for osc message. Increasing to " << max_size;
-		return write_osc_event(destination, message, retry_allocation_attempt + 1);
+		return write_osc_event(destination, message, max_size, retry_allocation_attempt + 1);
 	}
 
 	destination.resize(o.Size());
@@ -133,23 +142,70 @@ void write_osc_bundle_element_start(byte_vector& destination, const byte_vector&
 
 struct client::impl : public spl::enable_shared_from_this<client::impl>, core::monitor::sink
 {
+	typedef boost::chrono::steady_clock clock;
+
+	struct subscription
+	{
+		int						reference_count			= 0;
+		int						max_updates_per_second	= 0;
+	};
+
+	// Paths no longer published are forgotten after this long, so that they
+	// are not sent to new subscribers. Monitored values are published every
+	// frame, or at least every second.
+	static const int PATH_EXPIRY_SECONDS = 10;
+
+	// The latest encoded value of an OSC path. Paths are interned to an index
+	// into a vector so that the sender never has to hash them. The indexes of
+	// expired paths are reused, which is why versions are unique across all
+	// slots rather than counted per slot.
+	struct slot
+	{
+		byte_vector				data;
+		std::uint64_t			version			= 0; // 0 when unused.
+		bool					dirty			= false;
+		clock::time_point		last_published;
+	};
+
+	// Encodes on the publishing thread.
+	struct encoder
+	{
+		byte_vector				buffer;
+		std::size_t				max_size		= 128;
+	};
+
+	// What has been sent to a subscriber, kept by the sender thread only.
+	struct subscriber_state
+	{
+		clock::duration				min_interval	= clock::duration::zero();
+		clock::time_point			next_send		= clock::time_point::min();
+		std::vector<std::uint64_t>	sent_versions;
+	};
+
 	std::shared_ptr<boost::asio::io_service>		service_;
 	udp::socket										socket_;
+	const std::size_t								max_datagram_size_;
 	tbb::spin_mutex									endpoints_mutex_;
-	std::map<udp::endpoint, int>					reference_counts_by_endpoint_;
-
-	std::unordered_map<std::string, byte_vector>	updates_;
-	boost::mutex									updates_mutex_;								
+	std::map<udp::endpoint, subscription>			subscriptions_by_endpoint_;
+
+	std::unordered_map<std::string, int>			path_ids_;
+	std::vector<slot>								slots_;
+	std::vector<int>								dirty_ids_;
+	std::vector<int>								free_ids_;
+	std::uint64_t									last_version_	= 0;
+	boost::mutex									updates_mutex_;
 	boost::condition_variable						updates_cond_;
+	boost::thread_specific_ptr<encoder>				encoders_;
 
 	tbb::atomic<bool>								is_running_;
 
 	boost::thread									thread_;
 	
 public:
-	impl(std::shared_ptr<boost::asio::io_service> service)
+	impl(std::shared_ptr<boost::asio::io_service> service, int max_datagram_size)
 		: service_(std::move(service))
 		, socket_(*service_, udp::v4())
+		, max_datagram_size_(static_cast<std::size_t>(std::max(64, max_datagram_size)))
 		, thread_(boost::bind(&impl::run, this))
 	{
 	}
@@ -164,11 +220,19 @@ public:
 	}
 
 	std::shared_ptr<void> get_subscription_token(
-			const boost::asio::ip::udp::endpoint& endpoint)
+			const boost::asio::ip::udp::endpoint& endpoint,
+			int max_updates_per_second)
 	{
 		tbb::spin_mutex::scoped_lock lock(endpoints_mutex_);
 
-		++reference_counts_by_endpoint_[endpoint];
+		auto& subscription = subscriptions_by_endpoint_[endpoint];
+		++subscription.reference_count;
+
+		// The least restrictive rate wins when an endpoint is subscribed twice.
+		if (subscription.reference_count == 1 || max_updates_per_second <= 0)
+			subscription.max_updates_per_second = std::max(0, max_updates_per_second);
+		else if (subscription.max_updates_per_second > 0)
+			subscription.max_updates_per_second = std::max(subscription.max_updates_per_second, max_updates_per_second);
 
 		std::weak_ptr<impl> weak_self = shared_from_this();
 
@@ -184,115 +248,212 @@ public:
 			tbb::spin_mutex::scoped_lock lock(self.endpoints_mutex_);
 
 			int reference_count_after =
-				--self.reference_counts_by_endpoint_[endpoint];
+				--self.subscriptions_by_endpoint_[endpoint].reference_count;
 
 			if (reference_count_after == 0)
-				self.reference_counts_by_endpoint_.erase(endpoint);
+				self.subscriptions_by_endpoint_.erase(endpoint);
 		});
 	}
 private:
 	void propagate(const core::monitor::message& msg)
 	{
-		boost::lock_guard<boost::mutex> lock(updates_mutex_);
+		// Encode outside of the lock into a per thread buffer, which is then
+		// swapped with the buffer of the slot, so no allocations are needed
+		// once the buffers have grown to size.
+		if (!encoders_.get())
+			encoders_.reset(new encoder);
+
+		auto& encoder = *encoders_;
+		auto& encoded = encoder.buffer;
 
-		try 
+		try
 		{
-			write_osc_event(updates_[msg.path()], msg);
+			write_osc_event(encoded, msg, encoder.max_size);
 		}
 		catch(...)
 		{
 			CASPAR_LOG_CURRENT_EXCEPTION();
-			updates_.erase(msg.path());
+			return;
 		}
 
+		boost::lock_guard<boost::mutex> lock(updates_mutex_);
+
+		auto id = intern(msg.path());
+		auto& slot = slots_[id];
+
+		slot.last_published = clock::now();
+
+		// Unchanged values are not sent again.
+		if (slot.version > 0 && slot.data.size() == encoded.size()
+				&& std::memcmp(slot.data.data(), encoded.data(), encoded.size()) == 0)
+			return;
+
+		std::swap(slot.data, encoded);
+		slot.version = ++last_version_;
+		mark_dirty(id);
+
 		updates_cond_.notify_one();
 	}
 
+	int intern(const std::string& path)
+	{
+		auto result = path_ids_.find(path);
+
+		if (result != path_ids_.end())
+			return result->second;
+
+		int id;
+
+		if (free_ids_.empty())
+		{
+			id = static_cast<int>(slots_.size());
+			slots_.emplace_back();
+		}
+		else
+		{
+			id = free_ids_.back();
+			free_ids_.pop_back();
+		}
+
+		path_ids_.insert(std::make_pair(path, id));
+
+		return id;
+	}
+
+	void mark_dirty(int id)
+	{
+		auto& slot = slots_[id];
+
+		if (!slot.dirty)
+		{
+			slot.dirty = true;
+			dirty_ids_.push_back(id);
+		}
+	}
+
+	// Called with updates_mutex_ held.
+	void expire_paths(clock::time_point now)
+	{
+		auto oldest_allowed = now - boost::chrono::seconds(PATH_EXPIRY_SECONDS);
+
+		for (auto it = path_ids_.begin(); it != path_ids_.end();)
+		{
+			auto id = it->second;
+			auto& slot = slots_[id];
+
+			if (slot.last_published >= oldest_allowed)
+			{
+				++it;
+				continue;
+			}
+
+			// The sender gets the unused slot, so it forgets the value too.
+			slot.data.clear();
+			slot.version = 0;
+			mark_dirty(id);
+			free_ids_.push_back(id);
+			it = path_ids_.erase(it);
+		}
+	}
+
 	template<typename T>
 	void do_send(
-			const T& buffers, const std::vector<udp::endpoint>& destinations)
+			const T& buffers, const udp::endpoint& destination)
 	{
 		boost::system::error_code ec;
 
-		for (const auto& endpoint : destinations)
-			socket_.send_to(buffers, endpoint, 0, ec);
+		socket_.send_to(buffers, destination, 0, ec);
 	}
 
 	void run()
 	{
-		// http://stackoverflow.com/questions/14993000/the-most-reliable-and-efficient-udp-packet-size
-		const int SAFE_DATAGRAM_SIZE = 508;
-
 		ensure_gpf_handler_installed_for_thread("osc-sender-thread");
 
 		try
 		{
 			is_running_ = true;
 
-			std::unordered_map<std::string, byte_vector> updates;
-			std::vector<udp::endpoint> destinations;
+			std::vector<slot> slots;
+			std::vector<std::pair<udp::endpoint, int>> subscriptions;
+			std::map<udp::endpoint, subscriber_state> subscribers;
 			const byte_vector bundle_header = write_osc_bundle_start();
 			std::vector<byte_vector> element_headers;
+			std::vector<boost::asio::const_buffers_1> buffers;
+			auto wake_up_at = clock::time_point::max();
+			auto next_expiry = clock::now() + boost::chrono::seconds(PATH_EXPIRY_SECONDS);
 
 			while (is_running_)
-			{		
-				updates.clear();
-				destinations.clear();
+			{
+				subscriptions.clear();
 
-				{			
+				{
 					boost::unique_lock<boost::mutex> cond_lock(updates_mutex_);
 
 					if (!is_running_)
 						return;
 
-					if (updates_.empty())
-						updates_cond_.wait(cond_lock);
+					if (dirty_ids_.empty())
+						updates_cond_.wait_until(cond_lock, std::min(wake_up_at, next_expiry));
+
+					if (clock::now() >= next_expiry)
+					{
+						expire_paths(clock::now());
+						next_expiry = clock::now() + boost::chrono::seconds(PATH_EXPIRY_SECONDS);
+					}
+
+					// Copy the changed slots into the sender's own table. The
+					// buffers keep their capacity between rounds.
+					slots.resize(slots_.size());
+
+					for (auto id : dirty_ids_)
+					{
+						auto& source = slots_[id];
+						auto& destination = slots[id];
+
+						destination.data.assign(source.data.begin(), source.data.end());
+						destination.version = source.version;
+						source.dirty = false;
+					}
 
-					std::swap(updates, updates_);
+					dirty_ids_.clear();
 				}
 
 				{
 					tbb::spin_mutex::scoped_lock lock(endpoints_mutex_);
 
-					for (const auto& endpoint : reference_counts_by_endpoint_)
-						destinations.push_back(endpoint.first);
+					for (const auto& subscription : subscriptions_by_endpoint_)
+						subscriptions.push_back(std::make_pair(subscription.first, subscription.second.max_updates_per_second));
 				}
 
-				if (destinations.empty())
-					continue;
+				sync_subscribers(subscribers, subscriptions);
 
-				std::vector<boost::asio::const_buffers_1> buffers;
-				element_headers.resize(
-						std::max(element_headers.size(), updates.size()));
+				element_headers.resize(std::max(element_headers.size(), slots.size()));
 
-				int i = 0;
-				auto datagram_size = bundle_header.size();
-				buffers.push_back(boost::asio::buffer(bundle_header));
+				for (std::size_t i = 0; i < slots.size(); ++i)
+					write_osc_bundle_element_start(element_headers[i], slots[i].data);
+
+				auto now = clock::now();
+				wake_up_at = clock::time_point::max();
 
-				for (const auto& slot : updates)
+				for (auto& subscriber : subscribers)
 				{
-					write_osc_bundle_element_start(element_headers[i], slot.second);
-					const auto& headers = element_headers;
+					auto& state = subscriber.second;
+					state.sent_versions.resize(slots.size(), 0);
 
-					auto size_of_element = headers[i].size() + slot.second.size();
-	
-					if (datagram_size + size_of_element >= SAFE_DATAGRAM_SIZE)
+					if (!has_unsent(slots, state))
+						continue;
+
+					// Rate limited subscribers get the latest values when
+					// their interval has passed.
+					if (now < state.next_send)
 					{
-						do_send(buffers, destinations);
-						buffers.clear();
-						buffers.push_back(boost::asio::buffer(bundle_header));
-						datagram_size = bundle_header.size();
+						wake_up_at = std::min(wake_up_at, state.next_send);
+						continue;
 					}
 
-					buffers.push_back(boost::asio::buffer(headers[i]));
-					buffers.push_back(boost::asio::buffer(slot.second));
-
-					datagram_size += size_of_element;
-					++i;
+					send_unsent(slots, element_headers, bundle_header, buffers, subscriber.first, state);
+					state.next_send = now + state.min_interval;
 				}
-			
-				if (!buffers.empty())
-					do_send(buffers, destinations);
 			}
 		}
 		catch (...)
@@ -300,10 +461,87 @@ private:
 			CASPAR_LOG_CURRENT_EXCEPTION();
 		}
 	}
+
+	void sync_subscribers(
+			std::map<udp::endpoint, subscriber_state>& subscribers,
+			const std::vector<std::pair<udp::endpoint, int>>& subscriptions)
+	{
+		for (auto it = subscribers.begin(); it != subscribers.end();)
+		{
+			auto found = std::find_if(subscriptions.begin(), subscriptions.end(), [&](const std::pair<udp::endpoint, int>& subscription)
+			{
+				return subscription.first == it->first;
+			});
+
+			if (found == subscriptions.end())
+				it = subscribers.erase(it);
+			else
+				++it;
+		}
+
+		for (const auto& subscription : subscriptions)
+		{
+			auto& state = subscribers[subscription.first];
+
+			state.min_interval = subscription.second > 0
+					? boost::chrono::duration_cast<clock::duration>(boost::chrono::seconds(1)) / subscription.second
+					: clock::duration::zero();
+		}
+	}
+
+	static bool has_unsent(const std::vector<slot>& slots, const subscriber_state& state)
+	{
+		for (std::size_t i = 0; i < slots.size(); ++i)
+		{
+			if (slots[i].version > state.sent_versions[i])
+				return true;
+		}
+
+		return false;
+	}
+
+	void send_unsent(
+			const std::vector<slot>& slots,
+			const std::vector<byte_vector>& element_headers,
+			const byte_vector& bundle_header,
+			std::vector<boost::asio::const_buffers_1>& buffers,
+			const udp::endpoint& destination,
+			subscriber_state& state)
+	{
+		buffers.clear();
+		buffers.push_back(boost::asio::buffer(bundle_header));
+		auto datagram_size = bundle_header.size();
+
+		for (std::size_t i = 0; i < slots.size(); ++i)
+		{
+			if (slots[i].version <= state.sent_versions[i])
+				continue;
+
+			auto size_of_element = element_headers[i].size() + slots[i].data.size();
+
+			// Pack as many messages as fits in one datagram.
+			if (buffers.size() > 1 && datagram_size + size_of_element > max_datagram_size_)
+			{
+				do_send(buffers, destination);
+				buffers.clear();
+				buffers.push_back(boost::asio::buffer(bundle_header));
+				datagram_size = bundle_header.size();
+			}
+
+			buffers.push_back(boost::asio::buffer(element_headers[i]));
+			buffers.push_back(boost::asio::buffer(slots[i].data));
+
+			datagram_size += size_of_element;
+			state.sent_versions[i] = slots[i].version;
+		}
+
+		if (buffers.size() > 1)
+			do_send(buffers, destination);
+	}
 };
 
-client::client(std::shared_ptr<boost::asio::io_service> service)
-	: impl_(new impl(std::move(service)))
+client::client(std::shared_ptr<boost::asio::io_service> service, int max_datagram_size)
+	: impl_(new impl(std::move(service), max_datagram_size))
 {
 }
 
@@ -323,9 +561,10 @@ client::~client()
 }
 
 std::shared_ptr<void> client::get_subscription_token(
-			const boost::asio::ip::udp::endpoint& endpoint)
+			const boost::asio::ip::udp::endpoint& endpoint,
+			int max_updates_per_second)
 {
-	return impl_->get_subscription_token(endpoint);
+	return impl_->get_subscription_token(endpoint, max_updates_per_second);
 }
 
 spl::shared_ptr<core::monitor::sink> client::sink()
@@ -40,7 +40,14 @@ public:
 
 	// Constructors
 
-	client(std::shared_ptr<boost::asio::io_service> service);
+	/**
+	 * Constructor.
+	 *
+	 * @param service           The io_service to create the socket with.
+	 * @param max_datagram_size The maximum size of each UDP datagram. Bundles
+	 *                          are packed with as many messages as fits.
+	 */
+	client(std::shared_ptr<boost::asio::io_service> service, int max_datagram_size = 1472);
 	
 	client(client&&);
 
@@ -50,12 +57,19 @@ public:
 	 * the token is dropped unless another token to the same endpoint has
 	 * previously been checked out.
 	 *
-	 * @param endpoint The UDP endpoint to send OSC messages to.
+	 * Only changed values are sent. A rate limited endpoint receives the
+	 * latest value of each changed path at most max_updates_per_second times
+	 * per second.
+	 *
+	 * @param endpoint               The UDP endpoint to send OSC messages to.
+	 * @param max_updates_per_second The maximum number of times per second to
+	 *                               send to the endpoint, 0 for no limit.
 	 *
 	 * @return The token. It is ok for the token to outlive the client
 	 */
 	std::shared_ptr<void> get_subscription_token(
-			const boost::asio::ip::udp::endpoint& endpoint);
+			const boost::asio::ip::udp::endpoint& endpoint,
+			int max_updates_per_second = 0);
 
 	~client();
 
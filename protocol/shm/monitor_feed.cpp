@@ -0,0 +1,382 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../StdAfx.h"
+
+#include "monitor_feed.h"
+
+#include <common/log.h>
+#include <common/utf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/variant/static_visitor.hpp>
+
+namespace caspar { namespace protocol { namespace shm {
+
+namespace {
+
+class value_writer : public boost::static_visitor<void>
+{
+	monitor_feed_entry&	entry_;
+	std::uint32_t		text_used_	= 0;
+public:
+	explicit value_writer(monitor_feed_entry& entry)
+		: entry_(entry)
+	{
+		entry_.num_values = 0;
+	}
+
+	void operator()(bool value)							{ add(value ? 'T' : 'F'); }
+	void operator()(std::int32_t value)					{ add('h').integer = value; }
+	void operator()(std::int64_t value)					{ add('h').integer = value; }
+	void operator()(float value)						{ add('d').real = value; }
+	void operator()(double value)						{ add('d').real = value; }
+	void operator()(const std::string& value)			{ add_text('s', value.data(), value.size()); }
+	void operator()(const std::wstring& value)			{ operator()(u8(value)); }
+	void operator()(const std::vector<std::int8_t>& value)	{ add_text('b', value.data(), value.size()); }
+private:
+	monitor_feed_value& add(char type)
+	{
+		static monitor_feed_value ignored;
+
+		if (entry_.num_values == MONITOR_FEED_MAX_VALUES)
+			return ignored;
+
+		entry_.types[entry_.num_values] = type;
+
+		return entry_.values[entry_.num_values++];
+	}
+
+	void add_text(char type, const void* data, std::size_t size)
+	{
+		// Text that does not fit is truncated.
+		auto length = static_cast<std::uint32_t>(std::min<std::size_t>(size, MONITOR_FEED_TEXT_SIZE - text_used_));
+		auto& value = add(type);
+
+		value.text.offset = text_used_;
+		value.text.length = length;
+		std::memcpy(entry_.text + text_used_, data, length);
+		text_used_ += length;
+	}
+};
+
+}
+
+struct monitor_feed::impl : public core::monitor::sink
+{
+	typedef boost::chrono::steady_clock clock;
+
+	// Paths no longer published are removed after this long, so that readers
+	// do not see the state of layers and consumers that are gone. Monitored
+	// values are published every frame, or at least every second.
+	static const int PATH_EXPIRY_SECONDS = 10;
+
+	// Writer side state of an entry. The generation changes whenever the
+	// entry is taken from its path, which invalidates cached ids.
+	struct slot
+	{
+		std::atomic<std::uint32_t>	generation;
+		std::atomic<std::int64_t>	last_published;
+	};
+
+	struct cached_id
+	{
+		int							id;
+		std::uint32_t				generation;
+	};
+
+	// The ids of the paths a thread publishes, so that publishing an already
+	// known path takes no shared lock. Every channel publishes from its own
+	// threads, so these are never contended.
+	typedef std::unordered_map<std::string, cached_id> id_cache;
+
+	const std::string								name_;
+	const int										capacity_;
+	boost::interprocess::shared_memory_object		shared_memory_;
+	boost::interprocess::mapped_region				region_;
+	monitor_feed_header&							header_;
+	monitor_feed_entry*								entries_;
+	std::unique_ptr<slot[]>							slots_;
+	boost::thread_specific_ptr<id_cache>			id_caches_;
+	std::atomic<std::int64_t>						next_expiry_;
+
+	boost::mutex									mutex_;
+	std::unordered_map<std::string, int>			entry_ids_;
+	std::vector<int>								free_ids_;
+	int												num_entries_	= 0;
+	bool											full_logged_	= false;
+public:
+	impl(const std::string& name, int capacity)
+		: name_(name)
+		, capacity_(std::max(1, capacity))
+		, shared_memory_(create(name_, capacity_))
+		, region_(shared_memory_, boost::interprocess::read_write)
+		, header_(*static_cast<monitor_feed_header*>(region_.get_address()))
+		, entries_(reinterpret_cast<monitor_feed_entry*>(static_cast<char*>(region_.get_address()) + sizeof(monitor_feed_header)))
+		, slots_(new slot[capacity_])
+	{
+		std::memset(region_.get_address(), 0, region_.get_size());
+		std::memcpy(header_.magic, MONITOR_FEED_MAGIC, sizeof(MONITOR_FEED_MAGIC));
+		header_.layout_version	= MONITOR_FEED_LAYOUT_VERSION;
+		header_.entry_size		= sizeof(monitor_feed_entry);
+		header_.capacity		= static_cast<std::uint32_t>(capacity_);
+		header_.num_entries.store(0, std::memory_order_release);
+
+		for (int id = 0; id < capacity_; ++id)
+		{
+			slots_[id].generation.store(0, std::memory_order_relaxed);
+			slots_[id].last_published.store(0, std::memory_order_relaxed);
+		}
+
+		next_expiry_.store(ticks(clock::now()) + expiry_ticks(), std::memory_order_relaxed);
+
+		CASPAR_LOG(info) << L"[monitor_feed] Publishing monitor state in shared memory " << u16(name_);
+	}
+
+	~impl()
+	{
+		boost::interprocess::shared_memory_object::remove(name_.c_str());
+	}
+
+	void propagate(const core::monitor::message& msg) override
+	{
+		if (msg.path().size() >= MONITOR_FEED_MAX_PATH)
+			return;
+
+		auto now = ticks(clock::now());
+
+		if (now >= next_expiry_.load(std::memory_order_relaxed))
+			expire_paths(now);
+
+		auto& cache = id_cache_of_current_thread();
+		auto cached = cache.find(msg.path());
+
+		if (cached != cache.end() && write(cached->second, msg, now))
+			return;
+
+		if (cached != cache.end())
+			cache.erase(cached);
+
+		auto id = find_or_create_entry(msg.path());
+
+		if (id.id == -1)
+			return;
+
+		// The cache is only a shortcut, so it is simply dropped when it holds
+		// far more paths than are published.
+		if (cache.size() >= static_cast<std::size_t>(capacity_) * 2)
+			cache.clear();
+
+		cache.insert(std::make_pair(msg.path(), id));
+		write(id, msg, now);
+	}
+private:
+	static boost::interprocess::shared_memory_object create(const std::string& name, int capacity)
+	{
+		using namespace boost::interprocess;
+
+		shared_memory_object::remove(name.c_str());
+		shared_memory_object result(create_only, name.c_str(), read_write);
+		result.truncate(sizeof(monitor_feed_header) + sizeof(monitor_feed_entry) * capacity);
+
+		return result;
+	}
+
+	static std::int64_t ticks(clock::time_point time)
+	{
+		return time.time_since_epoch().count();
+	}
+
+	static std::int64_t expiry_ticks()
+	{
+		return boost::chrono::duration_cast<clock::duration>(boost::chrono::seconds(PATH_EXPIRY_SECONDS)).count();
+	}
+
+	id_cache& id_cache_of_current_thread()
+	{
+		auto cache = id_caches_.get();
+
+		if (!cache)
+		{
+			cache = new id_cache;
+			id_caches_.reset(cache);
+		}
+
+		return *cache;
+	}
+
+	// Takes the sequence lock of an entry, which also keeps other writers
+	// out. Returns the sequence to pass to end_write().
+	static std::uint32_t begin_write(monitor_feed_entry& entry)
+	{
+		while (true)
+		{
+			auto sequence = entry.sequence.load(std::memory_order_relaxed);
+
+			if (sequence % 2 == 0 && entry.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				std::atomic_thread_fence(std::memory_order_release);
+				return sequence;
+			}
+
+			boost::this_thread::yield();
+		}
+	}
+
+	static void end_write(monitor_feed_entry& entry, std::uint32_t sequence)
+	{
+		entry.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Returns false if the entry has been taken from the path since the id was
+	// cached, in which case nothing is written.
+	bool write(const cached_id& id, const core::monitor::message& msg, std::int64_t now)
+	{
+		auto& entry = entries_[id.id];
+		auto& slot = slots_[id.id];
+		auto sequence = begin_write(entry);
+
+		if (slot.generation.load(std::memory_order_relaxed) != id.generation)
+		{
+			end_write(entry, sequence);
+			return false;
+		}
+
+		value_writer writer(entry);
+
+		for (auto& data : msg.data())
+			boost::apply_visitor(writer, data);
+
+		slot.last_published.store(now, std::memory_order_relaxed);
+		end_write(entry, sequence);
+
+		return true;
+	}
+
+	cached_id find_or_create_entry(const std::string& path)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto found = entry_ids_.find(path);
+
+		if (found != entry_ids_.end())
+			return cached_id { found->second, slots_[found->second].generation.load(std::memory_order_relaxed) };
+
+		int id;
+
+		if (!free_ids_.empty())
+		{
+			id = free_ids_.back();
+			free_ids_.pop_back();
+		}
+		else if (num_entries_ < capacity_)
+			id = num_entries_++;
+		else
+		{
+			if (!full_logged_)
+				CASPAR_LOG(warning) << L"[monitor_feed] Capacity of " << capacity_ << L" paths exceeded. Not publishing " << u16(path);
+
+			full_logged_ = true;
+
+			return cached_id { -1, 0 };
+		}
+
+		entry_ids_.insert(std::make_pair(path, id));
+
+		auto& entry = entries_[id];
+		auto& slot = slots_[id];
+		auto sequence = begin_write(entry);
+
+		std::memcpy(entry.path, path.c_str(), path.size() + 1);
+		entry.num_values = 0;
+		slot.last_published.store(ticks(clock::now()), std::memory_order_relaxed);
+		end_write(entry, sequence);
+
+		// Publish the entry only after its path has been written.
+		if (id >= static_cast<int>(header_.num_entries.load(std::memory_order_relaxed)))
+			header_.num_entries.store(static_cast<std::uint32_t>(id + 1), std::memory_order_release);
+
+		return cached_id { id, slot.generation.load(std::memory_order_relaxed) };
+	}
+
+	void expire_paths(std::int64_t now)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_, boost::try_to_lock);
+
+		// Another thread is already at it, or is adding a path.
+		if (!lock.owns_lock())
+			return;
+
+		next_expiry_.store(now + expiry_ticks(), std::memory_order_relaxed);
+
+		auto oldest_allowed = now - expiry_ticks();
+
+		for (auto it = entry_ids_.begin(); it != entry_ids_.end();)
+		{
+			auto id = it->second;
+			auto& slot = slots_[id];
+
+			if (slot.last_published.load(std::memory_order_relaxed) >= oldest_allowed)
+			{
+				++it;
+				continue;
+			}
+
+			auto& entry = entries_[id];
+			auto sequence = begin_write(entry);
+
+			slot.generation.fetch_add(1, std::memory_order_relaxed);
+			entry.path[0] = '\0';
+			entry.num_values = 0;
+			end_write(entry, sequence);
+
+			free_ids_.push_back(id);
+			it = entry_ids_.erase(it);
+			full_logged_ = false;
+		}
+	}
+};
+
+monitor_feed::monitor_feed(const std::string& name, int capacity)
+	: impl_(spl::make_shared<impl>(name, capacity))
+{
+}
+
+monitor_feed::~monitor_feed()
+{
+}
+
+spl::shared_ptr<core::monitor::sink> monitor_feed::sink()
+{
+	return impl_;
+}
+
+}}}
@@ -0,0 +1,139 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <common/memory.h>
+#include <core/monitor/monitor.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace caspar { namespace protocol { namespace shm {
+
+/*
+ * Layout of the shared memory region, which local processes can map read
+ * only. The region starts with a monitor_feed_header followed by capacity
+ * entries of entry_size bytes each, of which the first num_entries have
+ * been used.
+ *
+ * Every entry holds the latest values of one monitor path, for example
+ * /channel/1/stage/layer/10/file/frame. An entry is never moved. When its
+ * path has not been published for 10 seconds the path is cleared, and the
+ * entry may later be reused for another path. Readers caching entry indexes
+ * must check the path, and skip entries with an empty path.
+ *
+ * Entries, including their paths, are protected by a sequence lock. To read
+ * an entry consistently:
+ *
+ *   do
+ *   {
+ *       s1 = entry.sequence.load(acquire);   // retry while odd
+ *       copy the entry;
+ *       std::atomic_thread_fence(acquire);
+ *       s2 = entry.sequence.load(relaxed);
+ *   } while (s1 != s2 || s1 % 2 == 1);
+ */
+
+const char			MONITOR_FEED_MAGIC[8]			= { 'C', 'C', 'G', 'M', 'O', 'N', 'F', '\0' };
+const std::uint32_t	MONITOR_FEED_LAYOUT_VERSION		= 2;
+const int			MONITOR_FEED_MAX_PATH			= 128;
+const int			MONITOR_FEED_MAX_VALUES			= 8;
+const int			MONITOR_FEED_TEXT_SIZE			= 304;
+
+struct monitor_feed_header
+{
+	char						magic[8];
+	std::uint32_t				layout_version;
+	std::uint32_t				entry_size;
+	std::uint32_t				capacity;
+	std::atomic<std::uint32_t>	num_entries;
+	char						padding[40];
+};
+
+/*
+ * A value is interpreted according to the type character of the entry:
+ *
+ *   'h' integer (all integral types are widened to 64 bit)
+ *   'd' real (float and double)
+ *   'T' true, 'F' false (no payload)
+ *   's' utf-8 string in text, not null terminated
+ *   'b' blob in text
+ */
+union monitor_feed_value
+{
+	std::int64_t				integer;
+	double						real;
+	struct
+	{
+		std::uint32_t			offset;
+		std::uint32_t			length;
+	}							text;
+};
+
+struct monitor_feed_entry
+{
+	std::atomic<std::uint32_t>	sequence;
+	std::uint32_t				num_values;
+	char						path[MONITOR_FEED_MAX_PATH];		// null terminated
+	char						types[MONITOR_FEED_MAX_VALUES];
+	monitor_feed_value			values[MONITOR_FEED_MAX_VALUES];
+	char						text[MONITOR_FEED_TEXT_SIZE];
+};
+
+static_assert(sizeof(monitor_feed_header) == 64, "monitor_feed_header must be 64 bytes");
+static_assert(sizeof(monitor_feed_entry) == 512, "monitor_feed_entry must be 512 bytes");
+
+/**
+ * Mirrors the monitor subject tree into a named shared memory region, so
+ * that local processes can read current state without syscalls or parsing.
+ */
+class monitor_feed
+{
+	monitor_feed(const monitor_feed&);
+	monitor_feed& operator=(const monitor_feed&);
+public:
+
+	// Static Members
+
+	// Constructors
+
+	/**
+	 * Constructor.
+	 *
+	 * @param name     The name of the shared memory object. Any stale object
+	 *                 with the same name is replaced.
+	 * @param capacity The maximum number of monitor paths to mirror.
+	 */
+	monitor_feed(const std::string& name, int capacity);
+
+	~monitor_feed();
+
+	// Methods
+
+	// Properties
+
+	spl::shared_ptr<core::monitor::sink> sink();
+private:
+	struct impl;
+	spl::shared_ptr<impl> impl_;
+};
+
+}}}
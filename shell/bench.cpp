@@ -0,0 +1,786 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+// Headless benchmark booting a number of channels with the cpu accelerator,
+// synthetic layer stacks and null consumers. The channels are run in freewheel
+// mode, so each of them renders as fast as it can while competing with the
+// others for the cpu. If every channel still renders at least at the rate of
+// its video format, that many channels can be run in real time.
+//
+// Usage:
+//
+//   casparcg-bench [--video-mode 1080i5000] [--layers color:1,bgra:1,yuv:1,scene:1,text:1]
+//                  [--channels N | --max-channels N] [--seconds 5] [--warmup 2]
+//                  [--config casparcg.config] [--output result.json]
+//                  [--suite channels|micro|all]
+//
+// The configuration file, relative to the working directory, is needed for the
+// paths (the font folder for the text layers) and the channel settings. The
+// result is written as json to stdout or to the --output file.
+//
+// The micro suite times hot paths in isolation instead, like the evaluation of
+// the bindings of a large scene and the dispatch of executor tasks.
+
+#include <accelerator/accelerator.h>
+
+#include <common/env.h>
+#include <common/except.h>
+#include <common/executor.h>
+#include <common/future.h>
+#include <common/log.h>
+#include <common/memory.h>
+#include <common/timer.h>
+#include <common/tweener.h>
+#include <common/utf.h>
+
+#include <core/video_channel.h>
+#include <core/video_format.h>
+#include <core/consumer/frame_consumer.h>
+#include <core/consumer/output.h>
+#include <core/frame/audio_channel_layout.h>
+#include <core/frame/draw_frame.h>
+#include <core/frame/frame.h>
+#include <core/frame/frame_factory.h>
+#include <core/frame/frame_transform.h>
+#include <core/frame/pixel_format.h>
+#include <core/mixer/mixer.h>
+#include <core/mixer/image/image_mixer.h>
+#include <core/monitor/monitor.h>
+#include <core/producer/frame_producer.h>
+#include <core/producer/stage.h>
+#include <core/producer/color/color_producer.h>
+#include <core/producer/scene/expression_parser.h>
+#include <core/producer/scene/scene_producer.h>
+#include <core/producer/text/text_producer.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/chrono/process_cpu_clocks.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/locale.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace caspar;
+
+namespace {
+
+tbb::atomic<std::int64_t> g_allocations;
+tbb::atomic<std::int64_t> g_allocated_bytes;
+
+void* counted_malloc(std::size_t size)
+{
+	++g_allocations;
+	g_allocated_bytes += size;
+
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+}
+
+// Counts every heap allocation in the process, so that allocations per frame
+// can be reported.
+void* operator new(std::size_t size)
+{
+	auto result = counted_malloc(size);
+
+	if (!result)
+		throw std::bad_alloc();
+
+	return result;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) throw()
+{
+	return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) throw()
+{
+	return counted_malloc(size);
+}
+
+void operator delete(void* p) throw()						{ std::free(p); }
+void operator delete[](void* p) throw()						{ std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) throw()	{ std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) throw()	{ std::free(p); }
+
+namespace {
+
+struct options
+{
+	std::wstring	video_mode		= L"1080i5000";
+	std::wstring	layers			= L"color:1,bgra:1,yuv:1,scene:1,text:1";
+	int				channels		= 0;
+	int				max_channels	= 16;
+	double			seconds			= 5.0;
+	double			warmup			= 2.0;
+	std::wstring	config			= L"casparcg.config";
+	std::string		output;
+	std::wstring	suite			= L"channels";
+};
+
+options parse_options(int argc, char** argv)
+{
+	options result;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string name = argv[i];
+
+		if (i + 1 == argc)
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Missing value for " + u16(name)));
+
+		std::string value = argv[++i];
+
+		if (name == "--video-mode")
+			result.video_mode = u16(value);
+		else if (name == "--layers")
+			result.layers = u16(value);
+		else if (name == "--channels")
+			result.channels = boost::lexical_cast<int>(value);
+		else if (name == "--max-channels")
+			result.max_channels = boost::lexical_cast<int>(value);
+		else if (name == "--seconds")
+			result.seconds = boost::lexical_cast<double>(value);
+		else if (name == "--warmup")
+			result.warmup = boost::lexical_cast<double>(value);
+		else if (name == "--config")
+			result.config = u16(value);
+		else if (name == "--output")
+			result.output = value;
+		else if (name == "--suite")
+			result.suite = u16(value);
+		else
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Unknown option " + u16(name)));
+	}
+
+	return result;
+}
+
+class null_consumer : public core::frame_consumer
+{
+	core::monitor::subject monitor_subject_;
+public:
+	std::future<bool> send(core::const_frame frame) override
+	{
+		return make_ready_future(true);
+	}
+
+	void initialize(const core::video_format_desc& format_desc, const core::audio_channel_layout& channel_layout, int channel_index) override
+	{
+	}
+
+	core::monitor::subject& monitor_output() override		{ return monitor_subject_; }
+	std::wstring print() const override						{ return L"null[]"; }
+	std::wstring name() const override						{ return L"null"; }
+	bool has_synchronization_clock() const override			{ return false; }
+	int buffer_depth() const override						{ return -1; }
+	int index() const override								{ return 0; }
+	int64_t presentation_frame_age_millis() const override	{ return 0; }
+
+	boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"null");
+		return info;
+	}
+};
+
+// Moving color bars, generated into a new frame every frame like a decoder
+// would deliver them.
+class test_pattern_producer : public core::frame_producer_base
+{
+	core::monitor::subject					monitor_subject_;
+	const spl::shared_ptr<core::frame_factory>	frame_factory_;
+	core::pixel_format_desc					desc_;
+	core::constraints						constraints_;
+	int										offset_		= 0;
+public:
+	test_pattern_producer(const spl::shared_ptr<core::frame_factory>& frame_factory, core::pixel_format format, int width, int height)
+		: frame_factory_(frame_factory)
+		, desc_(format)
+		, constraints_(width, height)
+	{
+		if (format == core::pixel_format::ycbcr)
+		{
+			desc_.planes.push_back(core::pixel_format_desc::plane(width, height, 1));
+			desc_.planes.push_back(core::pixel_format_desc::plane(width / 2, height / 2, 1));
+			desc_.planes.push_back(core::pixel_format_desc::plane(width / 2, height / 2, 1));
+		}
+		else
+			desc_.planes.push_back(core::pixel_format_desc::plane(width, height, 4));
+	}
+
+	core::draw_frame receive_impl() override
+	{
+		auto frame = frame_factory_->create_frame(this, desc_, core::audio_channel_layout::invalid());
+
+		offset_ += 4;
+
+		for (int n = 0; n < static_cast<int>(desc_.planes.size()); ++n)
+		{
+			auto& plane	= desc_.planes[n];
+			auto dest	= frame.image_data(n).begin();
+
+			for (int x = 0; x < plane.linesize; ++x)
+			{
+				int bar = ((x / plane.stride + offset_) * 8 / plane.width) % 8;
+
+				if (desc_.format == core::pixel_format::ycbcr)
+					dest[x] = static_cast<std::uint8_t>(n == 0 ? 16 + bar * 28 : 128 + (bar - 4) * (n == 1 ? 20 : -20));
+				else
+					dest[x] = static_cast<std::uint8_t>(x % 4 == 3 ? 255 : ((bar >> (x % 4)) & 1) * 191);
+			}
+
+			tbb::parallel_for(1, plane.height, [&](int y)
+			{
+				std::memcpy(dest + y * plane.linesize, dest, plane.linesize);
+			});
+		}
+
+		return core::draw_frame(std::move(frame));
+	}
+
+	core::constraints& pixel_constraints() override		{ return constraints_; }
+	std::wstring print() const override					{ return L"test-pattern[" + name() + L"]"; }
+	std::wstring name() const override					{ return desc_.format == core::pixel_format::ycbcr ? L"yuv" : L"bgra"; }
+	core::monitor::subject& monitor_output() override	{ return monitor_subject_; }
+
+	boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"test-pattern");
+		return info;
+	}
+};
+
+spl::shared_ptr<core::frame_producer> create_scene(const spl::shared_ptr<core::frame_factory>& frame_factory, const core::video_format_desc& format_desc)
+{
+	static const int NUM_LAYERS	= 8;
+	static const int WIDTH		= 320;
+	static const int HEIGHT		= 180;
+
+	auto scene	= spl::make_shared<core::scene::scene_producer>(L"bench", L"bench", format_desc.square_width, format_desc.square_height, format_desc);
+	auto raw	= scene.get();
+	auto repo	= [raw](const std::wstring& name) -> core::variable& { return raw->get_variable(name); };
+
+	for (int i = 0; i < NUM_LAYERS; ++i)
+	{
+		auto index	= boost::lexical_cast<std::wstring>(i);
+		auto format	= i % 2 == 0 ? core::pixel_format::bgra : core::pixel_format::ycbcr;
+		auto& layer	= scene->create_layer(spl::make_shared<test_pattern_producer>(frame_factory, format, WIDTH, HEIGHT), L"layer" + index);
+
+		layer.position.x.bind(core::scene::parse_expression<double>(
+				L"(sin(frame / 25 + " + index + L") + 1) * (scene_width - 320) / 2", repo));
+		layer.position.y.bind(core::scene::parse_expression<double>(
+				L"(cos(frame / 30 + " + index + L") + 1) * (scene_height - 180) / 2", repo));
+		layer.rotation.bind(core::scene::parse_expression<double>(
+				L"(frame * 2 + " + index + L" * 45) % 360", repo));
+	}
+
+	return scene;
+}
+
+std::wstring find_font()
+{
+	try
+	{
+		auto fonts = core::text::list_fonts();
+
+		return fonts.empty() ? L"" : fonts.front().first;
+	}
+	catch (...)
+	{
+		return L"";
+	}
+}
+
+spl::shared_ptr<core::frame_producer> create_layer_producer(
+		const std::wstring& type,
+		const spl::shared_ptr<core::frame_factory>& frame_factory,
+		const core::video_format_desc& format_desc,
+		const std::wstring& font)
+{
+	if (type == L"color")
+		return core::create_color_producer(frame_factory, 0xFF336699);
+	else if (type == L"bgra")
+		return spl::make_shared<test_pattern_producer>(frame_factory, core::pixel_format::bgra, format_desc.width, format_desc.height);
+	else if (type == L"yuv")
+		return spl::make_shared<test_pattern_producer>(frame_factory, core::pixel_format::ycbcr, format_desc.width, format_desc.height);
+	else if (type == L"scene")
+		return create_scene(frame_factory, format_desc);
+	else if (type == L"text")
+	{
+		core::text::text_info text_info;
+		text_info.font	= font;
+		text_info.size	= 72.0;
+		text_info.color	= core::text::color<double>(1.0, 1.0, 1.0, 1.0);
+
+		return core::text_producer::create(frame_factory, 100, 100, L"CasparCG benchmark 0123456789", text_info, format_desc.width, format_desc.height, true);
+	}
+
+	CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Unknown layer type " + type));
+}
+
+struct layer_spec
+{
+	std::wstring	type;
+	int				count;
+};
+
+std::vector<layer_spec> parse_layers(const std::wstring& str)
+{
+	std::vector<std::wstring> items;
+	std::vector<layer_spec> result;
+
+	boost::split(items, str, boost::is_any_of(L","), boost::token_compress_on);
+
+	for (auto& item : items)
+	{
+		auto colon = item.find(L':');
+		layer_spec spec;
+		spec.type	= boost::to_lower_copy(item.substr(0, colon));
+		spec.count	= colon == std::wstring::npos ? 1 : boost::lexical_cast<int>(item.substr(colon + 1));
+
+		result.push_back(spec);
+	}
+
+	return result;
+}
+
+// Collects the per stage times reported by the channels through the monitor.
+class stage_times : public core::monitor::sink
+{
+	std::mutex									mutex_;
+	std::map<std::string, std::vector<double>>	samples_;
+public:
+	void propagate(const core::monitor::message& msg) override
+	{
+		static const std::string PROFILER_TIME = "/profiler/time";
+
+		auto& path = msg.path();
+
+		if (!boost::ends_with(path, PROFILER_TIME) || path.compare(0, 9, "/channel/") != 0 || msg.data().empty())
+			return;
+
+		auto stage_begin	= path.find('/', 9);
+		auto stage			= path.substr(stage_begin, path.size() - stage_begin - PROFILER_TIME.size());
+
+		if (stage.empty())
+			stage = "tick";
+		else if (stage == "/stage")
+			stage = "produce";
+		else if (stage == "/mixer")
+			stage = "mix";
+		else if (stage == "/output")
+			stage = "consume";
+		else
+			return;
+
+		auto seconds = boost::get<double>(&msg.data().at(0));
+
+		if (!seconds)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		samples_[stage].push_back(*seconds * 1000.0);
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		samples_.clear();
+	}
+
+	boost::property_tree::ptree distributions()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		boost::property_tree::ptree result;
+
+		for (auto& stage : samples_)
+		{
+			auto& samples = stage.second;
+
+			if (samples.empty())
+				continue;
+
+			std::sort(samples.begin(), samples.end());
+
+			auto percentile = [&](double p) { return samples.at(static_cast<std::size_t>(p * (samples.size() - 1))); };
+			double sum = 0.0;
+
+			for (auto sample : samples)
+				sum += sample;
+
+			boost::property_tree::ptree distribution;
+			distribution.add("samples", samples.size());
+			distribution.add("mean-ms", sum / samples.size());
+			distribution.add("p50-ms", percentile(0.5));
+			distribution.add("p95-ms", percentile(0.95));
+			distribution.add("p99-ms", percentile(0.99));
+			distribution.add("max-ms", samples.back());
+			result.add_child(stage.first, distribution);
+		}
+
+		return result;
+	}
+};
+
+struct run_result
+{
+	boost::property_tree::ptree	tree;
+	bool						real_time;
+};
+
+run_result run(
+		int num_channels,
+		const options& opts,
+		const std::vector<layer_spec>& layers,
+		const std::wstring& font,
+		accelerator::accelerator& accelerator)
+{
+	auto format_desc	= core::video_format_desc(opts.video_mode);
+	auto times			= spl::make_shared<stage_times>();
+
+	std::vector<spl::shared_ptr<core::video_channel>>	channels;
+	std::vector<std::shared_ptr<tbb::atomic<int>>>		frame_counts;
+	std::vector<std::shared_ptr<void>>					tick_listeners;
+
+	for (int i = 0; i < num_channels; ++i)
+	{
+		auto channel = spl::make_shared<core::video_channel>(
+				i + 1, format_desc, core::audio_channel_layout(2, L"stereo", L"FL FR"), accelerator.create_image_mixer(i + 1), true);
+		auto frame_count = std::make_shared<tbb::atomic<int>>();
+		*frame_count = 0;
+
+		channel->mixer().set_profiler_time_output(true);
+		channel->monitor_output().attach_parent(times);
+		channel->output().add(spl::make_shared<null_consumer>());
+		tick_listeners.push_back(channel->add_tick_listener([=] { ++*frame_count; }));
+
+		int index = 0;
+
+		for (auto& spec : layers)
+		{
+			if (spec.type == L"text" && font.empty())
+				continue;
+
+			for (int n = 0; n < spec.count; ++n, ++index)
+			{
+				auto producer = create_layer_producer(spec.type, channel->frame_factory(), format_desc, font);
+
+				channel->stage().load(index, producer).get();
+				channel->stage().play(index).get();
+
+				// Scale each layer down into its own cell of a grid and tween
+				// it from there, so that the transforms are not the identity.
+				double scale	= 0.5 + 0.5 * (index % 2);
+				double x		= 0.25 * (index % 3);
+				double y		= 0.25 * ((index / 3) % 3);
+
+				channel->stage().apply_transform(index, [=](core::frame_transform transform) -> core::frame_transform
+				{
+					transform.image_transform.fill_scale[0]			= scale;
+					transform.image_transform.fill_scale[1]			= scale;
+					transform.image_transform.fill_translation[0]	= x;
+					transform.image_transform.fill_translation[1]	= y;
+					transform.image_transform.opacity				= 0.8;
+					transform.image_transform.angle					= 5.0;
+					return transform;
+				}, static_cast<unsigned int>(format_desc.fps * 3600), tweener(L"easeinoutsine")).get();
+			}
+		}
+
+		channels.push_back(channel);
+		frame_counts.push_back(frame_count);
+	}
+
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(static_cast<int>(opts.warmup * 1000)));
+
+	times->clear();
+
+	for (auto& frame_count : frame_counts)
+		*frame_count = 0;
+
+	auto allocations	= g_allocations;
+	auto bytes			= g_allocated_bytes;
+	auto cpu_start		= boost::chrono::process_cpu_clock::now();
+	caspar::timer timer;
+
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(static_cast<int>(opts.seconds * 1000)));
+
+	auto elapsed		= timer.elapsed();
+	auto cpu			= boost::chrono::process_cpu_clock::now() - cpu_start;
+	allocations			= g_allocations - allocations;
+	bytes				= g_allocated_bytes - bytes;
+
+	std::vector<int> counts;
+
+	for (auto& frame_count : frame_counts)
+		counts.push_back(*frame_count);
+
+	tick_listeners.clear();
+	channels.clear();
+
+	int total_frames	= 0;
+	double min_fps		= std::numeric_limits<double>::max();
+	boost::property_tree::ptree fps;
+
+	for (auto count : counts)
+	{
+		total_frames	+= count;
+		min_fps			= std::min(min_fps, count / elapsed);
+
+		boost::property_tree::ptree channel_fps;
+		channel_fps.put_value(count / elapsed);
+		fps.push_back(std::make_pair("", channel_fps));
+	}
+
+	double cpu_seconds	= (cpu.count().user + cpu.count().system) / 1e9;
+	int frames			= std::max(total_frames, 1);
+
+	run_result result;
+	result.real_time = min_fps >= format_desc.fps;
+
+	auto& tree = result.tree;
+	tree.add("channels", num_channels);
+	tree.add("seconds", elapsed);
+	tree.add("real-time", result.real_time);
+	tree.add("min-fps", min_fps);
+	tree.add_child("fps", fps);
+	tree.add_child("stages", times->distributions());
+	tree.add("cpu.usage", cpu_seconds / elapsed);
+	tree.add("cpu.usage-per-core", cpu_seconds / elapsed / boost::thread::hardware_concurrency());
+	tree.add("cpu.ms-per-frame", cpu_seconds * 1000.0 / frames);
+	tree.add("cpu.real-time-usage", cpu_seconds / frames * format_desc.fps * num_channels / boost::thread::hardware_concurrency());
+	tree.add("allocations.count-per-frame", static_cast<double>(allocations) / frames);
+	tree.add("allocations.bytes-per-frame", static_cast<double>(bytes) / frames);
+
+	return result;
+}
+
+// A scene with 1000 bound variables, each depending on the frame and the
+// scene size, evaluated frame by frame without a channel.
+boost::property_tree::ptree bench_scene_bindings()
+{
+	static const int NUM_BINDINGS	= 1000;
+	static const int NUM_FRAMES		= 500;
+
+	core::scene::scene_producer scene(L"bench", L"bench", 1920, 1080, core::video_format_desc(core::video_format::x1080p5000));
+	auto repo = [&](const std::wstring& name) -> core::variable& { return scene.get_variable(name); };
+
+	for (int i = 0; i < NUM_BINDINGS; ++i)
+	{
+		auto index = boost::lexical_cast<std::wstring>(i);
+		auto& var = scene.create_variable<double>(L"v" + index, false);
+
+		var.bind(core::scene::parse_expression<double>(
+				L"sin(frame / 25 + " + index + L") * scene_width / 4 + (frame % 50 < 25 ? " + index + L" : -" + index + L")",
+				repo));
+	}
+
+	auto allocations = g_allocations;
+	caspar::timer timer;
+
+	for (int frame = 0; frame < NUM_FRAMES; ++frame)
+		scene.receive_impl();
+
+	auto elapsed	= timer.elapsed();
+	allocations		= g_allocations - allocations;
+
+	boost::property_tree::ptree result;
+	result.add("bindings", NUM_BINDINGS);
+	result.add("ms-per-frame", elapsed * 1000.0 / NUM_FRAMES);
+	result.add("allocations-per-frame", static_cast<double>(allocations) / NUM_FRAMES);
+
+	return result;
+}
+
+// Round trips through invoke and batches of begin_invoke on an idle executor.
+boost::property_tree::ptree bench_executor()
+{
+	static const int NUM_TASKS = 100000;
+
+	executor exec(L"bench");
+	std::vector<std::future<int>> futures;
+	futures.reserve(NUM_TASKS);
+
+	// Warms up the task pools.
+	for (int i = 0; i < NUM_TASKS; ++i)
+		futures.push_back(exec.begin_invoke([i] { return i; }));
+
+	for (auto& future : futures)
+		future.get();
+
+	futures.clear();
+
+	auto allocations = g_allocations;
+	caspar::timer timer;
+
+	for (int i = 0; i < NUM_TASKS; ++i)
+		exec.invoke([] { });
+
+	auto invoke				= timer.elapsed();
+	auto invoke_allocations	= g_allocations - allocations;
+
+	allocations = g_allocations;
+	timer.restart();
+
+	for (int i = 0; i < NUM_TASKS; ++i)
+		futures.push_back(exec.begin_invoke([i] { return i; }));
+
+	for (auto& future : futures)
+		future.get();
+
+	auto begin_invoke				= timer.elapsed();
+	auto begin_invoke_allocations	= g_allocations - allocations;
+
+	boost::property_tree::ptree result;
+	result.add("invoke.ns-per-task", invoke * 1e9 / NUM_TASKS);
+	result.add("invoke.allocations-per-task", static_cast<double>(invoke_allocations) / NUM_TASKS);
+	result.add("begin-invoke.ns-per-task", begin_invoke * 1e9 / NUM_TASKS);
+	result.add("begin-invoke.allocations-per-task", static_cast<double>(begin_invoke_allocations) / NUM_TASKS);
+
+	return result;
+}
+
+boost::property_tree::ptree run_micro_benchmarks()
+{
+	boost::property_tree::ptree result;
+
+	result.add_child("scene-bindings", bench_scene_bindings());
+	result.add_child("executor", bench_executor());
+
+	return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	boost::locale::generator gen;
+	gen.categories(boost::locale::codepage_facet);
+	std::locale::global(gen(""));
+
+	log::set_log_level(L"warning");
+
+	try
+	{
+		auto opts		= parse_options(argc, argv);
+		auto layers		= parse_layers(opts.layers);
+		auto format		= core::video_format_desc(opts.video_mode);
+		std::wstring font;
+		bool text_layers_skipped = false;
+
+		if (format.format == core::video_format::invalid)
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Invalid video mode " + opts.video_mode));
+
+		bool run_channels	= opts.suite == L"channels" || opts.suite == L"all";
+		bool run_micro		= opts.suite == L"micro" || opts.suite == L"all";
+
+		if (!run_channels && !run_micro)
+			CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Unknown suite " + opts.suite));
+
+		env::configure(opts.config);
+
+		if (run_channels && std::any_of(layers.begin(), layers.end(), [](const layer_spec& spec) { return spec.type == L"text"; }))
+		{
+			font = find_font();
+
+			text_layers_skipped = font.empty();
+
+			if (text_layers_skipped)
+				CASPAR_LOG(warning) << L"No fonts found in " << env::font_folder() << L", text layers are skipped.";
+		}
+
+		accelerator::accelerator accelerator(L"cpu");
+
+		boost::property_tree::ptree report;
+		boost::property_tree::ptree runs;
+		int max_real_time_channels = 0;
+
+		report.add("video-mode", u8(format.name));
+		report.add("layers", u8(opts.layers));
+
+		if (text_layers_skipped)
+			report.add("text-layers-skipped", true);
+
+		report.add("hardware-threads", boost::thread::hardware_concurrency());
+
+		if (run_channels)
+		{
+			int first = opts.channels > 0 ? opts.channels : 1;
+			int last = opts.channels > 0 ? opts.channels : opts.max_channels;
+
+			for (int n = first; n <= last; ++n)
+			{
+				auto result = run(n, opts, layers, font, accelerator);
+
+				runs.push_back(std::make_pair("", result.tree));
+
+				if (!result.real_time)
+					break;
+
+				max_real_time_channels = n;
+			}
+
+			report.add("max-real-time-channels", max_real_time_channels);
+			report.add_child("runs", runs);
+		}
+
+		if (run_micro)
+			report.add_child("micro-benchmarks", run_micro_benchmarks());
+
+		if (opts.output.empty())
+			boost::property_tree::write_json(std::cout, report);
+		else
+		{
+			std::ofstream file(opts.output);
+			boost::property_tree::write_json(file, report);
+		}
+	}
+	catch (...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return 1;
+	}
+
+	return 0;
+}
@@ -39,6 +39,7 @@ void setup_prerequisites()
 	std::set_terminate([]
 	{
 		CASPAR_LOG_CURRENT_EXCEPTION();
+		log::flush();
 	});
 }
 
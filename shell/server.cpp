@@ -27,11 +27,17 @@
 
 #include <accelerator/accelerator.h>
 
+#include <common/cpu_affinity.h>
+#include <common/diagnostics/memory_accounting.h>
 #include <common/env.h>
+#include <common/task_arena.h>
 #include <common/except.h>
 #include <common/utf.h>
 #include <common/memory.h>
 #include <common/polling_filesystem_monitor.h>
+#ifndef _MSC_VER
+#include <common/os/native_filesystem_monitor.h>
+#endif
 #include <common/ptree.h>
 
 #include <core/video_channel.h>
@@ -69,6 +75,7 @@
 #include <protocol/util/AsyncEventServer.h>
 #include <protocol/util/strategy_adapters.h>
 #include <protocol/osc/client.h>
+#include <protocol/shm/monitor_feed.h>
 #include <protocol/log/tcp_logger_protocol_strategy.h>
 
 #include <boost/algorithm/string.hpp>
@@ -127,6 +134,23 @@ std::shared_ptr<boost::asio::io_service> create_running_io_service()
 			});
 }
 
+// Forwards monitor messages to more than one sink.
+class monitor_broadcaster : public monitor::sink
+{
+	std::vector<spl::shared_ptr<monitor::sink>> sinks_;
+public:
+	explicit monitor_broadcaster(std::vector<spl::shared_ptr<monitor::sink>> sinks)
+		: sinks_(std::move(sinks))
+	{
+	}
+
+	void propagate(const monitor::message& msg) override
+	{
+		for (auto& sink : sinks_)
+			sink->propagate(msg);
+	}
+};
+
 struct server::impl : boost::noncopyable
 {
 	std::shared_ptr<boost::asio::io_service>			io_service_						= create_running_io_service();
@@ -137,8 +161,10 @@ struct server::impl : boost::noncopyable
 	std::shared_ptr<amcp::amcp_command_repository>		amcp_command_repo_;
 	std::vector<spl::shared_ptr<IO::AsyncEventServer>>	async_servers_;
 	std::shared_ptr<IO::AsyncEventServer>				primary_amcp_server_;
-	std::shared_ptr<osc::client>						osc_client_						= std::make_shared<osc::client>(io_service_);
+	std::shared_ptr<osc::client>						osc_client_;
 	std::vector<std::shared_ptr<void>>					predefined_osc_subscriptions_;
+	std::shared_ptr<shm::monitor_feed>					monitor_feed_;
+	std::shared_ptr<monitor::sink>						monitor_broadcaster_;
 	std::vector<spl::shared_ptr<video_channel>>			channels_;
 	spl::shared_ptr<media_info_repository>				media_info_repo_;
 	boost::thread										initial_media_info_thread_;
@@ -152,7 +178,7 @@ struct server::impl : boost::noncopyable
 
 	explicit impl(std::promise<bool>& shutdown_server_now)
 		: accelerator_(env::properties().get(L"configuration.accelerator", L"auto"))
-		, media_info_repo_(create_in_memory_media_info_repository())
+		, media_info_repo_(create_media_info_repository(env::properties()))
 		, producer_registry_(spl::make_shared<core::frame_producer_registry>(help_repo_))
 		, consumer_registry_(spl::make_shared<core::frame_consumer_registry>(help_repo_))
 		, shutdown_server_now_(shutdown_server_now)
@@ -184,6 +210,9 @@ struct server::impl : boost::noncopyable
 		setup_audio_config(env::properties());
 		CASPAR_LOG(info) << L"Initialized audio config.";
 
+		setup_memory_budgets(env::properties());
+		CASPAR_LOG(info) << L"Initialized memory budgets.";
+
 		setup_channels(env::properties());
 		CASPAR_LOG(info) << L"Initialized channels.";
 
@@ -211,6 +240,8 @@ struct server::impl : boost::noncopyable
 		std::weak_ptr<boost::asio::io_service> weak_io_service = io_service_;
 		io_service_.reset();
 		osc_client_.reset();
+		monitor_broadcaster_.reset();
+		monitor_feed_.reset();
 		thumbnail_generator_.reset();
 		amcp_command_repo_.reset();
 		primary_amcp_server_.reset();
@@ -253,6 +284,28 @@ struct server::impl : boost::noncopyable
 		}
 	}
 
+	void setup_memory_budgets(const boost::property_tree::wptree& pt)
+	{
+		auto budgets = pt.get_child_optional(L"configuration.memory-budget");
+
+		if (!budgets)
+			return;
+
+		CASPAR_SCOPED_CONTEXT_MSG("/configuration/memory-budget");
+
+		for (auto& budget : *budgets)
+		{
+			auto bytes = budget.second.get_value<std::int64_t>() * 1024 * 1024;
+
+			if (budget.first == L"total-mb")
+				caspar::diagnostics::set_memory_budget(bytes);
+			else if (boost::algorithm::ends_with(budget.first, L"-mb"))
+				caspar::diagnostics::set_memory_budget(budget.first.substr(0, budget.first.size() - 3), bytes);
+			else
+				CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Unknown memory budget: " + budget.first));
+		}
+	}
+
 	void setup_channels(const boost::property_tree::wptree& pt)
 	{
 		using boost::property_tree::wptree;
@@ -274,8 +327,27 @@ struct server::impl : boost::noncopyable
 			if (!channel_layout)
 				CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Unknown channel-layout: " + channel_layout_str));
 
+			auto numa_node = xml_channel.second.get_optional<int>(L"numa-node");
+			auto cpus = xml_channel.second.get_optional<std::wstring>(L"cpus");
+			cpu_affinity affinity;
+
+			if (numa_node && cpus)
+				CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Only one of numa-node and cpus can be specified for a channel"));
+			else if (numa_node)
+				affinity = cpu_affinity::from_numa_node(*numa_node);
+			else if (cpus)
+				affinity = cpu_affinity::from_processor_list(*cpus);
+
 			auto channel_id = static_cast<int>(channels_.size() + 1);
-			auto channel = spl::make_shared<video_channel>(channel_id, format_desc, *channel_layout, accelerator_.create_image_mixer(channel_id));
+			auto channel = spl::make_shared<video_channel>(
+					channel_id,
+					format_desc,
+					*channel_layout,
+					accelerator_.create_image_mixer(channel_id),
+					xml_channel.second.get(L"freewheel", false),
+					affinity,
+					xml_channel.second.get(L"max-threads", 0),
+					task_arena_priority_from_string(xml_channel.second.get(L"priority", L"normal")));
 
 			channel->monitor_output().attach_parent(monitor_subject_);
 			channel->mixer().set_straight_alpha_output(xml_channel.second.get(L"straight-alpha-output", false));
@@ -326,10 +398,41 @@ struct server::impl : boost::noncopyable
 		using boost::property_tree::wptree;
 		using namespace boost::asio::ip;
 
-		monitor_subject_->attach_parent(osc_client_->sink());
+		osc_client_ = std::make_shared<osc::client>(
+				io_service_,
+				pt.get(L"configuration.osc.max-datagram-size", 1472));
+
+		if (pt.get(L"configuration.monitor-feed.enabled", false))
+		{
+			try
+			{
+				monitor_feed_ = std::make_shared<shm::monitor_feed>(
+						u8(pt.get(L"configuration.monitor-feed.name", L"casparcg-monitor")),
+						pt.get(L"configuration.monitor-feed.capacity", 4096));
+			}
+			catch (...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+				CASPAR_LOG(warning) << L"Could not create shared memory monitor feed.";
+			}
+		}
+
+		if (monitor_feed_)
+		{
+			auto broadcaster = spl::make_shared<monitor_broadcaster>(std::vector<spl::shared_ptr<monitor::sink>> {
+				osc_client_->sink(),
+				monitor_feed_->sink()
+			});
+			monitor_broadcaster_ = broadcaster;
+			monitor_subject_->attach_parent(broadcaster);
+		}
+		else
+			monitor_subject_->attach_parent(osc_client_->sink());
 
 		auto default_port =
 				pt.get<unsigned short>(L"configuration.osc.default-port", 6250);
+		auto max_updates_per_second =
+				pt.get(L"configuration.osc.max-updates-per-second", 0);
 		auto disable_send_to_amcp_clients =
 				pt.get(L"configuration.osc.disable-send-to-amcp-clients", false);
 		auto predefined_clients =
@@ -345,10 +448,13 @@ struct server::impl : boost::noncopyable
 						ptree_get<std::wstring>(predefined_client.second, L"address");
 				const auto port =
 						ptree_get<unsigned short>(predefined_client.second, L"port");
+				const auto client_max_updates_per_second =
+						predefined_client.second.get(L"max-updates-per-second", max_updates_per_second);
 				predefined_osc_subscriptions_.push_back(
 						osc_client_->get_subscription_token(udp::endpoint(
 								address_v4::from_string(u8(address)),
-								port)));
+								port),
+								client_max_updates_per_second));
 			}
 		}
 
@@ -365,7 +471,8 @@ struct server::impl : boost::noncopyable
 										udp::endpoint(
 												address_v4::from_string(
 														ipv4_address),
-												default_port)));
+												default_port),
+										max_updates_per_second));
 					});
 	}
 
@@ -376,21 +483,34 @@ struct server::impl : boost::noncopyable
 
 		auto scan_interval_millis = pt.get(L"configuration.thumbnails.scan-interval-millis", 5000);
 
-		polling_filesystem_monitor_factory monitor_factory(io_service_, scan_interval_millis);
+		std::unique_ptr<filesystem_monitor_factory> monitor_factory;
+
+#ifdef _MSC_VER
+		// The native filesystem monitor uses inotify, so Windows always polls.
+		monitor_factory.reset(new polling_filesystem_monitor_factory(io_service_, scan_interval_millis));
+#else
+		if (boost::iequals(pt.get(L"configuration.thumbnails.filesystem-monitor", L"native"), L"polling"))
+			monitor_factory.reset(new polling_filesystem_monitor_factory(io_service_, scan_interval_millis));
+		else
+			monitor_factory.reset(new native_filesystem_monitor_factory(io_service_, scan_interval_millis));
+#endif
+
 		thumbnail_generator_.reset(new thumbnail_generator(
-			monitor_factory,
+			*monitor_factory,
 			env::media_folder(),
 			env::thumbnail_folder(),
 			pt.get(L"configuration.thumbnails.width", 256),
 			pt.get(L"configuration.thumbnails.height", 144),
 			core::video_format_desc(pt.get(L"configuration.thumbnails.video-mode", L"720p2500")),
 			accelerator_.create_image_mixer(0),
-			pt.get(L"configuration.thumbnails.generate-delay-millis", 2000),
+			pt.get(L"configuration.thumbnails.worker-threads", static_cast<int>(std::max(1u, boost::thread::hardware_concurrency() / 2))),
 			&image::write_cropped_png,
 			media_info_repo_,
 			producer_registry_,
 			cg_registry_,
 			pt.get(L"configuration.thumbnails.mipmap", true)));
+
+		thumbnail_generator_->monitor_output().attach_parent(monitor_subject_);
 	}
 
 	void setup_controllers(const boost::property_tree::wptree& pt)
@@ -449,31 +569,83 @@ struct server::impl : boost::noncopyable
 		CASPAR_THROW_EXCEPTION(user_error() << msg_info(L"Invalid protocol: " + name));
 	}
 
+	static spl::shared_ptr<media_info_repository> create_media_info_repository(const boost::property_tree::wptree& pt)
+	{
+		auto max_entries = pt.get(L"configuration.media-info.max-entries", static_cast<std::size_t>(100000));
+
+		if (!pt.get(L"configuration.media-info.persist-cache", true))
+			return create_in_memory_media_info_repository(max_entries);
+
+		return create_persistent_media_info_repository(env::data_folder() + L"media_info.cache", max_entries);
+	}
+
 	void start_initial_media_info_scan()
 	{
-		initial_media_info_thread_ = boost::thread([this]
+		auto default_scan_threads	= std::max(1u, boost::thread::hardware_concurrency() / 2);
+		auto scan_threads			= env::properties().get(L"configuration.media-info.scan-threads", default_scan_threads);
+
+		initial_media_info_thread_ = boost::thread([this, scan_threads]
 		{
 			try
 			{
 				ensure_gpf_handler_installed_for_thread("initial media scan");
 
+				std::vector<std::wstring> files;
+
 				for (boost::filesystem::wrecursive_directory_iterator iter(env::media_folder()), end; iter != end; ++iter)
 				{
-					if (running_)
-					{
-						if (boost::filesystem::is_regular_file(iter->path()))
-						{
-							CASPAR_LOG(trace) << L"Retrieving information for file " << iter->path().wstring();
-							media_info_repo_->get(iter->path().wstring());
-						}
-					}
-					else
+					if (!running_)
 					{
 						CASPAR_LOG(info) << L"Initial media information retrieval aborted.";
 						return;
 					}
+
+					if (boost::filesystem::is_regular_file(iter->path()))
+						files.push_back(iter->path().wstring());
+				}
+
+				// Files already in the persisted cache with unchanged size and
+				// modification time are answered without probing, so only new or
+				// changed files keep the workers busy.
+				tbb::atomic<std::size_t> next_file;
+				next_file = 0;
+				boost::thread_group workers;
+
+				for (unsigned int i = 0; i < std::max(1u, scan_threads); ++i)
+				{
+					workers.create_thread([&]
+					{
+						ensure_gpf_handler_installed_for_thread("media scan worker");
+
+						while (running_)
+						{
+							auto index = next_file++;
+
+							if (index >= files.size())
+								return;
+
+							try
+							{
+								CASPAR_LOG(trace) << L"Retrieving information for file " << files[index];
+								media_info_repo_->get(files[index]);
+							}
+							catch (...)
+							{
+								CASPAR_LOG_CURRENT_EXCEPTION();
+							}
+						}
+					});
+				}
+
+				workers.join_all();
+
+				if (!running_)
+				{
+					CASPAR_LOG(info) << L"Initial media information retrieval aborted.";
+					return;
 				}
 
+				media_info_repo_->persist();
 				CASPAR_LOG(info) << L"Initial media information retrieval finished.";
 			}
 			catch (...)
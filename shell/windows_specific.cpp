@@ -53,6 +53,7 @@ LONG WINAPI UserUnhandledExceptionFilter(EXCEPTION_POINTERS* info)
 			<< L"Continuing execution. \n#######################";
 
 		CASPAR_LOG_CALL_STACK();
+		log::flush();
 	}
 	catch (...){}
 
@@ -0,0 +1,61 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/cpu_affinity.h>
+#include <common/except.h>
+
+namespace caspar {
+
+TEST(CpuAffinityTest, ParsesProcessorList)
+{
+	EXPECT_EQ(std::vector<int>({ 0, 1, 2, 3, 8, 10, 11 }), parse_processor_list(L"0-3,8, 10-11"));
+	EXPECT_EQ(std::vector<int>({ 1, 2, 3 }), parse_processor_list(L"3,1-2,2"));
+	EXPECT_TRUE(parse_processor_list(L"").empty());
+}
+
+TEST(CpuAffinityTest, RejectsInvalidProcessorList)
+{
+	EXPECT_THROW(parse_processor_list(L"a-b"), user_error);
+	EXPECT_THROW(parse_processor_list(L"3-1"), user_error);
+	EXPECT_THROW(parse_processor_list(L"-1"), user_error);
+}
+
+TEST(CpuAffinityTest, PrintsRanges)
+{
+	EXPECT_EQ(L"0-3,8,10-11", print_processor_list({ 0, 1, 2, 3, 8, 10, 11 }));
+	EXPECT_EQ(L"5", print_processor_list({ 5 }));
+	EXPECT_EQ(L"0-7,16-23", cpu_affinity::from_processor_list(L"16-23,0-7").print());
+}
+
+TEST(CpuAffinityTest, EmptyAffinityDoesNotBind)
+{
+	cpu_affinity affinity;
+
+	EXPECT_TRUE(affinity.empty());
+	affinity.bind_current_thread();
+}
+
+}
@@ -0,0 +1,194 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/executor.h>
+#include <common/except.h>
+
+#include <boost/thread.hpp>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+namespace caspar {
+
+TEST(ExecutorTest, InvokeReturnsResult)
+{
+	executor exec(L"test");
+
+	EXPECT_EQ(42, exec.invoke([] { return 42; }));
+	EXPECT_EQ(L"42", exec.begin_invoke([] { return std::wstring(L"42"); }).get());
+}
+
+TEST(ExecutorTest, ExceptionIsPropagated)
+{
+	executor exec(L"test");
+
+	auto future = exec.begin_invoke([]() -> int { CASPAR_THROW_EXCEPTION(invalid_argument() << msg_info("test")); });
+
+	EXPECT_THROW(future.get(), invalid_argument);
+	EXPECT_EQ(1, exec.invoke([] { return 1; }));
+}
+
+TEST(ExecutorTest, TasksOfSamePriorityRunInOrder)
+{
+	executor exec(L"test");
+	std::vector<int> order;
+	std::vector<std::future<void>> futures;
+
+	for (int i = 0; i < 1000; ++i)
+		futures.push_back(exec.begin_invoke([&order, i] { order.push_back(i); }));
+
+	for (auto& future : futures)
+		future.get();
+
+	ASSERT_EQ(1000u, order.size());
+
+	for (int i = 0; i < 1000; ++i)
+		EXPECT_EQ(i, order[i]);
+}
+
+TEST(ExecutorTest, HigherPriorityRunsFirst)
+{
+	executor exec(L"test");
+	std::vector<task_priority> order;
+	std::promise<void> blocker;
+	auto blocked = blocker.get_future().share();
+
+	exec.begin_invoke([=] { blocked.wait(); });
+
+	auto low	= exec.begin_invoke([&] { order.push_back(task_priority::low_priority); }, task_priority::low_priority);
+	auto normal	= exec.begin_invoke([&] { order.push_back(task_priority::normal_priority); });
+	auto higher	= exec.begin_invoke([&] { order.push_back(task_priority::higher_priority); }, task_priority::higher_priority);
+
+	blocker.set_value();
+	low.get();
+	normal.get();
+	higher.get();
+
+	ASSERT_EQ(3u, order.size());
+	EXPECT_EQ(task_priority::higher_priority, order[0]);
+	EXPECT_EQ(task_priority::normal_priority, order[1]);
+	EXPECT_EQ(task_priority::low_priority, order[2]);
+}
+
+TEST(ExecutorTest, WaitingForOwnTaskDoesNotDeadlock)
+{
+	executor exec(L"test");
+
+	auto result = exec.invoke([&]
+	{
+		return exec.begin_invoke([] { return 7; }).get();
+	});
+
+	EXPECT_EQ(7, result);
+}
+
+TEST(ExecutorTest, FullQueueBlocksCallerUntilSpaceAvailable)
+{
+	executor exec(L"test");
+	std::promise<void> started;
+	std::promise<void> blocker;
+	auto blocked = blocker.get_future().share();
+
+	exec.set_capacity(2);
+	exec.begin_invoke([&] { started.set_value(); blocked.wait(); });
+	started.get_future().wait();
+	exec.begin_invoke([] { });
+	exec.begin_invoke([] { });
+
+	EXPECT_TRUE(exec.is_full());
+
+	auto producer = std::async(std::launch::async, [&] { return exec.begin_invoke([] { return 3; }).get(); });
+
+	EXPECT_EQ(std::future_status::timeout, producer.wait_for(std::chrono::milliseconds(50)));
+
+	blocker.set_value();
+
+	EXPECT_EQ(3, producer.get());
+}
+
+TEST(ExecutorTest, ClearDropsQueuedTasks)
+{
+	executor exec(L"test");
+	std::promise<void> blocker;
+	auto blocked = blocker.get_future().share();
+
+	exec.begin_invoke([=] { blocked.wait(); });
+	auto dropped = exec.begin_invoke([] { });
+
+	exec.clear();
+	blocker.set_value();
+
+	EXPECT_THROW(dropped.get(), std::future_error);
+	EXPECT_EQ(0u, exec.size());
+}
+
+TEST(ExecutorTest, ConcurrentProducers)
+{
+	static const int NUM_PRODUCERS	= 4;
+	static const int NUM_TASKS		= 10000;
+
+	executor exec(L"test");
+	int sum = 0;
+	boost::thread_group producers;
+
+	for (int p = 0; p < NUM_PRODUCERS; ++p)
+	{
+		producers.create_thread([&]
+		{
+			for (int i = 0; i < NUM_TASKS; ++i)
+				exec.begin_invoke([&] { ++sum; }, static_cast<task_priority>(i % 6));
+		});
+	}
+
+	producers.join_all();
+	exec.wait();
+
+	EXPECT_EQ(NUM_PRODUCERS * NUM_TASKS, sum);
+}
+
+TEST(ExecutorTest, ManyTasksComplete)
+{
+	static const int NUM_TASKS = 1000;
+
+	executor exec(L"test");
+	std::vector<std::future<int>> futures;
+
+	for (int i = 0; i < NUM_TASKS; ++i)
+	{
+		exec.invoke([] { });
+		futures.push_back(exec.begin_invoke([i] { return i; }));
+	}
+
+	long long sum = 0;
+
+	for (auto& future : futures)
+		sum += future.get();
+
+	EXPECT_EQ(static_cast<long long>(NUM_TASKS) * (NUM_TASKS - 1) / 2, sum);
+}
+
+}
@@ -0,0 +1,174 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <core/producer/binding.h>
+#include <core/producer/variable.h>
+#include <core/producer/scene/expression_parser.h>
+#include <core/producer/scene/scene_producer.h>
+#include <core/frame/draw_frame.h>
+#include <core/video_format.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <map>
+#include <memory>
+
+namespace caspar { namespace core {
+
+namespace {
+
+struct variables
+{
+	std::map<std::wstring, std::shared_ptr<variable>> by_name;
+
+	template<typename T>
+	binding<T>& add(const std::wstring& name, T initial_value)
+	{
+		auto var = std::make_shared<variable_impl<T>>(L"", true, initial_value);
+		by_name[name] = var;
+
+		return var->value();
+	}
+
+	scene::variable_repository repo()
+	{
+		return [this](const std::wstring& name) -> variable& { return *by_name.at(name); };
+	}
+};
+
+}
+
+TEST(ExpressionParserTest, RespectsOperatorPrecedence)
+{
+	variables vars;
+
+	EXPECT_EQ(7.0, scene::parse_expression<double>(L"1 + 2 * 3", vars.repo()).get());
+	EXPECT_EQ(9.0, scene::parse_expression<double>(L"(1 + 2) * 3", vars.repo()).get());
+	EXPECT_EQ(1.0, scene::parse_expression<double>(L"7 % 3", vars.repo()).get());
+	EXPECT_TRUE(scene::parse_expression<bool>(L"1 < 2 && !(2 < 1)", vars.repo()).get());
+}
+
+TEST(ExpressionParserTest, FollowsVariables)
+{
+	variables vars;
+	auto& x = vars.add<double>(L"x", 1.0);
+	auto& name = vars.add<std::wstring>(L"name", L"Text");
+
+	auto number = scene::parse_expression<double>(L"-x * 2 + abs(x - 10)", vars.repo());
+	auto text = scene::parse_expression<std::wstring>(L"x > 3 ? to_upper(name) : name + length(name)", vars.repo());
+
+	EXPECT_EQ(7.0, number.get());
+	EXPECT_EQ(L"Text4", text.get());
+
+	x.set(5.0);
+	name.set(L"Other");
+
+	EXPECT_EQ(-5.0, number.get());
+	EXPECT_EQ(L"OTHER", text.get());
+}
+
+TEST(BindingTest, EvaluatesSharedDependantOnceAfterAllDependencies)
+{
+	binding<double> source(1.0);
+	auto left = source + 1.0;
+	auto right = source * 2.0;
+	int evaluations = 0;
+	double seen_left = 0.0;
+	double seen_right = 0.0;
+
+	binding<double> sum([&]
+	{
+		++evaluations;
+		seen_left = left.get();
+		seen_right = right.get();
+
+		return seen_left + seen_right;
+	});
+	sum.depend_on(left);
+	sum.depend_on(right);
+
+	EXPECT_EQ(4.0, sum.get());
+	evaluations = 0;
+
+	source.set(2.0);
+
+	EXPECT_EQ(1, evaluations);
+	EXPECT_EQ(3.0, seen_left);
+	EXPECT_EQ(4.0, seen_right);
+	EXPECT_EQ(7.0, sum.get());
+}
+
+TEST(BindingTest, SkipsDependantsOfUnchangedValues)
+{
+	binding<double> source(1.0);
+	auto above = source > 5.0;
+	int evaluations = 0;
+
+	auto counted = above.transformed([&](bool value) { ++evaluations; return value; });
+
+	counted.get();
+	evaluations = 0;
+
+	source.set(2.0);
+	source.set(3.0);
+
+	EXPECT_EQ(0, evaluations);
+
+	source.set(6.0);
+
+	EXPECT_EQ(1, evaluations);
+	EXPECT_TRUE(counted.get());
+}
+
+TEST(ExpressionParserTest, SceneBindingsFollowFrames)
+{
+	static const int NUM_BINDINGS	= 10;
+	static const int NUM_FRAMES		= 5;
+
+	scene::scene_producer scene(L"test", L"test", 1920, 1080, video_format_desc(video_format::x1080p5000));
+	auto repo = [&](const std::wstring& name) -> variable& { return scene.get_variable(name); };
+
+	for (int i = 0; i < NUM_BINDINGS; ++i)
+	{
+		auto index = boost::lexical_cast<std::wstring>(i);
+		auto& var = scene.create_variable<double>(L"v" + index, false);
+
+		var.bind(scene::parse_expression<double>(
+				L"frame * 2 + (frame % 2 < 1 ? " + index + L" : scene_width)",
+				repo));
+	}
+
+	for (int frame = 0; frame < NUM_FRAMES; ++frame)
+		scene.receive_impl();
+
+	auto last_frame = static_cast<double>(NUM_FRAMES - 1);
+
+	EXPECT_EQ(last_frame, scene.get_variable(L"frame").as<double>().get());
+
+	for (int i = 0; i < NUM_BINDINGS; ++i)
+		EXPECT_EQ(last_frame * 2 + i, scene.get_variable(L"v" + boost::lexical_cast<std::wstring>(i)).as<double>().get());
+}
+
+}}
@@ -28,6 +28,7 @@
 #include <core/frame/pixel_format.h>
 #include <core/frame/frame_transform.h>
 #include <core/frame/draw_frame.h>
+#include <core/frame/geometry.h>
 
 #include <accelerator/ogl/image/image_mixer.h>
 #include <accelerator/ogl/util/device.h>
@@ -215,6 +216,26 @@ TYPED_TEST(MixerTestEveryImpl, HalfAlpha)
 	assert_all_pixels_eq(0, 127, 0, 127, this->get_result(16, 16));
 }
 
+TYPED_TEST(MixerTestEveryImpl, QuadListGeometry)
+{
+	auto atlas = this->create_frame(2, 1);
+	set_pixel(atlas, 0, 0, 255, 0, 0, 255);
+	set_pixel(atlas, 1, 0, 0, 255, 0, 255);
+
+	// Draw the two texels swapped, the way a text producer draws glyphs.
+	std::vector<core::frame_geometry::coord> coords = {
+		{ 0.0, 0.0, 0.5, 0.0 }, { 0.5, 0.0, 1.0, 0.0 }, { 0.5, 1.0, 1.0, 1.0 }, { 0.0, 1.0, 0.5, 1.0 },
+		{ 0.5, 0.0, 0.0, 0.0 }, { 1.0, 0.0, 0.5, 0.0 }, { 1.0, 1.0, 0.5, 1.0 }, { 0.5, 1.0, 0.0, 1.0 }
+	};
+	atlas.set_geometry(core::frame_geometry(core::frame_geometry::geometry_type::quad_list, std::move(coords)));
+
+	this->add_layer(core::draw_frame(std::move(atlas)));
+	auto result = this->get_result(2, 1);
+
+	assert_pixel_eq(0, 255, 0, 255, result.data());
+	assert_pixel_eq(255, 0, 0, 255, result.data() + 4);
+}
+
 // Tests for use cases that currently *only* works on GPU mixer
 // ------------------------------------------------------------
 
@@ -0,0 +1,94 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/diagnostics/latency_stats.h>
+
+namespace caspar { namespace diagnostics {
+
+TEST(LatencyHistogramTest, BucketsAreWithinOneSixteenth)
+{
+	for (std::int64_t value = 0; value < 1000000; value += 7)
+	{
+		auto bucket = latency_histogram::bucket_of(value);
+		auto highest = latency_histogram::highest_equivalent_value(bucket);
+
+		ASSERT_LT(bucket, latency_histogram::NUM_BUCKETS);
+		ASSERT_GE(highest, value);
+		ASSERT_LE(highest - value, value / 16);
+	}
+
+	EXPECT_LT(latency_histogram::bucket_of(std::numeric_limits<std::int64_t>::max()), latency_histogram::NUM_BUCKETS);
+}
+
+TEST(LatencyHistogramTest, Percentiles)
+{
+	latency_histogram histogram;
+
+	for (int value = 1; value <= 1000; ++value)
+		histogram.record(value);
+
+	auto snapshot = histogram.get_snapshot();
+
+	EXPECT_EQ(1000u, snapshot.count());
+	EXPECT_EQ(1000, snapshot.max());
+	EXPECT_DOUBLE_EQ(500.5, snapshot.mean());
+	EXPECT_NEAR(500, snapshot.value_at(0.5), 500 / 16);
+	EXPECT_NEAR(990, snapshot.value_at(0.99), 990 / 16);
+	EXPECT_EQ(1000, snapshot.value_at(1.0));
+}
+
+TEST(LatencyHistogramTest, SnapshotSinceEarlier)
+{
+	latency_histogram histogram;
+
+	for (int i = 0; i < 100; ++i)
+		histogram.record(10000);
+
+	auto earlier = histogram.get_snapshot();
+
+	for (int i = 0; i < 100; ++i)
+		histogram.record(100);
+
+	auto interval = histogram.get_snapshot().since(earlier);
+
+	EXPECT_EQ(100u, interval.count());
+	EXPECT_NEAR(100, interval.value_at(0.99), 100 / 16);
+	EXPECT_NEAR(100, interval.max(), 100 / 16);
+}
+
+TEST(LatencyStatsTest, CountsLateFramesAgainstBudget)
+{
+	latency_stats stats;
+
+	stats.record_frame_time(0.010, 50.0);
+	stats.record_frame_time(0.030, 50.0);
+	stats.record_frame_time(0.030, 0.0);
+	stats.record_underflow();
+
+	EXPECT_EQ(1u, stats.late());
+	EXPECT_EQ(1u, stats.underflows());
+}
+
+}}
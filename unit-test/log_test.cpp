@@ -0,0 +1,64 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/log.h>
+
+#include <boost/thread.hpp>
+
+namespace caspar { namespace log {
+
+TEST(RateLimiterTest, SuppressesAfterMaxMessages)
+{
+	rate_limiter limiter(3, 1000000);
+
+	EXPECT_EQ(0, limiter.acquire());
+	EXPECT_EQ(0, limiter.acquire());
+	EXPECT_EQ(0, limiter.acquire());
+	EXPECT_EQ(-1, limiter.acquire());
+	EXPECT_EQ(-1, limiter.acquire());
+}
+
+TEST(RateLimiterTest, ReportsSuppressedInNextInterval)
+{
+	rate_limiter limiter(1, 50);
+
+	EXPECT_EQ(0, limiter.acquire());
+	EXPECT_EQ(-1, limiter.acquire());
+	EXPECT_EQ(-1, limiter.acquire());
+
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(60));
+
+	EXPECT_EQ(2, limiter.acquire());
+	EXPECT_EQ(-1, limiter.acquire());
+}
+
+TEST(RateLimiterTest, SuppressedNote)
+{
+	EXPECT_EQ(L"", suppressed_note(0));
+	EXPECT_EQ(L"(2 similar messages suppressed) ", suppressed_note(2));
+}
+
+}}
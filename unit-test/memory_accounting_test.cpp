@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/diagnostics/memory_accounting.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+namespace caspar { namespace diagnostics {
+
+TEST(MemoryAccountingTest, UsageIsReleasedWithAccount)
+{
+	auto before = get_memory_usage();
+
+	{
+		memory_account account(L"test-release", 1, 10);
+
+		account.add(1000);
+		account.subtract(400);
+		EXPECT_EQ(600, account.bytes());
+		EXPECT_EQ(600, get_memory_usage(L"test-release"));
+
+		account.set(250);
+		EXPECT_EQ(250, get_memory_usage(L"test-release"));
+		EXPECT_EQ(before + 250, get_memory_usage());
+	}
+
+	EXPECT_EQ(0, get_memory_usage(L"test-release"));
+	EXPECT_EQ(before, get_memory_usage());
+}
+
+TEST(MemoryAccountingTest, SubsystemBudget)
+{
+	memory_account first(L"test-budget");
+	memory_account second(L"test-budget");
+
+	EXPECT_FALSE(first.over_budget());
+
+	set_memory_budget(L"test-budget", 1000);
+	first.add(600);
+	EXPECT_FALSE(second.over_budget());
+
+	second.add(600);
+	EXPECT_TRUE(first.over_budget());
+	EXPECT_TRUE(second.over_budget());
+
+	second.set(0);
+	EXPECT_FALSE(first.over_budget());
+
+	set_memory_budget(L"test-budget", 0);
+}
+
+TEST(MemoryAccountingTest, TotalBudget)
+{
+	memory_account account(L"test-total");
+
+	set_memory_budget(get_memory_usage() + 1000);
+	account.add(500);
+	EXPECT_FALSE(account.over_budget());
+
+	account.add(1000);
+	EXPECT_TRUE(account.over_budget());
+
+	set_memory_budget(0);
+	EXPECT_FALSE(account.over_budget());
+}
+
+TEST(MemoryAccountingTest, InfoIsBrokenDownPerChannelAndLayer)
+{
+	memory_account layer10(L"test-info", 1, 10);
+	memory_account layer20(L"test-info", 1, 20);
+	memory_account other_layer10(L"test-info", 1, 10);
+
+	layer10.add(100);
+	layer20.add(200);
+	other_layer10.add(300);
+
+	auto info = get_memory_info();
+	bool found = false;
+
+	for (auto& subsystem : info.get_child(L"subsystems"))
+	{
+		if (subsystem.second.get<std::wstring>(L"name") != L"test-info")
+			continue;
+
+		found = true;
+		EXPECT_EQ(600, subsystem.second.get<std::int64_t>(L"used"));
+
+		auto& owners = subsystem.second.get_child(L"owners");
+		ASSERT_EQ(2u, owners.size());
+
+		auto owner = owners.begin();
+		EXPECT_EQ(1, owner->second.get<int>(L"channel"));
+		EXPECT_EQ(10, owner->second.get<int>(L"layer"));
+		EXPECT_EQ(400, owner->second.get<std::int64_t>(L"used"));
+
+		++owner;
+		EXPECT_EQ(20, owner->second.get<int>(L"layer"));
+		EXPECT_EQ(200, owner->second.get<std::int64_t>(L"used"));
+	}
+
+	EXPECT_TRUE(found);
+}
+
+}}
@@ -0,0 +1,68 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Helge Norberg, helge.norberg@svt.se
+*/
+
+
+#include "stdafx.h"
+
+#include <gtest/gtest.h>
+
+#include <common/task_arena.h>
+#include <common/except.h>
+
+#include <tbb/atomic.h>
+#include <tbb/parallel_for.h>
+
+#include <stdexcept>
+
+namespace caspar {
+
+TEST(TaskArenaTest, RunsParallelWork)
+{
+	task_arena arena(2, 1, task_arena_priority::high);
+	tbb::atomic<int> sum;
+	sum = 0;
+
+	arena.execute([&]
+	{
+		tbb::parallel_for(0, 1000, [&](int i) { sum += i; });
+	});
+
+	EXPECT_EQ(999 * 1000 / 2, sum);
+	EXPECT_EQ(2, arena.max_threads());
+	EXPECT_EQ(task_arena_priority::high, arena.priority());
+}
+
+TEST(TaskArenaTest, ExceptionIsPropagated)
+{
+	task_arena arena;
+
+	EXPECT_THROW(arena.execute([] { throw std::runtime_error("test"); }), std::runtime_error);
+}
+
+TEST(TaskArenaTest, ParsesPriority)
+{
+	EXPECT_EQ(task_arena_priority::low, task_arena_priority_from_string(L"low"));
+	EXPECT_EQ(task_arena_priority::high, task_arena_priority_from_string(L"HIGH"));
+	EXPECT_EQ(L"normal", to_string(task_arena_priority_from_string(L"normal")));
+	EXPECT_THROW(task_arena_priority_from_string(L"urgent"), user_error);
+}
+
+}